@@ -0,0 +1,95 @@
+// Binary AST image reload vs lex + parse.
+//
+// Build and run from the repository root:
+//   g++ -std=c++20 -O2 -I. bench/ast_load_bench.cpp $(find core evolution -name '*.cpp') -lpthread -o ast_load_bench
+//   ./ast_load_bench [programs] [rounds]
+//
+// The corpus is ProgramGenerator's default corpus (seed 1), so every run
+// and every machine times the same programs. Each round rebuilds all of
+// them three ways: lexing and parsing their text, decoding their images
+// from memory, and mmap-loading their images from disk.
+
+#include "../core/lexer/lexer.hpp"
+#include "../core/parser/parser.hpp"
+#include "../core/serialize/ast_binary.hpp"
+#include "../core/utils/timer.hpp"
+#include "../evolution/operators/program_generator.hpp"
+#include <cstdio>
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    ProgramGenerator gen;
+    std::vector<std::string> texts;
+    std::vector<std::vector<uint8_t>> images;
+    std::vector<std::string> paths;
+    std::string dir = "ast_load_bench." + std::to_string(::getpid());
+    if (::mkdir(dir.c_str(), 0755) != 0)
+    {
+        std::fprintf(stderr, "cannot create %s\n", dir.c_str());
+        return 1;
+    }
+    size_t textBytes = 0, imageBytes = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        auto prog = gen.generate(i);
+        texts.push_back(gen.generateText(i));
+        images.push_back(AstBinary::encode(*prog));
+        paths.push_back(dir + "/" + std::to_string(i) + ".gxab");
+        AstBinary::save(*prog, paths.back());
+        textBytes += texts.back().size();
+        imageBytes += images.back().size();
+    }
+
+    double bestParse = 1e30, bestDecode = 1e30, bestLoad = 1e30;
+    size_t sink = 0;
+    for (int r = 0; r < rounds; r++)
+    {
+        double t0 = wallSeconds();
+        for (const auto &text : texts)
+        {
+            Lexer lexer(text);
+            std::vector<Token> tokens = lexer.tokenize();
+            Parser parser(tokens);
+            parser.setEcho(false);
+            auto prog = parser.parse();
+            sink += prog ? prog->decls.size() : 0;
+        }
+        double t1 = wallSeconds();
+        for (const auto &image : images)
+        {
+            auto prog = AstBinary::decode(image.data(), image.size());
+            sink += prog ? prog->decls.size() : 0;
+        }
+        double t2 = wallSeconds();
+        for (const auto &path : paths)
+        {
+            auto prog = AstBinary::load(path);
+            sink += prog ? prog->decls.size() : 0;
+        }
+        double t3 = wallSeconds();
+        bestParse = std::min(bestParse, t1 - t0);
+        bestDecode = std::min(bestDecode, t2 - t1);
+        bestLoad = std::min(bestLoad, t3 - t2);
+    }
+
+    for (const auto &path : paths)
+        std::remove(path.c_str());
+    ::rmdir(dir.c_str());
+
+    std::printf("%zu programs, %zu bytes of text, %zu bytes of images (best of %d)\n", count, textBytes,
+                imageBytes, rounds);
+    std::printf("  lex + parse   %8.4f s  %6.2f us/program\n", bestParse, bestParse * 1e6 / count);
+    std::printf("  decode        %8.4f s  %6.2f us/program\n", bestDecode, bestDecode * 1e6 / count);
+    std::printf("  mmap + decode %8.4f s  %6.2f us/program\n", bestLoad, bestLoad * 1e6 / count);
+    std::printf("  (checksum %zu)\n", sink);
+    return 0;
+}
@@ -0,0 +1,124 @@
+// The map table alone vs std::unordered_map, in ns per operation.
+//
+// Build and run from the repository root (add -DMUTAGEN_NO_SIMD to time
+// the plain-loop group probe):
+//   g++ -std=c++20 -O2 -I. bench/hash_map_bench.cpp $(find core evolution -name '*.cpp') -lpthread -o hash_map_bench
+//   ./hash_map_bench [keys] [rounds]
+//
+// Each round puts `keys` distinct keys (default 200000) into an empty
+// table, then finds every one of them, best of `rounds` (default 5).
+// Number keys are 0..keys-1 in a fixed shuffled order; text keys are
+// "key-of-the-table-" + that number, too long to be inline texts.
+// std::unordered_map gets the same keys as double and std::string, with no
+// reserve(), as mapPut has none.
+
+#include "../core/runtime/hash_map.hpp"
+#include "../core/utils/timer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    volatile size_t g_sink;
+
+    struct Times
+    {
+        double put = 1e300;
+        double find = 1e300;
+    };
+
+    Times timeTable(const std::vector<Value> &keys, int rounds)
+    {
+        Times best;
+        ValueHeap heap;
+        for (int r = 0; r < rounds; r++)
+        {
+            heap.clear();
+            Value m = heap.map();
+            double t0 = wallSeconds();
+            for (const Value &k : keys)
+                mapPut(m.map(), k, k, heap);
+            double t1 = wallSeconds();
+            size_t found = 0;
+            for (const Value &k : keys)
+                found += mapFind(m.map(), k) != nullptr;
+            double t2 = wallSeconds();
+            g_sink = found;
+            best.put = std::min(best.put, t1 - t0);
+            best.find = std::min(best.find, t2 - t1);
+        }
+        return best;
+    }
+
+    template <typename K>
+    Times timeStd(const std::vector<K> &keys, int rounds)
+    {
+        Times best;
+        for (int r = 0; r < rounds; r++)
+        {
+            std::unordered_map<K, K> m;
+            double t0 = wallSeconds();
+            for (const K &k : keys)
+                m[k] = k;
+            double t1 = wallSeconds();
+            size_t found = 0;
+            for (const K &k : keys)
+                found += m.find(k) != m.end();
+            double t2 = wallSeconds();
+            g_sink = found;
+            best.put = std::min(best.put, t1 - t0);
+            best.find = std::min(best.find, t2 - t1);
+        }
+        return best;
+    }
+
+    void report(const char *what, size_t n, const Times &table, const Times &std)
+    {
+        std::printf("  %-12s put %6.1f ns vs %6.1f ns   find %6.1f ns vs %6.1f ns\n", what, 1e9 * table.put / n,
+                    1e9 * std.put / n, 1e9 * table.find / n, 1e9 * std.find / n);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    // A fixed shuffle, so every run and build sees the same key order.
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++)
+        order[i] = i;
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    for (size_t i = n; i > 1; i--)
+    {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+        std::swap(order[i - 1], order[(x >> 33) % i]);
+    }
+
+    ValueHeap keyHeap;
+    std::vector<Value> numbers, texts;
+    std::vector<double> stdNumbers;
+    std::vector<std::string> stdTexts;
+    for (size_t i : order)
+    {
+        std::string s = "key-of-the-table-" + std::to_string(i);
+        numbers.push_back(Value::number(double(i)));
+        texts.push_back(keyHeap.text(s));
+        stdNumbers.push_back(double(i));
+        stdTexts.push_back(s);
+    }
+
+#ifdef MUTAGEN_NO_SIMD
+    const char *probe = "plain loop";
+#else
+    const char *probe = "SSE2";
+#endif
+    std::printf("%zu keys, best of %d, %s probe (table vs std::unordered_map)\n", n, rounds, probe);
+    report("number keys", n, timeTable(numbers, rounds), timeStd(stdNumbers, rounds));
+    report("text keys", n, timeTable(texts, rounds), timeStd(stdTexts, rounds));
+    return 0;
+}
@@ -0,0 +1,86 @@
+// Subtree mutation throughput.
+//
+// Build and run from the repository root:
+//   g++ -std=c++20 -O2 -I. bench/mutation_bench.cpp $(find core evolution -name '*.cpp') -lpthread -o mutation_bench
+//   ./mutation_bench [programs] [edits-per-program]
+//
+// Every operator runs `edits` times on a fresh clone of each program of the
+// default generator corpus (seed 1), through one Mutator, i.e. one index
+// build per program. The "rescan" column charges a full index rebuild to
+// every edit instead: the cost of finding a random node by walking the
+// pointer tree, which is what the index replaces.
+
+#include "../core/parser/ast_clone.hpp"
+#include "../core/utils/timer.hpp"
+#include "../evolution/operators/mutation.hpp"
+#include "../evolution/operators/program_generator.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    const char *opName(MutationOp op)
+    {
+        switch (op)
+        {
+        case MutationOp::ReplaceExpr:
+            return "replace expr";
+        case MutationOp::WrapExpr:
+            return "wrap expr";
+        case MutationOp::MutateLiteral:
+            return "mutate literal";
+        case MutationOp::RenameIdentifier:
+            return "rename identifier";
+        case MutationOp::DeleteStmt:
+            return "delete stmt";
+        case MutationOp::WrapStmt:
+            return "wrap stmt";
+        default:
+            return "?";
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200;
+    unsigned edits = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : 200;
+
+    ProgramGenerator gen;
+    std::vector<std::unique_ptr<Program>> corpus;
+    for (size_t i = 0; i < count; i++)
+        corpus.push_back(gen.generate(i));
+
+    std::printf("%zu programs, %u edits per program and operator\n", count, edits);
+    std::printf("  %-18s %14s %14s\n", "operator", "indexed/s", "rescan/s");
+    for (int o = 0; o < static_cast<int>(MutationOp::Count); o++)
+    {
+        MutationOp op = static_cast<MutationOp>(o);
+        uint64_t done = 0, doneRescan = 0;
+        double indexed = 0, rescan = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            RandomStream rng(1, o, i, RngStream::Mutation);
+            auto prog = AstCloner::clone(*corpus[i]);
+            double t0 = wallSeconds();
+            Mutator m(*prog);
+            for (unsigned k = 0; k < edits; k++)
+                done += m.apply(op, rng);
+            indexed += wallSeconds() - t0;
+
+            RandomStream rng2(1, o, i, RngStream::Mutation);
+            auto prog2 = AstCloner::clone(*corpus[i]);
+            t0 = wallSeconds();
+            for (unsigned k = 0; k < edits; k++)
+            {
+                Mutator fresh(*prog2);
+                doneRescan += fresh.apply(op, rng2);
+            }
+            rescan += wallSeconds() - t0;
+        }
+        std::printf("  %-18s %14.0f %14.0f\n", opName(op), done / indexed, doneRescan / rescan);
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+// Generational vs steady-state GA under straggling evaluations.
+//
+// Build and run from the repository root:
+//   g++ -std=c++20 -O2 -I. bench/steady_state_bench.cpp $(find core evolution -name '*.cpp') -lpthread -o steady_state_bench
+//   ./steady_state_bench [threads...]
+//
+// Both modes score the same budget: population 100 for 10 generations,
+// 1000 candidates including the seeds, from the first 100 programs of the
+// runnable generator corpus. Fitness is a cheap hash of the program plus a
+// sleep of 2 ms * 2^k, k = 0..6 with probability halving at each step
+// (128 ms takes the remainder), chosen by that hash: a heavy tail that
+// leaves a generational run waiting on its slowest candidate. dedupe is
+// off so every candidate is scored in both modes. Occupancy is the time
+// spent in fitness calls over wall time * threads, so the number holds on
+// a single core too, where sleeping workers do not compete.
+
+#include "../core/parser/ast_hash.hpp"
+#include "../core/utils/timer.hpp"
+#include "../evolution/engine/ga_controller.hpp"
+#include "../evolution/engine/steady_state.hpp"
+#include "../evolution/operators/mutation.hpp"
+#include "../evolution/operators/program_generator.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    std::atomic<uint64_t> g_busyNanos{0};
+
+    FitnessRecord straggler(const Program &prog, EvalWorkspace &)
+    {
+        double t0 = wallSeconds();
+        uint64_t h = AstHasher::hash(prog);
+        int k = 0;
+        while (k < 6 && (h >> (20 + k) & 1))
+            k++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2 << k));
+        FitnessRecord r;
+        r.score = static_cast<double>(h % 1000) / 1000.0;
+        r.evaluated = true;
+        g_busyNanos += static_cast<uint64_t>((wallSeconds() - t0) * 1e9);
+        return r;
+    }
+
+    GAConfig config(unsigned threads)
+    {
+        GAConfig c;
+        c.threads = threads;
+        c.populationSize = 100;
+        c.generations = 10;
+        c.targetFitness = 2.0; // never reached: both modes spend the whole budget
+        c.dedupe = false;
+        return c;
+    }
+
+    std::vector<std::unique_ptr<Program>> seeds(size_t n)
+    {
+        ProgramGenerator gen(GeneratorConfig::runnable());
+        std::vector<std::unique_ptr<Program>> out;
+        for (size_t i = 0; i < n; i++)
+            out.push_back(gen.generate(i));
+        return out;
+    }
+
+    void report(const char *mode, double wall, unsigned threads, double best)
+    {
+        const double candidates = 1000.0;
+        double busy = static_cast<double>(g_busyNanos.load()) * 1e-9;
+        std::printf("  %-13s %8.2f s %8.0f cand/s %7.1f%% busy   best %.3f\n", mode, wall, candidates / wall,
+                    100.0 * busy / (wall * threads), best);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<unsigned> threadCounts;
+    for (int i = 1; i < argc; i++)
+        threadCounts.push_back(static_cast<unsigned>(std::atoi(argv[i])));
+    if (threadCounts.empty())
+        threadCounts = {4, 8, 16};
+
+    for (unsigned threads : threadCounts)
+    {
+        std::printf("%u threads\n", threads);
+        {
+            GAController ga(config(threads), straggler);
+            ga.setMutation(Mutator::makeMutationFn());
+            ga.seed(seeds(100));
+            g_busyNanos = 0;
+            double t0 = wallSeconds();
+            ga.run();
+            report("generational", wallSeconds() - t0, threads, ga.best().fitness.score);
+        }
+        {
+            SteadyStateGA ga(config(threads), straggler);
+            ga.setMutation(Mutator::makeMutationFn());
+            ga.seed(seeds(100));
+            g_busyNanos = 0;
+            double t0 = wallSeconds();
+            ga.run();
+            report("steady-state", wallSeconds() - t0, threads, ga.best().fitness.score);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+// Vector kernels vs a naive scalar loop, in ns per element.
+//
+// Build and run from the repository root, once per kernel flavour (add
+// -mavx2 for AVX2, nothing for SSE2, -DMUTAGEN_NO_SIMD for plain loops):
+//   g++ -std=c++20 -O2 -mavx2 -I. bench/vector_kernels_bench.cpp $(find core evolution -name '*.cpp') -lpthread -o vector_kernels_bench
+//   ./vector_kernels_bench [rounds]
+//
+// Each size is timed over about 2^24 elements per round, best of `rounds`.
+// The reference loops are what the VM ran before the kernels: one
+// accumulator, left to right. Inputs are the same pseudo-random doubles
+// on every build.
+
+#include "../core/runtime/vector_kernels.hpp"
+#include "../core/utils/timer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    volatile double g_sink;
+
+    double refDot(const double *a, const double *b, size_t n)
+    {
+        double s = 0.0;
+        for (size_t i = 0; i < n; i++)
+            s += a[i] * b[i];
+        return s;
+    }
+
+    double refSum(const double *a, size_t n)
+    {
+        double s = 0.0;
+        for (size_t i = 0; i < n; i++)
+            s += a[i];
+        return s;
+    }
+
+    void refAdd(double *out, const double *a, const double *b, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+            out[i] = a[i] + b[i];
+    }
+
+    double refMin(const double *a, size_t n)
+    {
+        double m = a[0];
+        for (size_t i = 1; i < n; i++)
+            m = a[i] < m ? a[i] : m;
+        return m;
+    }
+
+    // Best ns per element of `body` run over n elements, repeated to about
+    // 2^24 elements per round.
+    template <typename F>
+    double nsPerElement(size_t n, int rounds, F body)
+    {
+        size_t reps = std::max<size_t>(1, (size_t(1) << 24) / n);
+        double best = 1e300;
+        for (int r = 0; r < rounds; r++)
+        {
+            double t0 = wallSeconds();
+            for (size_t k = 0; k < reps; k++)
+                body();
+            best = std::min(best, wallSeconds() - t0);
+        }
+        return best * 1e9 / (double(reps) * n);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 5;
+
+#if defined(MUTAGEN_NO_SIMD)
+    const char *flavour = "plain loops";
+#elif defined(__AVX2__)
+    const char *flavour = "AVX2";
+#else
+    const char *flavour = "SSE2";
+#endif
+    std::printf("%s kernels, ns per element, best of %d (kernel / reference)\n", flavour, rounds);
+    std::printf("  %-8s %14s %14s %14s %14s\n", "n", "dot", "sum", "add", "min");
+
+    for (size_t n : {16, 256, 4096, 65536})
+    {
+        std::vector<double> a(n), b(n), out(n);
+        uint64_t x = 0x9E3779B97F4A7C15ull;
+        for (size_t i = 0; i < n; i++)
+        {
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+            a[i] = double(x >> 11) / double(1ull << 53) - 0.5;
+            b[i] = double(x >> 20) / double(1ull << 44) - 0.5;
+        }
+
+        double kd = nsPerElement(n, rounds, [&] { g_sink = vecDot(a.data(), b.data(), n); });
+        double rd = nsPerElement(n, rounds, [&] { g_sink = refDot(a.data(), b.data(), n); });
+        double ks = nsPerElement(n, rounds, [&] { g_sink = vecSum(a.data(), n); });
+        double rs = nsPerElement(n, rounds, [&] { g_sink = refSum(a.data(), n); });
+        double ka = nsPerElement(n, rounds, [&] {
+            vecBinary(VecOp::Add, out.data(), a.data(), b.data(), n);
+            g_sink = out[n - 1];
+        });
+        double ra = nsPerElement(n, rounds, [&] {
+            refAdd(out.data(), a.data(), b.data(), n);
+            g_sink = out[n - 1];
+        });
+        double km = nsPerElement(n, rounds, [&] { g_sink = vecMin(a.data(), n); });
+        double rm = nsPerElement(n, rounds, [&] { g_sink = refMin(a.data(), n); });
+
+        std::printf("  %-8zu %6.2f / %5.2f %6.2f / %5.2f %6.2f / %5.2f %6.2f / %5.2f\n", n, kd, rd, ks, rs, ka, ra, km,
+                    rm);
+    }
+    return 0;
+}
@@ -0,0 +1,321 @@
+// Bytecode VM vs tree walker on fixed Genex programs.
+//
+// Build and run from the repository root:
+//   g++ -std=c++20 -O2 -I. bench/vm_bench.cpp $(find core evolution -name '*.cpp') -lpthread -o vm_bench
+//   ./vm_bench [rounds] [--vm] [program...]
+//
+// Each program's main() runs on both engines, best of `rounds` (default
+// 3); the result and print output must agree. Compilation is not timed.
+// --vm skips the tree walker, for the longer programs that only compare
+// value representations (fib27 and below).
+// Add -DMUTAGEN_NO_COMPUTED_GOTO to time the switch dispatch instead.
+
+#include "../core/lexer/lexer.hpp"
+#include "../core/parser/parser.hpp"
+#include "../core/utils/timer.hpp"
+#include "../core/vm/compiler.hpp"
+#include "../core/vm/tree_walker.hpp"
+#include "../core/vm/vm.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Bench
+    {
+        const char *name;
+        const char *source;
+        int runs = 1; // main() calls per timing, for programs that build short-lived values
+    };
+
+    const Bench kBenches[] = {
+        {"fib", R"(
+            @func fib(number n) {
+                if (n < 2) {
+                    return n;
+                }
+                return fib(n - 1) + fib(n - 2);
+            }
+            @func main() {
+                return fib(25);
+            }
+        )"},
+        // Sum of the multiples of 3 or 5 below 1e6.
+        {"sum", R"(
+            @func main() {
+                number s = 0;
+                loop(number i = 0, i < 1000000, i = i + 1) {
+                    if ((i % 3 == 0) || (i % 5 == 0)) {
+                        s = s + i;
+                    }
+                }
+                return s;
+            }
+        )"},
+        {"iter", R"(
+            @func main() {
+                number e = 0;
+                loop(number k = 0, k < 100000, k = k + 1) {
+                    iter("genex", text c) {
+                        if (c == "e") {
+                            e = e + 1;
+                        }
+                    }
+                }
+                return e;
+            }
+        )"},
+        {"fib27", R"(
+            @func fib(number n) {
+                if (n < 2) {
+                    return n;
+                }
+                return fib(n - 1) + fib(n - 2);
+            }
+            @func main() {
+                return fib(27);
+            }
+        )"},
+        {"sum3e6", R"(
+            @func main() {
+                number s = 0;
+                loop(number i = 0, i < 3000000, i = i + 1) {
+                    s = s + i;
+                }
+                return s;
+            }
+        )"},
+        // Short concatenations and compares.
+        {"cat", R"(
+            @func main() {
+                number n = 0;
+                loop(number i = 0, i < 1000000, i = i + 1) {
+                    text t = "ge" + "nx";
+                    if (t == "genx") {
+                        n = n + 1;
+                    }
+                }
+                return n;
+            }
+        )"},
+        // iter over a 43-character text.
+        {"chars", R"(
+            @func main() {
+                number n = 0;
+                loop(number i = 0, i < 30000, i = i + 1) {
+                    iter("the quick brown fox jumps over the lazy dog", text c) {
+                        if (c == "o") {
+                            n = n + 1;
+                        }
+                    }
+                }
+                return n;
+            }
+        )"},
+        // Short texts built from a number, then compared.
+        {"words", R"(
+            @func main() {
+                number n = 0;
+                loop(number i = 0, i < 1000000, i = i + 1) {
+                    text w = "w" + (i % 10);
+                    if (w == "w7") {
+                        n = n + 1;
+                    }
+                }
+                return n;
+            }
+        )"},
+        // Bool and number registers mixed in one loop.
+        {"mixed", R"(
+            @func main() {
+                number x = 0;
+                bool odd = false;
+                loop(number i = 0, i < 3000000, i = i + 1) {
+                    odd = !odd;
+                    if (odd && (x < 1000000)) {
+                        x = x + 1;
+                    }
+                }
+                return x;
+            }
+        )"},
+        // Texts that grow at their end, one short piece at a time.
+        {"grow", R"(
+            @func main() {
+                text t = "";
+                loop(number i = 0, i < 20000, i = i + 1) {
+                    t = t + "x";
+                }
+                return len(t);
+            }
+        )"},
+        {"growlong", R"(
+            @func main() {
+                text t = "";
+                loop(number i = 0, i < 5000, i = i + 1) {
+                    t = t + i + ",";
+                }
+                return len(t);
+            }
+        )"},
+        {"grow2k", R"(
+            @func main() {
+                text t = "";
+                loop(number i = 0, i < 2000, i = i + 1) {
+                    t = t + "x";
+                }
+                return len(t);
+            }
+        )",
+         2000},
+        // Short labels that never grow.
+        {"labels", R"(
+            @func main() {
+                number n = 0;
+                loop(number i = 0, i < 1000000, i = i + 1) {
+                    text l = "L" + (i % 100);
+                    n = n + len(l);
+                }
+                return n;
+            }
+        )"},
+        {"wordcount", R"(
+            @func main() {
+                hash_map counts = map();
+                loop(number i = 0, i < 1000000, i = i + 1) {
+                    text w = "word" + (i * 7919 % 1000);
+                    if (has(counts, w)) {
+                        put(counts, w, get(counts, w) + 1);
+                    }
+                    else {
+                        put(counts, w, 1);
+                    }
+                }
+                return len(counts);
+            }
+        )"},
+        {"idmap", R"(
+            @func main() {
+                hash_map ids = map();
+                loop(number i = 0, i < 300000, i = i + 1) {
+                    put(ids, i * 7, i);
+                }
+                number s = 0;
+                loop(number j = 0, j < 900000, j = j + 1) {
+                    s = s + get(ids, (j % 300000) * 7);
+                }
+                return s;
+            }
+        )"},
+        {"seqbuild", R"(
+            @func main() {
+                sequence s = seq();
+                loop(number i = 0, i < 300000, i = i + 1) {
+                    s = s + seq(i);
+                }
+                number t = 0;
+                iter(s, number x) {
+                    t = t + x;
+                }
+                return t;
+            }
+        )"},
+        // Sliding windows over a sequence.
+        {"windows", R"(
+            @func main() {
+                sequence s = seq();
+                loop(number i = 0, i < 100, i = i + 1) {
+                    s = s + seq(i);
+                }
+                number t = 0;
+                loop(number j = 0, j < 1000000, j = j + 1) {
+                    sequence w = slice(s, j % 90, 10);
+                    t = t + at(w, 3);
+                }
+                return t;
+            }
+        )"},
+    };
+
+    std::string describe(const VmResult &r, const std::string &output)
+    {
+        return std::string(to_string(r.status)) + " " + formatValue(r.value) + " [" + output + "]";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 3;
+    int first = 2;
+    bool vmOnly = argc > 2 && std::strcmp(argv[2], "--vm") == 0;
+    if (vmOnly)
+        first++;
+    int failures = 0;
+
+    std::printf("%-10s %10s %12s %8s  %s\n", "program", "vm s", "walker s", "ratio", "result");
+    for (const Bench &b : kBenches)
+    {
+        bool wanted = argc <= first;
+        for (int i = first; i < argc; i++)
+            wanted = wanted || std::strcmp(argv[i], b.name) == 0;
+        if (!wanted)
+            continue;
+
+        Lexer lexer(b.source);
+        std::vector<Token> tokens = lexer.tokenize();
+        Parser parser(tokens);
+        parser.setEcho(false);
+        auto prog = parser.parse();
+        BytecodeCompiler compiler;
+        auto module = prog && parser.errors().empty() ? compiler.compile(*prog) : nullptr;
+        if (!module)
+        {
+            std::printf("%-10s does not compile\n", b.name);
+            failures++;
+            continue;
+        }
+
+        VM vm;
+        VmLimits limits;
+        limits.maxSteps = ~uint64_t(0);
+        limits.maxHeapBytes = ~size_t(0);
+        vm.setLimits(limits);
+        TreeWalker walker;
+        double vmBest = 1e300, walkerBest = 1e300;
+        std::string left, right, result;
+        for (int r = 0; r < rounds; r++)
+        {
+            double t0 = wallSeconds();
+            VmResult a = vm.run(*module, "main");
+            for (int k = 1; k < b.runs; k++)
+                a = vm.run(*module, "main");
+            double t1 = wallSeconds();
+            vmBest = std::min(vmBest, t1 - t0);
+            result = a.ok() ? formatValue(a.value) : std::string(to_string(a.status)) + ": " + a.error;
+            left = describe(a, vm.output());
+            if (vmOnly)
+                continue;
+            VmResult w = walker.run(*prog, "main");
+            for (int k = 1; k < b.runs; k++)
+                w = walker.run(*prog, "main");
+            walkerBest = std::min(walkerBest, wallSeconds() - t1);
+            right = describe(w, walker.output());
+        }
+        if (vmOnly)
+            std::printf("%-10s %10.4f %12s %8s  %s\n", b.name, vmBest, "-", "-", result.c_str());
+        else
+            std::printf("%-10s %10.4f %12.4f %7.0fx  %s\n", b.name, vmBest, walkerBest, walkerBest / vmBest,
+                        result.c_str());
+        if (!vmOnly && left != right)
+        {
+            std::printf("  MISMATCH\n  vm:          %s\n  tree walker: %s\n", left.c_str(), right.c_str());
+            failures++;
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -246,9 +246,26 @@ std::vector<Token> Lexer::tokenize()
             break;
 
         case '"':
+            pos--;
+            column--;
             tokens.push_back(stringLiteral());
             break;
 
+        // Genex has no bitwise operators: a lone '&' or '|' is an error token,
+        // so the parser reports it instead of reading `a & b` as `a b`.
+        case '&':
+            if (match('&'))
+                tokens.push_back(makeToken(TokenType::AND, "&&"));
+            else
+                tokens.push_back(makeToken(TokenType::INVALID, "&"));
+            break;
+        case '|':
+            if (match('|'))
+                tokens.push_back(makeToken(TokenType::OR, "||"));
+            else
+                tokens.push_back(makeToken(TokenType::INVALID, "|"));
+            break;
+
         case '0':
             if (!isAtEnd() && peek() == 'b')
             {
@@ -262,6 +279,8 @@ std::vector<Token> Lexer::tokenize()
                 tokens.push_back(hexLiteral());
                 break;
             }
+            pos--;
+            column--;
             tokens.push_back(number());
             break;
 
@@ -280,7 +299,13 @@ std::vector<Token> Lexer::tokenize()
             }
             else
             {
-                // Ignore unknowns or handle error
+                // Any other character is an error token, so the parser reports
+                // it instead of reading on as if it were not there. A UTF-8
+                // sequence stays one token.
+                std::string text(1, c);
+                while (!isAtEnd() && (static_cast<unsigned char>(peek()) & 0xC0) == 0x80)
+                    text += advance();
+                tokens.push_back(makeToken(TokenType::INVALID, text));
             }
             break;
         }
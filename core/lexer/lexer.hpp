@@ -56,5 +56,7 @@ static std::unordered_map<std::string, TokenType> keywords = {
         {"hash_map", TokenType::HASH_MAP},
         {"datetime", TokenType::DATETIME},
         {"bool", TokenType::BOOL},
+        {"true", TokenType::BOOL_LITERAL},
+        {"false", TokenType::BOOL_LITERAL},
         {"return", TokenType::RETURN}
     };
\ No newline at end of file
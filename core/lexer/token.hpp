@@ -23,7 +23,10 @@ enum class TokenType {
     SEQUENCE_INST, HASH_MAP_INST, BLOCK_INST,
 
     IDENTIFIER,
-    END_OF_FILE
+    END_OF_FILE,
+
+    // Lexing error; the lexeme holds the offending text
+    INVALID
 };
 
 inline const char* to_string(TokenType t) {
@@ -102,6 +105,7 @@ inline const char* to_string(TokenType t) {
 
         case TokenType::IDENTIFIER: return "IDENTIFIER";
         case TokenType::END_OF_FILE: return "END_OF_FILE";
+        case TokenType::INVALID: return "INVALID";
         default: return "UNKNOWN";
     }
 }
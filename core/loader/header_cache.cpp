@@ -0,0 +1,277 @@
+#include "header_cache.hpp"
+#include "../lexer/lexer.hpp"
+#include "../parser/parser.hpp"
+#include "../serialize/ast_binary.hpp"
+#include "../utils/hash.hpp"
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+//////////////////////////////////////////////////////////////////////////
+// HeaderCache
+
+HeaderCache::HeaderCache(std::string cacheDir) : m_cacheDir(std::move(cacheDir))
+{
+    if (!m_cacheDir.empty())
+        ::mkdir(m_cacheDir.c_str(), 0755);
+}
+
+uint64_t HeaderCache::contentHash(const std::string &source)
+{
+    // Seeded with the image and parser versions so a format bump or a parser
+    // change never reuses stale files.
+    return hashString(source, (uint64_t(kParserVersion) << 16) | kAstBinaryVersion);
+}
+
+std::string HeaderCache::diskPath(uint64_t hash) const
+{
+    char name[48];
+    std::snprintf(name, sizeof(name), "%016llx.v%u.p%u.gxa", static_cast<unsigned long long>(hash),
+                  static_cast<unsigned>(kAstBinaryVersion), static_cast<unsigned>(kParserVersion));
+    return m_cacheDir + "/" + name;
+}
+
+std::shared_ptr<const ParsedHeader> HeaderCache::get(const std::string &source)
+{
+    uint64_t hash = contentHash(source);
+    std::promise<std::shared_ptr<const ParsedHeader>> promise;
+    std::shared_future<std::shared_ptr<const ParsedHeader>> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(hash);
+        if (it != m_entries.end())
+        {
+            pending = it->second;
+        }
+        else
+        {
+            m_entries.emplace(hash, promise.get_future().share());
+        }
+    }
+    // Another thread owns (or finished) this entry: wait for its result.
+    if (pending.valid())
+    {
+        m_memoryHits++;
+        return pending.get();
+    }
+
+    auto parsed = loadFromDisk(hash);
+    if (parsed)
+        m_diskHits++;
+    else
+        parsed = parse(hash, source);
+    promise.set_value(parsed);
+    return parsed;
+}
+
+std::shared_ptr<const ParsedHeader> HeaderCache::lookup(uint64_t hash)
+{
+    std::shared_future<std::shared_ptr<const ParsedHeader>> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(hash);
+        if (it != m_entries.end())
+            pending = it->second;
+    }
+    if (pending.valid())
+    {
+        m_memoryHits++;
+        return pending.get();
+    }
+
+    auto parsed = loadFromDisk(hash);
+    if (!parsed)
+        return nullptr;
+    m_diskHits++;
+    std::promise<std::shared_ptr<const ParsedHeader>> ready;
+    ready.set_value(parsed);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.emplace(hash, ready.get_future().share());
+    return parsed;
+}
+
+std::shared_ptr<const ParsedHeader> HeaderCache::loadFromDisk(uint64_t hash)
+{
+    if (m_cacheDir.empty())
+        return nullptr;
+    std::unique_ptr<Program> prog = AstBinary::load(diskPath(hash));
+    if (!prog)
+        return nullptr;
+    auto parsed = std::make_shared<ParsedHeader>();
+    parsed->contentHash = hash;
+    parsed->program = std::move(prog);
+    return parsed;
+}
+
+std::shared_ptr<const ParsedHeader> HeaderCache::parse(uint64_t hash, const std::string &source)
+{
+    m_parses++;
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.tokenize();
+    Parser parser(tokens);
+    parser.setEcho(false);
+    auto parsed = std::make_shared<ParsedHeader>();
+    parsed->contentHash = hash;
+    parsed->program = parser.parse();
+    parsed->errors = parser.errors();
+
+    // Only clean parses are worth sharing with other processes.
+    if (!m_cacheDir.empty() && parsed->program && parsed->errors.empty())
+        AstBinary::save(*parsed->program, diskPath(hash));
+    return parsed;
+}
+
+HeaderCache::Stats HeaderCache::stats() const
+{
+    Stats s;
+    s.memoryHits = m_memoryHits.load();
+    s.diskHits = m_diskHits.load();
+    s.parses = m_parses.load();
+    return s;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// HeaderResolver
+
+namespace
+{
+    // The lexer keeps the closing quote of a string literal (and the
+    // opening one depending on the path taken), so strip either side.
+    std::string unquote(std::string name)
+    {
+        if (!name.empty() && name.back() == '"')
+            name.pop_back();
+        if (!name.empty() && name.front() == '"')
+            name.erase(0, 1);
+        return name;
+    }
+
+    std::string dirName(const std::string &path)
+    {
+        size_t slash = path.find_last_of('/');
+        if (slash == std::string::npos)
+            return ".";
+        return slash == 0 ? "/" : path.substr(0, slash);
+    }
+
+    bool statFile(const std::string &path, struct stat &st)
+    {
+        return ::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+    }
+}
+
+HeaderResolver::HeaderResolver(HeaderCache &cache, std::vector<std::string> searchPaths)
+    : m_cache(cache), m_searchPaths(std::move(searchPaths)) {}
+
+bool HeaderResolver::resolve(const Program &prog, std::vector<ResolvedHeader> &out, const std::string &baseDir)
+{
+    m_errors.clear();
+    std::vector<std::string> stack;
+    return resolveInto(prog, baseDir, out, stack) && m_errors.empty();
+}
+
+bool HeaderResolver::resolveInto(const Program &prog, const std::string &baseDir, std::vector<ResolvedHeader> &out,
+                                 std::vector<std::string> &stack)
+{
+    bool ok = true;
+    for (const auto &d : prog.decls)
+    {
+        auto h = dynamic_cast<const HeaderDecl *>(d.get());
+        if (!h)
+            continue;
+        std::string name = unquote(h->name);
+        std::string path = findFile(name, baseDir);
+        if (path.empty())
+        {
+            m_errors.push_back("Header not found: " + name);
+            ok = false;
+            continue;
+        }
+
+        bool seen = false;
+        for (const auto &r : out)
+            seen = seen || r.path == path;
+        if (seen)
+            continue;
+        for (const auto &p : stack)
+        {
+            if (p == path)
+            {
+                m_errors.push_back("Circular header include: " + path);
+                return false;
+            }
+        }
+
+        auto parsed = loadFile(path);
+        if (!parsed)
+        {
+            m_errors.push_back("Cannot read header: " + path);
+            ok = false;
+            continue;
+        }
+        for (const auto &e : parsed->errors)
+            m_errors.push_back(path + ": " + e);
+
+        // Dependencies are appended before the header that includes them.
+        stack.push_back(path);
+        ok = resolveInto(*parsed->program, dirName(path), out, stack) && ok;
+        stack.pop_back();
+        out.push_back(ResolvedHeader{name, path, parsed});
+    }
+    return ok;
+}
+
+std::string HeaderResolver::findFile(const std::string &name, const std::string &baseDir) const
+{
+    struct stat st;
+    if (!name.empty() && name.front() == '/')
+        return statFile(name, st) ? name : "";
+    std::string local = baseDir + "/" + name;
+    if (statFile(local, st))
+        return local;
+    for (const auto &dir : m_searchPaths)
+    {
+        std::string candidate = dir + "/" + name;
+        if (statFile(candidate, st))
+            return candidate;
+    }
+    return "";
+}
+
+std::shared_ptr<const ParsedHeader> HeaderResolver::loadFile(const std::string &path)
+{
+    struct stat st;
+    if (!statFile(path, st))
+        return nullptr;
+
+    // Unchanged file: go straight to the cache by hash without re-reading it.
+    // The nanoseconds matter: a file rewritten within the same second, at
+    // the same size, differs from its stamp only there. Filesystems with
+    // whole-second stamps are covered below.
+    auto it = m_stamps.find(path);
+    if (it != m_stamps.end() && it->second.mtime == st.st_mtime && it->second.mtimeNanos == st.st_mtim.tv_nsec &&
+        it->second.size == st.st_size)
+    {
+        if (auto cached = m_cache.lookup(it->second.hash))
+            return cached;
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return nullptr;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    std::string source = ss.str();
+
+    auto parsed = m_cache.get(source);
+    // A file modified this second or the last may still change without its
+    // stamp moving, so it is not stamped and is read again next time.
+    if (st.st_mtime < std::time(nullptr) - 1)
+        m_stamps[path] = FileStamp{static_cast<int64_t>(st.st_mtime), static_cast<int64_t>(st.st_mtim.tv_nsec),
+                                   static_cast<int64_t>(st.st_size), parsed->contentHash};
+    else
+        m_stamps.erase(path);
+    return parsed;
+}
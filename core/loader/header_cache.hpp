@@ -0,0 +1,102 @@
+#pragma once
+#include "../parser/ast.hpp"
+#include <cstdint>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Pre-parsed header() sources, keyed by the hash of their contents.
+//
+// Lookups go memory -> disk -> lex/parse. The in-memory table is shared by
+// every thread of the process and parses a given source at most once; the
+// optional on-disk layer stores binary AST images (see ast_binary.hpp) so
+// other processes can skip parsing as well.
+struct ParsedHeader
+{
+    uint64_t contentHash = 0;
+    std::shared_ptr<const Program> program;
+    std::vector<std::string> errors; // parser errors, empty on success
+};
+
+class HeaderCache
+{
+public:
+    // cacheDir may be empty to keep the cache in memory only.
+    explicit HeaderCache(std::string cacheDir = "");
+
+    // Return the parsed form of `source`, parsing it only on a full miss.
+    std::shared_ptr<const ParsedHeader> get(const std::string &source);
+
+    // Look up an already known content hash (memory, then disk) without
+    // parsing; returns nullptr on a miss.
+    std::shared_ptr<const ParsedHeader> lookup(uint64_t hash);
+
+    struct Stats
+    {
+        uint64_t memoryHits = 0;
+        uint64_t diskHits = 0;
+        uint64_t parses = 0;
+    };
+    Stats stats() const;
+
+    static uint64_t contentHash(const std::string &source);
+
+private:
+    std::shared_ptr<const ParsedHeader> loadFromDisk(uint64_t hash);
+    std::shared_ptr<const ParsedHeader> parse(uint64_t hash, const std::string &source);
+    std::string diskPath(uint64_t hash) const;
+
+    std::string m_cacheDir;
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint64_t, std::shared_future<std::shared_ptr<const ParsedHeader>>> m_entries;
+    std::atomic<uint64_t> m_memoryHits{0};
+    std::atomic<uint64_t> m_diskHits{0};
+    std::atomic<uint64_t> m_parses{0};
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Resolves the HeaderDecls of a program to files and loads them through a
+// shared HeaderCache, following nested header() declarations.
+struct ResolvedHeader
+{
+    std::string name; // as written, without quotes
+    std::string path;
+    std::shared_ptr<const ParsedHeader> parsed;
+};
+
+class HeaderResolver
+{
+public:
+    HeaderResolver(HeaderCache &cache, std::vector<std::string> searchPaths);
+
+    // Resolve every header reachable from `prog`, dependencies first. `baseDir`
+    // is used for names relative to the including file. Returns false when a
+    // header is missing or fails to parse; see errors().
+    bool resolve(const Program &prog, std::vector<ResolvedHeader> &out, const std::string &baseDir = ".");
+
+    const std::vector<std::string> &errors() const { return m_errors; }
+
+private:
+    struct FileStamp
+    {
+        int64_t mtime = 0;
+        int64_t mtimeNanos = 0;
+        int64_t size = 0;
+        uint64_t hash = 0;
+    };
+
+    bool resolveInto(const Program &prog, const std::string &baseDir, std::vector<ResolvedHeader> &out,
+                     std::vector<std::string> &stack);
+    std::string findFile(const std::string &name, const std::string &baseDir) const;
+    std::shared_ptr<const ParsedHeader> loadFile(const std::string &path);
+
+    HeaderCache &m_cache;
+    std::vector<std::string> m_searchPaths;
+    std::unordered_map<std::string, FileStamp> m_stamps;
+    std::vector<std::string> m_errors;
+};
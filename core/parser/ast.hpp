@@ -1,6 +1,7 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include "../lexer/token.hpp"
@@ -21,6 +22,26 @@ struct Node
     virtual ~Node() = default;
 };
 
+//////////////////////////////////////////////////////////////////////////
+// Name binding written by Resolver (core/semantic/resolver.hpp). Every
+// resolve() pass overwrites it, so the fields are mutable and a Program
+// must not be resolved by two threads at once.
+enum class SymbolKind : uint8_t
+{
+    Unresolved, // no pass has run since the node was built
+    Local,      // slot: parameter or local of the enclosing function
+    Global,     // slot: module global
+    Function,   // slot: function index (callees only)
+    Builtin,    // slot: Builtin (callees only)
+    Undefined   // the name is not bound at this point
+};
+
+struct SymbolRef
+{
+    SymbolKind kind = SymbolKind::Unresolved;
+    uint32_t slot = 0;
+};
+
 //////////////////////////////////////////////////////////////////////////
 // Expressions
 struct Expr : Node
@@ -31,6 +52,7 @@ struct Expr : Node
 struct IdentifierExpr : Expr
 {
     std::string name;
+    mutable SymbolRef ref;
     IdentifierExpr(std::string n) : name(std::move(n)) {}
 };
 
@@ -86,6 +108,31 @@ public:
         statements.erase(statements.end() - n, statements.end());
     }
 
+    // Positional edits used by the mutation operators; out-of-range
+    // positions are clamped (insert) or ignored (remove/replace).
+    void insertAt(size_t i, StmtPtr&& s) {
+        if (i > statements.size()) i = statements.size();
+        statements.insert(statements.begin() + i, std::move(s));
+    }
+    StmtPtr removeAt(size_t i) {
+        if (i >= statements.size()) return nullptr;
+        StmtPtr old = std::move(statements[i]);
+        statements.erase(statements.begin() + i);
+        return old;
+    }
+    StmtPtr replaceAt(size_t i, StmtPtr&& s) {
+        if (i >= statements.size()) return nullptr;
+        StmtPtr old = std::move(statements[i]);
+        statements[i] = std::move(s);
+        return old;
+    }
+    Stmt* at(size_t i) const { return i < statements.size() ? statements[i].get() : nullptr; }
+    size_t indexOf(const Stmt* s) const {
+        for (size_t i = 0; i < statements.size(); i++)
+            if (statements[i].get() == s) return i;
+        return statements.size();
+    }
+
     // Accessors without exposing the vector directly
     size_t size() const { return statements.size(); }
     bool empty() const { return statements.empty(); }
@@ -141,6 +188,7 @@ struct IterStmt : Stmt
 {
     ExprPtr iterable;
     std::string varName;
+    mutable uint32_t slot = 0; // local slot of varName
     Block body;
 };
 
@@ -161,6 +209,7 @@ struct FuncDecl : Decl
     std::string name;
     std::vector<std::pair<std::string, std::string>> params; // (type, name)
     std::optional<Block> body;
+    mutable uint32_t frameSize = 0; // local slots, parameters first
 };
 
 struct VarDecl : Stmt
@@ -168,6 +217,7 @@ struct VarDecl : Stmt
     std::string typeName;
     std::string varName;
     std::optional<ExprPtr> initValue;
+    mutable uint32_t slot = 0; // local slot, or global slot at top level
 };
 
 struct BlockDecl : Decl
@@ -0,0 +1,271 @@
+#include "ast_clone.hpp"
+#include <algorithm>
+
+AstCloner::AstCloner() {}
+
+std::unique_ptr<Program> AstCloner::clone(const Program &prog)
+{
+    AstCloner c;
+    return c.cloneProgram(prog);
+}
+
+DeclPtr AstCloner::clone(const Decl *d)
+{
+    AstCloner c;
+    return c.cloneDecl(d);
+}
+
+std::unique_ptr<FuncDecl> AstCloner::clone(const FuncDecl *f)
+{
+    AstCloner c;
+    return c.cloneFunc(f);
+}
+
+std::unique_ptr<VarDecl> AstCloner::clone(const VarDecl *v)
+{
+    AstCloner c;
+    return c.cloneVar(v);
+}
+
+StmtPtr AstCloner::clone(const Stmt *s)
+{
+    AstCloner c;
+    return c.cloneStmt(s);
+}
+
+ExprPtr AstCloner::clone(const Expr *e)
+{
+    AstCloner c;
+    return c.cloneExpr(e);
+}
+
+Block AstCloner::clone(const Block &b)
+{
+    AstCloner c;
+    return c.cloneBlock(b);
+}
+
+std::unique_ptr<Program> AstCloner::cloneReplacing(const Program &prog, const Expr *target, const Expr *donor)
+{
+    AstCloner c;
+    c.m_exprTarget = target;
+    c.m_exprDonor = donor;
+    return c.cloneProgram(prog);
+}
+
+std::unique_ptr<Program> AstCloner::cloneReplacing(const Program &prog, const Block *target, const Block *donor)
+{
+    AstCloner c;
+    c.m_blockTarget = target;
+    c.m_blockDonor = donor;
+    return c.cloneProgram(prog);
+}
+
+std::unique_ptr<Program> AstCloner::cloneReplacing(const Program &prog, const FuncDecl *target, const FuncDecl *donor)
+{
+    AstCloner c;
+    c.m_funcTarget = target;
+    c.m_funcDonor = donor;
+    return c.cloneProgram(prog);
+}
+
+const std::string &AstCloner::renamed(const std::string &name) const
+{
+    auto it = m_renames.find(name);
+    return it == m_renames.end() ? name : it->second;
+}
+
+std::unique_ptr<Program> AstCloner::cloneProgram(const Program &prog)
+{
+    auto out = std::make_unique<Program>();
+    out->decls.reserve(prog.decls.size());
+    for (const auto &d : prog.decls)
+        out->decls.push_back(cloneDecl(d.get()));
+    for (const auto &e : prog.globalExprs)
+        out->globalExprs.push_back(cloneExpr(e.get()));
+    for (const auto &v : prog.globalVars)
+        out->globalVars.push_back(cloneVar(v.get()));
+    return out;
+}
+
+DeclPtr AstCloner::cloneDecl(const Decl *d)
+{
+    if (!d)
+        return nullptr;
+    if (auto f = dynamic_cast<const FuncDecl *>(d))
+        return cloneFunc(f);
+    if (auto h = dynamic_cast<const HeaderDecl *>(d))
+    {
+        auto out = std::make_unique<HeaderDecl>();
+        out->name = h->name;
+        return out;
+    }
+    if (auto b = dynamic_cast<const BlockDecl *>(d))
+    {
+        auto out = std::make_unique<BlockDecl>();
+        out->name = b->name;
+        for (const auto &f : b->fields)
+            out->fields.push_back(cloneVar(f.get()));
+        for (const auto &m : b->methods)
+            out->methods.push_back(cloneFunc(m.get()));
+        return out;
+    }
+    return nullptr;
+}
+
+std::unique_ptr<FuncDecl> AstCloner::cloneFunc(const FuncDecl *f)
+{
+    if (!f)
+        return nullptr;
+    auto out = std::make_unique<FuncDecl>();
+    out->name = f->name;
+    out->params = f->params;
+    if (f == m_funcTarget && m_funcDonor && m_funcDonor->body)
+    {
+        // A permutation of names: donor parameter i becomes target parameter
+        // i, and a donor local already called like a target parameter takes
+        // a donor parameter name that was freed, so nothing is captured.
+        const FuncDecl *donor = m_funcDonor;
+        m_funcTarget = nullptr;
+        size_t n = std::min(donor->params.size(), f->params.size());
+        auto isParam = [n](const FuncDecl *g, const std::string &name) {
+            for (size_t i = 0; i < n; i++)
+                if (g->params[i].second == name)
+                    return true;
+            return false;
+        };
+        std::vector<std::string> freed;
+        for (size_t i = 0; i < n; i++)
+        {
+            m_renames[donor->params[i].second] = f->params[i].second;
+            if (!isParam(f, donor->params[i].second))
+                freed.push_back(donor->params[i].second);
+        }
+        for (size_t i = 0, j = 0; i < n; i++)
+            if (!isParam(donor, f->params[i].second))
+                m_renames[f->params[i].second] = freed[j++];
+        out->body = cloneBlock(*donor->body);
+        m_renames.clear();
+    }
+    else if (f->body)
+        out->body = cloneBlock(*f->body);
+    return out;
+}
+
+std::unique_ptr<VarDecl> AstCloner::cloneVar(const VarDecl *v)
+{
+    if (!v)
+        return nullptr;
+    auto out = std::make_unique<VarDecl>();
+    out->typeName = v->typeName;
+    out->varName = renamed(v->varName);
+    if (v->initValue)
+        out->initValue = cloneExpr(v->initValue->get());
+    return out;
+}
+
+Block AstCloner::cloneBlock(const Block &b)
+{
+    if (&b == m_blockTarget && m_blockDonor)
+    {
+        // Substitute once; the donor may itself contain the target when a
+        // program is crossed with itself.
+        m_blockTarget = nullptr;
+        return cloneBlock(*m_blockDonor);
+    }
+    Block out;
+    for (const auto &s : b)
+        out.addStatement(cloneStmt(s.get()));
+    return out;
+}
+
+StmtPtr AstCloner::cloneStmt(const Stmt *s)
+{
+    if (!s)
+        return nullptr;
+    if (auto es = dynamic_cast<const ExprStmt *>(s))
+        return std::make_unique<ExprStmt>(cloneExpr(es->expr.get()));
+    if (auto rs = dynamic_cast<const ReturnStmt *>(s))
+    {
+        std::optional<ExprPtr> value;
+        if (rs->value)
+            value = cloneExpr(rs->value->get());
+        return std::make_unique<ReturnStmt>(std::move(value));
+    }
+    if (auto is = dynamic_cast<const IfStmt *>(s))
+    {
+        auto out = std::make_unique<IfStmt>();
+        out->ifBlock.first = cloneExpr(is->ifBlock.first.get());
+        out->ifBlock.second = cloneBlock(is->ifBlock.second);
+        if (is->elseIfs)
+        {
+            out->elseIfs.emplace();
+            out->elseIfs->reserve(is->elseIfs->size());
+            for (const auto &ei : *is->elseIfs)
+                out->elseIfs->emplace_back(cloneExpr(ei.first.get()), cloneBlock(ei.second));
+        }
+        if (is->elseBlock)
+            out->elseBlock = cloneBlock(*is->elseBlock);
+        return out;
+    }
+    if (auto ws = dynamic_cast<const WhileStmt *>(s))
+    {
+        auto out = std::make_unique<WhileStmt>();
+        out->condition = cloneExpr(ws->condition.get());
+        out->body = cloneBlock(ws->body);
+        return out;
+    }
+    if (auto ls = dynamic_cast<const LoopStmt *>(s))
+    {
+        auto out = std::make_unique<LoopStmt>();
+        out->dtype = ls->dtype;
+        out->init = cloneStmt(ls->init.get());
+        out->condition = cloneExpr(ls->condition.get());
+        out->step = cloneStmt(ls->step.get());
+        out->body = cloneBlock(ls->body);
+        return out;
+    }
+    if (auto it = dynamic_cast<const IterStmt *>(s))
+    {
+        auto out = std::make_unique<IterStmt>();
+        out->iterable = cloneExpr(it->iterable.get());
+        out->varName = renamed(it->varName);
+        out->body = cloneBlock(it->body);
+        return out;
+    }
+    if (auto vd = dynamic_cast<const VarDecl *>(s))
+        return cloneVar(vd);
+    return nullptr;
+}
+
+ExprPtr AstCloner::cloneExpr(const Expr *e)
+{
+    if (e && e == m_exprTarget)
+    {
+        m_exprTarget = nullptr;
+        e = m_exprDonor;
+    }
+    if (!e)
+        return nullptr;
+    if (auto lit = dynamic_cast<const LiteralExpr *>(e))
+        return std::make_unique<LiteralExpr>(lit->value, lit->litType);
+    if (auto id = dynamic_cast<const IdentifierExpr *>(e))
+        return std::make_unique<IdentifierExpr>(renamed(id->name));
+    if (auto u = dynamic_cast<const UnaryExpr *>(e))
+        return std::make_unique<UnaryExpr>(u->op, cloneExpr(u->right.get()));
+    if (auto b = dynamic_cast<const BinaryExpr *>(e))
+    {
+        ExprPtr l = cloneExpr(b->left.get());
+        ExprPtr r = cloneExpr(b->right.get());
+        return std::make_unique<BinaryExpr>(std::move(l), b->op, std::move(r));
+    }
+    if (auto c = dynamic_cast<const CallExpr *>(e))
+    {
+        std::vector<ExprPtr> args;
+        args.reserve(c->args.size());
+        for (const auto &a : c->args)
+            args.push_back(cloneExpr(a.get()));
+        return std::make_unique<CallExpr>(cloneExpr(c->callee.get()), std::move(args));
+    }
+    return nullptr;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "ast.hpp"
+#include <unordered_map>
+
+// Deep copies of AST nodes. Nodes are owned through unique_ptr, so every
+// offspring that must outlive its parent goes through here.
+class AstCloner
+{
+public:
+    static std::unique_ptr<Program> clone(const Program &prog);
+    static DeclPtr clone(const Decl *d);
+    static std::unique_ptr<FuncDecl> clone(const FuncDecl *f);
+    static std::unique_ptr<VarDecl> clone(const VarDecl *v);
+    static StmtPtr clone(const Stmt *s);
+    static ExprPtr clone(const Expr *e);
+    static Block clone(const Block &b);
+
+    // Clone `prog` in one pass, copying `donor` (taken from another program)
+    // in place of the subtree at `target`. The replaced subtree is never
+    // copied, which is what makes subtree crossover cheap.
+    static std::unique_ptr<Program> cloneReplacing(const Program &prog, const Expr *target, const Expr *donor);
+    static std::unique_ptr<Program> cloneReplacing(const Program &prog, const Block *target, const Block *donor);
+    // Same for a whole function body: `target` keeps its name and parameters
+    // and gets `donor`'s body, whose parameter names (and any of its names
+    // that clash with them) are renamed to `target`'s. Both must have as
+    // many parameters.
+    static std::unique_ptr<Program> cloneReplacing(const Program &prog, const FuncDecl *target,
+                                                   const FuncDecl *donor);
+
+private:
+    AstCloner();
+    std::unique_ptr<Program> cloneProgram(const Program &prog);
+    DeclPtr cloneDecl(const Decl *d);
+    std::unique_ptr<FuncDecl> cloneFunc(const FuncDecl *f);
+    std::unique_ptr<VarDecl> cloneVar(const VarDecl *v);
+    StmtPtr cloneStmt(const Stmt *s);
+    ExprPtr cloneExpr(const Expr *e);
+    Block cloneBlock(const Block &b);
+    const std::string &renamed(const std::string &name) const;
+
+    const Expr *m_exprTarget = nullptr;
+    const Expr *m_exprDonor = nullptr;
+    const Block *m_blockTarget = nullptr;
+    const Block *m_blockDonor = nullptr;
+    const FuncDecl *m_funcTarget = nullptr;
+    const FuncDecl *m_funcDonor = nullptr;
+    std::unordered_map<std::string, std::string> m_renames; // only while the donor body is copied
+};
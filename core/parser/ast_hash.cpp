@@ -0,0 +1,150 @@
+#include "ast_hash.hpp"
+#include "../utils/hash.hpp"
+
+namespace
+{
+    // Distinct seeds per node kind keep e.g. `-x` and `x` or an empty
+    // block and an absent one apart.
+    enum Tag : uint64_t
+    {
+        TNull = 1,
+        TProgram,
+        THeader,
+        TFunc,
+        TBlockDecl,
+        TBlock,
+        TExprStmt,
+        TReturn,
+        TIf,
+        TWhile,
+        TLoop,
+        TIter,
+        TVarDecl,
+        TIdent,
+        TLiteral,
+        TUnary,
+        TBinary,
+        TCall,
+        TUnknown
+    };
+
+    inline uint64_t str(uint64_t h, const std::string &s)
+    {
+        return hashCombine(h, hashString(s));
+    }
+}
+
+uint64_t AstHasher::hash(const Expr *e)
+{
+    if (!e)
+        return mix64(TNull);
+    if (auto lit = dynamic_cast<const LiteralExpr *>(e))
+        return hashCombine(str(mix64(TLiteral), lit->value), static_cast<uint64_t>(lit->litType));
+    if (auto id = dynamic_cast<const IdentifierExpr *>(e))
+        return str(mix64(TIdent), id->name);
+    if (auto u = dynamic_cast<const UnaryExpr *>(e))
+        return hashCombine(str(mix64(TUnary), u->op), hash(u->right.get()));
+    if (auto b = dynamic_cast<const BinaryExpr *>(e))
+        return hashCombine(hashCombine(str(mix64(TBinary), b->op), hash(b->left.get())), hash(b->right.get()));
+    if (auto c = dynamic_cast<const CallExpr *>(e))
+    {
+        uint64_t h = hashCombine(mix64(TCall), hash(c->callee.get()));
+        for (const auto &a : c->args)
+            h = hashCombine(h, hash(a.get()));
+        return hashCombine(h, c->args.size());
+    }
+    return mix64(TUnknown);
+}
+
+uint64_t AstHasher::hash(const Block &b)
+{
+    uint64_t h = mix64(TBlock);
+    for (const auto &s : b)
+        h = hashCombine(h, hash(s.get()));
+    return hashCombine(h, b.size());
+}
+
+uint64_t AstHasher::hash(const Stmt *s)
+{
+    if (!s)
+        return mix64(TNull);
+    if (auto es = dynamic_cast<const ExprStmt *>(s))
+        return hashCombine(mix64(TExprStmt), hash(es->expr.get()));
+    if (auto rs = dynamic_cast<const ReturnStmt *>(s))
+        return hashCombine(mix64(TReturn), rs->value ? hash(rs->value->get()) : 0);
+    if (auto is = dynamic_cast<const IfStmt *>(s))
+    {
+        uint64_t h = hashCombine(hashCombine(mix64(TIf), hash(is->ifBlock.first.get())), hash(is->ifBlock.second));
+        if (is->elseIfs)
+        {
+            for (const auto &ei : *is->elseIfs)
+                h = hashCombine(hashCombine(h, hash(ei.first.get())), hash(ei.second));
+            h = hashCombine(h, is->elseIfs->size());
+        }
+        return hashCombine(h, is->elseBlock ? hash(*is->elseBlock) : 0);
+    }
+    if (auto ws = dynamic_cast<const WhileStmt *>(s))
+        return hashCombine(hashCombine(mix64(TWhile), hash(ws->condition.get())), hash(ws->body));
+    if (auto ls = dynamic_cast<const LoopStmt *>(s))
+    {
+        uint64_t h = ls->dtype ? str(mix64(TLoop), *ls->dtype) : mix64(TLoop);
+        h = hashCombine(h, hash(ls->init.get()));
+        h = hashCombine(h, hash(ls->condition.get()));
+        h = hashCombine(h, hash(ls->step.get()));
+        return hashCombine(h, hash(ls->body));
+    }
+    if (auto it = dynamic_cast<const IterStmt *>(s))
+        return hashCombine(str(hashCombine(mix64(TIter), hash(it->iterable.get())), it->varName), hash(it->body));
+    if (auto vd = dynamic_cast<const VarDecl *>(s))
+    {
+        uint64_t h = str(str(mix64(TVarDecl), vd->typeName), vd->varName);
+        return hashCombine(h, vd->initValue ? hash(vd->initValue->get()) : 0);
+    }
+    return mix64(TUnknown);
+}
+
+uint64_t AstHasher::hashFunc(const FuncDecl *f)
+{
+    if (!f)
+        return mix64(TNull);
+    uint64_t h = str(mix64(TFunc), f->name);
+    for (const auto &p : f->params)
+        h = str(str(h, p.first), p.second);
+    h = hashCombine(h, f->params.size());
+    return hashCombine(h, f->body ? hash(*f->body) : 0);
+}
+
+uint64_t AstHasher::hash(const Decl *d)
+{
+    if (!d)
+        return mix64(TNull);
+    if (auto f = dynamic_cast<const FuncDecl *>(d))
+        return hashFunc(f);
+    if (auto b = dynamic_cast<const BlockDecl *>(d))
+    {
+        uint64_t h = str(mix64(TBlockDecl), b->name);
+        for (const auto &fld : b->fields)
+            h = hashCombine(h, hash(fld.get()));
+        h = hashCombine(h, b->fields.size());
+        for (const auto &m : b->methods)
+            h = hashCombine(h, hashFunc(m.get()));
+        return hashCombine(h, b->methods.size());
+    }
+    if (auto hd = dynamic_cast<const HeaderDecl *>(d))
+        return str(mix64(THeader), hd->name);
+    return mix64(TUnknown);
+}
+
+uint64_t AstHasher::hash(const Program &prog)
+{
+    uint64_t h = mix64(TProgram);
+    for (const auto &d : prog.decls)
+        h = hashCombine(h, hash(d.get()));
+    h = hashCombine(h, prog.decls.size());
+    for (const auto &v : prog.globalVars)
+        h = hashCombine(h, hash(v.get()));
+    h = hashCombine(h, prog.globalVars.size());
+    for (const auto &e : prog.globalExprs)
+        h = hashCombine(h, hash(e.get()));
+    return hashCombine(h, prog.globalExprs.size());
+}
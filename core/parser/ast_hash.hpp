@@ -0,0 +1,21 @@
+#pragma once
+#include "ast.hpp"
+#include <cstdint>
+
+//////////////////////////////////////////////////////////////////////////
+// Structural 64-bit hash of an AST: node kinds, names, operators, literal
+// lexemes and dtypes, in tree order. Two programs that print the same hash
+// the same; no pointer or allocation detail leaks in, so the hash is stable
+// across runs and usable as a cache key.
+class AstHasher
+{
+public:
+    static uint64_t hash(const Program &prog);
+    static uint64_t hash(const Decl *d);
+    static uint64_t hash(const Stmt *s);
+    static uint64_t hash(const Expr *e);
+    static uint64_t hash(const Block &b);
+
+private:
+    static uint64_t hashFunc(const FuncDecl *f);
+};
@@ -1,98 +1,141 @@
 #include "ast_printer.hpp"
-#include <sstream>
-#include <iostream>
 
-AstPrinter::AstPrinter() {}
+// Everything is appended to one output string: nested ostringstreams made
+// printing quadratic in nesting depth and dominated corpus generation.
+
+AstPrinter::AstPrinter(std::string &out) : m_out(out) {}
 
 std::string AstPrinter::print(const Program &prog)
 {
-    AstPrinter p;
-    return p.printProgram(prog);
+    std::string out;
+    printTo(prog, out);
+    return out;
 }
 
-std::string AstPrinter::printProgram(const Program &prog)
+void AstPrinter::printTo(const Program &prog, std::string &out)
 {
-    std::ostringstream out;
+    AstPrinter p(out);
+    p.printProgram(prog);
+}
+
+void AstPrinter::printProgram(const Program &prog)
+{
+    // headers first, then globals, then everything else
+    for (const auto &declPtr : prog.decls)
+        if (dynamic_cast<const HeaderDecl *>(declPtr.get()))
+            printDecl(declPtr.get(), 0);
+    for (const auto &v : prog.globalVars)
+        printVarDecl(v.get(), 0);
     for (const auto &declPtr : prog.decls)
     {
-        out << printDecl(declPtr.get(), 0);
-        out << "\n";
+        if (dynamic_cast<const HeaderDecl *>(declPtr.get()))
+            continue;
+        printDecl(declPtr.get(), 0);
+        m_out += "\n";
     }
-    return out.str();
 }
 
-std::string AstPrinter::printDecl(const Decl *d, int indent)
+void AstPrinter::printDecl(const Decl *d, int indent)
 {
     if (!d)
-        return std::string(indent, ' ') + "// <null decl>\n";
+    {
+        indentStr(indent);
+        m_out += "// <null decl>\n";
+        return;
+    }
     // Try dynamic casts
     if (auto f = dynamic_cast<const FuncDecl *>(d))
         return printFunc(f, indent);
     if (auto b = dynamic_cast<const BlockDecl *>(d))
         return printBlockDecl(b, indent);
+    if (auto h = dynamic_cast<const HeaderDecl *>(d))
+    {
+        // the lexeme keeps its quotes; names built in code may not have them
+        bool quoted = !h->name.empty() && h->name.front() == '"';
+        indentStr(indent);
+        m_out += "header(";
+        if (quoted)
+            m_out += h->name;
+        else
+            m_out += "\"" + h->name + "\"";
+        m_out += ");\n";
+        return;
+    }
     // Unknown decl
-    return std::string(indent, ' ') + "// <unknown decl>\n";
+    indentStr(indent);
+    m_out += "// <unknown decl>\n";
 }
 
-std::string AstPrinter::printFunc(const FuncDecl *f, int indent)
+void AstPrinter::printFunc(const FuncDecl *f, int indent)
 {
-    std::ostringstream out;
-    out << std::string(indent, ' ') << "@func " << f->name << "(";
+    indentStr(indent);
+    m_out += "@func ";
+    m_out += f->name;
+    m_out += "(";
     bool first = true;
     for (const auto &p : f->params)
     {
         if (!first)
-            out << ", ";
-        out << p.first << " " << p.second;
+            m_out += ", ";
+        m_out += p.first;
+        m_out += " ";
+        m_out += p.second;
         first = false;
     }
-    out << ") ";
-    // body
-    out << "{\n";
-    for (auto it = f->body->begin(); it != f->body->end(); ++it)
+    m_out += ")";
+    // prototype
+    if (!f->body)
     {
-        out << printStmt(it->get(), indent + 4);
+        m_out += ";\n";
+        return;
     }
-    out << std::string(indent, ' ') << "}\n";
-    return out.str();
+    m_out += " ";
+    printBlock(*f->body, indent);
 }
 
-std::string AstPrinter::printBlockDecl(const BlockDecl *b, int indent)
+void AstPrinter::printBlockDecl(const BlockDecl *b, int indent)
 {
-    std::ostringstream out;
-    out << std::string(indent, ' ') << "Block " << b->name << " {\n";
+    indentStr(indent);
+    m_out += "Block ";
+    m_out += b->name;
+    m_out += " {\n";
     // fields
     for (const auto &f : b->fields)
-    {
-        out << printVarDecl(f.get(), indent + 4);
-    }
+        printVarDecl(f.get(), indent + 4);
     // methods
     for (const auto &m : b->methods)
-    {
-        out << printFunc(m.get(), indent + 4);
-    }
-    out << std::string(indent, ' ') << "}\n";
-    return out.str();
+        printFunc(m.get(), indent + 4);
+    indentStr(indent);
+    m_out += "}\n";
 }
 
-std::string AstPrinter::printVarDecl(const VarDecl *v, int indent)
+void AstPrinter::printVarDecl(const VarDecl *v, int indent)
 {
-    std::ostringstream out;
+    indentStr(indent);
     if (!v)
-        return std::string(indent, ' ') + "// <null var>\n";
-    out << std::string(indent, ' ') << v->typeName << " " << v->varName;
+    {
+        m_out += "// <null var>\n";
+        return;
+    }
+    m_out += v->typeName;
+    m_out += " ";
+    m_out += v->varName;
     if (v->initValue.has_value() && v->initValue.value())
     {
-        out << " = " << printExpr(v->initValue.value().get());
+        m_out += " = ";
+        printExpr(v->initValue.value().get());
     }
-    out << ";\n";
-    return out.str();
+    m_out += ";\n";
 }
 
-std::string AstPrinter::printStmt(const Stmt *s, int indent)
+void AstPrinter::printStmt(const Stmt *s, int indent)
 {
     if (!s)
-        return std::string(indent, ' ') + "// <null stmt>\n";
+    {
+        indentStr(indent);
+        m_out += "// <null stmt>\n";
+        return;
+    }
     if (auto es = dynamic_cast<const ExprStmt *>(s))
         return printExprStmt(es, indent);
     if (auto rs = dynamic_cast<const ReturnStmt *>(s))
@@ -108,120 +151,126 @@ std::string AstPrinter::printStmt(const Stmt *s, int indent)
     if (auto vd = dynamic_cast<const VarDecl *>(s))
         return printVarDecl(vd, indent);
     // Unknown
-    return std::string(indent, ' ') + "// <unknown stmt>\n";
+    indentStr(indent);
+    m_out += "// <unknown stmt>\n";
 }
 
-std::string AstPrinter::printExprStmt(const ExprStmt *e, int indent)
+// "{\n" statements "}\n", the closing brace at `indent`.
+void AstPrinter::printBlock(const Block &b, int indent)
 {
-    std::ostringstream out;
-    out << std::string(indent, ' ') << printExpr(e->expr.get()) << ";\n";
-    return out.str();
+    m_out += "{\n";
+    for (const auto &s : b)
+        printStmt(s.get(), indent + 4);
+    indentStr(indent);
+    m_out += "}\n";
 }
 
-std::string AstPrinter::printReturn(const ReturnStmt *r, int indent)
+void AstPrinter::printExprStmt(const ExprStmt *e, int indent)
 {
-    std::ostringstream out;
-    out << std::string(indent, ' ') << "return";
+    indentStr(indent);
+    printExpr(e->expr.get());
+    m_out += ";\n";
+}
+
+void AstPrinter::printReturn(const ReturnStmt *r, int indent)
+{
+    indentStr(indent);
+    m_out += "return";
     if (r->value.has_value() && r->value.value())
     {
-        out << " " << printExpr(r->value.value().get());
+        m_out += " ";
+        printExpr(r->value.value().get());
     }
-    out << ";\n";
-    return out.str();
+    m_out += ";\n";
 }
 
-std::string AstPrinter::printIf(const IfStmt *ifs, int indent)
+void AstPrinter::printIf(const IfStmt *ifs, int indent)
 {
-    std::ostringstream out;
-    out << std::string(indent, ' ') << "if(" << printExpr(ifs->ifBlock.first.get()) << ") {\n";
-    for (auto it = ifs->ifBlock.second.begin(); it != ifs->ifBlock.second.end(); ++it)
-        out << printStmt(it->get(), indent + 4);
-    out << std::string(indent, ' ') << "}\n";
+    indentStr(indent);
+    m_out += "if(";
+    printExpr(ifs->ifBlock.first.get());
+    m_out += ") ";
+    printBlock(ifs->ifBlock.second, indent);
 
-    if (ifs->elseBlock.has_value())
+    if (ifs->elseIfs.has_value())
         for (auto it = ifs->elseIfs->begin(); it != ifs->elseIfs->end(); ++it)
         {
-            out << std::string(indent, ' ') << "else(" << printExpr(it->first.get()) << ") {\n";
-            for (auto sit = it->second.begin(); sit != it->second.end(); ++sit)
-                out << printStmt(sit->get(), indent + 4);
-            out << std::string(indent, ' ') << "}\n";
+            indentStr(indent);
+            m_out += "else(";
+            printExpr(it->first.get());
+            m_out += ") ";
+            printBlock(it->second, indent);
         }
 
     if (ifs->elseBlock.has_value() && ifs->elseBlock->size() > 0)
     {
-        out << std::string(indent, ' ') << "else {\n";
-        for (auto it = ifs->elseBlock->begin(); it != ifs->elseBlock->end(); it++)
-            out << printStmt(it->get(), indent + 4);
-        out << std::string(indent, ' ') << "}\n";
+        indentStr(indent);
+        m_out += "else ";
+        printBlock(*ifs->elseBlock, indent);
     }
-
-    return out.str();
 }
 
-std::string AstPrinter::printWhile(const WhileStmt *w, int indent)
+void AstPrinter::printWhile(const WhileStmt *w, int indent)
 {
-    std::ostringstream out;
-    out << std::string(indent, ' ') << "while(" << printExpr(w->condition.get()) << ") {\n";
-    for (const auto &s : w->body)
-        out << printStmt(s.get(), indent + 4);
-    out << std::string(indent, ' ') << "}\n";
-    return out.str();
+    indentStr(indent);
+    m_out += "while(";
+    printExpr(w->condition.get());
+    m_out += ") ";
+    printBlock(w->body, indent);
 }
 
-std::string AstPrinter::printLoop(const LoopStmt *l, int indent)
+void AstPrinter::printLoop(const LoopStmt *l, int indent)
 {
-    std::ostringstream out;
-    out << std::string(indent, ' ') << "loop(";
+    indentStr(indent);
+    m_out += "loop(";
+    if (l->dtype)
+    {
+        m_out += *l->dtype;
+        m_out += " ";
+    }
     if (l->init.get())
     {
         // init is usually ExprStmt
         if (auto es = dynamic_cast<const ExprStmt *>(l->init.get()))
-        {
-            out << printExpr(es->expr.get());
-        }
+            printExpr(es->expr.get());
         else
-        {
-            out << "//init";
-        }
+            m_out += "//init";
     }
-    out << ", ";
+    m_out += ", ";
     if (l->condition)
-        out << printExpr(l->condition.get());
+        printExpr(l->condition.get());
     else
-        out << "true";
-    out << ", ";
+        m_out += "true";
+    m_out += ", ";
     if (l->step.get())
     {
         if (auto es = dynamic_cast<const ExprStmt *>(l->step.get()))
-        {
-            out << printExpr(es->expr.get());
-        }
+            printExpr(es->expr.get());
         else
-        {
-            out << "//step";
-        }
+            m_out += "//step";
     }
-    out << ") {\n";
-    for (const auto &s : l->body)
-        out << printStmt(s.get(), indent + 4);
-    out << std::string(indent, ' ') << "}\n";
-    return out.str();
+    m_out += ") ";
+    printBlock(l->body, indent);
 }
 
-std::string AstPrinter::printIter(const IterStmt *it, int indent)
+void AstPrinter::printIter(const IterStmt *it, int indent)
 {
-    std::ostringstream out;
-    out << std::string(indent, ' ') << "iter(" << printExpr(it->iterable.get()) << ", " << it->varName << ") {\n";
-    for (const auto &s : it->body)
-        out << printStmt(s.get(), indent + 4);
-    out << std::string(indent, ' ') << "}\n";
-    return out.str();
+    indentStr(indent);
+    m_out += "iter(";
+    printExpr(it->iterable.get());
+    m_out += ", ";
+    m_out += it->varName;
+    m_out += ") ";
+    printBlock(it->body, indent);
 }
 
-std::string AstPrinter::printExpr(const Expr *e)
+void AstPrinter::printExpr(const Expr *e)
 {
     if (!e)
-        return "<null_expr>";
+    {
+        m_out += "<null_expr>";
+        return;
+    }
     if (auto lit = dynamic_cast<const LiteralExpr *>(e))
         return printLiteral(lit);
     if (auto id = dynamic_cast<const IdentifierExpr *>(e))
@@ -233,57 +282,62 @@ std::string AstPrinter::printExpr(const Expr *e)
     if (auto c = dynamic_cast<const CallExpr *>(e))
         return printCall(c);
     // fallback
-    return "<expr>";
+    m_out += "<expr>";
 }
 
-std::string AstPrinter::printLiteral(const LiteralExpr *lit)
+void AstPrinter::printLiteral(const LiteralExpr *lit)
 {
-    return lit->value;
+    m_out += lit->value;
 }
 
-std::string AstPrinter::printIdentifier(const IdentifierExpr *id)
+void AstPrinter::printIdentifier(const IdentifierExpr *id)
 {
-    return id->name;
+    m_out += id->name;
 }
 
-std::string AstPrinter::printUnary(const UnaryExpr *u)
+void AstPrinter::printUnary(const UnaryExpr *u)
 {
-    std::ostringstream out;
-    out << u->op;
+    m_out += u->op;
     if (u->right)
-        out << printExpr(u->right.get());
+        printExpr(u->right.get());
     else
-        out << "<null>";
-    return out.str();
+        m_out += "<null>";
 }
 
-std::string AstPrinter::printBinary(const BinaryExpr *b)
+void AstPrinter::printBinary(const BinaryExpr *b)
 {
-    std::ostringstream out;
     // simple parentheses to keep precedence safe
-    out << "(" << (b->left ? printExpr(b->left.get()) : "<null>")
-        << " " << b->op << " "
-        << (b->right ? printExpr(b->right.get()) : "<null>") << ")";
-    return out.str();
+    m_out += "(";
+    if (b->left)
+        printExpr(b->left.get());
+    else
+        m_out += "<null>";
+    m_out += " ";
+    m_out += b->op;
+    m_out += " ";
+    if (b->right)
+        printExpr(b->right.get());
+    else
+        m_out += "<null>";
+    m_out += ")";
 }
 
-std::string AstPrinter::printCall(const CallExpr *c)
+void AstPrinter::printCall(const CallExpr *c)
 {
-    std::ostringstream out;
-    out << printExpr(c->callee.get()) << "(";
+    printExpr(c->callee.get());
+    m_out += "(";
     bool first = true;
     for (const auto &a : c->args)
     {
         if (!first)
-            out << ", ";
-        out << printExpr(a.get());
+            m_out += ", ";
+        printExpr(a.get());
         first = false;
     }
-    out << ")";
-    return out.str();
+    m_out += ")";
 }
 
-std::string AstPrinter::indentStr(int indent)
+void AstPrinter::indentStr(int indent)
 {
-    return std::string(indent, ' ');
+    m_out.append(static_cast<size_t>(indent), ' ');
 }
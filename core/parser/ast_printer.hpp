@@ -7,25 +7,31 @@ public:
     // Print a full program to source text
     static std::string print(const Program& prog);
 
+    // Append the program's source text to `out` (no intermediate strings)
+    static void printTo(const Program& prog, std::string& out);
+
 private:
-    AstPrinter();
-    std::string printProgram(const Program& prog);
-    std::string printDecl(const Decl* d, int indent);
-    std::string printFunc(const FuncDecl* f, int indent);
-    std::string printBlockDecl(const BlockDecl* b, int indent);
-    std::string printVarDecl(const VarDecl* v, int indent);
-    std::string printStmt(const Stmt* s, int indent);
-    std::string printExprStmt(const ExprStmt* e, int indent);
-    std::string printReturn(const ReturnStmt* r, int indent);
-    std::string printIf(const IfStmt* ifs, int indent);
-    std::string printWhile(const WhileStmt* w, int indent);
-    std::string printLoop(const LoopStmt* l, int indent);
-    std::string printIter(const IterStmt* it, int indent);
-    std::string printExpr(const Expr* e);
-    std::string printLiteral(const LiteralExpr* lit);
-    std::string printIdentifier(const IdentifierExpr* id);
-    std::string printUnary(const UnaryExpr* u);
-    std::string printBinary(const BinaryExpr* b);
-    std::string printCall(const CallExpr* c);
-    std::string indentStr(int n);
+    explicit AstPrinter(std::string& out);
+    void printProgram(const Program& prog);
+    void printDecl(const Decl* d, int indent);
+    void printFunc(const FuncDecl* f, int indent);
+    void printBlockDecl(const BlockDecl* b, int indent);
+    void printVarDecl(const VarDecl* v, int indent);
+    void printStmt(const Stmt* s, int indent);
+    void printBlock(const Block& b, int indent);
+    void printExprStmt(const ExprStmt* e, int indent);
+    void printReturn(const ReturnStmt* r, int indent);
+    void printIf(const IfStmt* ifs, int indent);
+    void printWhile(const WhileStmt* w, int indent);
+    void printLoop(const LoopStmt* l, int indent);
+    void printIter(const IterStmt* it, int indent);
+    void printExpr(const Expr* e);
+    void printLiteral(const LiteralExpr* lit);
+    void printIdentifier(const IdentifierExpr* id);
+    void printUnary(const UnaryExpr* u);
+    void printBinary(const BinaryExpr* b);
+    void printCall(const CallExpr* c);
+    void indentStr(int n);
+
+    std::string& m_out;
 };
@@ -43,8 +43,13 @@ void Parser::consume(TokenType t, const std::string &errMsg)
     if (!check(t))
     {
         std::stringstream ss;
-        ss << "Parse error at line " << peek().line << " col " << peek().column << ": " << errMsg;
-        std::cout << ss.str() << "\n";
+        ss << "Parse error at line " << peek().line << " col " << peek().column << ": ";
+        if (peek().type == TokenType::INVALID)
+            ss << "Invalid token '" << peek().lexeme << "'";
+        else
+            ss << errMsg;
+        if (m_echo)
+            std::cout << ss.str() << "\n";
         m_errors.push_back(ss.str());
     }
     advance();
@@ -54,7 +59,8 @@ void Parser::logError(const std::string &errMsg)
 {
     std::stringstream ss;
     ss << "Parse error at line " << peek().line << ", col " << peek().column << ": " << errMsg;
-    std::cout << ss.str() << "\n";
+    if (m_echo)
+        std::cout << ss.str() << "\n";
     m_errors.push_back(ss.str());
 }
 
@@ -63,6 +69,12 @@ std::unique_ptr<Program> Parser::parse()
     auto program = std::make_unique<Program>();
     while (!isAtEnd())
     {
+        // global variables are statements, so they don't go through decls
+        if (isDtypeToken() && !check(TokenType::BLOCK))
+        {
+            program->globalVars.push_back(parseVarDeclStmt());
+            continue;
+        }
         auto d = parseTopLevelDecl();
         if (d)
             program->decls.push_back(std::move(d));
@@ -105,21 +117,13 @@ DeclPtr Parser::parseTopLevelDecl()
             return h;
     }
 
-    // otherwise attempt to parse as statement-level declaration (e.g., var decl)
-    // If type keyword present (like 'number' etc), parse var decl as top-level
-    if (isDtypeToken())
-    {
-        auto v = parseVarDeclStmt();
-        // return v ? std::move(v) : nullptr;
-        return nullptr;
-    }
-    // unknown top-level token -> error and skip
+    // unknown top-level token -> error and skip; parse() tries the next one
     if (!isAtEnd() && peek().type != TokenType::END_OF_FILE)
     {
         logError("Unexpected token at top-level: " + peek().lexeme);
     }
     advance();
-    return parseTopLevelDecl(); // try next
+    return nullptr;
 }
 
 DeclPtr Parser::parseHeader()
@@ -203,7 +207,8 @@ DeclPtr Parser::parseFuncDecl()
 {
     // assume current token is function name (IDENTIFIER)
     std::string fname;
-    if (check(TokenType::IDENTIFIER))
+    // `main` is a keyword but names the entry point
+    if (check(TokenType::IDENTIFIER) || check(TokenType::MAIN))
     {
         fname = peek().lexeme;
     }
@@ -225,20 +230,24 @@ DeclPtr Parser::parseFuncDecl()
         consume(TokenType::LPAREN, "Expected '(' after function name");
     }
 
-    // Function declaration ends with semicolon, NO body
-    consume(TokenType::SEMICOLON, "Expected ';' after function declaration.");
-
     auto func = std::make_unique<FuncDecl>();
     func->name = fname;
     func->params = std::move(params);
 
+    // `@func f(...);` is a prototype; `@func f(...) { ... }` also defines it
+    if (match(TokenType::LBRACE))
+        func->body = parseBlock();
+    else
+        consume(TokenType::SEMICOLON, "Expected ';' after function declaration.");
+
     return func;
 }
 
 DeclPtr Parser::parseFuncDef()
 {
     std::string fname;
-    if (check(TokenType::IDENTIFIER))
+    // `main` is a keyword but names the entry point
+    if (check(TokenType::IDENTIFIER) || check(TokenType::MAIN))
     {
         fname = peek().lexeme;
     }
@@ -283,7 +292,9 @@ std::vector<std::pair<std::string, std::string>> Parser::parseArgList()
 {
     // parse params: type name, comma separated
     std::vector<std::pair<std::string, std::string>> params;
-    while (!match(TokenType::RPAREN) || match(TokenType::COMMA))
+    if (match(TokenType::RPAREN))
+        return params;
+    do
     {
         std::string ptype;
         if (!isDtypeToken())
@@ -298,28 +309,24 @@ std::vector<std::pair<std::string, std::string>> Parser::parseArgList()
         std::string pname;
         if (match(TokenType::IDENTIFIER))
         {
-            pname = peek().lexeme;
+            pname = previous().lexeme;
         }
         else
         {
             logError("Expected parameter name after type in function *args or **kwargs");
         }
         params.emplace_back(ptype, pname);
-        if (!check(TokenType::RPAREN) && !check(TokenType::COMMA) || isAtEnd())
-        {
-            logError("Expected ',' or ')' after function parameter");
-            break;
-        }
-    }
+    } while (match(TokenType::COMMA));
+    consume(TokenType::RPAREN, "Expected ',' or ')' after function parameter");
     return params;
 }
 
 std::unique_ptr<VarDecl> Parser::parseVarDeclStmt()
 {
     // first token is a type keyword
-    std::string typeName = peek().lexeme;
+    std::string typeName = advance().lexeme;
     std::string varName;
-    if (!check(TokenType::IDENTIFIER))
+    if (check(TokenType::IDENTIFIER))
     {
         varName = peek().lexeme;
     }
@@ -362,7 +369,8 @@ StmtPtr Parser::parseStatement()
         auto v = parseVarDeclStmt();
         return v ? std::move(v) : nullptr;
     }
-    if (check(TokenType::IDENTIFIER))
+    if (check(TokenType::IDENTIFIER) || check(TokenType::LPAREN) || isLiteralToken() ||
+        check(TokenType::NOT) || check(TokenType::MINUS) || check(TokenType::PLUS))
     {
         return parseExprStmt();
     }
@@ -386,16 +394,17 @@ StmtPtr Parser::parseReturnStmt()
 StmtPtr Parser::parseIfStmt()
 {
     ExprPtr cond;
-    if (match(TokenType::RPAREN))
+    if (match(TokenType::LPAREN))
     {
         cond = parseExpression();
+        consume(TokenType::RPAREN, "Expected ')' after if condition");
     }
     else
     {
         logError("Expected '(' after if");
     }
     Block thenBlock;
-    if (check(TokenType::LBRACE))
+    if (match(TokenType::LBRACE))
     {
         thenBlock = parseBlock();
     }
@@ -407,37 +416,39 @@ StmtPtr Parser::parseIfStmt()
     ifstmt->ifBlock.first = std::move(cond);
     ifstmt->ifBlock.second = std::move(thenBlock);
 
-    // else-if and else chain
-    if (match(TokenType::ELSE) && check(TokenType::LPAREN))
-        while (match(TokenType::ELSE))
+    // else-if and else chain: `else(cond) { ... }`* then an optional `else { ... }`
+    while (match(TokenType::ELSE))
+    {
+        if (match(TokenType::LBRACE))
         {
-            if (check(TokenType::LBRACE))
-            {
-                auto elseBlk = parseBlock();
-                ifstmt->elseBlock = std::move(elseBlk);
-            }
-            else if (check(TokenType::LPAREN))
+            auto elseBlk = parseBlock();
+            ifstmt->elseBlock = std::move(elseBlk);
+            break;
+        }
+        else if (match(TokenType::LPAREN))
+        {
+            ExprPtr econd = parseExpression();
+            consume(TokenType::RPAREN, "Expected ')' after else condition");
+            Block elseBlock;
+            if (match(TokenType::LBRACE))
             {
-                ExprPtr econd = parseExpression();
-                Block elseBlock;
-                if (match(TokenType::LBRACE))
-                {
-                    elseBlock = parseBlock();
-                }
-                else if (!check(TokenType::SEMICOLON))
-                {
-                    consume(TokenType::SEMICOLON, "Expected '{' or ';' after else(condition)");
-                    continue;
-                }
-                if (!ifstmt->elseIfs)
-                    ifstmt->elseIfs.emplace();
-                ifstmt->elseIfs->push_back(std::make_pair(std::move(econd), std::move(elseBlock)));
+                elseBlock = parseBlock();
             }
-            else
+            else if (!check(TokenType::SEMICOLON))
             {
-                logError("Expected '{' or '(' after else");
+                consume(TokenType::SEMICOLON, "Expected '{' or ';' after else(condition)");
+                continue;
             }
+            if (!ifstmt->elseIfs)
+                ifstmt->elseIfs.emplace();
+            ifstmt->elseIfs->push_back(std::make_pair(std::move(econd), std::move(elseBlock)));
         }
+        else
+        {
+            logError("Expected '{' or '(' after else");
+            break;
+        }
+    }
     return ifstmt;
 }
 
@@ -475,9 +486,9 @@ StmtPtr Parser::parseLoopStmt()
     {
         if (isDtypeToken())
         {
-            loop->dtype = std::move(peek().lexeme);
+            loop->dtype = advance().lexeme;
         }
-        if (check(TokenType::IDENTIFIER))
+        if (!check(TokenType::COMMA))
         {
             auto e = parseExpression();
             loop->init = std::make_unique<ExprStmt>(std::move(e));
@@ -487,12 +498,12 @@ StmtPtr Parser::parseLoopStmt()
             logError("Expected loop initialization statement");
         }
         consume(TokenType::COMMA, "Expected ',' after loop init");
-        if (check(TokenType::IDENTIFIER) || isLiteralToken())
+        if (!check(TokenType::COMMA))
         {
-            loop->condition = std::move(parseExpression());
+            loop->condition = parseExpression();
         }
         consume(TokenType::COMMA, "Expected ',' after loop condition");
-        if (check(TokenType::IDENTIFIER) || isLiteralToken())
+        if (!check(TokenType::RPAREN))
         {
             auto stepExpr = parseExpression();
             loop->step = std::make_unique<ExprStmt>(std::move(stepExpr));
@@ -521,7 +532,7 @@ StmtPtr Parser::parseIterStmt()
     }
     else
     {
-        if (check(TokenType::IDENTIFIER))
+        if (!check(TokenType::COMMA))
         {
             auto e = parseExpression();
             iter->iterable = std::move(e);
@@ -531,9 +542,17 @@ StmtPtr Parser::parseIterStmt()
             logError("Expected iterable expression in iter statement");
         }
         consume(TokenType::COMMA, "Expected ',' after loop init");
-        if (isDtypeToken() && check(TokenType::IDENTIFIER))
+        if (isDtypeToken())
+        {
+            advance();
+        }
+        if (match(TokenType::IDENTIFIER))
+        {
+            iter->varName = previous().lexeme;
+        }
+        else
         {
-            iter->varName = std::move(peek().lexeme);
+            logError("Expected loop variable name in iter statement");
         }
         consume(TokenType::RPAREN, "Expected ')' after loop parameters");
     }
@@ -677,6 +696,7 @@ ExprPtr Parser::parsePrimary()
 {
     if (isLiteralToken())
     {
+        advance();
         return std::make_unique<LiteralExpr>(previous().lexeme, previous().type);
     }
 
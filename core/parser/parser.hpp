@@ -4,6 +4,13 @@
 #include <vector>
 #include <optional>
 
+// Bumped whenever some source lexes or parses to a different tree or
+// different errors, so caches of parsed sources keyed on it (HeaderCache)
+// stop serving what an older build produced.
+//   2: a lone '&' or '|' is an INVALID token instead of being dropped
+//   3: so is any other character the lexer has no use for
+constexpr uint32_t kParserVersion = 3;
+
 class Parser
 {
 public:
@@ -15,6 +22,9 @@ public:
     // get errors
     const std::vector<std::string> &errors() const { return m_errors; }
 
+    // echo errors to stdout as they are found (on by default)
+    void setEcho(bool echo) { m_echo = echo; }
+
 private:
     // token helpers
     const Token &peek() const;
@@ -64,4 +74,5 @@ private:
     const std::vector<Token> &tokens;
     size_t current = 0;
     std::vector<std::string> m_errors;
+    bool m_echo = true;
 };
@@ -0,0 +1,67 @@
+#include "arena.hpp"
+#include <algorithm>
+#include <utility>
+
+Arena::Arena(Arena &&other) noexcept
+    : m_chunks(std::move(other.m_chunks)), m_chunk(other.m_chunk), m_cur(other.m_cur), m_end(other.m_end),
+      m_used(other.m_used)
+{
+    other.m_chunks.clear();
+    other.reset();
+}
+
+Arena &Arena::operator=(Arena &&other) noexcept
+{
+    if (this != &other)
+    {
+        m_chunks = std::move(other.m_chunks);
+        m_chunk = other.m_chunk;
+        m_cur = other.m_cur;
+        m_end = other.m_end;
+        m_used = other.m_used;
+        other.m_chunks.clear();
+        other.reset();
+    }
+    return *this;
+}
+
+size_t Arena::reserved() const
+{
+    size_t n = 0;
+    for (const Chunk &c : m_chunks)
+        n += c.size;
+    return n;
+}
+
+bool Arena::contains(const void *p) const
+{
+    auto at = reinterpret_cast<uintptr_t>(p);
+    for (size_t i = 0; i < m_chunks.size() && i <= m_chunk; i++)
+        if (at >= m_chunks[i].begin() && at < (i == m_chunk ? m_cur : m_chunks[i].end()))
+            return true;
+    return false;
+}
+
+void *Arena::grow(size_t bytes, size_t align)
+{
+    // Room for the request at any alignment of the chunk start.
+    size_t need = bytes + align - 1;
+    size_t next = m_chunks.empty() ? 0 : m_chunk + 1;
+    // A chunk kept from before the last reset, if one is large enough; it
+    // moves up to be the next one in use.
+    size_t found = next;
+    while (found < m_chunks.size() && m_chunks[found].size < need)
+        found++;
+    if (found < m_chunks.size())
+        std::swap(m_chunks[next], m_chunks[found]);
+    else
+    {
+        size_t last = m_chunks.empty() ? kFirstChunk / 2 : m_chunks[m_chunk].size;
+        size_t size = std::max(need, std::min(2 * last, kMaxChunk));
+        m_chunks.insert(m_chunks.begin() + next, Chunk{std::unique_ptr<char[]>(new char[size]), size});
+    }
+    m_chunk = next;
+    m_cur = m_chunks[next].begin();
+    m_end = m_chunks[next].end();
+    return allocate(bytes, align);
+}
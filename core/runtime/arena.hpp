@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Bump allocator for objects that all die together, such as everything a
+// program creates during one test case.
+//
+// allocate() moves a pointer through the current chunk; reset() frees
+// everything at once in O(1) by going back to the start of the first
+// chunk. Chunks are kept across resets, so a workspace that runs many test
+// cases allocates from the system only until it reaches its high-water
+// mark. Nothing is destroyed: only trivially destructible objects belong
+// in an arena.
+
+class Arena
+{
+public:
+    Arena() = default;
+    Arena(const Arena &) = delete; // objects point into it
+    Arena &operator=(const Arena &) = delete;
+    Arena(Arena &&other) noexcept;
+    Arena &operator=(Arena &&other) noexcept;
+
+    // `align` must be a power of two, at most 64.
+    void *allocate(size_t bytes, size_t align = alignof(std::max_align_t))
+    {
+        uintptr_t p = (m_cur + (align - 1)) & ~static_cast<uintptr_t>(align - 1);
+        if (p > m_end || bytes > m_end - p)
+            return grow(bytes, align);
+        m_cur = p + bytes;
+        m_used += bytes;
+        return reinterpret_cast<void *>(p);
+    }
+    void reset()
+    {
+        m_chunk = 0;
+        m_cur = m_chunks.empty() ? 0 : m_chunks[0].begin();
+        m_end = m_chunks.empty() ? 0 : m_chunks[0].end();
+        m_used = 0;
+    }
+
+    // Bytes handed out since the last reset, alignment padding excluded.
+    size_t used() const { return m_used; }
+    // Bytes held in chunks, in use or not.
+    size_t reserved() const;
+    // Whether `p` lies in memory handed out since the last reset.
+    bool contains(const void *p) const;
+
+private:
+    struct Chunk
+    {
+        std::unique_ptr<char[]> data;
+        size_t size;
+        uintptr_t begin() const { return reinterpret_cast<uintptr_t>(data.get()); }
+        uintptr_t end() const { return begin() + size; }
+    };
+
+    void *grow(size_t bytes, size_t align);
+
+    static constexpr size_t kFirstChunk = 4096;
+    static constexpr size_t kMaxChunk = 1 << 20; // larger requests get a chunk of their own
+
+    // chunks[0..m_chunk] are in use, the rest wait for a later allocation
+    std::vector<Chunk> m_chunks;
+    size_t m_chunk = 0;
+    uintptr_t m_cur = 0;
+    uintptr_t m_end = 0;
+    size_t m_used = 0;
+};
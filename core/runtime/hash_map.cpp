@@ -0,0 +1,153 @@
+#include "hash_map.hpp"
+#include "../utils/hash.hpp"
+
+#if !defined(MUTAGEN_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    constexpr size_t kGroup = 16;
+    constexpr uint8_t kEmpty = 0x80;
+
+    // Bit j set where ctrl[j] == byte, over one group (16-byte aligned).
+    inline uint32_t match(const uint8_t *ctrl, uint8_t byte)
+    {
+#if !defined(MUTAGEN_NO_SIMD) && defined(__SSE2__)
+        __m128i group = _mm_load_si128(reinterpret_cast<const __m128i *>(ctrl));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(byte)))));
+#else
+        uint32_t bits = 0;
+        for (size_t j = 0; j < kGroup; j++)
+            bits |= static_cast<uint32_t>(ctrl[j] == byte) << j;
+        return bits;
+#endif
+    }
+
+    // The slot holding `key`, setting `found`, or else the empty slot
+    // where it would go. The table must have an empty slot.
+    size_t probe(const HashMap &m, const Value &key, uint64_t h, bool &found)
+    {
+        size_t mask = m.capacity / kGroup - 1;
+        size_t g = (h >> 7) & mask;
+        uint8_t tag = h & 0x7F;
+        for (size_t step = 1;; step++)
+        {
+            const uint8_t *ctrl = m.ctrl + g * kGroup;
+            for (uint32_t bits = match(ctrl, tag); bits; bits &= bits - 1)
+            {
+                size_t i = g * kGroup + __builtin_ctz(bits);
+                const Value &k = m.slots[i].key;
+                if (k.bits() == key.bits() || valuesEqual(k, key))
+                {
+                    found = true;
+                    return i;
+                }
+            }
+            if (uint32_t empty = match(ctrl, kEmpty))
+            {
+                found = false;
+                return g * kGroup + __builtin_ctz(empty);
+            }
+            g = (g + step) & mask;
+        }
+    }
+
+    void fill(HashMap &m, size_t i, uint64_t h, const Value &key, const Value &value)
+    {
+        m.ctrl[i] = h & 0x7F;
+        m.slots[i] = {key, value};
+        m.size++;
+    }
+
+    void allocateTable(HashMap &m, size_t capacity, ValueHeap &heap)
+    {
+        m.capacity = capacity;
+        m.ctrl = static_cast<uint8_t *>(heap.allocate(capacity, kGroup));
+        m.slots = static_cast<HashMap::Slot *>(heap.allocate(capacity * sizeof(HashMap::Slot), alignof(HashMap::Slot)));
+        std::memset(m.ctrl, kEmpty, capacity);
+    }
+
+    // Re-inserts every key into a table twice the size, in slot order.
+    void grow(HashMap &m, ValueHeap &heap)
+    {
+        HashMap old = m;
+        m.size = 0;
+        allocateTable(m, old.capacity ? old.capacity * 2 : kGroup, heap);
+        for (size_t i = mapNext(old, 0); i < old.capacity; i = mapNext(old, i + 1))
+        {
+            const HashMap::Slot &s = old.slots[i];
+            uint64_t h = hashKey(s.key);
+            bool found;
+            fill(m, probe(m, s.key, h, found), h, s.key, s.value);
+        }
+    }
+}
+
+bool hashableKey(const Value &key)
+{
+    return key.isText() || key.kind() == ValueKind::Bool || (key.isNumber() && key.num() == key.num());
+}
+
+uint64_t hashKey(const Value &key)
+{
+    if (key.isText())
+        return hashString(key.text());
+    if (key.isNumber())
+    {
+        double x = key.num() == 0.0 ? 0.0 : key.num();
+        uint64_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        return mix64(bits);
+    }
+    return mix64(key.bits());
+}
+
+const Value *mapFind(const HashMap &m, const Value &key)
+{
+    if (m.size == 0 || !hashableKey(key))
+        return nullptr;
+    bool found;
+    size_t i = probe(m, key, hashKey(key), found);
+    return found ? &m.slots[i].value : nullptr;
+}
+
+void mapPut(HashMap &m, const Value &key, const Value &value, ValueHeap &heap)
+{
+    uint64_t h = hashKey(key);
+    bool found = false;
+    size_t i = 0;
+    if (m.capacity)
+        i = probe(m, key, h, found);
+    if (found)
+    {
+        m.slots[i].value = value;
+        return;
+    }
+    if ((m.size + 1) * 8 > m.capacity * 7)
+    {
+        grow(m, heap);
+        i = probe(m, key, h, found);
+    }
+    fill(m, i, h, key, value);
+}
+
+size_t mapNext(const HashMap &m, size_t pos)
+{
+    while (pos < m.capacity && m.ctrl[pos] == kEmpty)
+        pos++;
+    return pos;
+}
+
+HashMap &mapClone(const HashMap &m, ValueHeap &to)
+{
+    auto *copy = new (to.allocate(sizeof(HashMap), alignof(HashMap))) HashMap(m);
+    if (m.capacity)
+    {
+        allocateTable(*copy, m.capacity, to);
+        std::memcpy(copy->ctrl, m.ctrl, m.capacity);
+        for (size_t i = mapNext(m, 0); i < m.capacity; i = mapNext(m, i + 1))
+            copy->slots[i] = m.slots[i];
+    }
+    return *copy;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "value.hpp"
+#include <cstddef>
+#include <cstdint>
+
+//////////////////////////////////////////////////////////////////////////
+// The table behind a map value: a Swiss table, open addressing over groups
+// of 16 slots with a control byte per slot.
+//
+// A key's 64-bit hash is split in two: the high 57 bits pick the group a
+// probe starts at, the low 7 are kept in the control byte of the slot the
+// key goes to (an empty slot's byte is 0x80). A probe compares the 16
+// control bytes of a group at once (SSE2; a plain loop elsewhere or with
+// MUTAGEN_NO_SIMD), so a lookup is usually one group load and one key
+// comparison, hit or miss. Groups are visited in triangular steps, which
+// reach every group of a power-of-two table. Keys are never removed, so
+// there are no tombstones; the table doubles at 7/8 full. Tables come
+// from a ValueHeap, and a grown map leaves its old one there until the
+// next clear().
+//
+// Slot order depends only on the keys and the order they were put, not on
+// addresses or the instruction set, so iterating and printing a map give
+// the same order on every build.
+
+struct HashMap::Slot
+{
+    Value key;
+    Value value;
+};
+
+// Keys are numbers (not NaN), bools and texts. Keys that valuesEqual()
+// calls equal hash alike: 0 and -0, an inline text and a heap one.
+bool hashableKey(const Value &key);
+uint64_t hashKey(const Value &key);
+
+// The value stored for `key`, or null.
+const Value *mapFind(const HashMap &m, const Value &key);
+// Stores `value` under `key`, which must be hashable, growing the table
+// in `heap`.
+void mapPut(HashMap &m, const Value &key, const Value &value, ValueHeap &heap);
+// The first full slot at or after `pos`; m.capacity when there is none.
+size_t mapNext(const HashMap &m, size_t pos);
+// A copy of `m` made in `to`, slot for slot, so it iterates in the same
+// order. Keys and values are shared, not copied.
+HashMap &mapClone(const HashMap &m, ValueHeap &to);
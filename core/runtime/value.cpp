@@ -0,0 +1,531 @@
+#include "value.hpp"
+#include "hash_map.hpp"
+#include "vector_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+BinOp binOpFromLexeme(const std::string &op)
+{
+    if (op.size() == 1)
+    {
+        switch (op[0])
+        {
+        case '+': return BinOp::Add;
+        case '-': return BinOp::Sub;
+        case '*': return BinOp::Mul;
+        case '/': return BinOp::Div;
+        case '%': return BinOp::Mod;
+        case '<': return BinOp::Lt;
+        case '>': return BinOp::Gt;
+        default: return BinOp::Invalid;
+        }
+    }
+    if (op == "==") return BinOp::Eq;
+    if (op == "!=") return BinOp::Ne;
+    if (op == "<=") return BinOp::Le;
+    if (op == ">=") return BinOp::Ge;
+    return BinOp::Invalid;
+}
+
+const char *to_string(BinOp op)
+{
+    static const char *const names[] = {"+", "-", "*", "/", "%", "==", "!=", "<", "<=", ">", ">=", "?"};
+    return names[static_cast<int>(op)];
+}
+
+const char *to_string(ValueKind k)
+{
+    switch (k)
+    {
+    case ValueKind::Number: return "number";
+    case ValueKind::Bool: return "bool";
+    case ValueKind::Text: return "text";
+    case ValueKind::Complex: return "complex";
+    case ValueKind::Vector: return "vector";
+    case ValueKind::Sequence: return "sequence";
+    case ValueKind::HashMap: return "hash_map";
+    default: return "nil";
+    }
+}
+
+namespace
+{
+    // Vector elements and complex parts are raw doubles, not boxed Values, so
+    // their NaNs are folded onto Value's canonical one here.
+    double canonicalNaN(double x)
+    {
+        return x == x ? x : -std::numeric_limits<double>::quiet_NaN();
+    }
+
+    void appendNumber(std::string &out, double x)
+    {
+        x = canonicalNaN(x);
+        char buf[32];
+        if (std::fabs(x) < 1e15 && x == std::floor(x))
+            std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(x));
+        else
+            std::snprintf(buf, sizeof(buf), "%.17g", x);
+        out += buf;
+    }
+}
+
+std::string formatValue(const Value &v)
+{
+    std::string out;
+    switch (v.kind())
+    {
+    case ValueKind::Number: appendNumber(out, v.num()); return out;
+    case ValueKind::Bool: return v.boolean() ? "true" : "false";
+    case ValueKind::Text: return std::string(v.text());
+    case ValueKind::Complex:
+    {
+        // The literal form: 3+4i, 1-2i.
+        const std::complex<double> &z = v.complex();
+        appendNumber(out, z.real());
+        out += std::signbit(canonicalNaN(z.imag())) ? '-' : '+';
+        appendNumber(out, std::fabs(z.imag()));
+        out += 'i';
+        return out;
+    }
+    case ValueKind::Vector:
+    {
+        const NumVector &vec = v.vector();
+        out += '[';
+        for (size_t i = 0; i < vec.size; i++)
+        {
+            if (i)
+                out += ", ";
+            appendNumber(out, vec.data[i]);
+        }
+        out += ']';
+        return out;
+    }
+    case ValueKind::Sequence:
+    {
+        const Sequence &s = v.sequence();
+        out += '(';
+        for (size_t i = 0; i < s.size; i++)
+        {
+            if (i)
+                out += ", ";
+            out += formatValue(s.items[i]);
+        }
+        out += ')';
+        return out;
+    }
+    case ValueKind::HashMap:
+    {
+        // Slot order, the order iter visits the keys in.
+        const HashMap &m = v.map();
+        out += '{';
+        for (size_t i = mapNext(m, 0); i < m.capacity; i = mapNext(m, i + 1))
+        {
+            if (out.size() > 1)
+                out += ", ";
+            out += formatValue(m.slots[i].key);
+            out += ": ";
+            out += formatValue(m.slots[i].value);
+        }
+        out += '}';
+        return out;
+    }
+    default: return "nil";
+    }
+}
+
+bool literalValue(const std::string &lexeme, TokenType type, ValueHeap &heap, Value &out)
+{
+    switch (type)
+    {
+    case TokenType::INT_LITERAL:
+    case TokenType::FLOAT_LITERAL:
+        out = Value::number(std::strtod(lexeme.c_str(), nullptr));
+        return true;
+    case TokenType::BIN_LITERAL:
+        out = Value::number(static_cast<double>(std::strtoull(lexeme.c_str() + 2, nullptr, 2)));
+        return lexeme.size() > 2;
+    case TokenType::HEX_LITERAL:
+        out = Value::number(static_cast<double>(std::strtoull(lexeme.c_str() + 2, nullptr, 16)));
+        return lexeme.size() > 2;
+    case TokenType::BOOL_LITERAL:
+        out = Value::fromBool(lexeme == "true");
+        return true;
+    case TokenType::STRING_LITERAL:
+    {
+        size_t begin = !lexeme.empty() && lexeme.front() == '"' ? 1 : 0;
+        size_t end = lexeme.size() > begin && lexeme.back() == '"' ? lexeme.size() - 1 : lexeme.size();
+        out = heap.text(lexeme.substr(begin, end - begin));
+        return true;
+    }
+    case TokenType::COMPLEX_LITERAL:
+    {
+        // re+imi or re-imi
+        const char *p = lexeme.c_str();
+        char *end;
+        double re = std::strtod(p, &end);
+        if (end == p || (*end != '+' && *end != '-'))
+            return false;
+        p = end;
+        double im = std::strtod(p, &end);
+        if (end == p || *end != 'i' || end[1] != '\0')
+            return false;
+        out = heap.complex({re, im});
+        return true;
+    }
+    case TokenType::VECTOR_LITERAL:
+    {
+        // [x, y, ...]
+        std::vector<double> xs;
+        const char *p = lexeme.c_str();
+        if (*p++ != '[')
+            return false;
+        while (*p == ' ')
+            p++;
+        while (*p != ']')
+        {
+            char *end;
+            xs.push_back(std::strtod(p, &end));
+            if (end == p)
+                return false;
+            for (p = end; *p == ' '; p++)
+                ;
+            if (*p == ',')
+                p++;
+            else if (*p != ']')
+                return false;
+            while (*p == ' ')
+                p++;
+        }
+        if (p[1] != '\0')
+            return false;
+        double *data;
+        out = heap.vector(xs.size(), data);
+        std::copy(xs.begin(), xs.end(), data);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+Value ValueHeap::escape(const Value &v, ValueHeap &to) const
+{
+    if (!owns(v))
+        return v;
+    switch (v.kind())
+    {
+    case ValueKind::Text: return to.text(v.text());
+    case ValueKind::Complex: return to.complex(v.complex());
+    case ValueKind::Vector:
+    {
+        const NumVector &x = v.vector();
+        double *data;
+        Value copy = to.vector(x.size, data);
+        std::copy(x.data, x.data + x.size, data);
+        return copy;
+    }
+    case ValueKind::Sequence:
+    {
+        const Sequence &s = v.sequence();
+        Value *items;
+        Value copy = to.sequence(s.size, s.depth, items);
+        for (size_t i = 0; i < s.size; i++)
+            items[i] = escape(s.items[i], to);
+        return copy;
+    }
+    case ValueKind::HashMap:
+    {
+        HashMap &m = mapClone(v.map(), to);
+        for (size_t i = mapNext(m, 0); i < m.capacity; i = mapNext(m, i + 1))
+            m.slots[i] = {escape(m.slots[i].key, to), escape(m.slots[i].value, to)};
+        return Value::fromMap(&m);
+    }
+    default: return v;
+    }
+}
+
+Value ValueHeap::adopt(const Value &v)
+{
+    return v.isMap() && !owns(v) ? Value::fromMap(&mapClone(v.map(), *this)) : v;
+}
+
+AppendBuffer *ValueHeap::appendBuffer(size_t capacity)
+{
+    return new (m_arena.allocate(sizeof(AppendBuffer) + capacity, alignof(AppendBuffer))) AppendBuffer{this, capacity, 0};
+}
+
+Value ValueHeap::textView(size_t n, const char *bytes, AppendBuffer *buf)
+{
+    return Value::fromText(new (m_arena.allocate(sizeof(HeapText), alignof(HeapText))) HeapText{n, bytes, buf});
+}
+
+Value ValueHeap::sequenceView(size_t n, uint8_t depth, const Value *items, AppendBuffer *buf)
+{
+    return Value::fromSequence(new (m_arena.allocate(sizeof(Sequence), alignof(Sequence)))
+                                   Sequence{ValueKind::Sequence, depth, n, items, buf});
+}
+
+Value ValueHeap::appendText(const Value &a, std::string_view b)
+{
+    std::string_view x = a.text();
+    size_t n = x.size() + b.size();
+    if (n <= Value::kInlineText)
+    {
+        char buf[Value::kInlineText];
+        std::memcpy(buf, x.data(), x.size());
+        std::memcpy(buf + x.size(), b.data(), b.size());
+        Value v;
+        if (Value::inlineText(buf, n, v))
+            return v;
+    }
+    auto *t = static_cast<const HeapText *>(a.object());
+    if (!t)
+    {
+        char *data;
+        Value v = text(n, data);
+        std::memcpy(data, x.data(), x.size());
+        std::memcpy(data + x.size(), b.data(), b.size());
+        return v;
+    }
+    if (fitsAfter(t->buffer, t->bytes + t->size, b.size()))
+    {
+        std::memcpy(t->buffer->data() + t->buffer->used, b.data(), b.size());
+        t->buffer->used += b.size();
+        return textView(n, t->bytes, t->buffer);
+    }
+    // A long text that grows is likely to grow again: leave as much room
+    // again after it.
+    AppendBuffer *buf = appendBuffer(2 * n);
+    std::memcpy(buf->data(), x.data(), x.size());
+    std::memcpy(buf->data() + x.size(), b.data(), b.size());
+    buf->used = n;
+    return textView(n, buf->data(), buf);
+}
+
+Value ValueHeap::sequence(size_t n, uint8_t depth, Value *&items)
+{
+    void *at = m_arena.allocate(sizeof(Sequence) + n * sizeof(Value), alignof(Sequence));
+    items = reinterpret_cast<Value *>(static_cast<Sequence *>(at) + 1);
+    return Value::fromSequence(new (at) Sequence{ValueKind::Sequence, depth, n, items, nullptr});
+}
+
+Value ValueHeap::appendSequence(const Value &a, const Value &b)
+{
+    const Sequence &x = a.sequence(), &y = b.sequence();
+    size_t n = x.size + y.size;
+    uint8_t depth = std::max(x.depth, y.depth);
+    if (fitsAfter(x.buffer, reinterpret_cast<const char *>(x.items + x.size), y.size * sizeof(Value)))
+    {
+        std::memcpy(x.buffer->data() + x.buffer->used, y.items, y.size * sizeof(Value));
+        x.buffer->used += y.size * sizeof(Value);
+        return sequenceView(n, depth, x.items, x.buffer);
+    }
+    AppendBuffer *buf = appendBuffer(std::max<size_t>(2 * n, 4) * sizeof(Value));
+    auto *items = reinterpret_cast<Value *>(buf->data());
+    std::copy(x.items, x.items + x.size, items);
+    std::copy(y.items, y.items + y.size, items + x.size);
+    buf->used = n * sizeof(Value);
+    return sequenceView(n, depth, items, buf);
+}
+
+Value ValueHeap::slice(const Value &v, size_t start, size_t count)
+{
+    if (v.isSequence())
+    {
+        const Sequence &s = v.sequence();
+        return sequenceView(count, s.depth, s.items + start, s.buffer);
+    }
+    std::string_view t = v.text();
+    if (count <= Value::kInlineText)
+        return text(t.substr(start, count));
+    // Too long to be inline, so the text is a HeapText.
+    auto *h = static_cast<const HeapText *>(v.object());
+    return textView(count, h->bytes + start, h->buffer);
+}
+
+Value ValueHeap::map()
+{
+    return Value::fromMap(new (m_arena.allocate(sizeof(HashMap), alignof(HashMap)))
+                              HashMap{ValueKind::HashMap, 0, 0, nullptr, nullptr});
+}
+
+bool valuesEqual(const Value &a, const Value &b)
+{
+    if (a.kind() != b.kind())
+        return false;
+    switch (a.kind())
+    {
+    case ValueKind::Number: return a.num() == b.num();
+    case ValueKind::Bool: return a.boolean() == b.boolean();
+    case ValueKind::Text: return a.bits() == b.bits() || a.text() == b.text();
+    case ValueKind::Complex: return a.complex() == b.complex();
+    case ValueKind::Vector:
+    {
+        const NumVector &x = a.vector(), &y = b.vector();
+        return x.size == y.size && std::equal(x.data, x.data + x.size, y.data);
+    }
+    case ValueKind::Sequence:
+    {
+        const Sequence &x = a.sequence(), &y = b.sequence();
+        return x.size == y.size && std::equal(x.items, x.items + x.size, y.items, valuesEqual);
+    }
+    case ValueKind::HashMap:
+    {
+        // The same pairs, in whatever slot order.
+        const HashMap &x = a.map(), &y = b.map();
+        if (&x == &y)
+            return true;
+        if (x.size != y.size)
+            return false;
+        for (size_t i = mapNext(x, 0); i < x.capacity; i = mapNext(x, i + 1))
+        {
+            const Value *v = mapFind(y, x.slots[i].key);
+            if (!v || !valuesEqual(*v, x.slots[i].value))
+                return false;
+        }
+        return true;
+    }
+    default: return true;
+    }
+}
+
+namespace
+{
+    bool typeError(BinOp op, const Value &a, const Value &b, std::string &err)
+    {
+        err = std::string("cannot apply '") + to_string(op) + "' to " + to_string(a.kind()) + " and " + to_string(b.kind());
+        return false;
+    }
+
+    bool vecOp(BinOp op, VecOp &out)
+    {
+        switch (op)
+        {
+        case BinOp::Add: out = VecOp::Add; return true;
+        case BinOp::Sub: out = VecOp::Sub; return true;
+        case BinOp::Mul: out = VecOp::Mul; return true;
+        case BinOp::Div: out = VecOp::Div; return true;
+        default: return false;
+        }
+    }
+
+    // Elementwise, with a number on either side applied to every element.
+    bool vectorArith(BinOp op, const Value &a, const Value &b, ValueHeap &heap, Value &out, std::string &err)
+    {
+        VecOp vop;
+        if (!vecOp(op, vop) || !(a.isVector() || a.isNumber()) || !(b.isVector() || b.isNumber()))
+            return typeError(op, a, b, err);
+        double *data;
+        if (a.isVector() && b.isVector())
+        {
+            const NumVector &x = a.vector(), &y = b.vector();
+            if (x.size != y.size)
+            {
+                err = "vector sizes differ: " + std::to_string(x.size) + " and " + std::to_string(y.size);
+                return false;
+            }
+            out = heap.vector(x.size, data);
+            vecBinary(vop, data, x.data, y.data, x.size);
+            return true;
+        }
+        // `out` may be `a` or `b`: read both before it is written.
+        bool scalarLeft = !a.isVector();
+        const NumVector &x = scalarLeft ? b.vector() : a.vector();
+        double s = scalarLeft ? a.num() : b.num();
+        out = heap.vector(x.size, data);
+        vecScalar(vop, data, x.data, s, scalarLeft, x.size);
+        return true;
+    }
+
+    // A number on either side acts on each component, so z * 1 and z - 0
+    // give z back exactly; only number / complex goes through complex
+    // division.
+    bool complexArith(BinOp op, const Value &a, const Value &b, ValueHeap &heap, Value &out, std::string &err)
+    {
+        bool ac = a.isComplex(), bc = b.isComplex();
+        if (!(ac || a.isNumber()) || !(bc || b.isNumber()))
+            return typeError(op, a, b, err);
+        std::complex<double> x = ac ? a.complex() : a.num(), y = bc ? b.complex() : b.num();
+        std::complex<double> r;
+        switch (op)
+        {
+        case BinOp::Add: r = ac && bc ? x + y : ac ? std::complex<double>(x.real() + y.real(), x.imag())
+                                                   : std::complex<double>(x.real() + y.real(), y.imag());
+            break;
+        case BinOp::Sub: r = ac && bc ? x - y : ac ? std::complex<double>(x.real() - y.real(), x.imag())
+                                                   : std::complex<double>(x.real() - y.real(), -y.imag());
+            break;
+        case BinOp::Mul: r = ac && bc ? x * y : ac ? x * y.real() : x.real() * y; break;
+        case BinOp::Div: r = bc ? x / y : x / y.real(); break;
+        default: return typeError(op, a, b, err);
+        }
+        out = heap.complex(r);
+        return true;
+    }
+}
+
+bool applyBinOp(BinOp op, const Value &a, const Value &b, ValueHeap &heap, Value &out, std::string &err)
+{
+    if (op == BinOp::Eq || op == BinOp::Ne)
+    {
+        out = Value::fromBool(valuesEqual(a, b) == (op == BinOp::Eq));
+        return true;
+    }
+
+    if (a.isNumber() && b.isNumber())
+    {
+        double x = a.num(), y = b.num();
+        switch (op)
+        {
+        case BinOp::Add: out = Value::number(x + y); return true;
+        case BinOp::Sub: out = Value::number(x - y); return true;
+        case BinOp::Mul: out = Value::number(x * y); return true;
+        case BinOp::Div: out = Value::number(x / y); return true;
+        case BinOp::Mod: out = Value::number(numberMod(x, y)); return true;
+        case BinOp::Lt: out = Value::fromBool(x < y); return true;
+        case BinOp::Le: out = Value::fromBool(x <= y); return true;
+        case BinOp::Gt: out = Value::fromBool(x > y); return true;
+        case BinOp::Ge: out = Value::fromBool(x >= y); return true;
+        default: return typeError(op, a, b, err);
+        }
+    }
+
+    bool aText = a.isText(), bText = b.isText();
+    // text + anything concatenates the display forms
+    if (op == BinOp::Add && (aText || bText))
+    {
+        if (!aText)
+            out = heap.text(formatValue(a) + formatValue(b));
+        else if (bText)
+            out = heap.appendText(a, b.text());
+        else
+            out = heap.appendText(a, formatValue(b));
+        return true;
+    }
+    if (op == BinOp::Add && a.isSequence() && b.isSequence())
+    {
+        out = heap.appendSequence(a, b);
+        return true;
+    }
+    if (a.isVector() || b.isVector())
+        return vectorArith(op, a, b, heap, out, err);
+    if (a.isComplex() || b.isComplex())
+        return complexArith(op, a, b, heap, out, err);
+    if (aText && bText)
+    {
+        int c = a.text().compare(b.text());
+        switch (op)
+        {
+        case BinOp::Lt: out = Value::fromBool(c < 0); return true;
+        case BinOp::Le: out = Value::fromBool(c <= 0); return true;
+        case BinOp::Gt: out = Value::fromBool(c > 0); return true;
+        case BinOp::Ge: out = Value::fromBool(c >= 0); return true;
+        default: break;
+        }
+    }
+    return typeError(op, a, b, err);
+}
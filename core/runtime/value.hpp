@@ -0,0 +1,375 @@
+#pragma once
+#include "../lexer/token.hpp"
+#include "arena.hpp"
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+
+//////////////////////////////////////////////////////////////////////////
+// Runtime values shared by the bytecode VM and the tree-walking baseline.
+//
+// A Value is one NaN-boxed 64-bit word passed by value, so a register is
+// 8 bytes and copying one is a move of a word. A number is stored as its
+// double. Everything else lives in the negative quiet-NaN space above the
+// x86 default NaN (0xFFF8...), which stays an ordinary number: the top 16
+// bits are 0xFFF8 + a tag from 1 to 7, the low 48 bits a payload.
+//
+//   0xFFF9  nil
+//   0xFFFA  bool     payload 0 or 1
+//   0xFFFB  text     pointer to a HeapText in a ValueHeap
+//   0xFFFC  text     up to 6 bytes inline, zero-padded
+//   0xFFFD  complex  pointer to a std::complex<double>
+//   0xFFFE  vector   pointer to a NumVector
+//   0xFFFF  object   pointer to a Sequence or HashMap, whose first byte
+//                    is its ValueKind
+//
+// Nothing is owned by the Value. A short text (no NUL byte) is kept in
+// the payload, so the one-character texts of `iter` and short concats
+// allocate nothing; everything else points into a ValueHeap: the VM's
+// (per run) or a Module's (its constants). bin and hex literals evaluate
+// to numbers.
+//
+// number() stores every NaN as 0xFFF8..., so a number is never mistaken
+// for a tagged value. Folding them all (not just those in the tagged range)
+// also gives Genex a single NaN: which operand's NaN x86 propagates depends
+// on the operand order the C++ compiler picked, which differs between the
+// VM and the tree walker, so a NaN's sign would otherwise depend on the
+// engine.
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "inline text is stored in the low bytes of a Value");
+
+enum class ValueKind : uint8_t
+{
+    Nil,
+    Number,
+    Bool,
+    Text,
+    Complex,
+    Vector,
+    Sequence,
+    HashMap
+};
+
+class Value;
+class ValueHeap;
+
+// Storage with room to grow, shared by the texts or sequences that `+`
+// builds on top of each other. Each of them is a view of a range in it;
+// appending to the one that ends at `used` writes past every existing
+// view, so the bytes in place can take the new part instead of a copy.
+struct AppendBuffer
+{
+    const ValueHeap *owner; // only the owner appends
+    size_t capacity;        // bytes
+    size_t used;
+    char *data() { return reinterpret_cast<char *>(this + 1); }
+    const char *data() const { return reinterpret_cast<const char *>(this + 1); }
+};
+
+// A text value too long to be inline: `size` bytes at `bytes`, which
+// follow the header, or lie in the buffer it was appended to, or in the
+// text it was sliced from.
+struct HeapText
+{
+    size_t size;
+    const char *bytes;
+    AppendBuffer *buffer; // null unless the bytes are in one
+    const char *data() const { return bytes; }
+};
+
+// The elements of a vector value: contiguous doubles, 32-byte aligned for
+// the kernels in vector_kernels.hpp.
+struct NumVector
+{
+    const double *data = nullptr;
+    size_t size = 0;
+};
+
+// A sequence value: `size` values at `items`, a view like HeapText's.
+// Sequences are immutable and may nest, but not deeper than kMaxNesting;
+// they never hold a map (see HashMap).
+struct Sequence
+{
+    ValueKind kind; // ValueKind::Sequence
+    uint8_t depth;  // sequences nested in this one, itself included
+    size_t size;
+    const Value *items;
+    AppendBuffer *buffer;
+
+    static constexpr uint8_t kMaxNesting = 32;
+};
+
+// A map value: a Swiss table over number, bool and text keys (see
+// hash_map.hpp). Unlike every other value it is mutable, through put(), so
+// it may not be stored in a map or a sequence: nothing can reach itself,
+// and printing, comparing or copying a value always ends.
+struct HashMap
+{
+    struct Slot;
+
+    ValueKind kind; // ValueKind::HashMap
+    size_t size;
+    size_t capacity; // slots, a power of two, 0 until the first put
+    uint8_t *ctrl;   // one control byte per slot
+    Slot *slots;
+};
+
+class Value
+{
+public:
+    static constexpr size_t kInlineText = 6; // longest text kept in the payload
+
+    Value() : m_bits(kNil) {}
+
+    static Value number(double v)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        return Value(v == v ? bits : kNaN);
+    }
+    static Value fromBool(bool v) { return Value(kBool | static_cast<uint64_t>(v)); }
+    // Text already held by a ValueHeap. ValueHeap::text is the usual way to
+    // make a text value.
+    static Value fromText(const HeapText *s) { return Value(kText | reinterpret_cast<uintptr_t>(s)); }
+    static Value fromComplex(const std::complex<double> *z) { return Value(kComplex | reinterpret_cast<uintptr_t>(z)); }
+    static Value fromVector(const NumVector *v) { return Value(kVector | reinterpret_cast<uintptr_t>(v)); }
+    static Value fromSequence(const Sequence *s) { return Value(kObject | reinterpret_cast<uintptr_t>(s)); }
+    static Value fromMap(HashMap *m) { return Value(kObject | reinterpret_cast<uintptr_t>(m)); }
+    // Inline text, if `s` fits: at most kInlineText bytes and no NUL.
+    static bool inlineText(const char *s, size_t n, Value &out)
+    {
+        if (n > kInlineText || std::memchr(s, 0, n))
+            return false;
+        uint64_t bits = 0;
+        std::memcpy(&bits, s, n);
+        out = Value(kInline | bits);
+        return true;
+    }
+
+    ValueKind kind() const
+    {
+        static constexpr ValueKind tags[8] = {ValueKind::Nil,  ValueKind::Nil,     ValueKind::Bool,   ValueKind::Text,
+                                              ValueKind::Text, ValueKind::Complex, ValueKind::Vector, ValueKind::Nil};
+        if (isNumber())
+            return ValueKind::Number;
+        if ((m_bits & kTagMask) == kObject)
+            return *reinterpret_cast<const ValueKind *>(m_bits & kPayload);
+        return tags[(m_bits >> 48) & 7];
+    }
+    bool isNumber() const { return m_bits < kTagged; }
+    bool isText() const { return (m_bits & kTagMask) == kText || (m_bits & kTagMask) == kInline; }
+    bool isComplex() const { return (m_bits & kTagMask) == kComplex; }
+    bool isVector() const { return (m_bits & kTagMask) == kVector; }
+    bool isSequence() const { return (m_bits & kTagMask) == kObject && kind() == ValueKind::Sequence; }
+    bool isMap() const { return (m_bits & kTagMask) == kObject && kind() == ValueKind::HashMap; }
+
+    double num() const
+    {
+        double v;
+        std::memcpy(&v, &m_bits, sizeof(v));
+        return v;
+    }
+    bool boolean() const { return m_bits & 1; }
+    // The bytes of a text value. An inline text is a view into this Value,
+    // so it must not outlive it.
+    std::string_view text() const
+    {
+        if ((m_bits & kTagMask) == kText)
+        {
+            auto *t = reinterpret_cast<const HeapText *>(m_bits & kPayload);
+            return std::string_view(t->data(), t->size);
+        }
+        uint64_t chars = m_bits & kPayload;
+        size_t n = chars ? (64 - __builtin_clzll(chars) + 7) / 8 : 0;
+        return std::string_view(reinterpret_cast<const char *>(&m_bits), n);
+    }
+    const std::complex<double> &complex() const { return *reinterpret_cast<const std::complex<double> *>(m_bits & kPayload); }
+    const NumVector &vector() const { return *reinterpret_cast<const NumVector *>(m_bits & kPayload); }
+    const Sequence &sequence() const { return *reinterpret_cast<const Sequence *>(m_bits & kPayload); }
+    // Maps are the one mutable kind; see HashMap.
+    HashMap &map() const { return *reinterpret_cast<HashMap *>(m_bits & kPayload); }
+    uint64_t bits() const { return m_bits; }
+    // The object a value points at; null for numbers, bools, nil and
+    // inline texts.
+    const void *object() const
+    {
+        uint64_t tag = m_bits & kTagMask;
+        bool pointer = tag == kText || tag == kComplex || tag == kVector || tag == kObject;
+        return pointer ? reinterpret_cast<const void *>(m_bits & kPayload) : nullptr;
+    }
+
+    bool truthy() const
+    {
+        if (isNumber())
+            return num() != 0.0;
+        switch (m_bits & kTagMask)
+        {
+        case kBool: return m_bits & 1;
+        case kText: return reinterpret_cast<const HeapText *>(m_bits & kPayload)->size != 0;
+        case kInline: return m_bits & kPayload;
+        case kComplex: return complex() != 0.0;
+        case kVector: return vector().size != 0;
+        case kObject: return kind() == ValueKind::Sequence ? sequence().size != 0 : map().size != 0;
+        default: return false;
+        }
+    }
+
+private:
+    static constexpr uint64_t kTagMask = 0xFFFFull << 48;
+    static constexpr uint64_t kPayload = ~kTagMask;
+    static constexpr uint64_t kNaN = 0xFFF8ull << 48; // x86's default NaN
+    static constexpr uint64_t kTagged = 0xFFF9ull << 48;
+    static constexpr uint64_t kNil = 0xFFF9ull << 48;
+    static constexpr uint64_t kBool = 0xFFFAull << 48;
+    static constexpr uint64_t kText = 0xFFFBull << 48;
+    static constexpr uint64_t kInline = 0xFFFCull << 48;
+    static constexpr uint64_t kComplex = 0xFFFDull << 48;
+    static constexpr uint64_t kVector = 0xFFFEull << 48;
+    static constexpr uint64_t kObject = 0xFFFFull << 48;
+
+    explicit Value(uint64_t bits) : m_bits(bits) {}
+
+    uint64_t m_bits;
+};
+
+// Owner of the objects created while running a program, all in one
+// Arena: making one is a pointer bump, and clear() drops them all in O(1)
+// between test cases. bytes() counts what they take, so many long texts
+// are not free; inline texts cost nothing here.
+//
+// A Value made here dies with the next clear(). One that must outlive it,
+// such as a test case's result kept for comparison, goes through escape().
+class ValueHeap
+{
+public:
+    Value text(std::string_view s)
+    {
+        Value v;
+        if (Value::inlineText(s.data(), s.size(), v))
+            return v;
+        char *data;
+        v = text(s.size(), data);
+        std::memcpy(data, s.data(), s.size());
+        return v;
+    }
+    // A text of n bytes kept here, left for the caller to fill through
+    // `data`. Unlike text(std::string_view) it is never inline.
+    Value text(size_t n, char *&data)
+    {
+        auto *t = static_cast<HeapText *>(m_arena.allocate(sizeof(HeapText) + n, alignof(HeapText)));
+        data = reinterpret_cast<char *>(t + 1);
+        *t = HeapText{n, data, nullptr};
+        return Value::fromText(t);
+    }
+    // Text `a` followed by `b`, for `+`. When `a` is a long text this heap
+    // built by appending, `b` usually goes in place after it, so a loop
+    // that grows a text costs amortised O(|b|) per step, not O(|a|). `b`
+    // may point into `a`.
+    Value appendText(const Value &a, std::string_view b);
+    Value complex(std::complex<double> z)
+    {
+        return Value::fromComplex(new (m_arena.allocate(sizeof(z), alignof(std::complex<double>))) std::complex<double>(z));
+    }
+    // A vector of n elements, left for the caller to fill through `data`.
+    // The elements follow the header, 32-byte aligned.
+    Value vector(size_t n, double *&data)
+    {
+        void *at = m_arena.allocate(kVectorHeader + n * sizeof(double), 32);
+        data = reinterpret_cast<double *>(static_cast<char *>(at) + kVectorHeader);
+        return Value::fromVector(new (at) NumVector{data, n});
+    }
+    // A sequence of n items, left for the caller to fill through `items`;
+    // `depth` as in Sequence, which the caller keeps within kMaxNesting.
+    Value sequence(size_t n, uint8_t depth, Value *&items);
+    // Sequence `a` followed by `b`, growing in place like appendText.
+    Value appendSequence(const Value &a, const Value &b);
+    // Items or bytes [start, start + count) of a sequence or text, which
+    // must lie within it: a view, so O(1) whatever the length.
+    Value slice(const Value &v, size_t start, size_t count);
+    // A new, empty map; its table is allocated here on the first put().
+    Value map();
+    // Raw storage for the runtime's own objects, such as map tables.
+    void *allocate(size_t bytes, size_t align) { return m_arena.allocate(bytes, align); }
+    void clear() { m_arena.reset(); }
+    size_t bytes() const { return m_arena.used(); }
+
+    // Escape check: whether `v` points at an object made here since the
+    // last clear().
+    bool owns(const Value &v) const { return v.object() && m_arena.contains(v.object()); }
+    // `v` itself, or, when owns(v), a copy of it made in `to`.
+    Value escape(const Value &v, ValueHeap &to) const;
+    // `v` itself, or a copy made here of a map that lives elsewhere: a
+    // program may only put() into maps of its own heap, since another
+    // heap's may be read by other threads at the same time. For the
+    // arguments of a run.
+    Value adopt(const Value &v);
+
+private:
+    static constexpr size_t kVectorHeader = 32;
+    static_assert(sizeof(NumVector) <= kVectorHeader, "vector header");
+
+    AppendBuffer *appendBuffer(size_t capacity);
+    // Headers over bytes or items that already exist.
+    Value textView(size_t n, const char *bytes, AppendBuffer *buf);
+    Value sequenceView(size_t n, uint8_t depth, const Value *items, AppendBuffer *buf);
+    // Whether `bytes` more can go at `end`, the end of a view into `buf`.
+    bool fitsAfter(const AppendBuffer *buf, const char *end, size_t bytes) const
+    {
+        return buf && buf->owner == this && end == buf->data() + buf->used && buf->capacity - buf->used >= bytes;
+    }
+
+    Arena m_arena;
+};
+
+// Binary operators with value semantics (assignment and the short-circuit
+// logical operators are control flow, not operators on values).
+enum class BinOp : uint8_t
+{
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Mod,
+    Eq,
+    Ne,
+    Lt,
+    Le,
+    Gt,
+    Ge,
+    Invalid
+};
+
+BinOp binOpFromLexeme(const std::string &op);
+const char *to_string(BinOp op);
+const char *to_string(ValueKind k);
+
+// Display form: integral numbers without a fraction, text without quotes.
+std::string formatValue(const Value &v);
+
+// Value of a literal (number, bin, hex, bool or quoted text); text is
+// allocated in `heap`. Returns false for kinds the runtime lacks.
+bool literalValue(const std::string &lexeme, TokenType type, ValueHeap &heap, Value &out);
+
+bool valuesEqual(const Value &a, const Value &b);
+
+// fmod, with an integer fast path: generated programs mostly take `%` of
+// whole numbers, and libm's fmod costs several times a whole instruction.
+inline double numberMod(double x, double y)
+{
+    if (std::fabs(x) < 9007199254740992.0 && std::fabs(y) < 9007199254740992.0 && y != 0.0 &&
+        x == static_cast<double>(static_cast<int64_t>(x)) && y == static_cast<double>(static_cast<int64_t>(y)))
+    {
+        double r = static_cast<double>(static_cast<int64_t>(x) % static_cast<int64_t>(y));
+        return r == 0.0 && x < 0.0 ? -0.0 : r; // fmod keeps the sign of x
+    }
+    return std::fmod(x, y);
+}
+
+// Generic (slow-path) operator application. On a type error it returns
+// false and describes the problem in `err`.
+bool applyBinOp(BinOp op, const Value &a, const Value &b, ValueHeap &heap, Value &out, std::string &err);
@@ -0,0 +1,209 @@
+#include "vector_kernels.hpp"
+
+#if !defined(MUTAGEN_NO_SIMD) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // minpd / maxpd per element: the second operand when either is NaN or
+    // both are zeros.
+    inline double min1(double x, double m) { return x < m ? x : m; }
+    inline double max1(double x, double m) { return x > m ? x : m; }
+
+    // Four doubles, whatever the instruction set. The kernels below are
+    // written once against it, which is what keeps every build in the same
+    // order of operations.
+#if !defined(MUTAGEN_NO_SIMD) && defined(__AVX2__)
+    struct Pack
+    {
+        __m256d v;
+    };
+    inline Pack vload(const double *p) { return {_mm256_loadu_pd(p)}; }
+    inline void vstore(double *p, Pack x) { _mm256_storeu_pd(p, x.v); }
+    inline Pack vsplat(double s) { return {_mm256_set1_pd(s)}; }
+    inline Pack vadd(Pack x, Pack y) { return {_mm256_add_pd(x.v, y.v)}; }
+    inline Pack vsub(Pack x, Pack y) { return {_mm256_sub_pd(x.v, y.v)}; }
+    inline Pack vmul(Pack x, Pack y) { return {_mm256_mul_pd(x.v, y.v)}; }
+    inline Pack vdiv(Pack x, Pack y) { return {_mm256_div_pd(x.v, y.v)}; }
+    inline Pack vmin(Pack x, Pack m) { return {_mm256_min_pd(x.v, m.v)}; }
+    inline Pack vmax(Pack x, Pack m) { return {_mm256_max_pd(x.v, m.v)}; }
+#elif !defined(MUTAGEN_NO_SIMD) && defined(__SSE2__)
+    struct Pack
+    {
+        __m128d lo, hi;
+    };
+    inline Pack vload(const double *p) { return {_mm_loadu_pd(p), _mm_loadu_pd(p + 2)}; }
+    inline void vstore(double *p, Pack x)
+    {
+        _mm_storeu_pd(p, x.lo);
+        _mm_storeu_pd(p + 2, x.hi);
+    }
+    inline Pack vsplat(double s) { return {_mm_set1_pd(s), _mm_set1_pd(s)}; }
+    inline Pack vadd(Pack x, Pack y) { return {_mm_add_pd(x.lo, y.lo), _mm_add_pd(x.hi, y.hi)}; }
+    inline Pack vsub(Pack x, Pack y) { return {_mm_sub_pd(x.lo, y.lo), _mm_sub_pd(x.hi, y.hi)}; }
+    inline Pack vmul(Pack x, Pack y) { return {_mm_mul_pd(x.lo, y.lo), _mm_mul_pd(x.hi, y.hi)}; }
+    inline Pack vdiv(Pack x, Pack y) { return {_mm_div_pd(x.lo, y.lo), _mm_div_pd(x.hi, y.hi)}; }
+    inline Pack vmin(Pack x, Pack m) { return {_mm_min_pd(x.lo, m.lo), _mm_min_pd(x.hi, m.hi)}; }
+    inline Pack vmax(Pack x, Pack m) { return {_mm_max_pd(x.lo, m.lo), _mm_max_pd(x.hi, m.hi)}; }
+#else
+    struct Pack
+    {
+        double v[4];
+    };
+    template <class F> inline Pack lanes(Pack x, Pack y, F f)
+    {
+        return {{f(x.v[0], y.v[0]), f(x.v[1], y.v[1]), f(x.v[2], y.v[2]), f(x.v[3], y.v[3])}};
+    }
+    inline Pack vload(const double *p) { return {{p[0], p[1], p[2], p[3]}}; }
+    inline void vstore(double *p, Pack x)
+    {
+        for (int j = 0; j < 4; j++)
+            p[j] = x.v[j];
+    }
+    inline Pack vsplat(double s) { return {{s, s, s, s}}; }
+    inline Pack vadd(Pack x, Pack y) { return lanes(x, y, [](double a, double b) { return a + b; }); }
+    inline Pack vsub(Pack x, Pack y) { return lanes(x, y, [](double a, double b) { return a - b; }); }
+    inline Pack vmul(Pack x, Pack y) { return lanes(x, y, [](double a, double b) { return a * b; }); }
+    inline Pack vdiv(Pack x, Pack y) { return lanes(x, y, [](double a, double b) { return a / b; }); }
+    inline Pack vmin(Pack x, Pack m) { return lanes(x, m, min1); }
+    inline Pack vmax(Pack x, Pack m) { return lanes(x, m, max1); }
+#endif
+
+    // One operation on packs and on single elements; passed as a type so
+    // the loops below inline it.
+    template <VecOp Op> struct Arith
+    {
+        static Pack pack(Pack x, Pack y)
+        {
+            switch (Op)
+            {
+            case VecOp::Add: return vadd(x, y);
+            case VecOp::Sub: return vsub(x, y);
+            case VecOp::Mul: return vmul(x, y);
+            default: return vdiv(x, y);
+            }
+        }
+        static double one(double x, double y)
+        {
+            switch (Op)
+            {
+            case VecOp::Add: return x + y;
+            case VecOp::Sub: return x - y;
+            case VecOp::Mul: return x * y;
+            default: return x / y;
+            }
+        }
+    };
+
+    template <VecOp Op> void binaryLoop(double *out, const double *a, const double *b, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+            vstore(out + i, Arith<Op>::pack(vload(a + i), vload(b + i)));
+        for (; i < n; i++)
+            out[i] = Arith<Op>::one(a[i], b[i]);
+    }
+
+    template <VecOp Op, bool ScalarLeft> void scalarLoop(double *out, const double *a, double s, size_t n)
+    {
+        Pack k = vsplat(s);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+            vstore(out + i, ScalarLeft ? Arith<Op>::pack(k, vload(a + i)) : Arith<Op>::pack(vload(a + i), k));
+        for (; i < n; i++)
+            out[i] = ScalarLeft ? Arith<Op>::one(s, a[i]) : Arith<Op>::one(a[i], s);
+    }
+
+    template <VecOp Op> void scalarLoop(double *out, const double *a, double s, bool scalarLeft, size_t n)
+    {
+        if (scalarLeft)
+            scalarLoop<Op, true>(out, a, s, n);
+        else
+            scalarLoop<Op, false>(out, a, s, n);
+    }
+
+    // min (Min) or max of a[0..n), n > 0.
+    template <bool Min> double extreme(const double *a, size_t n)
+    {
+        auto pick = [](Pack x, Pack m) { return Min ? vmin(x, m) : vmax(x, m); };
+        auto pick1 = [](double x, double m) { return Min ? min1(x, m) : max1(x, m); };
+        double r = a[0];
+        size_t i = 1;
+        if (n >= 4)
+        {
+            size_t n4 = n & ~size_t(3);
+            Pack acc = vload(a);
+            for (size_t j = 4; j < n4; j += 4)
+                acc = pick(vload(a + j), acc);
+            double p[4];
+            vstore(p, acc);
+            r = pick1(pick1(p[0], p[1]), pick1(p[2], p[3]));
+            i = n4;
+        }
+        for (; i < n; i++)
+            r = pick1(a[i], r);
+        return r;
+    }
+}
+
+void vecBinary(VecOp op, double *out, const double *a, const double *b, size_t n)
+{
+    switch (op)
+    {
+    case VecOp::Add: binaryLoop<VecOp::Add>(out, a, b, n); break;
+    case VecOp::Sub: binaryLoop<VecOp::Sub>(out, a, b, n); break;
+    case VecOp::Mul: binaryLoop<VecOp::Mul>(out, a, b, n); break;
+    case VecOp::Div: binaryLoop<VecOp::Div>(out, a, b, n); break;
+    }
+}
+
+void vecScalar(VecOp op, double *out, const double *a, double s, bool scalarLeft, size_t n)
+{
+    switch (op)
+    {
+    case VecOp::Add: scalarLoop<VecOp::Add>(out, a, s, scalarLeft, n); break;
+    case VecOp::Sub: scalarLoop<VecOp::Sub>(out, a, s, scalarLeft, n); break;
+    case VecOp::Mul: scalarLoop<VecOp::Mul>(out, a, s, scalarLeft, n); break;
+    case VecOp::Div: scalarLoop<VecOp::Div>(out, a, s, scalarLeft, n); break;
+    }
+}
+
+double vecDot(const double *a, const double *b, size_t n)
+{
+    size_t n4 = n & ~size_t(3);
+    double r = 0.0;
+    if (n4)
+    {
+        Pack acc = vsplat(0.0);
+        for (size_t i = 0; i < n4; i += 4)
+            acc = vadd(acc, vmul(vload(a + i), vload(b + i)));
+        double p[4];
+        vstore(p, acc);
+        r = (p[0] + p[1]) + (p[2] + p[3]);
+    }
+    for (size_t i = n4; i < n; i++)
+        r += a[i] * b[i];
+    return r;
+}
+
+double vecSum(const double *a, size_t n)
+{
+    size_t n4 = n & ~size_t(3);
+    double r = 0.0;
+    if (n4)
+    {
+        Pack acc = vsplat(0.0);
+        for (size_t i = 0; i < n4; i += 4)
+            acc = vadd(acc, vload(a + i));
+        double p[4];
+        vstore(p, acc);
+        r = (p[0] + p[1]) + (p[2] + p[3]);
+    }
+    for (size_t i = n4; i < n; i++)
+        r += a[i];
+    return r;
+}
+
+double vecMin(const double *a, size_t n) { return extreme<true>(a, n); }
+double vecMax(const double *a, size_t n) { return extreme<false>(a, n); }
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+//////////////////////////////////////////////////////////////////////////
+// Kernels over the contiguous doubles of a vector value.
+//
+// AVX2 when compiled with -mavx2, SSE2 otherwise on x86-64, plain loops
+// elsewhere or with MUTAGEN_NO_SIMD. Pointers need no alignment (a
+// ValueHeap hands out 32-byte aligned storage anyway) and may alias.
+//
+// Every build gives bit-identical results: elementwise kernels are exact
+// per element, and the reductions fix their order instead of leaving it
+// to the instruction set. Elements i < n - n % 4 go to four partial
+// results by i % 4, combined as (p0 . p1) . (p2 . p3), then the tail is
+// folded in left to right. min/max keep `x < m ? x : m` (minpd's rule),
+// so NaN and -0 come out the same way on every path. Products are not
+// fused, so this holds as long as the compiler does not contract a * b + c
+// into an FMA (it cannot without -mfma).
+
+enum class VecOp : uint8_t
+{
+    Add,
+    Sub,
+    Mul,
+    Div
+};
+
+// out[i] = a[i] op b[i]
+void vecBinary(VecOp op, double *out, const double *a, const double *b, size_t n);
+// out[i] = a[i] op s, or s op a[i] when scalarLeft
+void vecScalar(VecOp op, double *out, const double *a, double s, bool scalarLeft, size_t n);
+
+double vecDot(const double *a, const double *b, size_t n);
+double vecSum(const double *a, size_t n);
+double vecMin(const double *a, size_t n); // n > 0
+double vecMax(const double *a, size_t n); // n > 0
@@ -0,0 +1,456 @@
+#include "checker.hpp"
+#include "../runtime/value.hpp"
+#include "../vm/builtins.hpp"
+
+namespace
+{
+    std::string where(const FuncDecl *fn) { return fn ? fn->name : "<init>"; }
+
+    // May a value of type `actual` be stored where `declared` is expected?
+    bool compatible(DType declared, DType actual)
+    {
+        return declared == DType::Unknown || actual == DType::Unknown || declared == actual ||
+               (isNumeric(declared) && isNumeric(actual));
+    }
+
+    bool mapKey(DType t) { return isNumeric(t) || t == DType::Text || t == DType::Bool; }
+
+    // Argument types callBuiltin() takes, for the argument at `index`.
+    bool builtinAccepts(Builtin b, size_t index, DType t)
+    {
+        if (t == DType::Unknown)
+            return true;
+        switch (b)
+        {
+        case Builtin::Print: return true;
+        case Builtin::Len:
+            return t == DType::Text || t == DType::Vector || t == DType::Sequence || t == DType::HashMap;
+        case Builtin::Vec:
+        case Builtin::Cplx: return isNumeric(t);
+        case Builtin::Re:
+        case Builtin::Im: return isNumeric(t) || t == DType::Complex;
+        case Builtin::Put:
+        case Builtin::Get:
+        case Builtin::Has: return index == 0 ? t == DType::HashMap : index == 1 ? mapKey(t) : t != DType::HashMap;
+        case Builtin::Seq: return t != DType::HashMap;
+        case Builtin::At: return index == 0 ? t == DType::Sequence : isNumeric(t);
+        case Builtin::Slice: return index == 0 ? t == DType::Text || t == DType::Sequence : isNumeric(t);
+        default: return t == DType::Vector; // dot, sum, min, max
+        }
+    }
+
+    // Same set as literalValue(): what the compiler can put in a constant.
+    bool runnableLiteral(const LiteralExpr &lit)
+    {
+        switch (lit.litType)
+        {
+        case TokenType::INT_LITERAL:
+        case TokenType::FLOAT_LITERAL:
+        case TokenType::BOOL_LITERAL:
+        case TokenType::STRING_LITERAL: return true;
+        case TokenType::BIN_LITERAL:
+        case TokenType::HEX_LITERAL: return lit.value.size() > 2;
+        case TokenType::COMPLEX_LITERAL:
+        case TokenType::VECTOR_LITERAL:
+        {
+            ValueHeap heap;
+            Value v;
+            return literalValue(lit.value, lit.litType, heap, v);
+        }
+        default: return false;
+        }
+    }
+}
+
+const char *to_string(CheckError e)
+{
+    switch (e)
+    {
+    case CheckError::None: return "none";
+    case CheckError::UndefinedName: return "undefined name";
+    case CheckError::UndeclaredAssignment: return "undeclared assignment";
+    case CheckError::InvalidTarget: return "invalid target";
+    case CheckError::UndefinedFunction: return "undefined function";
+    case CheckError::MissingBody: return "missing body";
+    case CheckError::Arity: return "arity";
+    case CheckError::TypeMismatch: return "type mismatch";
+    case CheckError::Unsupported: return "unsupported";
+    default: return "?";
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Declarations
+
+bool SemanticChecker::check(const Program &prog, bool stopAtFirst)
+{
+    m_stopAtFirst = stopAtFirst;
+    m_first = CheckError::None;
+    m_errors.clear();
+    m_fn = nullptr;
+
+    m_resolver.begin(prog);
+    for (const auto &d : prog.decls)
+        if (auto b = dynamic_cast<const BlockDecl *>(d.get()); b && !b->fields.empty())
+            error(CheckError::Unsupported, "Block fields are not supported at runtime (block '" + b->name + "')");
+    m_globals.clear();
+    for (const VarDecl *g : m_resolver.globals())
+        m_globals.push_back(dtypeFromName(g->typeName));
+
+    for (const FuncDecl *f : m_resolver.functions())
+    {
+        if (stopped())
+            break;
+        function(*f);
+    }
+
+    for (const auto &g : prog.globalVars)
+    {
+        if (stopped() || !g->initValue)
+            continue;
+        DType t = expr(g->initValue->get());
+        DType declared = dtypeFromName(g->typeName);
+        if (m_typeChecks && !compatible(declared, t))
+            error(CheckError::TypeMismatch, std::string("Cannot initialise ") + to_string(declared) + " '" +
+                                                g->varName + "' with " + to_string(t));
+    }
+    for (const auto &e : prog.globalExprs)
+    {
+        if (stopped())
+            break;
+        expr(e.get());
+    }
+    return m_errors.empty();
+}
+
+void SemanticChecker::function(const FuncDecl &f)
+{
+    m_fn = &f;
+    m_locals.clear();
+    m_resolver.beginFunction(f);
+    for (const auto &p : f.params)
+        m_locals.push_back(dtypeFromName(p.first));
+    if (f.body)
+        block(*f.body);
+    m_resolver.endFunction(f);
+    m_fn = nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Statements
+
+void SemanticChecker::block(const Block &b)
+{
+    size_t mark = m_resolver.mark();
+    for (const auto &s : b)
+    {
+        if (stopped())
+            break;
+        statement(s.get());
+    }
+    m_resolver.popTo(mark);
+}
+
+void SemanticChecker::declare(uint32_t slot, DType t)
+{
+    if (slot >= m_locals.size())
+        m_locals.resize(slot + 1);
+    m_locals[slot] = t;
+}
+
+DType *SemanticChecker::slotType(const IdentifierExpr &id)
+{
+    switch (m_resolver.bind(id).kind)
+    {
+    case SymbolKind::Local: return &m_locals[id.ref.slot];
+    case SymbolKind::Global: return &m_globals[id.ref.slot];
+    default: return nullptr;
+    }
+}
+
+void SemanticChecker::statement(const Stmt *s)
+{
+    if (!s || stopped())
+        return;
+    if (auto v = dynamic_cast<const VarDecl *>(s))
+    {
+        DType declared = dtypeFromName(v->typeName);
+        if (v->initValue)
+        {
+            DType t = expr(v->initValue->get());
+            if (m_typeChecks && !compatible(declared, t))
+                error(CheckError::TypeMismatch, std::string("Cannot initialise ") + to_string(declared) + " '" +
+                                                    v->varName + "' with " + to_string(t));
+        }
+        v->slot = m_resolver.declare(v->varName);
+        declare(v->slot, declared);
+    }
+    else if (auto e = dynamic_cast<const ExprStmt *>(s))
+        expr(e->expr.get());
+    else if (auto r = dynamic_cast<const ReturnStmt *>(s))
+    {
+        if (r->value)
+            expr(r->value->get());
+    }
+    else if (auto i = dynamic_cast<const IfStmt *>(s))
+    {
+        expr(i->ifBlock.first.get());
+        block(i->ifBlock.second);
+        if (i->elseIfs)
+            for (const auto &branch : *i->elseIfs)
+            {
+                expr(branch.first.get());
+                block(branch.second);
+            }
+        if (i->elseBlock)
+            block(*i->elseBlock);
+    }
+    else if (auto w = dynamic_cast<const WhileStmt *>(s))
+    {
+        expr(w->condition.get());
+        block(w->body);
+    }
+    else if (auto l = dynamic_cast<const LoopStmt *>(s))
+        loop(*l);
+    else if (auto it = dynamic_cast<const IterStmt *>(s))
+    {
+        DType t = expr(it->iterable.get());
+        if (m_typeChecks && t != DType::Unknown && t != DType::Text && t != DType::Vector && t != DType::Sequence &&
+            t != DType::HashMap && !isNumeric(t))
+            error(CheckError::TypeMismatch, std::string("Cannot iterate over ") + to_string(t));
+        size_t mark = m_resolver.mark();
+        it->slot = m_resolver.declare(it->varName);
+        declare(it->slot, t == DType::Text                            ? DType::Text
+                          : isNumeric(t) || t == DType::Vector ? DType::Number
+                                                                      : DType::Unknown);
+        block(it->body);
+        m_resolver.popTo(mark);
+    }
+    else
+        error(CheckError::Unsupported, "Unsupported statement in function '" + where(m_fn) + "'");
+}
+
+void SemanticChecker::loop(const LoopStmt &l)
+{
+    // With a dtype an `id = expr` init declares a loop-scoped variable.
+    size_t mark = m_resolver.mark();
+    auto init = dynamic_cast<const ExprStmt *>(l.init.get());
+    auto b = init ? dynamic_cast<const BinaryExpr *>(init->expr.get()) : nullptr;
+    auto id = b && b->op == "=" ? dynamic_cast<const IdentifierExpr *>(b->left.get()) : nullptr;
+    if (l.dtype && id)
+    {
+        DType declared = dtypeFromName(*l.dtype);
+        DType t = expr(b->right.get());
+        if (m_typeChecks && !compatible(declared, t))
+            error(CheckError::TypeMismatch, std::string("Cannot initialise ") + to_string(declared) + " '" + id->name +
+                                                "' with " + to_string(t));
+        id->ref = SymbolRef{SymbolKind::Local, m_resolver.declare(id->name)};
+        declare(id->ref.slot, declared);
+    }
+    else
+        statement(l.init.get());
+    expr(l.condition.get());
+    block(l.body);
+    statement(l.step.get());
+    m_resolver.popTo(mark);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Expressions
+
+DType SemanticChecker::expr(const Expr *e)
+{
+    if (!e || stopped())
+        return DType::Unknown;
+    if (auto lit = dynamic_cast<const LiteralExpr *>(e))
+    {
+        if (!runnableLiteral(*lit))
+        {
+            error(CheckError::Unsupported,
+                  std::string("Unsupported literal '") + lit->value + "' (" + to_string(lit->litType) + ")");
+            return DType::Unknown;
+        }
+        return dtypeOfLiteral(lit->litType);
+    }
+    if (auto id = dynamic_cast<const IdentifierExpr *>(e))
+    {
+        if (const DType *t = slotType(*id))
+            return *t;
+        error(CheckError::UndefinedName,
+              "Undefined name '" + id->name + "' in function '" + where(m_fn) + "'");
+        return DType::Unknown;
+    }
+    if (auto u = dynamic_cast<const UnaryExpr *>(e))
+    {
+        DType t = expr(u->right.get());
+        if (u->op == "!")
+            return DType::Bool;
+        if (m_typeChecks && t != DType::Unknown && !isNumeric(t))
+            error(CheckError::TypeMismatch, "Unary '" + u->op + "' on " + to_string(t));
+        return t == DType::Unknown ? DType::Unknown : DType::Number;
+    }
+    if (auto b = dynamic_cast<const BinaryExpr *>(e))
+        return binary(*b);
+    if (auto c = dynamic_cast<const CallExpr *>(e))
+        return call(*c);
+    error(CheckError::Unsupported, "Unsupported expression in function '" + where(m_fn) + "'");
+    return DType::Unknown;
+}
+
+DType SemanticChecker::binary(const BinaryExpr &b)
+{
+    if (b.op == "=")
+    {
+        auto id = dynamic_cast<const IdentifierExpr *>(b.left.get());
+        if (!id)
+        {
+            error(CheckError::InvalidTarget,
+                  "Invalid assignment target in function '" + where(m_fn) + "'");
+            return DType::Unknown;
+        }
+        const DType *declared = slotType(*id);
+        if (!declared)
+        {
+            error(CheckError::UndeclaredAssignment, "Assignment to undeclared name '" + id->name + "' in function '" +
+                                                        where(m_fn) + "'");
+            return DType::Unknown;
+        }
+        DType to = *declared;
+        DType t = expr(b.right.get());
+        if (m_typeChecks && !compatible(to, t))
+            error(CheckError::TypeMismatch, std::string("Cannot assign ") + to_string(t) + " to " + to_string(to) +
+                                                " '" + id->name + "'");
+        return to == DType::Unknown ? t : to;
+    }
+
+    DType l = expr(b.left.get());
+    DType r = expr(b.right.get());
+    if (b.op == "&&" || b.op == "||")
+        return DType::Bool;
+    BinOp op = binOpFromLexeme(b.op);
+    if (op == BinOp::Invalid)
+    {
+        error(CheckError::Unsupported,
+              "Unknown operator '" + b.op + "' in function '" + where(m_fn) + "'");
+        return DType::Unknown;
+    }
+    if (op == BinOp::Eq || op == BinOp::Ne)
+        return DType::Bool;
+
+    // The runtime rules of applyBinOp: numbers with numbers, text + anything
+    // concatenates, so does sequence + sequence, text compares with text,
+    // + - * / take a vector or a complex number with numbers of the same
+    // kind.
+    bool known = l != DType::Unknown && r != DType::Unknown;
+    bool numbers = isNumeric(l) && isNumeric(r);
+    if (op == BinOp::Add && (l == DType::Text || r == DType::Text))
+        return DType::Text;
+    if (op == BinOp::Add && l == DType::Sequence && r == DType::Sequence)
+        return DType::Sequence;
+    bool comparison = op == BinOp::Lt || op == BinOp::Le || op == BinOp::Gt || op == BinOp::Ge;
+    bool arithmetic = op != BinOp::Mod && !comparison;
+    if (arithmetic && arithmeticType(l, r) != DType::Unknown)
+        return arithmeticType(l, r);
+    bool fine = numbers || (comparison && l == DType::Text && r == DType::Text);
+    if (!fine)
+    {
+        // One side known and already impossible, e.g. a bool operand.
+        auto usable = [&](DType t)
+        {
+            return t == DType::Unknown || isNumeric(t) || (t == DType::Text && comparison) ||
+                   (arithmetic && (t == DType::Vector || t == DType::Complex)) ||
+                   (op == BinOp::Add && t == DType::Sequence);
+        };
+        if (m_typeChecks && (known || !usable(l) || !usable(r)))
+        {
+            error(CheckError::TypeMismatch,
+                  "Operator '" + b.op + "' on " + to_string(l) + " and " + to_string(r));
+            return DType::Unknown;
+        }
+    }
+    if (comparison)
+        return DType::Bool;
+    return numbers ? DType::Number : DType::Unknown;
+}
+
+DType SemanticChecker::call(const CallExpr &c)
+{
+    auto id = dynamic_cast<const IdentifierExpr *>(c.callee.get());
+    if (!id)
+    {
+        error(CheckError::Unsupported,
+              "Only named functions can be called (in function '" + where(m_fn) + "')");
+        return DType::Unknown;
+    }
+    // Argument types are kept on a shared stack: nested calls push above
+    // the outer call's arguments and pop back before it reads them.
+    size_t base = m_args.size();
+    for (const auto &a : c.args)
+    {
+        DType t = expr(a.get());
+        m_args.push_back(t);
+    }
+
+    DType result = DType::Unknown;
+    m_resolver.bindCallee(*id);
+    if (id->ref.kind == SymbolKind::Function)
+    {
+        const FuncDecl *decl = m_resolver.functions()[id->ref.slot];
+        if (!decl->body)
+            error(CheckError::MissingBody, "Function '" + id->name + "' is declared but never defined");
+        else if (decl->params.size() != c.args.size())
+            error(CheckError::Arity, "Function '" + id->name + "' expects " + std::to_string(decl->params.size()) +
+                                         " arguments, got " + std::to_string(c.args.size()));
+        else if (m_typeChecks)
+        {
+            for (size_t i = 0; i < decl->params.size(); i++)
+            {
+                DType want = dtypeFromName(decl->params[i].first);
+                if (!compatible(want, m_args[base + i]))
+                {
+                    error(CheckError::TypeMismatch, "Argument " + std::to_string(i + 1) + " of '" + id->name +
+                                                        "' is " + to_string(m_args[base + i]) + ", expected " +
+                                                        to_string(want));
+                    break;
+                }
+            }
+        }
+    }
+    else if (id->ref.kind == SymbolKind::Builtin)
+    {
+        Builtin builtin = static_cast<Builtin>(id->ref.slot);
+        int arity = builtinArity(builtin);
+        if (arity >= 0 && c.args.size() != static_cast<size_t>(arity))
+            error(CheckError::Arity, std::string(to_string(builtin)) + " expects " + std::to_string(arity) +
+                                         " argument" + (arity == 1 ? "" : "s") + ", got " +
+                                         std::to_string(c.args.size()));
+        else if (c.args.size() > kMaxRegisters)
+            error(CheckError::Unsupported, std::string("Too many arguments to ") + to_string(builtin));
+        else if (m_typeChecks)
+        {
+            for (size_t i = base; i < m_args.size(); i++)
+            {
+                if (!builtinAccepts(builtin, i - base, m_args[i]))
+                {
+                    error(CheckError::TypeMismatch, std::string(to_string(builtin)) + " of " + to_string(m_args[i]));
+                    break;
+                }
+            }
+        }
+        result = builtinResult(builtin);
+    }
+    else
+    {
+        error(CheckError::UndefinedFunction,
+              "Call to undefined function '" + id->name + "' in function '" + where(m_fn) + "'");
+    }
+    m_args.resize(base);
+    return result;
+}
+
+void SemanticChecker::error(CheckError kind, const std::string &msg)
+{
+    if (m_first == CheckError::None)
+        m_first = kind;
+    m_errors.push_back(msg);
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "../parser/ast.hpp"
+#include "dtype.hpp"
+#include "resolver.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Semantic check of a Program ahead of compilation.
+//
+// Resolves every name with the compiler's scoping rules (globals and
+// functions are visible everywhere, a VarDecl binds after its initialiser)
+// and reports what BytecodeCompiler would reject: undefined names,
+// assignments to undeclared names, wrong call arity, calls to missing or
+// bodiless functions, literals and statements the VM cannot run. On top of
+// that it checks the declared dtypes: initialisers, assignments and call
+// arguments against VarDecl/FuncDecl types, and operands against what the
+// runtime operators accept. bin and hex count as numbers, and expressions
+// whose type cannot be known statically (call results, untyped iter
+// variables) are accepted anywhere.
+//
+// One walk: names are bound through the Resolver's symbol table as it
+// goes (leaving the bindings on the AST), with a dtype per local and
+// global slot. Every buffer is kept between calls, so a warm checker
+// allocates only to format error messages.
+
+enum class CheckError : uint8_t
+{
+    None,
+    UndefinedName,
+    UndeclaredAssignment,
+    InvalidTarget,
+    UndefinedFunction,
+    MissingBody, // called function is only declared
+    Arity,
+    TypeMismatch,
+    Unsupported // literal, statement or block field the VM cannot run
+};
+
+const char *to_string(CheckError e);
+
+class SemanticChecker
+{
+public:
+    // Returns true when the program is clean. With stopAtFirst the check
+    // ends at the first error, which is all a fitness pipeline needs.
+    bool check(const Program &prog, bool stopAtFirst = false);
+    // Names, arity and literals only: exactly the programs the compiler
+    // accepts, dtype annotations notwithstanding.
+    void setTypeChecks(bool on) { m_typeChecks = on; }
+
+    const std::vector<std::string> &errors() const { return m_errors; }
+    CheckError firstError() const { return m_first; }
+    // Bindings and module layout of the last check.
+    const Resolver &resolver() const { return m_resolver; }
+
+private:
+    void function(const FuncDecl &f);
+    void block(const Block &b);
+    void statement(const Stmt *s);
+    void loop(const LoopStmt &l);
+    DType expr(const Expr *e);
+    DType binary(const BinaryExpr &b);
+    DType call(const CallExpr &c);
+    void error(CheckError kind, const std::string &msg);
+    bool stopped() const { return m_stopAtFirst && m_first != CheckError::None; }
+
+    void declare(uint32_t slot, DType t);
+    DType *slotType(const IdentifierExpr &id); // binds `id`
+
+    Resolver m_resolver;
+    std::vector<DType> m_locals;  // by local slot of the current function
+    std::vector<DType> m_globals; // by global slot
+    std::vector<DType> m_args;
+    const FuncDecl *m_fn = nullptr; // null while checking global initialisers
+    bool m_typeChecks = true;
+    bool m_stopAtFirst = false;
+    CheckError m_first = CheckError::None;
+    std::vector<std::string> m_errors;
+};
@@ -0,0 +1,109 @@
+#pragma once
+#include "../lexer/token.hpp"
+#include <cstdint>
+#include <string>
+
+// Genex value types, as named by the dtype keywords in token.hpp.
+enum class DType : uint8_t
+{
+    Unknown,
+    Number,
+    Text,
+    Bin,
+    Hex,
+    Complex,
+    Vector,
+    Sequence,
+    HashMap,
+    DateTime,
+    Bool,
+    Block
+};
+
+inline const char *to_string(DType t)
+{
+    switch (t)
+    {
+    case DType::Number: return "number";
+    case DType::Text: return "text";
+    case DType::Bin: return "bin";
+    case DType::Hex: return "hex";
+    case DType::Complex: return "complex";
+    case DType::Vector: return "vector";
+    case DType::Sequence: return "sequence";
+    case DType::HashMap: return "hash_map";
+    case DType::DateTime: return "datetime";
+    case DType::Bool: return "bool";
+    case DType::Block: return "Block";
+    default: return "unknown";
+    }
+}
+
+// Type named by a VarDecl::typeName / parameter type lexeme.
+inline DType dtypeFromName(const std::string &name)
+{
+    if (name == "number") return DType::Number;
+    if (name == "text") return DType::Text;
+    if (name == "bin") return DType::Bin;
+    if (name == "hex") return DType::Hex;
+    if (name == "complex") return DType::Complex;
+    if (name == "vector") return DType::Vector;
+    if (name == "sequence") return DType::Sequence;
+    if (name == "hash_map") return DType::HashMap;
+    if (name == "datetime") return DType::DateTime;
+    if (name == "bool") return DType::Bool;
+    if (name == "Block") return DType::Block;
+    return DType::Unknown;
+}
+
+// Type of a LiteralExpr from its token type.
+inline DType dtypeOfLiteral(TokenType t)
+{
+    switch (t)
+    {
+    case TokenType::INT_LITERAL:
+    case TokenType::FLOAT_LITERAL: return DType::Number;
+    case TokenType::STRING_LITERAL: return DType::Text;
+    case TokenType::BIN_LITERAL: return DType::Bin;
+    case TokenType::HEX_LITERAL: return DType::Hex;
+    case TokenType::BOOL_LITERAL: return DType::Bool;
+    case TokenType::COMPLEX_LITERAL: return DType::Complex;
+    case TokenType::VECTOR_LITERAL: return DType::Vector;
+    case TokenType::DATETIME_LITERAL: return DType::DateTime;
+    case TokenType::SEQUENCE_INST: return DType::Sequence;
+    case TokenType::HASH_MAP_INST: return DType::HashMap;
+    case TokenType::BLOCK_INST: return DType::Block;
+    default: return DType::Unknown;
+    }
+}
+
+// bin and hex values are numbers at runtime.
+inline bool isNumeric(DType t)
+{
+    return t == DType::Number || t == DType::Bin || t == DType::Hex;
+}
+
+// Operator classes shared by the type rules of later passes.
+inline bool isComparisonOp(const std::string &op)
+{
+    return op == "==" || op == "!=" || op == "<" || op == ">" || op == "<=" || op == ">=";
+}
+
+inline bool isLogicalOp(const std::string &op)
+{
+    return op == "&&" || op == "||" || op == "and" || op == "or";
+}
+
+// Static result of + - * / over operands of these types when it succeeds:
+// numbers give a number, a vector or complex operand with numbers of its
+// own kind gives that kind. Unknown when it depends on the values (or
+// cannot succeed).
+inline DType arithmeticType(DType l, DType r)
+{
+    if (isNumeric(l) && isNumeric(r))
+        return DType::Number;
+    for (DType t : {DType::Vector, DType::Complex})
+        if ((l == t || r == t) && (l == t || isNumeric(l)) && (r == t || isNumeric(r)))
+            return t;
+    return DType::Unknown;
+}
@@ -0,0 +1,271 @@
+#include "resolver.hpp"
+#include "../utils/hash.hpp"
+#include "../vm/bytecode.hpp"
+#include <algorithm>
+
+bool Resolver::resolve(const Program &prog)
+{
+    begin(prog);
+    for (const FuncDecl *f : m_functions)
+    {
+        beginFunction(*f);
+        if (f->body)
+            block(*f->body);
+        endFunction(*f);
+    }
+    // Global initialisers and expressions run with no locals.
+    for (const auto &g : prog.globalVars)
+        if (g->initValue)
+            expr(g->initValue->get());
+    for (const auto &e : prog.globalExprs)
+        expr(e.get());
+    return m_undefined == 0;
+}
+
+void Resolver::begin(const Program &prog)
+{
+    m_names.clear();
+    m_local.clear();
+    m_global.clear();
+    m_function.clear();
+    m_scopes.clear();
+    m_functions.clear();
+    m_globals.clear();
+    m_frame = 0;
+    m_undefined = 0;
+    if (m_table.empty())
+        m_table.resize(64);
+    std::fill(m_table.begin(), m_table.end(), 0);
+
+    auto addFunction = [&](const FuncDecl *f) {
+        uint32_t sym = intern(f->name);
+        uint32_t &at = m_function[sym];
+        if (!at)
+        {
+            m_functions.push_back(f);
+            at = static_cast<uint32_t>(m_functions.size());
+        }
+        else if (!m_functions[at - 1]->body && f->body)
+        {
+            m_functions[at - 1] = f;
+        }
+    };
+    for (const auto &d : prog.decls)
+    {
+        if (auto f = dynamic_cast<const FuncDecl *>(d.get()))
+            addFunction(f);
+        else if (auto b = dynamic_cast<const BlockDecl *>(d.get()))
+            for (const auto &m : b->methods)
+                addFunction(m.get());
+    }
+    for (const auto &g : prog.globalVars)
+    {
+        uint32_t sym = intern(g->varName);
+        uint32_t &at = m_global[sym];
+        if (!at)
+        {
+            m_globals.push_back(g.get());
+            at = static_cast<uint32_t>(m_globals.size());
+        }
+        g->slot = at - 1;
+    }
+}
+
+void Resolver::beginFunction(const FuncDecl &f)
+{
+    popTo(0);
+    m_frame = 0;
+    for (const auto &p : f.params)
+        declare(p.second);
+}
+
+void Resolver::endFunction(const FuncDecl &f)
+{
+    popTo(0);
+    f.frameSize = m_frame;
+    m_frame = 0;
+}
+
+uint32_t Resolver::intern(std::string_view name)
+{
+    size_t mask = m_table.size() - 1;
+    for (size_t i = hashString(name) & mask;; i = (i + 1) & mask)
+    {
+        uint32_t s = m_table[i];
+        if (!s)
+        {
+            uint32_t sym = static_cast<uint32_t>(m_names.size());
+            m_names.push_back(name);
+            m_local.push_back(0);
+            m_global.push_back(0);
+            m_function.push_back(0);
+            m_table[i] = sym + 1;
+            if (m_names.size() * 2 > m_table.size())
+            {
+                // Keep the load under a half; symbols are rehashed in order.
+                m_table.assign(m_table.size() * 2, 0);
+                mask = m_table.size() - 1;
+                for (uint32_t k = 0; k < m_names.size(); k++)
+                {
+                    size_t j = hashString(m_names[k]) & mask;
+                    while (m_table[j])
+                        j = (j + 1) & mask;
+                    m_table[j] = k + 1;
+                }
+            }
+            return sym;
+        }
+        if (m_names[s - 1] == name)
+            return s - 1;
+    }
+}
+
+uint32_t Resolver::declare(std::string_view name)
+{
+    uint32_t sym = intern(name);
+    m_scopes.push_back(Undo{sym, m_local[sym]});
+    m_local[sym] = ++m_frame;
+    return m_frame - 1;
+}
+
+void Resolver::popTo(size_t mark)
+{
+    while (m_scopes.size() > mark)
+    {
+        m_local[m_scopes.back().symbol] = m_scopes.back().previous;
+        m_scopes.pop_back();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Statements
+
+void Resolver::block(const Block &b)
+{
+    size_t mark = m_scopes.size();
+    for (const auto &s : b)
+        statement(s.get());
+    popTo(mark);
+}
+
+void Resolver::statement(const Stmt *s)
+{
+    if (auto v = dynamic_cast<const VarDecl *>(s))
+    {
+        if (v->initValue)
+            expr(v->initValue->get());
+        v->slot = declare(v->varName);
+    }
+    else if (auto e = dynamic_cast<const ExprStmt *>(s))
+        expr(e->expr.get());
+    else if (auto r = dynamic_cast<const ReturnStmt *>(s))
+    {
+        if (r->value)
+            expr(r->value->get());
+    }
+    else if (auto i = dynamic_cast<const IfStmt *>(s))
+    {
+        expr(i->ifBlock.first.get());
+        block(i->ifBlock.second);
+        if (i->elseIfs)
+            for (const auto &branch : *i->elseIfs)
+            {
+                expr(branch.first.get());
+                block(branch.second);
+            }
+        if (i->elseBlock)
+            block(*i->elseBlock);
+    }
+    else if (auto w = dynamic_cast<const WhileStmt *>(s))
+    {
+        expr(w->condition.get());
+        block(w->body);
+    }
+    else if (auto l = dynamic_cast<const LoopStmt *>(s))
+    {
+        // With a dtype an `id = expr` init declares a loop-scoped variable.
+        size_t mark = m_scopes.size();
+        auto init = dynamic_cast<const ExprStmt *>(l->init.get());
+        auto b = init ? dynamic_cast<const BinaryExpr *>(init->expr.get()) : nullptr;
+        auto id = b && b->op == "=" && l->dtype ? dynamic_cast<const IdentifierExpr *>(b->left.get()) : nullptr;
+        if (id)
+        {
+            expr(b->right.get());
+            id->ref = SymbolRef{SymbolKind::Local, declare(id->name)};
+        }
+        else
+            statement(l->init.get());
+        expr(l->condition.get());
+        block(l->body);
+        statement(l->step.get());
+        popTo(mark);
+    }
+    else if (auto it = dynamic_cast<const IterStmt *>(s))
+    {
+        expr(it->iterable.get());
+        size_t mark = m_scopes.size();
+        it->slot = declare(it->varName);
+        block(it->body);
+        popTo(mark);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Expressions
+
+void Resolver::expr(const Expr *e)
+{
+    // Most frequent node types first: each miss is a dynamic_cast.
+    if (auto id = dynamic_cast<const IdentifierExpr *>(e))
+        bind(*id);
+    else if (!e || dynamic_cast<const LiteralExpr *>(e))
+        return;
+    else if (auto b = dynamic_cast<const BinaryExpr *>(e))
+    {
+        expr(b->left.get());
+        expr(b->right.get());
+    }
+    else if (auto u = dynamic_cast<const UnaryExpr *>(e))
+        expr(u->right.get());
+    else if (auto c = dynamic_cast<const CallExpr *>(e))
+    {
+        if (auto id = dynamic_cast<const IdentifierExpr *>(c->callee.get()))
+            bindCallee(*id);
+        else
+            expr(c->callee.get());
+        for (const auto &a : c->args)
+            expr(a.get());
+    }
+}
+
+const SymbolRef &Resolver::bind(const IdentifierExpr &id)
+{
+    uint32_t sym = intern(id.name);
+    if (m_local[sym])
+        id.ref = SymbolRef{SymbolKind::Local, m_local[sym] - 1};
+    else if (m_global[sym])
+        id.ref = SymbolRef{SymbolKind::Global, m_global[sym] - 1};
+    else
+    {
+        id.ref = SymbolRef{SymbolKind::Undefined, 0};
+        m_undefined++;
+    }
+    return id.ref;
+}
+
+const SymbolRef &Resolver::bindCallee(const IdentifierExpr &id)
+{
+    // Functions are not values: a callee is only looked up among functions
+    // and builtins, never among variables.
+    uint32_t sym = intern(id.name);
+    if (m_function[sym])
+        id.ref = SymbolRef{SymbolKind::Function, m_function[sym] - 1};
+    else if (Builtin b = builtinFromName(id.name); b != Builtin::COUNT)
+        id.ref = SymbolRef{SymbolKind::Builtin, static_cast<uint32_t>(b)};
+    else
+    {
+        id.ref = SymbolRef{SymbolKind::Undefined, 0};
+        m_undefined++;
+    }
+    return id.ref;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "../parser/ast.hpp"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Name resolution.
+//
+// Binds every IdentifierExpr to a slot (SymbolRef in ast.hpp), so nothing
+// downstream compares names: reads and assignment targets become a Local
+// or Global slot, callees a Function index or Builtin. Declarations get
+// their slot too: VarDecl::slot, IterStmt::slot, and the identifier of a
+// typed loop initialiser. Local slots are numbered per function, parameters
+// first, one per declaration (slots are not reused between sibling
+// scopes); FuncDecl::frameSize is the count.
+//
+// The rules are the compiler's: functions and globals are visible from
+// every body, the first definition with a body wins, innermost local
+// before global, and a VarDecl binds after its initialiser. A name that is
+// not bound is marked Undefined; it is left to the consumer to report it
+// in its own terms.
+//
+// Names are interned into dense symbol ids. Each symbol holds its current
+// local, global and function binding, and the scope stack is a flat undo
+// log of (symbol, previous local binding), so a lookup and leaving a scope
+// are O(1) per name. Buffers are kept between programs.
+//
+// resolve() is a pass of its own (TreeWalker runs it before executing). A
+// pass that walks the tree anyway (BytecodeCompiler, SemanticChecker)
+// instead drives the table from its own walk through begin() and the
+// calls below it, which leaves the same annotations without a second
+// traversal.
+
+class Resolver
+{
+public:
+    // Binds the whole program. Returns false if any name came out Undefined.
+    bool resolve(const Program &prog);
+
+    // Numbers the functions and globals of `prog` and clears all locals.
+    void begin(const Program &prog);
+    // Opens the frame of `f` with its parameters in slots 0..n-1.
+    void beginFunction(const FuncDecl &f);
+    // Closes the frame, recording FuncDecl::frameSize.
+    void endFunction(const FuncDecl &f);
+    uint32_t declare(std::string_view name); // next local slot
+    const SymbolRef &bind(const IdentifierExpr &id);       // read or assignment target
+    const SymbolRef &bindCallee(const IdentifierExpr &id); // functions and builtins only
+    size_t mark() const { return m_scopes.size(); }
+    void popTo(size_t mark);
+
+    // Module layout of the current program.
+    const std::vector<const FuncDecl *> &functions() const { return m_functions; } // by Function slot
+    const std::vector<const VarDecl *> &globals() const { return m_globals; }      // by Global slot
+    size_t undefined() const { return m_undefined; }
+    size_t symbols() const { return m_names.size(); }
+
+private:
+    struct Undo
+    {
+        uint32_t symbol;
+        uint32_t previous;
+    };
+
+    uint32_t intern(std::string_view name);
+
+    void block(const Block &b);
+    void statement(const Stmt *s);
+    void expr(const Expr *e);
+
+    std::vector<std::string_view> m_names; // by symbol
+    std::vector<uint32_t> m_table;         // open addressing: symbol + 1, 0 empty
+    // By symbol, the binding in force, slot + 1 (0: none).
+    std::vector<uint32_t> m_local;
+    std::vector<uint32_t> m_global;
+    std::vector<uint32_t> m_function;
+    std::vector<Undo> m_scopes;
+
+    std::vector<const FuncDecl *> m_functions;
+    std::vector<const VarDecl *> m_globals;
+    uint32_t m_frame = 0; // local slots used by the current function
+    size_t m_undefined = 0;
+};
@@ -0,0 +1,742 @@
+#include "simplifier.hpp"
+#include "../vm/builtins.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    uint64_t size(const Expr *e);
+    uint64_t size(const Stmt *s);
+
+    uint64_t size(const Block &b)
+    {
+        uint64_t n = 0;
+        for (const auto &s : b)
+            n += size(s.get());
+        return n;
+    }
+
+    uint64_t size(const Expr *e)
+    {
+        if (!e)
+            return 0;
+        if (auto b = dynamic_cast<const BinaryExpr *>(e))
+            return 1 + size(b->left.get()) + size(b->right.get());
+        if (auto u = dynamic_cast<const UnaryExpr *>(e))
+            return 1 + size(u->right.get());
+        if (auto c = dynamic_cast<const CallExpr *>(e))
+        {
+            uint64_t n = 1 + size(c->callee.get());
+            for (const auto &a : c->args)
+                n += size(a.get());
+            return n;
+        }
+        return 1;
+    }
+
+    uint64_t size(const Stmt *s)
+    {
+        if (!s)
+            return 0;
+        if (auto e = dynamic_cast<const ExprStmt *>(s))
+            return 1 + size(e->expr.get());
+        if (auto v = dynamic_cast<const VarDecl *>(s))
+            return 1 + (v->initValue ? size(v->initValue->get()) : 0);
+        if (auto r = dynamic_cast<const ReturnStmt *>(s))
+            return 1 + (r->value ? size(r->value->get()) : 0);
+        if (auto i = dynamic_cast<const IfStmt *>(s))
+        {
+            uint64_t n = 1 + size(i->ifBlock.first.get()) + size(i->ifBlock.second);
+            if (i->elseIfs)
+                for (const auto &branch : *i->elseIfs)
+                    n += size(branch.first.get()) + size(branch.second);
+            if (i->elseBlock)
+                n += size(*i->elseBlock);
+            return n;
+        }
+        if (auto w = dynamic_cast<const WhileStmt *>(s))
+            return 1 + size(w->condition.get()) + size(w->body);
+        if (auto l = dynamic_cast<const LoopStmt *>(s))
+            return 1 + size(l->init.get()) + size(l->condition.get()) + size(l->step.get()) + size(l->body);
+        if (auto it = dynamic_cast<const IterStmt *>(s))
+            return 1 + size(it->iterable.get()) + size(it->body);
+        return 1;
+    }
+
+    bool bound(const IdentifierExpr &id)
+    {
+        return id.ref.kind == SymbolKind::Local || id.ref.kind == SymbolKind::Global;
+    }
+
+    // Evaluating `e` can neither fail nor change anything.
+    bool pure(const Expr *e)
+    {
+        if (auto id = dynamic_cast<const IdentifierExpr *>(e))
+            return bound(*id);
+        if (dynamic_cast<const LiteralExpr *>(e))
+            return true;
+        auto u = dynamic_cast<const UnaryExpr *>(e);
+        return u && u->op == "-" && dynamic_cast<const LiteralExpr *>(u->right.get()) &&
+               isNumeric(dtypeOfLiteral(static_cast<const LiteralExpr *>(u->right.get())->litType));
+    }
+
+    // An expression statement that can be dropped: pure, or `x = x`.
+    bool noop(const Expr *e)
+    {
+        if (pure(e))
+            return true;
+        auto b = dynamic_cast<const BinaryExpr *>(e);
+        if (!b || b->op != "=")
+            return false;
+        auto l = dynamic_cast<const IdentifierExpr *>(b->left.get());
+        auto r = dynamic_cast<const IdentifierExpr *>(b->right.get());
+        return l && r && bound(*l) && l->ref.kind == r->ref.kind && l->ref.slot == r->ref.slot;
+    }
+
+    bool declares(const Block &b)
+    {
+        for (const auto &s : b)
+            if (dynamic_cast<const VarDecl *>(s.get()))
+                return true;
+        return false;
+    }
+}
+
+bool Simplifier::simplify(Program &prog)
+{
+    m_stats = SimplifyStats();
+    m_removed = 0;
+    m_created = 0;
+    m_heap.clear();
+    m_checker.setTypeChecks(false);
+    if (!m_checker.check(prog, true))
+        return false;
+
+    // Only the bodies the compiler will use; later duplicates are left as
+    // they are (and unbound).
+    const auto &live = m_checker.resolver().functions();
+    auto visit = [&](FuncDecl &f) {
+        if (!f.body)
+            return;
+        if (std::find(live.begin(), live.end(), &f) != live.end())
+            function(f);
+        else
+            m_stats.nodesBefore += size(*f.body);
+    };
+    for (auto &d : prog.decls)
+    {
+        if (auto f = dynamic_cast<FuncDecl *>(d.get()))
+            visit(*f);
+        else if (auto b = dynamic_cast<BlockDecl *>(d.get()))
+            for (auto &m : b->methods)
+                visit(*m);
+    }
+
+    m_fn = nullptr;
+    for (auto &g : prog.globalVars)
+    {
+        m_stats.nodesBefore++;
+        if (g->initValue)
+            expr(*g->initValue);
+    }
+    for (auto &e : prog.globalExprs)
+        expr(e);
+
+    m_stats.nodesAfter = m_stats.nodesBefore - m_removed + m_created;
+    return true;
+}
+
+void Simplifier::function(FuncDecl &f)
+{
+    m_fn = &f;
+    m_kindsReady = false;
+    block(*f.body);
+    m_fn = nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Statements
+
+bool Simplifier::block(Block &b)
+{
+    for (size_t i = 0; i < b.size();)
+    {
+        bool exits = false;
+        i += statement(b, i, exits);
+        if (!exits)
+            continue;
+        if (i < b.size())
+        {
+            uint64_t dead = 0;
+            for (size_t j = i; j < b.size(); j++)
+                dead += size(b.at(j));
+            m_stats.nodesBefore += dead;
+            m_removed += dead;
+            m_stats.unreachable += static_cast<uint32_t>(b.size() - i);
+            b.removeLast(b.size() - i);
+        }
+        return true;
+    }
+    return false;
+}
+
+size_t Simplifier::statement(Block &b, size_t i, bool &exits)
+{
+    Stmt *s = b.at(i);
+    m_stats.nodesBefore++;
+    if (auto e = dynamic_cast<ExprStmt *>(s))
+    {
+        expr(e->expr);
+        if (!noop(e->expr.get()))
+            return 1;
+        m_stats.noops++;
+        m_removed += size(s);
+        b.removeAt(i);
+        return 0;
+    }
+    if (auto v = dynamic_cast<VarDecl *>(s))
+    {
+        if (v->initValue)
+            expr(*v->initValue);
+        return 1;
+    }
+    if (auto r = dynamic_cast<ReturnStmt *>(s))
+    {
+        if (r->value)
+            expr(*r->value);
+        exits = true;
+        return 1;
+    }
+    if (auto is = dynamic_cast<IfStmt *>(s))
+        return ifStmt(b, i, *is, exits);
+
+    Value v;
+    if (auto w = dynamic_cast<WhileStmt *>(s))
+    {
+        expr(w->condition);
+        bool known = constant(w->condition.get(), v);
+        if (known && !v.truthy())
+        {
+            m_stats.branches++;
+            m_stats.nodesBefore += size(w->body);
+            m_removed += size(s);
+            b.removeAt(i);
+            return 0;
+        }
+        block(w->body);
+        // There is no break: only a return leaves a loop that cannot end.
+        exits = !w->condition || known;
+        return 1;
+    }
+    if (auto l = dynamic_cast<LoopStmt *>(s))
+    {
+        loose(l->init.get());
+        expr(l->condition);
+        block(l->body);
+        loose(l->step.get());
+        exits = !l->condition || (constant(l->condition.get(), v) && v.truthy());
+        return 1;
+    }
+    if (auto it = dynamic_cast<IterStmt *>(s))
+    {
+        expr(it->iterable);
+        block(it->body);
+        return 1;
+    }
+    m_stats.nodesBefore += size(s) - 1;
+    return 1;
+}
+
+size_t Simplifier::ifStmt(Block &b, size_t i, IfStmt &s, bool &exits)
+{
+    Value v;
+    // A leading branch that is never taken hands over to the next one.
+    for (;;)
+    {
+        expr(s.ifBlock.first);
+        if (!constant(s.ifBlock.first.get(), v) || v.truthy())
+            break;
+        m_stats.branches++;
+        m_removed += size(s.ifBlock.first.get());
+        dropBlock(s.ifBlock.second);
+        if (s.elseIfs && !s.elseIfs->empty())
+        {
+            s.ifBlock = std::move(s.elseIfs->front());
+            s.elseIfs->erase(s.elseIfs->begin());
+            continue;
+        }
+        if (!s.elseBlock)
+        {
+            m_removed++;
+            b.removeAt(i);
+            return 0;
+        }
+        s.ifBlock.first = makeConstant(Value::fromBool(true));
+        s.ifBlock.second = std::move(*s.elseBlock);
+        s.elseBlock.reset();
+        m_created++;
+        break;
+    }
+
+    bool taken = constant(s.ifBlock.first.get(), v) && v.truthy();
+    if (s.elseIfs)
+    {
+        auto &chain = *s.elseIfs;
+        size_t j = 0;
+        while (!taken && j < chain.size())
+        {
+            expr(chain[j].first);
+            if (!constant(chain[j].first.get(), v))
+            {
+                j++;
+                continue;
+            }
+            m_stats.branches++;
+            m_removed += size(chain[j].first.get());
+            if (!v.truthy())
+            {
+                dropBlock(chain[j].second);
+                chain.erase(chain.begin() + j);
+                continue;
+            }
+            // Always taken when reached: it becomes the else branch.
+            if (s.elseBlock)
+                dropBlock(*s.elseBlock);
+            s.elseBlock = std::move(chain[j].second);
+            chain.erase(chain.begin() + j);
+            break;
+        }
+        // Whatever follows a branch that is always taken is dead.
+        for (size_t k = j; k < chain.size(); k++)
+        {
+            m_stats.branches++;
+            m_stats.nodesBefore += size(chain[k].first.get());
+            m_removed += size(chain[k].first.get());
+            dropBlock(chain[k].second);
+        }
+        chain.erase(chain.begin() + static_cast<std::ptrdiff_t>(std::min(j, chain.size())), chain.end());
+        if (chain.empty())
+            s.elseIfs.reset();
+    }
+    if (taken && s.elseBlock)
+    {
+        m_stats.branches++;
+        dropBlock(*s.elseBlock);
+        s.elseBlock.reset();
+    }
+
+    bool all = block(s.ifBlock.second);
+    if (s.elseIfs)
+        for (auto &branch : *s.elseIfs)
+            all = block(branch.second) && all;
+    if (s.elseBlock)
+        all = block(*s.elseBlock) && all;
+    else if (!taken)
+        all = false;
+    exits = all;
+
+    if (taken)
+    {
+        // The branch runs unconditionally; its statements move up unless
+        // that would change what a declaration inside it shadows.
+        Block &body = s.ifBlock.second;
+        if (declares(body))
+            return 1;
+        m_removed += 1 + size(s.ifBlock.first.get());
+        StmtPtr self = b.removeAt(i);
+        size_t n = 0;
+        while (!body.empty())
+            b.insertAt(i + n++, body.removeAt(0));
+        return n;
+    }
+    if (!s.elseIfs && s.ifBlock.second.empty() && (!s.elseBlock || s.elseBlock->empty()))
+    {
+        // Nothing runs either way; only the condition is left to evaluate.
+        m_stats.noops++;
+        ExprPtr cond = std::move(s.ifBlock.first);
+        if (pure(cond.get()))
+        {
+            m_removed += 1 + size(cond.get());
+            b.removeAt(i);
+            return 0;
+        }
+        m_removed++;
+        m_created++;
+        b.replaceAt(i, std::make_unique<ExprStmt>(std::move(cond)));
+    }
+    return 1;
+}
+
+void Simplifier::loose(Stmt *s)
+{
+    if (auto e = dynamic_cast<ExprStmt *>(s))
+    {
+        m_stats.nodesBefore++;
+        expr(e->expr);
+    }
+    else
+    {
+        m_stats.nodesBefore += size(s);
+    }
+}
+
+void Simplifier::dropBlock(Block &b)
+{
+    uint64_t n = size(b);
+    m_stats.nodesBefore += n;
+    m_removed += n;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Expressions
+
+void Simplifier::expr(ExprPtr &e)
+{
+    if (!e)
+        return;
+    m_stats.nodesBefore++;
+    Expr *p = e.get();
+    if (dynamic_cast<IdentifierExpr *>(p) || dynamic_cast<LiteralExpr *>(p))
+        return;
+    if (auto b = dynamic_cast<BinaryExpr *>(p))
+        binary(e, *b);
+    else if (auto u = dynamic_cast<UnaryExpr *>(p))
+        unary(e, *u);
+    else if (auto c = dynamic_cast<CallExpr *>(p))
+    {
+        m_stats.nodesBefore += size(c->callee.get());
+        for (auto &a : c->args)
+            expr(a);
+    }
+}
+
+void Simplifier::binary(ExprPtr &e, BinaryExpr &b)
+{
+    if (b.op == "=")
+    {
+        m_stats.nodesBefore += size(b.left.get());
+        expr(b.right);
+        return;
+    }
+
+    Value l, r;
+    if (isLogicalOp(b.op))
+    {
+        expr(b.left);
+        if (!constant(b.left.get(), l))
+        {
+            expr(b.right);
+            return;
+        }
+        if (l.truthy() != (b.op == "&&")) // as the compiler reads it
+        {
+            // Short-circuits: the right side never runs.
+            m_stats.nodesBefore += size(b.right.get());
+            replace(e, makeConstant(Value::fromBool(l.truthy())), size(e.get()));
+            m_stats.folded++;
+            return;
+        }
+        expr(b.right);
+        if (constant(b.right.get(), r))
+        {
+            replace(e, makeConstant(Value::fromBool(r.truthy())), size(e.get()));
+            m_stats.folded++;
+        }
+        return;
+    }
+
+    expr(b.left);
+    expr(b.right);
+    BinOp op = binOpFromLexeme(b.op);
+    if (op == BinOp::Invalid)
+        return;
+    if (constant(b.left.get(), l) && constant(b.right.get(), r))
+    {
+        // A failing operation is left for the VM to report.
+        Value out;
+        std::string err;
+        if (!applyBinOp(op, l, r, m_heap, out, err))
+            return;
+        if (ExprPtr c = makeConstant(out))
+        {
+            replace(e, std::move(c), size(e.get()));
+            m_stats.folded++;
+        }
+        return;
+    }
+
+    auto number = [&](const Expr *x, double n) {
+        Value v;
+        return constant(x, v) && v.isNumber() && v.num() == n && !std::signbit(v.num());
+    };
+    auto emptyText = [&](const Expr *x) {
+        Value v;
+        return constant(x, v) && v.isText() && v.text().empty();
+    };
+    ExprPtr *keep = nullptr;
+    switch (op)
+    {
+    case BinOp::Sub:
+    case BinOp::Div:
+        if (number(b.right.get(), op == BinOp::Sub ? 0.0 : 1.0) && kindOf(b.left.get()) == Kind::Number)
+            keep = &b.left;
+        break;
+    case BinOp::Mul:
+        if (number(b.right.get(), 1.0) && kindOf(b.left.get()) == Kind::Number)
+            keep = &b.left;
+        else if (number(b.left.get(), 1.0) && kindOf(b.right.get()) == Kind::Number)
+            keep = &b.right;
+        break;
+    case BinOp::Add:
+        if (emptyText(b.right.get()) && kindOf(b.left.get()) == Kind::Text)
+            keep = &b.left;
+        else if (emptyText(b.left.get()) && kindOf(b.right.get()) == Kind::Text)
+            keep = &b.right;
+        break;
+    default:
+        break;
+    }
+    if (keep)
+    {
+        uint64_t old = size(e.get());
+        ExprPtr kept = std::move(*keep);
+        replace(e, std::move(kept), old);
+        m_stats.noops++;
+    }
+}
+
+void Simplifier::unary(ExprPtr &e, UnaryExpr &u)
+{
+    expr(u.right);
+    Value v;
+    if (!constant(u.right.get(), v))
+        return;
+    ExprPtr c;
+    if (u.op == "!")
+        c = makeConstant(Value::fromBool(!v.truthy()));
+    else if (v.isNumber() && u.op == "+")
+        c = makeConstant(v);
+    else if (v.isNumber() && u.op == "-" && !dynamic_cast<const LiteralExpr *>(u.right.get()))
+        c = makeConstant(Value::number(-v.num())); // -lit is already the constant's form
+    if (c)
+    {
+        replace(e, std::move(c), size(e.get()));
+        m_stats.folded++;
+    }
+}
+
+bool Simplifier::constant(const Expr *e, Value &out)
+{
+    if (auto lit = dynamic_cast<const LiteralExpr *>(e))
+        return literalValue(lit->value, lit->litType, m_heap, out);
+    auto u = dynamic_cast<const UnaryExpr *>(e);
+    auto lit = u && u->op == "-" ? dynamic_cast<const LiteralExpr *>(u->right.get()) : nullptr;
+    if (!lit || !literalValue(lit->value, lit->litType, m_heap, out) || !out.isNumber())
+        return false;
+    out = Value::number(-out.num());
+    return true;
+}
+
+ExprPtr Simplifier::makeConstant(const Value &v) const
+{
+    switch (v.kind())
+    {
+    case ValueKind::Bool:
+        return std::make_unique<LiteralExpr>(v.boolean() ? "true" : "false", TokenType::BOOL_LITERAL);
+    case ValueKind::Text:
+        // Genex text literals have no escapes.
+        if (v.text().find('"') != std::string_view::npos)
+            return nullptr;
+        return std::make_unique<LiteralExpr>('"' + std::string(v.text()) + '"', TokenType::STRING_LITERAL);
+    case ValueKind::Number:
+    {
+        if (!std::isfinite(v.num()))
+            return nullptr;
+        // Digits with an optional fraction is all the lexer reads, so a
+        // negative number is -lit and the digits must round-trip exactly.
+        double a = std::fabs(v.num());
+        char buf[32];
+        if (a < 1e15 && a == std::floor(a))
+            std::snprintf(buf, sizeof(buf), "%.0f", a);
+        else
+            std::snprintf(buf, sizeof(buf), "%.17g", a);
+        if (std::strchr(buf, 'e') || std::strtod(buf, nullptr) != a)
+            return nullptr;
+        ExprPtr lit = std::make_unique<LiteralExpr>(buf, TokenType::FLOAT_LITERAL);
+        if (!std::signbit(v.num()))
+            return lit;
+        return std::make_unique<UnaryExpr>("-", std::move(lit));
+    }
+    default:
+        return nullptr;
+    }
+}
+
+void Simplifier::replace(ExprPtr &slot, ExprPtr with, uint64_t oldSize)
+{
+    m_removed += oldSize;
+    m_created += size(with.get());
+    slot = std::move(with);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Definite kinds
+
+Simplifier::Kind Simplifier::kindOf(const Expr *e)
+{
+    if (auto id = dynamic_cast<const IdentifierExpr *>(e))
+    {
+        if (!m_fn || id->ref.kind != SymbolKind::Local)
+            return Kind::Other;
+        if (!m_kindsReady)
+            inferKinds();
+        return id->ref.slot < m_kinds.size() ? m_kinds[id->ref.slot] : Kind::Other;
+    }
+    if (auto lit = dynamic_cast<const LiteralExpr *>(e))
+    {
+        DType t = dtypeOfLiteral(lit->litType);
+        return isNumeric(t) ? Kind::Number : t == DType::Text ? Kind::Text : Kind::Other;
+    }
+    if (auto b = dynamic_cast<const BinaryExpr *>(e))
+    {
+        if (b->op == "=")
+            return kindOf(b->right.get());
+        switch (binOpFromLexeme(b->op))
+        {
+        case BinOp::Add:
+        case BinOp::Sub:
+        case BinOp::Mul:
+        case BinOp::Div:
+        {
+            // A vector or complex operand gives a vector or complex result.
+            Kind l = kindOf(b->left.get()), r = kindOf(b->right.get());
+            if (b->op == "+" && (l == Kind::Text || r == Kind::Text))
+                return Kind::Text;
+            if (l == Kind::Other || r == Kind::Other)
+                return Kind::Other;
+            return l == Kind::Number && r == Kind::Number ? Kind::Number : Kind::None;
+        }
+        case BinOp::Mod: return Kind::Number; // or the run fails
+        default: return Kind::Other;          // comparisons and logic yield bool
+        }
+    }
+    if (auto u = dynamic_cast<const UnaryExpr *>(e))
+        return u->op == "!" ? Kind::Other : Kind::Number;
+    if (auto c = dynamic_cast<const CallExpr *>(e))
+    {
+        auto id = dynamic_cast<const IdentifierExpr *>(c->callee.get());
+        bool number = id && id->ref.kind == SymbolKind::Builtin &&
+                      builtinResult(static_cast<Builtin>(id->ref.slot)) == DType::Number;
+        return number ? Kind::Number : Kind::Other;
+    }
+    return Kind::Other;
+}
+
+void Simplifier::inferKinds()
+{
+    // Optimistic fixpoint: every slot starts with no writes, and each pass
+    // joins in the kinds of the values written to it. Identifiers read the
+    // kinds as they stand, so a self-referencing update like `n = n - 1`
+    // settles on the kind its other writes give.
+    m_kindsReady = true;
+    m_kinds.assign(m_fn->frameSize, Kind::None);
+    for (size_t p = 0; p < m_fn->params.size() && p < m_kinds.size(); p++)
+        m_kinds[p] = Kind::Other;
+    m_writes.clear();
+    collect(*m_fn->body);
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (const Write &w : m_writes)
+        {
+            if (w.slot >= m_kinds.size())
+                continue;
+            // An iteration variable takes the iterable's kind: a number
+            // counts up, a text yields one-character texts.
+            Kind k = w.value ? kindOf(w.value) : Kind::Other;
+            Kind &at = m_kinds[w.slot];
+            Kind joined = at == Kind::None || at == k ? k : k == Kind::None ? at : Kind::Other;
+            if (joined != at)
+            {
+                at = joined;
+                changed = true;
+            }
+        }
+    }
+    m_writes.clear();
+}
+
+void Simplifier::collect(const Block &b)
+{
+    for (const auto &s : b)
+        collect(s.get());
+}
+
+void Simplifier::collect(const Stmt *s)
+{
+    if (auto e = dynamic_cast<const ExprStmt *>(s))
+        collect(e->expr.get());
+    else if (auto v = dynamic_cast<const VarDecl *>(s))
+    {
+        const Expr *init = v->initValue ? v->initValue->get() : nullptr;
+        collect(init);
+        m_writes.push_back(Write{v->slot, init});
+    }
+    else if (auto r = dynamic_cast<const ReturnStmt *>(s))
+    {
+        if (r->value)
+            collect(r->value->get());
+    }
+    else if (auto i = dynamic_cast<const IfStmt *>(s))
+    {
+        collect(i->ifBlock.first.get());
+        collect(i->ifBlock.second);
+        if (i->elseIfs)
+            for (const auto &branch : *i->elseIfs)
+            {
+                collect(branch.first.get());
+                collect(branch.second);
+            }
+        if (i->elseBlock)
+            collect(*i->elseBlock);
+    }
+    else if (auto w = dynamic_cast<const WhileStmt *>(s))
+    {
+        collect(w->condition.get());
+        collect(w->body);
+    }
+    else if (auto l = dynamic_cast<const LoopStmt *>(s))
+    {
+        collect(l->init.get());
+        collect(l->condition.get());
+        collect(l->step.get());
+        collect(l->body);
+    }
+    else if (auto it = dynamic_cast<const IterStmt *>(s))
+    {
+        collect(it->iterable.get());
+        m_writes.push_back(Write{it->slot, it->iterable.get()});
+        collect(it->body);
+    }
+}
+
+void Simplifier::collect(const Expr *e)
+{
+    if (auto b = dynamic_cast<const BinaryExpr *>(e))
+    {
+        auto id = b->op == "=" ? dynamic_cast<const IdentifierExpr *>(b->left.get()) : nullptr;
+        if (id && id->ref.kind == SymbolKind::Local)
+            m_writes.push_back(Write{id->ref.slot, b->right.get()});
+        else
+            collect(b->left.get());
+        collect(b->right.get());
+    }
+    else if (auto u = dynamic_cast<const UnaryExpr *>(e))
+        collect(u->right.get());
+    else if (auto c = dynamic_cast<const CallExpr *>(e))
+        for (const auto &a : c->args)
+            collect(a.get());
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "../parser/ast.hpp"
+#include "../runtime/value.hpp"
+#include "checker.hpp"
+#include <cstdint>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Semantics-preserving AST simplification, to keep GP bloat out of every
+// later evaluation and clone.
+//
+//   folding      operators over constants become their value; `a && b`
+//                and `a || b` with a constant left side short-circuit
+//   dead code    if / else-if branches with a constant condition, while
+//                loops whose condition is constant false, statements after
+//                a return or another statement that never falls through
+//   no-ops       `x = x`, expression statements without effect, empty ifs,
+//                and the identities e - 0, e * 1, 1 * e, e / 1 (e a number)
+//                and e + "", "" + e (e a text)
+//
+// "Preserving" means bit-identical under the VM: same value, output and
+// error for every input. Only programs that pass the SemanticChecker (with
+// the compiler's rules) are touched, so removing code never turns a
+// program the compiler rejects into one it accepts. A constant is folded
+// only if its result is representable as a Genex literal: no NaN, infinity
+// or exponent, no text containing a quote. e + 0 is kept: it turns -0
+// into 0. Step and heap budgets are resources, not semantics; a simplified
+// program never needs more of either.
+//
+// The identities need the operand's kind for certain. Declared dtypes are
+// not enforced at runtime, so a local counts as a number (or text) only if
+// every value ever written to it is one; that is worked out per function,
+// on demand, as a fixpoint over its writes.
+//
+// The walk keeps the checker's bindings valid: nodes are folded or moved,
+// never renamed, and a taken if-branch is spliced into its parent only
+// when that declares nothing at its top level.
+
+struct SimplifyStats
+{
+    uint64_t nodesBefore = 0; // expressions and statements
+    uint64_t nodesAfter = 0;
+    uint32_t folded = 0;      // constant expressions replaced by their value
+    uint32_t branches = 0;    // dead branches and loops removed
+    uint32_t unreachable = 0; // statements removed after an unconditional exit
+    uint32_t noops = 0;       // no-op statements and identities removed
+};
+
+class Simplifier
+{
+public:
+    // Simplifies `prog` in place. Returns false, leaving it untouched, if
+    // the compiler would reject it.
+    bool simplify(Program &prog);
+    const SimplifyStats &stats() const { return m_stats; }
+
+private:
+    enum class Kind : uint8_t
+    {
+        None, // no write seen yet
+        Number,
+        Text,
+        Other
+    };
+
+    struct Write
+    {
+        uint32_t slot;
+        const Expr *value; // nullptr: nil; for an iteration variable, the iterable
+    };
+
+    void function(FuncDecl &f);
+
+    // statements
+    bool block(Block &b); // true when control never falls out of it
+    size_t statement(Block &b, size_t i, bool &exits);
+    size_t ifStmt(Block &b, size_t i, IfStmt &s, bool &exits);
+    void loose(Stmt *s); // loop init and step
+
+    // expressions
+    void expr(ExprPtr &e);
+    void binary(ExprPtr &e, BinaryExpr &b);
+    void unary(ExprPtr &e, UnaryExpr &u);
+    bool constant(const Expr *e, Value &out);
+    ExprPtr makeConstant(const Value &v) const;
+    void replace(ExprPtr &slot, ExprPtr with, uint64_t oldSize);
+    void dropBlock(Block &b);
+
+    // definite kinds of the current function's locals
+    Kind kindOf(const Expr *e);
+    void inferKinds();
+    void collect(const Block &b);
+    void collect(const Stmt *s);
+    void collect(const Expr *e);
+
+    SemanticChecker m_checker;
+    ValueHeap m_heap; // text of the constants being folded
+    SimplifyStats m_stats;
+    uint64_t m_removed = 0; // nodes, see stats()
+    uint64_t m_created = 0;
+
+    const FuncDecl *m_fn = nullptr; // null in global initialisers
+    bool m_kindsReady = false;
+    std::vector<Kind> m_kinds; // by local slot
+    std::vector<Write> m_writes;
+};
@@ -0,0 +1,718 @@
+#include "ast_binary.hpp"
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr char kMagic[4] = {'G', 'X', 'A', 'B'};
+    constexpr uint16_t kByteOrder = 0x0102;
+
+    size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+    //////////////////////////////////////////////////////////////////////////
+    // Encoder: post-order walk, children are emitted before their parent so
+    // that each parent's edge slice is contiguous.
+    class Encoder
+    {
+    public:
+        std::vector<uint8_t> run(const Program &prog)
+        {
+            uint32_t root = encodeProgram(prog);
+            return finish(root);
+        }
+
+    private:
+        std::vector<FlatNode> nodes;
+        std::vector<uint32_t> edges;
+        std::vector<PoolEntry> strings;
+        std::vector<PoolEntry> literals;
+        std::string bytes;
+        std::unordered_map<std::string, uint32_t> stringIds;
+        std::unordered_map<std::string, uint32_t> literalIds;
+
+        uint32_t intern(std::unordered_map<std::string, uint32_t> &ids, std::vector<PoolEntry> &pool,
+                        const std::string &s)
+        {
+            auto it = ids.find(s);
+            if (it != ids.end())
+                return it->second;
+            uint32_t id = static_cast<uint32_t>(pool.size());
+            pool.push_back(PoolEntry{static_cast<uint32_t>(bytes.size()), static_cast<uint32_t>(s.size())});
+            bytes += s;
+            ids.emplace(s, id);
+            return id;
+        }
+        uint32_t stringId(const std::string &s) { return intern(stringIds, strings, s); }
+        uint32_t literalId(const std::string &s) { return intern(literalIds, literals, s); }
+
+        uint32_t emit(FlatKind kind, const std::vector<uint32_t> &children,
+                      uint32_t str0 = 0, uint32_t str1 = 0, uint16_t tag = 0, uint8_t flags = 0)
+        {
+            FlatNode n{};
+            n.kind = kind;
+            n.flags = flags;
+            n.tag = tag;
+            n.str0 = str0;
+            n.str1 = str1;
+            n.firstEdge = static_cast<uint32_t>(edges.size());
+            n.edgeCount = static_cast<uint32_t>(children.size());
+            edges.insert(edges.end(), children.begin(), children.end());
+            nodes.push_back(n);
+            return static_cast<uint32_t>(nodes.size() - 1);
+        }
+
+        uint32_t encodeProgram(const Program &prog)
+        {
+            std::vector<uint32_t> decls, exprs, vars;
+            for (const auto &d : prog.decls)
+                decls.push_back(encodeDecl(d.get()));
+            for (const auto &e : prog.globalExprs)
+                exprs.push_back(encodeExpr(e.get()));
+            for (const auto &v : prog.globalVars)
+                vars.push_back(encodeStmt(v.get()));
+            return emit(FlatKind::Program, {emit(FlatKind::List, decls), emit(FlatKind::List, exprs),
+                                            emit(FlatKind::List, vars)});
+        }
+
+        uint32_t encodeDecl(const Decl *d)
+        {
+            if (!d)
+                return kNoNode;
+            if (auto h = dynamic_cast<const HeaderDecl *>(d))
+                return emit(FlatKind::HeaderDecl, {}, stringId(h->name));
+            if (auto f = dynamic_cast<const FuncDecl *>(d))
+                return encodeFunc(f);
+            if (auto b = dynamic_cast<const BlockDecl *>(d))
+            {
+                std::vector<uint32_t> fields, methods;
+                for (const auto &f : b->fields)
+                    fields.push_back(encodeStmt(f.get()));
+                for (const auto &m : b->methods)
+                    methods.push_back(encodeFunc(m.get()));
+                return emit(FlatKind::BlockDecl, {emit(FlatKind::List, fields), emit(FlatKind::List, methods)},
+                            stringId(b->name));
+            }
+            return kNoNode;
+        }
+
+        uint32_t encodeFunc(const FuncDecl *f)
+        {
+            if (!f)
+                return kNoNode;
+            std::vector<uint32_t> params;
+            for (const auto &p : f->params)
+                params.push_back(emit(FlatKind::Param, {}, stringId(p.first), stringId(p.second)));
+            uint32_t body = f->body ? encodeBlock(*f->body) : kNoNode;
+            return emit(FlatKind::FuncDecl, {emit(FlatKind::List, params), body}, stringId(f->name));
+        }
+
+        uint32_t encodeBlock(const Block &b)
+        {
+            std::vector<uint32_t> stmts;
+            for (const auto &s : b)
+                stmts.push_back(encodeStmt(s.get()));
+            return emit(FlatKind::Block, stmts);
+        }
+
+        uint32_t encodeStmt(const Stmt *s)
+        {
+            if (!s)
+                return kNoNode;
+            if (auto es = dynamic_cast<const ExprStmt *>(s))
+                return emit(FlatKind::ExprStmt, {encodeExpr(es->expr.get())});
+            if (auto rs = dynamic_cast<const ReturnStmt *>(s))
+            {
+                uint32_t v = rs->value ? encodeExpr(rs->value->get()) : kNoNode;
+                return emit(FlatKind::ReturnStmt, {v}, 0, 0, 0, rs->value ? kFlagEngaged : 0);
+            }
+            if (auto is = dynamic_cast<const IfStmt *>(s))
+            {
+                uint32_t cond = encodeExpr(is->ifBlock.first.get());
+                uint32_t then = encodeBlock(is->ifBlock.second);
+                uint32_t elseIfs = kNoNode;
+                uint8_t flags = 0;
+                if (is->elseIfs)
+                {
+                    std::vector<uint32_t> items;
+                    for (const auto &ei : *is->elseIfs)
+                        items.push_back(emit(FlatKind::ElseIf, {encodeExpr(ei.first.get()), encodeBlock(ei.second)}));
+                    elseIfs = emit(FlatKind::List, items);
+                    flags |= kFlagElseIfs;
+                }
+                uint32_t elseBlk = kNoNode;
+                if (is->elseBlock)
+                {
+                    elseBlk = encodeBlock(*is->elseBlock);
+                    flags |= kFlagElse;
+                }
+                return emit(FlatKind::IfStmt, {cond, then, elseIfs, elseBlk}, 0, 0, 0, flags);
+            }
+            if (auto ws = dynamic_cast<const WhileStmt *>(s))
+            {
+                uint32_t cond = encodeExpr(ws->condition.get());
+                return emit(FlatKind::WhileStmt, {cond, encodeBlock(ws->body)});
+            }
+            if (auto ls = dynamic_cast<const LoopStmt *>(s))
+            {
+                uint32_t init = encodeStmt(ls->init.get());
+                uint32_t cond = encodeExpr(ls->condition.get());
+                uint32_t step = encodeStmt(ls->step.get());
+                uint32_t body = encodeBlock(ls->body);
+                return emit(FlatKind::LoopStmt, {init, cond, step, body}, ls->dtype ? stringId(*ls->dtype) : 0, 0, 0,
+                            ls->dtype ? kFlagEngaged : 0);
+            }
+            if (auto it = dynamic_cast<const IterStmt *>(s))
+            {
+                uint32_t iterable = encodeExpr(it->iterable.get());
+                return emit(FlatKind::IterStmt, {iterable, encodeBlock(it->body)}, 0, stringId(it->varName));
+            }
+            if (auto vd = dynamic_cast<const VarDecl *>(s))
+            {
+                uint32_t init = vd->initValue ? encodeExpr(vd->initValue->get()) : kNoNode;
+                return emit(FlatKind::VarDecl, {init}, stringId(vd->typeName), stringId(vd->varName), 0,
+                            vd->initValue ? kFlagEngaged : 0);
+            }
+            return kNoNode;
+        }
+
+        uint32_t encodeExpr(const Expr *e)
+        {
+            if (!e)
+                return kNoNode;
+            if (auto lit = dynamic_cast<const LiteralExpr *>(e))
+                return emit(FlatKind::Literal, {}, literalId(lit->value), 0, static_cast<uint16_t>(lit->litType));
+            if (auto id = dynamic_cast<const IdentifierExpr *>(e))
+                return emit(FlatKind::Identifier, {}, stringId(id->name));
+            if (auto u = dynamic_cast<const UnaryExpr *>(e))
+            {
+                uint32_t r = encodeExpr(u->right.get());
+                return emit(FlatKind::Unary, {r}, stringId(u->op));
+            }
+            if (auto b = dynamic_cast<const BinaryExpr *>(e))
+            {
+                uint32_t l = encodeExpr(b->left.get());
+                uint32_t r = encodeExpr(b->right.get());
+                return emit(FlatKind::Binary, {l, r}, stringId(b->op));
+            }
+            if (auto c = dynamic_cast<const CallExpr *>(e))
+            {
+                std::vector<uint32_t> children{encodeExpr(c->callee.get())};
+                for (const auto &a : c->args)
+                    children.push_back(encodeExpr(a.get()));
+                return emit(FlatKind::Call, children);
+            }
+            return kNoNode;
+        }
+
+        std::vector<uint8_t> finish(uint32_t root)
+        {
+            AstBinaryHeader h{};
+            std::memcpy(h.magic, kMagic, sizeof(kMagic));
+            h.version = kAstBinaryVersion;
+            h.byteOrder = kByteOrder;
+            h.root = root;
+            h.nodeCount = static_cast<uint32_t>(nodes.size());
+            h.edgeCount = static_cast<uint32_t>(edges.size());
+            h.stringCount = static_cast<uint32_t>(strings.size());
+            h.literalCount = static_cast<uint32_t>(literals.size());
+            h.bytesSize = bytes.size();
+            h.nodesOffset = align8(sizeof(AstBinaryHeader));
+            h.edgesOffset = align8(h.nodesOffset + nodes.size() * sizeof(FlatNode));
+            h.stringsOffset = align8(h.edgesOffset + edges.size() * sizeof(uint32_t));
+            h.literalsOffset = align8(h.stringsOffset + strings.size() * sizeof(PoolEntry));
+            h.bytesOffset = align8(h.literalsOffset + literals.size() * sizeof(PoolEntry));
+            h.totalSize = align8(h.bytesOffset + bytes.size());
+
+            std::vector<uint8_t> out(h.totalSize, 0);
+            std::memcpy(out.data(), &h, sizeof(h));
+            if (!nodes.empty())
+                std::memcpy(out.data() + h.nodesOffset, nodes.data(), nodes.size() * sizeof(FlatNode));
+            if (!edges.empty())
+                std::memcpy(out.data() + h.edgesOffset, edges.data(), edges.size() * sizeof(uint32_t));
+            if (!strings.empty())
+                std::memcpy(out.data() + h.stringsOffset, strings.data(), strings.size() * sizeof(PoolEntry));
+            if (!literals.empty())
+                std::memcpy(out.data() + h.literalsOffset, literals.data(), literals.size() * sizeof(PoolEntry));
+            if (!bytes.empty())
+                std::memcpy(out.data() + h.bytesOffset, bytes.data(), bytes.size());
+            return out;
+        }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    // Decoder: rebuild unique_ptr nodes from a validated view.
+    class Decoder
+    {
+    public:
+        explicit Decoder(const AstBinaryView &v) : view(v) {}
+
+        std::unique_ptr<Program> run()
+        {
+            const FlatNode &root = view.node(view.root());
+            if (root.kind != FlatKind::Program)
+                return nullptr;
+            auto prog = std::make_unique<Program>();
+            forEach(view.child(root, 0), [&](uint32_t i) { prog->decls.push_back(decl(i)); });
+            forEach(view.child(root, 1), [&](uint32_t i) { prog->globalExprs.push_back(expr(i)); });
+            forEach(view.child(root, 2), [&](uint32_t i) { prog->globalVars.push_back(varDecl(i)); });
+            return prog;
+        }
+
+    private:
+        const AstBinaryView &view;
+
+        std::string str(uint32_t i) const { return std::string(view.string(i)); }
+
+        template <typename Fn>
+        void forEach(uint32_t list, Fn fn)
+        {
+            if (list == kNoNode)
+                return;
+            const FlatNode &n = view.node(list);
+            if (n.kind != FlatKind::List)
+                return;
+            for (uint32_t k = 0; k < n.edgeCount; k++)
+                fn(view.child(n, k));
+        }
+
+        DeclPtr decl(uint32_t i)
+        {
+            if (i == kNoNode)
+                return nullptr;
+            const FlatNode &n = view.node(i);
+            switch (n.kind)
+            {
+            case FlatKind::HeaderDecl:
+            {
+                auto h = std::make_unique<HeaderDecl>();
+                h->name = str(n.str0);
+                return h;
+            }
+            case FlatKind::FuncDecl:
+                return func(i);
+            case FlatKind::BlockDecl:
+            {
+                auto b = std::make_unique<BlockDecl>();
+                b->name = str(n.str0);
+                forEach(view.child(n, 0), [&](uint32_t c) { b->fields.push_back(varDecl(c)); });
+                forEach(view.child(n, 1), [&](uint32_t c) { b->methods.push_back(func(c)); });
+                return b;
+            }
+            default:
+                return nullptr;
+            }
+        }
+
+        std::unique_ptr<FuncDecl> func(uint32_t i)
+        {
+            if (i == kNoNode)
+                return nullptr;
+            const FlatNode &n = view.node(i);
+            if (n.kind != FlatKind::FuncDecl)
+                return nullptr;
+            auto f = std::make_unique<FuncDecl>();
+            f->name = str(n.str0);
+            forEach(view.child(n, 0), [&](uint32_t p) {
+                if (p == kNoNode)
+                    return;
+                const FlatNode &pn = view.node(p);
+                if (pn.kind == FlatKind::Param)
+                    f->params.emplace_back(str(pn.str0), str(pn.str1));
+            });
+            uint32_t body = view.child(n, 1);
+            if (body != kNoNode)
+                f->body = block(body);
+            return f;
+        }
+
+        std::unique_ptr<VarDecl> varDecl(uint32_t i)
+        {
+            if (i == kNoNode)
+                return nullptr;
+            const FlatNode &n = view.node(i);
+            if (n.kind != FlatKind::VarDecl)
+                return nullptr;
+            auto v = std::make_unique<VarDecl>();
+            v->typeName = str(n.str0);
+            v->varName = str(n.str1);
+            if (n.flags & kFlagEngaged)
+                v->initValue = expr(view.child(n, 0));
+            return v;
+        }
+
+        Block block(uint32_t i)
+        {
+            Block b;
+            if (i == kNoNode)
+                return b;
+            const FlatNode &n = view.node(i);
+            if (n.kind != FlatKind::Block)
+                return b;
+            for (uint32_t k = 0; k < n.edgeCount; k++)
+                b.addStatement(stmt(view.child(n, k)));
+            return b;
+        }
+
+        StmtPtr stmt(uint32_t i)
+        {
+            if (i == kNoNode)
+                return nullptr;
+            const FlatNode &n = view.node(i);
+            switch (n.kind)
+            {
+            case FlatKind::ExprStmt:
+                return std::make_unique<ExprStmt>(expr(view.child(n, 0)));
+            case FlatKind::ReturnStmt:
+            {
+                std::optional<ExprPtr> value;
+                if (n.flags & kFlagEngaged)
+                    value = expr(view.child(n, 0));
+                return std::make_unique<ReturnStmt>(std::move(value));
+            }
+            case FlatKind::IfStmt:
+            {
+                auto is = std::make_unique<IfStmt>();
+                is->ifBlock.first = expr(view.child(n, 0));
+                is->ifBlock.second = block(view.child(n, 1));
+                if (n.flags & kFlagElseIfs)
+                {
+                    is->elseIfs.emplace();
+                    forEach(view.child(n, 2), [&](uint32_t c) {
+                        if (c == kNoNode)
+                            return;
+                        const FlatNode &ei = view.node(c);
+                        if (ei.kind == FlatKind::ElseIf)
+                            is->elseIfs->emplace_back(expr(view.child(ei, 0)), block(view.child(ei, 1)));
+                    });
+                }
+                if (n.flags & kFlagElse)
+                    is->elseBlock = block(view.child(n, 3));
+                return is;
+            }
+            case FlatKind::WhileStmt:
+            {
+                auto ws = std::make_unique<WhileStmt>();
+                ws->condition = expr(view.child(n, 0));
+                ws->body = block(view.child(n, 1));
+                return ws;
+            }
+            case FlatKind::LoopStmt:
+            {
+                auto ls = std::make_unique<LoopStmt>();
+                if (n.flags & kFlagEngaged)
+                    ls->dtype = str(n.str0);
+                ls->init = stmt(view.child(n, 0));
+                ls->condition = expr(view.child(n, 1));
+                ls->step = stmt(view.child(n, 2));
+                ls->body = block(view.child(n, 3));
+                return ls;
+            }
+            case FlatKind::IterStmt:
+            {
+                auto it = std::make_unique<IterStmt>();
+                it->iterable = expr(view.child(n, 0));
+                it->varName = str(n.str1);
+                it->body = block(view.child(n, 1));
+                return it;
+            }
+            case FlatKind::VarDecl:
+                return varDecl(i);
+            default:
+                return nullptr;
+            }
+        }
+
+        ExprPtr expr(uint32_t i)
+        {
+            if (i == kNoNode)
+                return nullptr;
+            const FlatNode &n = view.node(i);
+            switch (n.kind)
+            {
+            case FlatKind::Identifier:
+                return std::make_unique<IdentifierExpr>(str(n.str0));
+            case FlatKind::Literal:
+                return std::make_unique<LiteralExpr>(std::string(view.literal(n.str0)), static_cast<TokenType>(n.tag));
+            case FlatKind::Unary:
+                return std::make_unique<UnaryExpr>(str(n.str0), expr(view.child(n, 0)));
+            case FlatKind::Binary:
+            {
+                ExprPtr l = expr(view.child(n, 0));
+                ExprPtr r = expr(view.child(n, 1));
+                return std::make_unique<BinaryExpr>(std::move(l), str(n.str0), std::move(r));
+            }
+            case FlatKind::Call:
+            {
+                ExprPtr callee = expr(view.child(n, 0));
+                std::vector<ExprPtr> args;
+                for (uint32_t k = 1; k < n.edgeCount; k++)
+                    args.push_back(expr(view.child(n, k)));
+                return std::make_unique<CallExpr>(std::move(callee), std::move(args));
+            }
+            default:
+                return nullptr;
+            }
+        }
+    };
+
+    bool sectionFits(uint64_t offset, uint64_t count, uint64_t elemSize, uint64_t total)
+    {
+        if (offset % 4 != 0 || offset > total)
+            return false;
+        return count <= (total - offset) / (elemSize ? elemSize : 1);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// AstBinaryView
+
+bool AstBinaryView::open(const void *data, size_t size)
+{
+    m_header = nullptr;
+    m_error.clear();
+    if (!data || size < sizeof(AstBinaryHeader))
+    {
+        m_error = "AST image too small";
+        return false;
+    }
+    if (reinterpret_cast<uintptr_t>(data) % alignof(AstBinaryHeader) != 0)
+    {
+        m_error = "AST image is not 8-byte aligned";
+        return false;
+    }
+    auto h = static_cast<const AstBinaryHeader *>(data);
+    if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0)
+    {
+        m_error = "Not a Genex AST image (bad magic)";
+        return false;
+    }
+    if (h->byteOrder != kByteOrder)
+    {
+        m_error = "AST image was written with a different byte order";
+        return false;
+    }
+    if (h->version != kAstBinaryVersion)
+    {
+        m_error = "Unsupported AST image version " + std::to_string(h->version);
+        return false;
+    }
+    if (h->totalSize > size ||
+        !sectionFits(h->nodesOffset, h->nodeCount, sizeof(FlatNode), h->totalSize) ||
+        !sectionFits(h->edgesOffset, h->edgeCount, sizeof(uint32_t), h->totalSize) ||
+        !sectionFits(h->stringsOffset, h->stringCount, sizeof(PoolEntry), h->totalSize) ||
+        !sectionFits(h->literalsOffset, h->literalCount, sizeof(PoolEntry), h->totalSize) ||
+        !sectionFits(h->bytesOffset, h->bytesSize, 1, h->totalSize))
+    {
+        m_error = "AST image sections are out of bounds";
+        return false;
+    }
+    if (h->root >= h->nodeCount)
+    {
+        m_error = "AST image root index out of range";
+        return false;
+    }
+
+    auto base = static_cast<const char *>(data);
+    m_nodes = reinterpret_cast<const FlatNode *>(base + h->nodesOffset);
+    m_edges = reinterpret_cast<const uint32_t *>(base + h->edgesOffset);
+    m_strings = reinterpret_cast<const PoolEntry *>(base + h->stringsOffset);
+    m_literals = reinterpret_cast<const PoolEntry *>(base + h->literalsOffset);
+    m_bytes = base + h->bytesOffset;
+
+    // Bounds-check cross references once so accessors can stay unchecked.
+    // A node reachable through two edges would be decoded once per path, so
+    // an image that shares subtrees is rejected rather than expanded.
+    std::vector<bool> hasParent(h->nodeCount, false);
+    for (uint32_t i = 0; i < h->nodeCount; i++)
+    {
+        const FlatNode &n = m_nodes[i];
+        if (n.kind > FlatKind::Call || uint64_t(n.firstEdge) + n.edgeCount > h->edgeCount)
+        {
+            m_error = "AST image node " + std::to_string(i) + " is malformed";
+            return false;
+        }
+        uint32_t strLimit = n.kind == FlatKind::Literal ? h->literalCount : h->stringCount;
+        bool usesStr0 = n.kind == FlatKind::Literal || n.kind == FlatKind::Identifier || n.kind == FlatKind::Unary ||
+                        n.kind == FlatKind::Binary || n.kind == FlatKind::HeaderDecl || n.kind == FlatKind::FuncDecl ||
+                        n.kind == FlatKind::BlockDecl || n.kind == FlatKind::VarDecl || n.kind == FlatKind::Param ||
+                        (n.kind == FlatKind::LoopStmt && (n.flags & kFlagEngaged));
+        bool usesStr1 = n.kind == FlatKind::VarDecl || n.kind == FlatKind::Param || n.kind == FlatKind::IterStmt;
+        if ((usesStr0 && n.str0 >= strLimit) || (usesStr1 && n.str1 >= h->stringCount))
+        {
+            m_error = "AST image node " + std::to_string(i) + " has a bad pool index";
+            return false;
+        }
+        for (uint32_t k = 0; k < n.edgeCount; k++)
+        {
+            uint32_t c = m_edges[n.firstEdge + k];
+            // post-order layout: children always precede their parent
+            if (c != kNoNode && c >= i)
+            {
+                m_error = "AST image node " + std::to_string(i) + " has a bad child index";
+                return false;
+            }
+            if (c != kNoNode)
+            {
+                if (hasParent[c])
+                {
+                    m_error = "AST image node " + std::to_string(c) + " has more than one parent";
+                    return false;
+                }
+                hasParent[c] = true;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < h->stringCount + h->literalCount; i++)
+    {
+        const PoolEntry &e = i < h->stringCount ? m_strings[i] : m_literals[i - h->stringCount];
+        if (uint64_t(e.offset) + e.length > h->bytesSize)
+        {
+            m_error = "AST image pool entry out of bounds";
+            return false;
+        }
+    }
+
+    m_header = h;
+    return true;
+}
+
+std::string_view AstBinaryView::string(uint32_t i) const
+{
+    const PoolEntry &e = m_strings[i];
+    return std::string_view(m_bytes + e.offset, e.length);
+}
+
+std::string_view AstBinaryView::literal(uint32_t i) const
+{
+    const PoolEntry &e = m_literals[i];
+    return std::string_view(m_bytes + e.offset, e.length);
+}
+
+std::unique_ptr<Program> AstBinaryView::toProgram() const
+{
+    if (!m_header)
+        return nullptr;
+    Decoder d(*this);
+    return d.run();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// MappedAstFile
+
+MappedAstFile::~MappedAstFile()
+{
+    close();
+}
+
+bool MappedAstFile::open(const std::string &path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        m_error = "Cannot open AST image: " + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        ::close(fd);
+        m_error = "Cannot stat AST image: " + path;
+        return false;
+    }
+    m_size = static_cast<size_t>(st.st_size);
+    m_addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (m_addr == MAP_FAILED)
+    {
+        m_addr = nullptr;
+        m_size = 0;
+        m_error = "Cannot mmap AST image: " + path;
+        return false;
+    }
+    if (!m_view.open(m_addr, m_size))
+    {
+        m_error = m_view.error();
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedAstFile::close()
+{
+    if (m_addr)
+        munmap(m_addr, m_size);
+    m_addr = nullptr;
+    m_size = 0;
+    m_view = AstBinaryView();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// AstBinary
+
+std::vector<uint8_t> AstBinary::encode(const Program &prog)
+{
+    Encoder e;
+    return e.run(prog);
+}
+
+std::unique_ptr<Program> AstBinary::decode(const void *data, size_t size)
+{
+    AstBinaryView view;
+    if (!view.open(data, size))
+        return nullptr;
+    return view.toProgram();
+}
+
+bool AstBinary::save(const Program &prog, const std::string &path, std::string *error)
+{
+    std::vector<uint8_t> image = encode(prog);
+    // mkstemp gives every writer its own temp file, so concurrent saves of the
+    // same path from several threads or processes cannot clobber each other;
+    // the last rename wins with a complete image.
+    std::string tmp = path + ".tmpXXXXXX";
+    int fd = ::mkstemp(tmp.data());
+    if (fd < 0)
+    {
+        if (error)
+            *error = "Cannot write AST image: " + path;
+        return false;
+    }
+    bool ok = ::fchmod(fd, 0644) == 0;
+    size_t done = 0;
+    while (ok && done < image.size())
+    {
+        ssize_t w = ::write(fd, image.data() + done, image.size() - done);
+        ok = w > 0;
+        if (ok)
+            done += static_cast<size_t>(w);
+    }
+    ok = (::close(fd) == 0) && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmp.c_str());
+        if (error)
+            *error = "Cannot write AST image: " + path;
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<Program> AstBinary::load(const std::string &path, std::string *error)
+{
+    MappedAstFile file;
+    if (!file.open(path))
+    {
+        if (error)
+            *error = file.error();
+        return nullptr;
+    }
+    return file.view().toProgram();
+}
@@ -0,0 +1,199 @@
+#pragma once
+#include "../parser/ast.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+
+//////////////////////////////////////////////////////////////////////////
+// Binary AST image
+//
+// A Program is flattened into a single position-independent image:
+//
+//   AstBinaryHeader
+//   FlatNode   nodes[nodeCount]
+//   uint32_t   edges[edgeCount]        child node indices (kNoNode = null)
+//   PoolEntry  strings[stringCount]    names, type names, operators
+//   PoolEntry  literals[literalCount]  literal lexemes
+//   char       bytes[bytesSize]        payload for both pools
+//
+// Every section is 8-byte aligned and addressed by offsets stored in the
+// header, so an image can be used in place straight out of mmap: reading
+// it needs no per-node allocation. Integers are stored in host byte order;
+// the header's byteOrder field lets a reader reject an image written on a
+// host of the other endianness instead of misreading it.
+//
+// Every node except the root is referenced by exactly one edge, so the
+// image always describes a tree and decoding is linear in its size.
+
+constexpr uint32_t kNoNode = 0xFFFFFFFFu;
+constexpr uint16_t kAstBinaryVersion = 1;
+
+enum class FlatKind : uint8_t
+{
+    Program,
+    List,
+    HeaderDecl,
+    FuncDecl,
+    Param,
+    BlockDecl,
+    VarDecl,
+    Block,
+    ExprStmt,
+    ReturnStmt,
+    IfStmt,
+    ElseIf,
+    WhileStmt,
+    LoopStmt,
+    IterStmt,
+    Identifier,
+    Literal,
+    Unary,
+    Binary,
+    Call
+};
+
+// FlatNode::flags
+constexpr uint8_t kFlagEngaged = 1u << 0; // ReturnStmt value / VarDecl init / LoopStmt dtype
+constexpr uint8_t kFlagElseIfs = 1u << 1; // IfStmt::elseIfs engaged
+constexpr uint8_t kFlagElse = 1u << 2;    // IfStmt::elseBlock engaged
+
+// Child layout (edges[first .. first + count)) per kind:
+//   Program    [decls List, globalExprs List, globalVars List]
+//   List       elements
+//   FuncDecl   [params List, body Block | kNoNode]          str0 = name
+//   Param      -                                            str0 = type, str1 = name
+//   BlockDecl  [fields List, methods List]                  str0 = name
+//   VarDecl    [init]                                       str0 = type, str1 = name
+//   Block      statements
+//   ExprStmt   [expr]
+//   ReturnStmt [value]
+//   IfStmt     [cond, then Block, elseIfs List, else Block]
+//   ElseIf     [cond, Block]
+//   WhileStmt  [cond, body Block]
+//   LoopStmt   [init, cond, step, body Block]               str0 = dtype
+//   IterStmt   [iterable, body Block]                       str1 = varName
+//   Identifier -                                            str0 = name
+//   Literal    -                                            str0 = literal index, tag = TokenType
+//   Unary      [right]                                      str0 = op
+//   Binary     [left, right]                                str0 = op
+//   Call       [callee, args...]
+//   HeaderDecl -                                            str0 = name
+struct FlatNode
+{
+    FlatKind kind;
+    uint8_t flags;
+    uint16_t tag;
+    uint32_t str0;
+    uint32_t str1;
+    uint32_t firstEdge;
+    uint32_t edgeCount;
+};
+static_assert(sizeof(FlatNode) == 20, "FlatNode layout is part of the file format");
+
+struct PoolEntry
+{
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct AstBinaryHeader
+{
+    char magic[4]; // "GXAB"
+    uint16_t version;
+    uint16_t byteOrder; // 0x0102 as written by the host
+    uint32_t root;
+    uint32_t nodeCount;
+    uint32_t edgeCount;
+    uint32_t stringCount;
+    uint32_t literalCount;
+    uint32_t reserved;
+    uint64_t bytesSize;
+    uint64_t nodesOffset;
+    uint64_t edgesOffset;
+    uint64_t stringsOffset;
+    uint64_t literalsOffset;
+    uint64_t bytesOffset;
+    uint64_t totalSize;
+};
+static_assert(sizeof(AstBinaryHeader) == 88, "AstBinaryHeader layout is part of the file format");
+
+//////////////////////////////////////////////////////////////////////////
+// Read-only view over an image held elsewhere (buffer or mapping).
+class AstBinaryView
+{
+public:
+    AstBinaryView() = default;
+
+    // Validate the header, section bounds and tree shape; the view does not
+    // copy data.
+    bool open(const void *data, size_t size);
+    const std::string &error() const { return m_error; }
+
+    const AstBinaryHeader &header() const { return *m_header; }
+    uint32_t root() const { return m_header->root; }
+    uint32_t nodeCount() const { return m_header->nodeCount; }
+
+    const FlatNode &node(uint32_t i) const { return m_nodes[i]; }
+    uint32_t child(const FlatNode &n, uint32_t k) const
+    {
+        return k < n.edgeCount ? m_edges[n.firstEdge + k] : kNoNode;
+    }
+    std::string_view string(uint32_t i) const;
+    std::string_view literal(uint32_t i) const;
+
+    // Rebuild the pointer AST.
+    std::unique_ptr<Program> toProgram() const;
+
+private:
+    const AstBinaryHeader *m_header = nullptr;
+    const FlatNode *m_nodes = nullptr;
+    const uint32_t *m_edges = nullptr;
+    const PoolEntry *m_strings = nullptr;
+    const PoolEntry *m_literals = nullptr;
+    const char *m_bytes = nullptr;
+    std::string m_error;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Read-only memory mapping of an image file.
+class MappedAstFile
+{
+public:
+    MappedAstFile() = default;
+    ~MappedAstFile();
+    MappedAstFile(const MappedAstFile &) = delete;
+    MappedAstFile &operator=(const MappedAstFile &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+    const std::string &error() const { return m_error; }
+
+    const AstBinaryView &view() const { return m_view; }
+
+private:
+    void *m_addr = nullptr;
+    size_t m_size = 0;
+    AstBinaryView m_view;
+    std::string m_error;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Encoding entry points
+class AstBinary
+{
+public:
+    // Flatten a program into a self-contained image.
+    static std::vector<uint8_t> encode(const Program &prog);
+
+    // Decode an in-memory image; returns nullptr when it is malformed.
+    static std::unique_ptr<Program> decode(const void *data, size_t size);
+
+    // Write an image atomically (temp file + rename).
+    static bool save(const Program &prog, const std::string &path, std::string *error = nullptr);
+
+    // mmap an image and rebuild the program; returns nullptr on failure.
+    static std::unique_ptr<Program> load(const std::string &path, std::string *error = nullptr);
+};
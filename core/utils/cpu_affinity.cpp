@@ -0,0 +1,112 @@
+#include "cpu_affinity.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sched.h>
+#include <string>
+
+namespace
+{
+    // "0-3,8,10-11" as used by sysfs cpulist files.
+    std::vector<int> parseCpuList(const std::string &text)
+    {
+        std::vector<int> cpus;
+        size_t i = 0;
+        while (i < text.size())
+        {
+            size_t end = text.find(',', i);
+            if (end == std::string::npos)
+                end = text.size();
+            std::string range = text.substr(i, end - i);
+            i = end + 1;
+            size_t dash = range.find('-');
+            char *tail = nullptr;
+            long lo = std::strtol(range.c_str(), &tail, 10);
+            if (tail == range.c_str())
+                continue;
+            long hi = dash == std::string::npos ? lo : std::strtol(range.c_str() + dash + 1, nullptr, 10);
+            for (long c = lo; c <= hi && c < CPU_SETSIZE; c++)
+                cpus.push_back(static_cast<int>(c));
+        }
+        return cpus;
+    }
+}
+
+std::vector<int> allowedCpus()
+{
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+        return cpus;
+    for (int c = 0; c < CPU_SETSIZE; c++)
+        if (CPU_ISSET(c, &set))
+            cpus.push_back(c);
+    return cpus;
+}
+
+std::vector<std::vector<int>> numaNodeCpus()
+{
+    std::vector<int> allowed = allowedCpus();
+    std::vector<std::vector<int>> nodes;
+    // Node ids can have gaps (offline or memory-only nodes), so probe a
+    // fixed range rather than stopping at the first missing one.
+    for (int node = 0; node < 1024; node++)
+    {
+        std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!in)
+            continue;
+        std::string text;
+        std::getline(in, text);
+        std::vector<int> cpus;
+        for (int c : parseCpuList(text))
+            if (std::binary_search(allowed.begin(), allowed.end(), c))
+                cpus.push_back(c);
+        if (!cpus.empty())
+            nodes.push_back(std::move(cpus));
+    }
+    if (nodes.empty() && !allowed.empty())
+        nodes.push_back(std::move(allowed));
+    return nodes;
+}
+
+std::vector<std::vector<int>> splitCpus(size_t parts, bool byNode)
+{
+    std::vector<std::vector<int>> out(parts);
+    std::vector<std::vector<int>> groups;
+    if (byNode)
+        groups = numaNodeCpus();
+    else
+        groups.push_back(allowedCpus());
+    if (groups.empty() || groups[0].empty())
+        return out;
+
+    size_t g = groups.size();
+    for (size_t i = 0; i < parts; i++)
+    {
+        const std::vector<int> &cpus = groups[i % g];
+        size_t sharing = parts / g + (i % g < parts % g ? 1 : 0);
+        size_t slot = i / g;
+        if (cpus.size() < sharing)
+        {
+            out[i].push_back(cpus[slot % cpus.size()]);
+            continue;
+        }
+        size_t begin = cpus.size() * slot / sharing;
+        size_t end = cpus.size() * (slot + 1) / sharing;
+        out[i].assign(cpus.begin() + begin, cpus.begin() + end);
+    }
+    return out;
+}
+
+bool pinCurrentThread(const std::vector<int> &cpus)
+{
+    if (cpus.empty())
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c : cpus)
+        CPU_SET(c, &set);
+    // pid 0 is the calling thread for sched_setaffinity.
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// CPU sets for pinning work to cores and NUMA nodes (Linux).
+//
+// Node layout comes from /sys/devices/system/node, so no libnuma is
+// needed; where that is missing the machine counts as a single node.
+// Threads inherit the affinity of the thread that creates them, so pinning
+// a thread before it builds a ThreadPool pins the pool as well, and memory
+// the pool first touches then lands on the local node.
+
+// CPUs the calling process may run on, ascending.
+std::vector<int> allowedCpus();
+
+// Allowed CPUs grouped by NUMA node; empty nodes are left out.
+std::vector<std::vector<int>> numaNodeCpus();
+
+// Split the allowed CPUs into `parts` sets. Part i goes to node
+// i % nodes when byNode (every part on one node), and the parts that
+// share a group get contiguous, disjoint slices of it. When a group has
+// fewer CPUs than parts, parts share CPUs round-robin.
+std::vector<std::vector<int>> splitCpus(size_t parts, bool byNode);
+
+// Restrict the calling thread to `cpus`; false when the kernel refuses.
+bool pinCurrentThread(const std::vector<int> &cpus);
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+// Small non-cryptographic 64-bit hashing helpers shared by the caches.
+
+// SplitMix64 finalizer: a cheap full-avalanche 64-bit mix.
+inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+inline uint64_t hashCombine(uint64_t seed, uint64_t v)
+{
+    return mix64(seed ^ (v + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
+
+// Hash a byte range 8 bytes at a time; good enough for content addressing
+// of source files and AST images.
+inline uint64_t hashBytes(const void *data, size_t len, uint64_t seed = 0)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    uint64_t h = mix64(seed ^ (len * 0x9e3779b97f4a7c15ULL));
+    while (len >= 8)
+    {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        h = hashCombine(h, w);
+        p += 8;
+        len -= 8;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, p, len);
+    return hashCombine(h, tail);
+}
+
+inline uint64_t hashString(std::string_view s, uint64_t seed = 0)
+{
+    return hashBytes(s.data(), s.size(), seed);
+}
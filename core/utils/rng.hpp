@@ -0,0 +1,139 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+
+//////////////////////////////////////////////////////////////////////////
+// Counter-based random numbers (Philox4x32-10, Salmon et al. 2011).
+//
+// Every draw is a pure function of (seed, generation, candidate, stream,
+// draw index): there is no shared generator state, so the numbers an
+// operator sees for candidate i never depend on which thread ran it or in
+// what order. Runs are bit-identical at any thread count.
+
+// Independent sub-streams per consumer, so adding draws to one operator
+// never shifts the numbers another operator sees.
+enum class RngStream : uint32_t
+{
+    Selection = 1,
+    Crossover = 2,
+    Mutation = 3,
+    Fitness = 4,
+    Init = 5,
+    Migration = 6,
+    User = 100
+};
+
+class Philox4x32
+{
+public:
+    struct Block
+    {
+        uint32_t v[4];
+    };
+
+    static Block generate(Block ctr, uint64_t key)
+    {
+        uint32_t k0 = static_cast<uint32_t>(key);
+        uint32_t k1 = static_cast<uint32_t>(key >> 32);
+        for (int r = 0; r < 10; r++)
+        {
+            uint64_t p0 = uint64_t(0xD2511F53u) * ctr.v[0];
+            uint64_t p1 = uint64_t(0xCD9E8D57u) * ctr.v[2];
+            Block next;
+            next.v[0] = static_cast<uint32_t>(p1 >> 32) ^ ctr.v[1] ^ k0;
+            next.v[1] = static_cast<uint32_t>(p1);
+            next.v[2] = static_cast<uint32_t>(p0 >> 32) ^ ctr.v[3] ^ k1;
+            next.v[3] = static_cast<uint32_t>(p0);
+            ctr = next;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        return ctr;
+    }
+};
+
+class RandomStream
+{
+public:
+    using result_type = uint64_t;
+
+    RandomStream(uint64_t seed, uint64_t generation, uint64_t candidate, RngStream stream)
+        : m_seed(seed), m_generation(static_cast<uint32_t>(generation)),
+          m_candidate(static_cast<uint32_t>(candidate)), m_stream(static_cast<uint32_t>(stream)) {}
+
+    // Draw number `index` of this stream; does not advance the counter.
+    uint64_t draw(uint64_t index) const
+    {
+        Philox4x32::Block ctr{{static_cast<uint32_t>(index >> 1), m_candidate, m_generation, m_stream}};
+        Philox4x32::Block out = Philox4x32::generate(ctr, m_seed);
+        // Each block yields two 64-bit draws.
+        uint32_t lo = out.v[(index & 1) * 2];
+        uint32_t hi = out.v[(index & 1) * 2 + 1];
+        return (uint64_t(hi) << 32) | lo;
+    }
+
+    uint64_t next()
+    {
+        uint64_t v;
+        if (m_counter & 1)
+        {
+            // Second half of the block computed for the previous even index.
+            v = m_pending;
+        }
+        else
+        {
+            Philox4x32::Block ctr{{static_cast<uint32_t>(m_counter >> 1), m_candidate, m_generation, m_stream}};
+            Philox4x32::Block out = Philox4x32::generate(ctr, m_seed);
+            v = (uint64_t(out.v[1]) << 32) | out.v[0];
+            m_pending = (uint64_t(out.v[3]) << 32) | out.v[2];
+        }
+        m_counter++;
+        return v;
+    }
+
+    // Uniform integer in [0, n) without modulo bias (Lemire's method).
+    uint64_t below(uint64_t n)
+    {
+        if (n <= 1)
+            return 0;
+        unsigned __int128 m = static_cast<unsigned __int128>(next()) * n;
+        uint64_t low = static_cast<uint64_t>(m);
+        if (low < n)
+        {
+            uint64_t threshold = (0 - n) % n;
+            while (low < threshold)
+            {
+                m = static_cast<unsigned __int128>(next()) * n;
+                low = static_cast<uint64_t>(m);
+            }
+        }
+        return static_cast<uint64_t>(m >> 64);
+    }
+
+    // Uniform double in [0, 1) with 53 random bits.
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    bool chance(double p) { return uniform() < p; }
+
+    // Number of draws consumed so far (for checkpointing / bisecting).
+    uint64_t counter() const { return m_counter; }
+    void seek(uint64_t counter)
+    {
+        m_counter = counter & ~uint64_t(1);
+        if (counter & 1)
+            next();
+    }
+
+    // UniformRandomBitGenerator, so <random> distributions also work.
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<uint64_t>::max(); }
+    result_type operator()() { return next(); }
+
+private:
+    uint64_t m_seed;
+    uint32_t m_generation;
+    uint32_t m_candidate;
+    uint32_t m_stream;
+    uint64_t m_counter = 0;
+    uint64_t m_pending = 0;
+};
@@ -0,0 +1,214 @@
+#include "thread_pool.hpp"
+
+namespace
+{
+    thread_local int t_workerId = -1;
+    thread_local const ThreadPool *t_pool = nullptr;
+}
+
+struct ThreadPool::Job
+{
+    const RangeFn *fn;
+    size_t grain;
+    std::atomic<size_t> remaining;
+    bool helping = false;  // the caller is a worker that runs ranges while it waits
+    bool finished = false; // guarded by mutex; the job lives on the caller's stack
+    bool pushed = false;   // guarded by mutex; a range was split off for the helper
+    std::mutex mutex;
+    std::condition_variable done;
+};
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+    m_size = threads;
+    for (unsigned i = 0; i < threads; i++)
+        m_queues.push_back(std::make_unique<Queue>());
+    m_threads.reserve(threads);
+    for (unsigned i = 0; i < threads; i++)
+        m_threads.emplace_back([this, i] { workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto &t : m_threads)
+        t.join();
+}
+
+int ThreadPool::currentWorker()
+{
+    return t_workerId;
+}
+
+void ThreadPool::push(unsigned id, const Range &r)
+{
+    // Counted under the queue lock, so the pop that takes this range (which
+    // needs the same lock) always decrements after the increment.
+    std::lock_guard<std::mutex> lock(m_queues[id]->mutex);
+    m_queued++;
+    m_queues[id]->ranges.push_back(r);
+}
+
+bool ThreadPool::takeFrom(Queue &q, const Job *job, Range &out)
+{
+    std::lock_guard<std::mutex> lock(q.mutex);
+    for (auto it = q.ranges.begin(); it != q.ranges.end(); ++it)
+    {
+        if (it->job == job)
+        {
+            out = *it;
+            q.ranges.erase(it);
+            m_queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::popOrSteal(unsigned id, Range &out)
+{
+    // Own work from the back (most recently split, cache-warm) ...
+    {
+        Queue &q = *m_queues[id];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.ranges.empty())
+        {
+            out = q.ranges.back();
+            q.ranges.pop_back();
+            m_queued--;
+            return true;
+        }
+    }
+    // ... then steal the oldest (largest) range from a sibling.
+    unsigned n = size();
+    for (unsigned k = 1; k < n; k++)
+    {
+        Queue &q = *m_queues[(id + k) % n];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.ranges.empty())
+        {
+            out = q.ranges.front();
+            q.ranges.pop_front();
+            m_queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runRange(unsigned id, Range r)
+{
+    Job *job = r.job;
+    // Split lazily so that thieves always find a large chunk to take.
+    while (r.end - r.begin > job->grain)
+    {
+        size_t mid = r.begin + (r.end - r.begin) / 2;
+        push(id, Range{mid, r.end, job});
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+        }
+        m_wake.notify_one();
+        if (job->helping)
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->pushed = true;
+            job->done.notify_all();
+        }
+        r.end = mid;
+    }
+    for (size_t i = r.begin; i < r.end; i++)
+        (*job->fn)(i, id);
+
+    size_t n = r.end - r.begin;
+    if (job->remaining.fetch_sub(n) == n)
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->finished = true;
+        job->done.notify_all();
+    }
+}
+
+void ThreadPool::workerLoop(unsigned id)
+{
+    t_workerId = static_cast<int>(id);
+    t_pool = this;
+    for (;;)
+    {
+        Range r;
+        if (popOrSteal(id, r))
+        {
+            runRange(id, r);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this] { return m_stop || m_queued.load() > 0; });
+        if (m_stop && m_queued.load() == 0)
+            return;
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const RangeFn &fn, size_t grain)
+{
+    if (count == 0)
+        return;
+    Job job;
+    job.fn = &fn;
+    job.grain = grain ? grain : 1;
+    job.remaining = count;
+    int self = t_pool == this ? t_workerId : -1;
+    job.helping = self >= 0;
+
+    // One contiguous slice per worker; stealing handles the imbalance.
+    unsigned n = size();
+    size_t per = (count + n - 1) / n;
+    for (unsigned w = 0; w < n; w++)
+    {
+        size_t begin = w * per;
+        if (begin >= count)
+            break;
+        size_t end = begin + per < count ? begin + per : count;
+        push(w, Range{begin, end, &job});
+    }
+    {
+        // Taken so a worker between its empty check and wait() cannot miss us.
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wake.notify_all();
+
+    if (!job.helping)
+    {
+        std::unique_lock<std::mutex> lock(job.mutex);
+        job.done.wait(lock, [&job] { return job.finished; });
+        return;
+    }
+
+    // Nested call: the other workers may all be blocked in nested calls of
+    // their own, so run this job's ranges here until none is left queued,
+    // then wait for the ones in flight (they may still split off more).
+    unsigned id = static_cast<unsigned>(self);
+    for (;;)
+    {
+        Range r;
+        bool found = false;
+        for (unsigned k = 0; k < n && !found; k++)
+            found = takeFrom(*m_queues[(id + k) % n], &job, r);
+        if (found)
+        {
+            runRange(id, r);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(job.mutex);
+        job.done.wait(lock, [&job] { return job.finished || job.pushed; });
+        if (job.finished)
+            return;
+        job.pushed = false;
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Work-stealing thread pool for data-parallel loops.
+//
+// parallelFor() seeds one range per worker; a worker that pops a range
+// larger than the grain keeps the lower half and pushes the upper half back
+// on its own deque, where idle workers can steal it. Uneven per-item cost
+// (fitness evaluations vary wildly between candidates) is therefore
+// rebalanced without a central queue.
+class ThreadPool
+{
+public:
+    using RangeFn = std::function<void(size_t index, unsigned worker)>;
+
+    // threads == 0 uses std::thread::hardware_concurrency().
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned size() const { return m_size; }
+
+    // Call fn(i, worker) for every i in [0, count) and block until all calls
+    // returned. `worker` is in [0, size()) and identifies the calling worker,
+    // so callers can index per-worker scratch state without locking.
+    //
+    // May be called from inside a task of this pool. The calling worker then
+    // runs ranges of the nested loop itself while it waits, instead of
+    // blocking on workers that may all be busy, so nesting cannot deadlock.
+    // It only takes ranges of its own loop, never unrelated tasks; but those
+    // ranges see the caller's worker index while the outer task on that
+    // worker is suspended, so the outer and inner fn must not share
+    // per-worker scratch.
+    void parallelFor(size_t count, const RangeFn &fn, size_t grain = 1);
+
+    // Worker index of the calling thread, or -1 outside the pool.
+    static int currentWorker();
+
+private:
+    struct Job;
+    struct Range
+    {
+        size_t begin;
+        size_t end;
+        Job *job;
+    };
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+
+    void workerLoop(unsigned id);
+    bool popOrSteal(unsigned id, Range &out);
+    bool takeFrom(Queue &q, const Job *job, Range &out);
+    void push(unsigned id, const Range &r);
+    void runRange(unsigned id, Range r);
+
+    unsigned m_size = 0;
+    std::vector<std::thread> m_threads;
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    std::atomic<size_t> m_queued{0}; // changed under the owning queue's mutex
+    bool m_stop = false;
+};
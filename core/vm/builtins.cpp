@@ -0,0 +1,237 @@
+#include "builtins.hpp"
+#include "../runtime/hash_map.hpp"
+#include "../runtime/vector_kernels.hpp"
+#include <algorithm>
+
+namespace
+{
+    bool argError(Builtin b, const Value &arg, std::string &err)
+    {
+        err = std::string(to_string(b)) + " of " + to_string(arg.kind());
+        return false;
+    }
+
+    bool keyError(Builtin b, const Value &key, std::string &err)
+    {
+        err = std::string(to_string(b)) + " with a " + (key.isNumber() ? "NaN" : to_string(key.kind())) + " key";
+        return false;
+    }
+
+    // A slice bound: fractions dropped, then clamped to [0, n].
+    size_t clampIndex(double x, size_t n)
+    {
+        return x > 0.0 ? (x < static_cast<double>(n) ? static_cast<size_t>(x) : n) : 0;
+    }
+}
+
+int builtinArity(Builtin b)
+{
+    switch (b)
+    {
+    case Builtin::Print:
+    case Builtin::Vec:
+    case Builtin::Seq: return -1;
+    case Builtin::Map: return 0;
+    case Builtin::Cplx:
+    case Builtin::Dot:
+    case Builtin::Get:
+    case Builtin::Has:
+    case Builtin::At: return 2;
+    case Builtin::Put:
+    case Builtin::Slice: return 3;
+    default: return 1;
+    }
+}
+
+DType builtinResult(Builtin b)
+{
+    switch (b)
+    {
+    case Builtin::Print:
+    case Builtin::Get:
+    case Builtin::At:
+    case Builtin::Slice: return DType::Unknown;
+    case Builtin::Vec: return DType::Vector;
+    case Builtin::Cplx: return DType::Complex;
+    case Builtin::Map:
+    case Builtin::Put: return DType::HashMap;
+    case Builtin::Has: return DType::Bool;
+    case Builtin::Seq: return DType::Sequence;
+    default: return DType::Number;
+    }
+}
+
+bool callBuiltin(Builtin b, Value *args, int argc, ValueHeap &heap, std::string &output, std::string &err)
+{
+    int arity = builtinArity(b);
+    if (arity >= 0 && argc != arity)
+    {
+        err = std::string(to_string(b)) + " expects " + std::to_string(arity) + " argument" + (arity == 1 ? "" : "s") +
+              ", got " + std::to_string(argc);
+        return false;
+    }
+    switch (b)
+    {
+    case Builtin::Print:
+        for (int i = 0; i < argc; i++)
+        {
+            if (i)
+                output += ' ';
+            output += formatValue(args[i]);
+        }
+        output += '\n';
+        args[0] = Value();
+        return true;
+    case Builtin::Len:
+        if (args[0].isText())
+            args[0] = Value::number(static_cast<double>(args[0].text().size()));
+        else if (args[0].isVector())
+            args[0] = Value::number(static_cast<double>(args[0].vector().size));
+        else if (args[0].isSequence())
+            args[0] = Value::number(static_cast<double>(args[0].sequence().size));
+        else if (args[0].isMap())
+            args[0] = Value::number(static_cast<double>(args[0].map().size));
+        else
+            return argError(b, args[0], err);
+        return true;
+    case Builtin::Vec:
+    {
+        for (int i = 0; i < argc; i++)
+            if (!args[i].isNumber())
+                return argError(b, args[i], err);
+        double *data;
+        Value v = heap.vector(static_cast<size_t>(argc), data);
+        for (int i = 0; i < argc; i++)
+            data[i] = args[i].num();
+        args[0] = v;
+        return true;
+    }
+    case Builtin::Cplx:
+        for (int i = 0; i < 2; i++)
+            if (!args[i].isNumber())
+                return argError(b, args[i], err);
+        args[0] = heap.complex({args[0].num(), args[1].num()});
+        return true;
+    case Builtin::Dot:
+    {
+        for (int i = 0; i < 2; i++)
+            if (!args[i].isVector())
+                return argError(b, args[i], err);
+        const NumVector &x = args[0].vector(), &y = args[1].vector();
+        if (x.size != y.size)
+        {
+            err = "vector sizes differ: " + std::to_string(x.size) + " and " + std::to_string(y.size);
+            return false;
+        }
+        args[0] = Value::number(vecDot(x.data, y.data, x.size));
+        return true;
+    }
+    case Builtin::Sum:
+    case Builtin::Min:
+    case Builtin::Max:
+    {
+        if (!args[0].isVector())
+            return argError(b, args[0], err);
+        const NumVector &x = args[0].vector();
+        if (b == Builtin::Sum)
+            args[0] = Value::number(vecSum(x.data, x.size));
+        else if (x.size == 0)
+        {
+            err = std::string(to_string(b)) + " of an empty vector";
+            return false;
+        }
+        else
+            args[0] = Value::number(b == Builtin::Min ? vecMin(x.data, x.size) : vecMax(x.data, x.size));
+        return true;
+    }
+    case Builtin::Re:
+    case Builtin::Im:
+        // A number is a complex number with no imaginary part.
+        if (args[0].isComplex())
+            args[0] = Value::number(b == Builtin::Re ? args[0].complex().real() : args[0].complex().imag());
+        else if (args[0].isNumber())
+            args[0] = Value::number(b == Builtin::Re ? args[0].num() : 0.0);
+        else
+            return argError(b, args[0], err);
+        return true;
+    case Builtin::Map:
+        args[0] = heap.map();
+        return true;
+    case Builtin::Put:
+    case Builtin::Get:
+    case Builtin::Has:
+    {
+        if (!args[0].isMap())
+            return argError(b, args[0], err);
+        if (!hashableKey(args[1]))
+            return keyError(b, args[1], err);
+        HashMap &m = args[0].map();
+        if (b == Builtin::Put)
+        {
+            // See HashMap: a map holds no map.
+            if (args[2].isMap())
+                return argError(b, args[2], err);
+            mapPut(m, args[1], args[2], heap);
+        }
+        else
+        {
+            const Value *v = mapFind(m, args[1]);
+            args[0] = b == Builtin::Has ? Value::fromBool(v != nullptr) : v ? *v : Value();
+        }
+        return true;
+    }
+    case Builtin::Seq:
+    {
+        uint8_t depth = 0;
+        for (int i = 0; i < argc; i++)
+        {
+            if (args[i].isMap())
+                return argError(b, args[i], err);
+            if (args[i].isSequence())
+                depth = std::max(depth, args[i].sequence().depth);
+        }
+        if (depth >= Sequence::kMaxNesting)
+        {
+            err = "sequences nested more than " + std::to_string(Sequence::kMaxNesting) + " deep";
+            return false;
+        }
+        Value *items;
+        Value s = heap.sequence(static_cast<size_t>(argc), depth + 1, items);
+        std::copy(args, args + argc, items);
+        args[0] = s;
+        return true;
+    }
+    case Builtin::At:
+    {
+        if (!args[0].isSequence())
+            return argError(b, args[0], err);
+        if (!args[1].isNumber())
+            return argError(b, args[1], err);
+        const Sequence &s = args[0].sequence();
+        double i = args[1].num();
+        if (!(i >= 0.0 && i < static_cast<double>(s.size)))
+        {
+            err = "at index " + formatValue(args[1]) + " out of range for " + std::to_string(s.size) + " items";
+            return false;
+        }
+        args[0] = s.items[static_cast<size_t>(i)];
+        return true;
+    }
+    case Builtin::Slice:
+    {
+        if (!args[0].isText() && !args[0].isSequence())
+            return argError(b, args[0], err);
+        for (int i = 1; i < 3; i++)
+            if (!args[i].isNumber())
+                return argError(b, args[i], err);
+        size_t n = args[0].isText() ? args[0].text().size() : args[0].sequence().size;
+        size_t start = clampIndex(args[1].num(), n);
+        size_t count = std::min(clampIndex(args[2].num(), n), n - start);
+        args[0] = heap.slice(args[0], start, count);
+        return true;
+    }
+    default:
+        err = "unknown builtin";
+        return false;
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "../runtime/value.hpp"
+#include "../semantic/dtype.hpp"
+#include "bytecode.hpp"
+#include <string>
+
+//////////////////////////////////////////////////////////////////////////
+// The builtins, shared by the VM and the tree walker so both give the same
+// values and errors.
+
+// Number of arguments, -1 for print, vec and seq (any number).
+int builtinArity(Builtin b);
+// Static type of the result; Unknown for print (nil) and for the ones
+// that give back an element.
+DType builtinResult(Builtin b);
+
+// Calls `b` on args[0..argc) and leaves the result in args[0], which must
+// exist even when argc is 0. print appends to `output`; new objects come
+// from `heap`, and put() grows its map there.
+bool callBuiltin(Builtin b, Value *args, int argc, ValueHeap &heap, std::string &output, std::string &err);
@@ -0,0 +1,103 @@
+#include "bytecode.hpp"
+#include <cstdio>
+
+const char *to_string(OpCode op)
+{
+    static const char *const names[] = {
+#define MUTAGEN_OPCODE_NAME(name) #name,
+        MUTAGEN_OPCODES(MUTAGEN_OPCODE_NAME)
+#undef MUTAGEN_OPCODE_NAME
+    };
+    return op < OpCode::COUNT ? names[static_cast<int>(op)] : "?";
+}
+
+const char *to_string(Builtin b)
+{
+    switch (b)
+    {
+    case Builtin::Print: return "print";
+    case Builtin::Len: return "len";
+    case Builtin::Vec: return "vec";
+    case Builtin::Cplx: return "cplx";
+    case Builtin::Dot: return "dot";
+    case Builtin::Sum: return "sum";
+    case Builtin::Min: return "min";
+    case Builtin::Max: return "max";
+    case Builtin::Re: return "re";
+    case Builtin::Im: return "im";
+    case Builtin::Map: return "map";
+    case Builtin::Put: return "put";
+    case Builtin::Get: return "get";
+    case Builtin::Has: return "has";
+    case Builtin::Seq: return "seq";
+    case Builtin::At: return "at";
+    case Builtin::Slice: return "slice";
+    default: return "?";
+    }
+}
+
+Builtin builtinFromName(const std::string &name)
+{
+    for (int b = 0; b < static_cast<int>(Builtin::COUNT); b++)
+        if (name == to_string(static_cast<Builtin>(b)))
+            return static_cast<Builtin>(b);
+    return Builtin::COUNT;
+}
+
+int Module::find(const std::string &name) const
+{
+    for (size_t i = 0; i < functions.size(); i++)
+        if (functions[i].name == name)
+            return static_cast<int>(i);
+    return -1;
+}
+
+std::string disassemble(const FunctionProto &fn)
+{
+    std::string out = fn.name + " (params " + std::to_string(fn.numParams) + ", regs " +
+                      std::to_string(fn.numRegs) + ")\n";
+    char line[96];
+    for (size_t pc = 0; pc < fn.code.size(); pc++)
+    {
+        Instr i = fn.code[pc];
+        OpCode op = decodeOp(i);
+        int a = decodeA(i);
+        switch (op)
+        {
+        case OpCode::LOADK:
+            std::snprintf(line, sizeof(line), "%4zu  %-11s %d K%d", pc, to_string(op), a, decodeBx(i));
+            out += line;
+            out += "  ; " + formatValue(fn.constants[decodeBx(i)]);
+            break;
+        case OpCode::GETGLOBAL:
+        case OpCode::SETGLOBAL:
+        case OpCode::CALL:
+            std::snprintf(line, sizeof(line), "%4zu  %-11s %d %d", pc, to_string(op), a, decodeBx(i));
+            out += line;
+            break;
+        case OpCode::JMP:
+        case OpCode::LOOP:
+        case OpCode::JMPIF:
+        case OpCode::JMPIFNOT:
+        case OpCode::ITERNEXT:
+            std::snprintf(line, sizeof(line), "%4zu  %-11s %d -> %d", pc, to_string(op), a,
+                          static_cast<int>(pc) + 1 + decodeSBx(i));
+            out += line;
+            break;
+        default:
+            std::snprintf(line, sizeof(line), "%4zu  %-11s %d %d %d", pc, to_string(op), a, decodeB(i), decodeC(i));
+            out += line;
+            break;
+        }
+        out += '\n';
+    }
+    return out;
+}
+
+std::string disassemble(const Module &module)
+{
+    std::string out;
+    for (const auto &fn : module.functions)
+        out += disassemble(fn) + '\n';
+    return out;
+}
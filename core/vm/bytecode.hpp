@@ -0,0 +1,178 @@
+#pragma once
+#include "../runtime/value.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Register bytecode for Genex.
+//
+// Every instruction is one 32-bit word: an 8-bit opcode and an 8-bit A
+// operand, followed by either two 8-bit operands B and C or one 16-bit
+// operand Bx (unsigned) / sBx (signed jump offset, relative to the next
+// instruction). R[n] is register n of the current frame, K[n] a constant
+// of the current function, G[n] a module global.
+//
+//   MOVE      A B     R[A] = R[B]
+//   LOADK     A Bx    R[A] = K[Bx]
+//   LOADBOOL  A B     R[A] = (B != 0)
+//   LOADNIL   A       R[A] = nil
+//   GETGLOBAL A Bx    R[A] = G[Bx]
+//   SETGLOBAL A Bx    G[Bx] = R[A]
+//   ADD..GE   A B C   R[A] = R[B] op R[C]
+//   NOT       A B     R[A] = !truthy(R[B])
+//   NEG/POS   A B     R[A] = -R[B] / +R[B] (numbers only)
+//   BOOL      A B     R[A] = truthy(R[B])
+//   JMP         sBx   pc += sBx (forward)
+//   LOOP        sBx   pc += sBx (backward); charges -sBx steps
+//   JMPIF     A sBx   if truthy(R[A]) pc += sBx
+//   JMPIFNOT  A sBx   if !truthy(R[A]) pc += sBx
+//   CALL      A Bx    R[A] = functions[Bx](R[A], R[A+1], ...)
+//   CALLB     A B C   R[A] = builtin B applied to R[A .. A+C-1]
+//   RET       A B     return B ? R[A] : nil
+//   ITERPREP  A       check R[A] is iterable, R[A+1] = 0
+//   ITERNEXT  A sBx   if R[A+1] < len(R[A]) then R[A+2] = R[A][R[A+1]++]
+//                     else pc += sBx
+//
+//   ADD_NUM     A B C R[A] = R[B] + R[C], both numbers       (quickened ADD)
+//   CONCAT_TEXT A B C R[A] = R[B] .. R[C], either one text   (quickened ADD)
+//   ADD_ANY     A B C R[A] = R[B] + R[C], never requickened  (deoptimised ADD)
+//
+// A call frame starts at the caller's register A, so arguments are passed
+// in place and the callee's result lands where the caller expects it.
+//
+// `+` is the one operator whose meaning depends on the operand kinds, so
+// its sites are specialised (quickened). The compiler emits ADD_NUM or
+// CONCAT_TEXT where the declared dtypes say what the operands are, and
+// plain ADD elsewhere; the VM rewrites an ADD into the specialisation for
+// the kinds it sees on its first execution. The specialised forms keep a
+// guard, because declared dtypes are not enforced at runtime: on a miss
+// the site is rewritten to ADD_ANY and stays generic. The quickened forms
+// are numbered after the base set, so ADD..GE stay contiguous with BinOp.
+
+#define MUTAGEN_OPCODES(X) \
+    X(MOVE)                \
+    X(LOADK)               \
+    X(LOADBOOL)            \
+    X(LOADNIL)             \
+    X(GETGLOBAL)           \
+    X(SETGLOBAL)           \
+    X(ADD)                 \
+    X(SUB)                 \
+    X(MUL)                 \
+    X(DIV)                 \
+    X(MOD)                 \
+    X(EQ)                  \
+    X(NE)                  \
+    X(LT)                  \
+    X(LE)                  \
+    X(GT)                  \
+    X(GE)                  \
+    X(NOT)                 \
+    X(NEG)                 \
+    X(POS)                 \
+    X(BOOL)                \
+    X(JMP)                 \
+    X(LOOP)                \
+    X(JMPIF)               \
+    X(JMPIFNOT)            \
+    X(CALL)                \
+    X(CALLB)               \
+    X(RET)                 \
+    X(ITERPREP)            \
+    X(ITERNEXT)            \
+    X(ADD_NUM)             \
+    X(CONCAT_TEXT)         \
+    X(ADD_ANY)
+
+enum class OpCode : uint8_t
+{
+#define MUTAGEN_OPCODE_ENUM(name) name,
+    MUTAGEN_OPCODES(MUTAGEN_OPCODE_ENUM)
+#undef MUTAGEN_OPCODE_ENUM
+    COUNT
+};
+
+const char *to_string(OpCode op);
+
+using Instr = uint32_t;
+
+constexpr int kMaxRegisters = 255;
+constexpr int kMaxBx = 0xFFFF;
+constexpr int kSBxBias = 0x7FFF;
+
+inline Instr encodeABC(OpCode op, int a, int b = 0, int c = 0)
+{
+    return static_cast<Instr>(op) | static_cast<Instr>(a) << 8 | static_cast<Instr>(b) << 16 |
+           static_cast<Instr>(c) << 24;
+}
+inline Instr encodeABx(OpCode op, int a, int bx)
+{
+    return static_cast<Instr>(op) | static_cast<Instr>(a) << 8 | static_cast<Instr>(bx) << 16;
+}
+inline Instr encodeAsBx(OpCode op, int a, int sbx) { return encodeABx(op, a, sbx + kSBxBias); }
+
+inline OpCode decodeOp(Instr i) { return static_cast<OpCode>(i & 0xFF); }
+inline int decodeA(Instr i) { return (i >> 8) & 0xFF; }
+inline int decodeB(Instr i) { return (i >> 16) & 0xFF; }
+inline int decodeC(Instr i) { return i >> 24; }
+inline int decodeBx(Instr i) { return i >> 16; }
+inline int decodeSBx(Instr i) { return static_cast<int>(i >> 16) - kSBxBias; }
+inline Instr replaceOp(Instr i, OpCode op) { return (i & ~Instr(0xFF)) | static_cast<Instr>(op); }
+
+// The unspecialised opcode of a quickened one (ADD for the ADD family).
+inline OpCode baseOp(OpCode op) { return op >= OpCode::ADD_NUM && op <= OpCode::ADD_ANY ? OpCode::ADD : op; }
+
+enum class Builtin : uint8_t
+{
+    Print, // print(args...): writes the values space-separated plus newline
+    Len,   // len(text, vector, sequence or map): character, element or key count
+    Vec,   // vec(numbers...): a vector of the arguments
+    Cplx,  // cplx(re, im): a complex number
+    Dot,   // dot(vector, vector): inner product
+    Sum,   // sum(vector)
+    Min,   // min(vector), non-empty
+    Max,   // max(vector), non-empty
+    Re,    // re(complex or number)
+    Im,    // im(complex or number)
+    Map,   // map(): a new, empty map
+    Put,   // put(map, key, value): stores value under key, gives the map
+    Get,   // get(map, key): the value under key, nil if none
+    Has,   // has(map, key)
+    Seq,   // seq(values...): a sequence of the arguments
+    At,    // at(sequence, index)
+    Slice, // slice(text or sequence, start, count), clamped to its length
+    COUNT
+};
+
+const char *to_string(Builtin b);
+// Builtin::COUNT when `name` is not a builtin.
+Builtin builtinFromName(const std::string &name);
+
+struct FunctionProto
+{
+    std::string name;
+    int numParams = 0;
+    int numRegs = 0; // frame size, parameters included
+    // Quickening rewrites `+` sites in place, even through a const Module;
+    // a Module must therefore not be run by two VMs at the same time.
+    mutable std::vector<Instr> code;
+    std::vector<Value> constants;
+};
+
+struct Module
+{
+    std::vector<FunctionProto> functions;
+    std::vector<std::string> globalNames;
+    // Backing store for text, complex and vector constants.
+    ValueHeap strings;
+    // Function that initialises the globals, or -1 when there are none.
+    int initFunction = -1;
+
+    // Index of the named function, or -1.
+    int find(const std::string &name) const;
+};
+
+// Human-readable listing, one instruction per line.
+std::string disassemble(const FunctionProto &fn);
+std::string disassemble(const Module &module);
@@ -0,0 +1,666 @@
+#include "compiler.hpp"
+#include "builtins.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Constants are shared only when identical to the bit: valuesEqual()
+    // takes -0 for 0, which 1 / k tells apart.
+    bool sameConstant(const Value &a, const Value &b)
+    {
+        if (a.kind() != b.kind())
+            return false;
+        switch (a.kind())
+        {
+        case ValueKind::Text: return a.text() == b.text();
+        case ValueKind::Complex: return std::memcmp(&a.complex(), &b.complex(), sizeof(std::complex<double>)) == 0;
+        case ValueKind::Vector:
+            return a.vector().size == b.vector().size &&
+                   std::memcmp(a.vector().data, b.vector().data, a.vector().size * sizeof(double)) == 0;
+        default: return a.bits() == b.bits();
+        }
+    }
+
+    bool isAssignment(const Expr *e)
+    {
+        auto b = dynamic_cast<const BinaryExpr *>(e);
+        return b && b->op == "=";
+    }
+
+    // True when evaluating `e` may write a local (only assignments can).
+    bool hasAssignment(const Expr *e)
+    {
+        if (!e)
+            return false;
+        if (auto b = dynamic_cast<const BinaryExpr *>(e))
+            return b->op == "=" || hasAssignment(b->left.get()) || hasAssignment(b->right.get());
+        if (auto u = dynamic_cast<const UnaryExpr *>(e))
+            return hasAssignment(u->right.get());
+        if (auto c = dynamic_cast<const CallExpr *>(e))
+        {
+            for (const auto &a : c->args)
+                if (hasAssignment(a.get()))
+                    return true;
+        }
+        return false;
+    }
+
+    OpCode binaryOpcode(BinOp op)
+    {
+        switch (op)
+        {
+        case BinOp::Add: return OpCode::ADD;
+        case BinOp::Sub: return OpCode::SUB;
+        case BinOp::Mul: return OpCode::MUL;
+        case BinOp::Div: return OpCode::DIV;
+        case BinOp::Mod: return OpCode::MOD;
+        case BinOp::Eq: return OpCode::EQ;
+        case BinOp::Ne: return OpCode::NE;
+        case BinOp::Lt: return OpCode::LT;
+        case BinOp::Le: return OpCode::LE;
+        case BinOp::Gt: return OpCode::GT;
+        default: return OpCode::GE;
+        }
+    }
+}
+
+std::unique_ptr<Module> BytecodeCompiler::compile(const Program &prog)
+{
+    auto module = std::make_unique<Module>();
+    m_module = module.get();
+    m_errors.clear();
+
+    // Every function and global is visible from every body, so number them
+    // before compiling anything. The first definition with a body wins over
+    // prototypes and later duplicates.
+    m_resolver.begin(prog);
+    for (const auto &d : prog.decls)
+        if (auto b = dynamic_cast<const BlockDecl *>(d.get()); b && !b->fields.empty())
+            error("Block fields are not supported at runtime (block '" + b->name + "')");
+    for (const VarDecl *g : m_resolver.globals())
+        m_module->globalNames.push_back(g->varName);
+
+    const auto &decls = m_resolver.functions();
+    m_module->functions.resize(decls.size());
+    for (size_t i = 0; i < decls.size(); i++)
+        compileFunction(*decls[i], m_module->functions[i]);
+
+    if (!prog.globalVars.empty() || !prog.globalExprs.empty())
+    {
+        m_module->initFunction = static_cast<int>(m_module->functions.size());
+        m_module->functions.emplace_back();
+        compileInit(prog, m_module->functions.back());
+    }
+
+    m_module = nullptr;
+    if (!m_errors.empty())
+        return nullptr;
+    return module;
+}
+
+void BytecodeCompiler::beginFunction(FunctionProto &proto)
+{
+    m_fn = &proto;
+    m_locals.clear();
+    m_slotRegs.clear();
+    m_slotTypes.clear();
+    m_scopes.clear();
+    m_top = 0;
+}
+
+void BytecodeCompiler::endFunction()
+{
+    emit(encodeABC(OpCode::RET, 0, 0));
+    m_fn->numRegs = std::max(m_fn->numRegs, 1);
+    m_fn = nullptr;
+}
+
+void BytecodeCompiler::compileFunction(const FuncDecl &f, FunctionProto &proto)
+{
+    proto.name = f.name;
+    proto.numParams = static_cast<int>(f.params.size());
+    beginFunction(proto);
+    m_resolver.beginFunction(f);
+    for (uint32_t i = 0; i < f.params.size(); i++)
+        declare(i, allocReg(), dtypeFromName(f.params[i].first));
+    if (f.body)
+        block(*f.body);
+    m_resolver.endFunction(f);
+    endFunction();
+}
+
+void BytecodeCompiler::compileInit(const Program &prog, FunctionProto &proto)
+{
+    proto.name = "<init>";
+    beginFunction(proto);
+    for (const auto &g : prog.globalVars)
+    {
+        int top = m_top;
+        int r = allocReg();
+        if (g->initValue)
+            exprTo(g->initValue->get(), r);
+        else
+            emit(encodeABC(OpCode::LOADNIL, r));
+        emit(encodeABx(OpCode::SETGLOBAL, r, static_cast<int>(g->slot)));
+        m_top = top;
+    }
+    for (const auto &e : prog.globalExprs)
+    {
+        int top = m_top;
+        effect(e.get());
+        m_top = top;
+    }
+    endFunction();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Statements
+
+void BytecodeCompiler::statement(const Stmt *s)
+{
+    int top = m_top;
+    if (auto v = dynamic_cast<const VarDecl *>(s))
+    {
+        varDecl(*v); // keeps its register
+        return;
+    }
+    if (auto e = dynamic_cast<const ExprStmt *>(s))
+        effect(e->expr.get());
+    else if (auto r = dynamic_cast<const ReturnStmt *>(s))
+        returnStmt(*r);
+    else if (auto i = dynamic_cast<const IfStmt *>(s))
+        ifStmt(*i);
+    else if (auto w = dynamic_cast<const WhileStmt *>(s))
+        whileStmt(*w);
+    else if (auto l = dynamic_cast<const LoopStmt *>(s))
+        loopStmt(*l);
+    else if (auto it = dynamic_cast<const IterStmt *>(s))
+        iterStmt(*it);
+    else if (s)
+        error("Unsupported statement in function '" + m_fn->name + "'");
+    m_top = top;
+}
+
+void BytecodeCompiler::block(const Block &b)
+{
+    beginScope();
+    for (const auto &s : b)
+        statement(s.get());
+    endScope();
+}
+
+void BytecodeCompiler::varDecl(const VarDecl &v)
+{
+    // The name is bound after the initialiser, which still sees any outer
+    // variable of the same name.
+    int r = allocReg();
+    if (v.initValue)
+        exprTo(v.initValue->get(), r);
+    else
+        emit(encodeABC(OpCode::LOADNIL, r));
+    m_top = r + 1;
+    v.slot = m_resolver.declare(v.varName);
+    declare(v.slot, r, dtypeFromName(v.typeName));
+}
+
+void BytecodeCompiler::ifStmt(const IfStmt &s)
+{
+    std::vector<int> exits;
+    bool more = s.elseIfs.has_value() || s.elseBlock.has_value();
+    int next = jumpIfFalse(s.ifBlock.first.get());
+    block(s.ifBlock.second);
+    if (more)
+        exits.push_back(emitJump(OpCode::JMP, 0));
+    patchJump(next);
+
+    if (s.elseIfs)
+    {
+        for (size_t i = 0; i < s.elseIfs->size(); i++)
+        {
+            const auto &branch = (*s.elseIfs)[i];
+            next = jumpIfFalse(branch.first.get());
+            block(branch.second);
+            if (i + 1 < s.elseIfs->size() || s.elseBlock)
+                exits.push_back(emitJump(OpCode::JMP, 0));
+            patchJump(next);
+        }
+    }
+    if (s.elseBlock)
+        block(*s.elseBlock);
+    for (int j : exits)
+        patchJump(j);
+}
+
+void BytecodeCompiler::whileStmt(const WhileStmt &s)
+{
+    int head = static_cast<int>(m_fn->code.size());
+    int exit = jumpIfFalse(s.condition.get());
+    block(s.body);
+    jumpBack(head);
+    patchJump(exit);
+}
+
+void BytecodeCompiler::loopStmt(const LoopStmt &s)
+{
+    // loop(init, cond, step) { body } == init; while (cond) { body; step }
+    // With a dtype the init assignment declares a loop-scoped variable.
+    beginScope();
+    if (auto init = dynamic_cast<const ExprStmt *>(s.init.get()); init && s.dtype && isAssignment(init->expr.get()))
+    {
+        auto b = static_cast<const BinaryExpr *>(init->expr.get());
+        if (auto id = dynamic_cast<const IdentifierExpr *>(b->left.get()))
+        {
+            int r = allocReg();
+            exprTo(b->right.get(), r);
+            m_top = r + 1;
+            id->ref = SymbolRef{SymbolKind::Local, m_resolver.declare(id->name)};
+            declare(id->ref.slot, r, dtypeFromName(*s.dtype));
+        }
+        else
+        {
+            statement(init);
+        }
+    }
+    else if (s.init)
+    {
+        statement(s.init.get());
+    }
+
+    int head = static_cast<int>(m_fn->code.size());
+    int exit = jumpIfFalse(s.condition.get());
+    block(s.body);
+    if (s.step)
+        statement(s.step.get());
+    jumpBack(head);
+    patchJump(exit);
+    endScope();
+}
+
+void BytecodeCompiler::iterStmt(const IterStmt &s)
+{
+    // Three consecutive registers: the sequence, the position and the
+    // current element (the loop variable).
+    beginScope();
+    int base = allocReg();
+    allocReg();
+    allocReg();
+    DType t = exprTo(s.iterable.get(), base);
+    emit(encodeABC(OpCode::ITERPREP, base));
+    int head = static_cast<int>(m_fn->code.size());
+    int exit = emitJump(OpCode::ITERNEXT, base);
+    s.slot = m_resolver.declare(s.varName);
+    // Text yields one-character texts, a vector its elements, a number the
+    // counts 0..n-1.
+    declare(s.slot, base + 2,
+            t == DType::Text                            ? DType::Text
+            : isNumeric(t) || t == DType::Vector ? DType::Number
+                                                        : DType::Unknown);
+    block(s.body);
+    jumpBack(head);
+    patchJump(exit);
+    endScope();
+}
+
+void BytecodeCompiler::returnStmt(const ReturnStmt &s)
+{
+    if (s.value && *s.value)
+        emit(encodeABC(OpCode::RET, exprReg(s.value->get()), 1));
+    else
+        emit(encodeABC(OpCode::RET, 0, 0));
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Expressions
+
+void BytecodeCompiler::effect(const Expr *e)
+{
+    if (auto b = dynamic_cast<const BinaryExpr *>(e); b && b->op == "=")
+        assign(*b, -1);
+    else if (auto c = dynamic_cast<const CallExpr *>(e))
+        call(*c, -1);
+    else if (e)
+        exprTo(e, allocReg()); // still evaluated: it may fail at runtime
+}
+
+int BytecodeCompiler::exprReg(const Expr *e, bool forceTemp, DType *type)
+{
+    if (auto id = dynamic_cast<const IdentifierExpr *>(e); id && !forceTemp)
+    {
+        int r = localReg(*id);
+        if (r >= 0)
+        {
+            if (type)
+                *type = nameType(*id);
+            return r;
+        }
+    }
+    int t = allocReg();
+    DType dt = exprTo(e, t);
+    if (type)
+        *type = dt;
+    return t;
+}
+
+DType BytecodeCompiler::exprTo(const Expr *e, int dst)
+{
+    if (!e)
+    {
+        emit(encodeABC(OpCode::LOADNIL, dst));
+        return DType::Unknown;
+    }
+    if (auto lit = dynamic_cast<const LiteralExpr *>(e))
+    {
+        literal(*lit, dst);
+        return dtypeOfLiteral(lit->litType);
+    }
+    if (auto id = dynamic_cast<const IdentifierExpr *>(e))
+    {
+        int r = localReg(*id);
+        if (r >= 0)
+        {
+            if (r != dst)
+                emit(encodeABC(OpCode::MOVE, dst, r));
+        }
+        else if (id->ref.kind == SymbolKind::Global)
+            emit(encodeABx(OpCode::GETGLOBAL, dst, static_cast<int>(id->ref.slot)));
+        else
+            error("Undefined name '" + id->name + "' in function '" + m_fn->name + "'");
+        return nameType(*id);
+    }
+    if (auto u = dynamic_cast<const UnaryExpr *>(e))
+    {
+        int top = m_top;
+        int r = exprReg(u->right.get());
+        OpCode op = u->op == "!" ? OpCode::NOT : u->op == "-" ? OpCode::NEG : OpCode::POS;
+        emit(encodeABC(op, dst, r));
+        m_top = top;
+        return op == OpCode::NOT ? DType::Bool : DType::Number;
+    }
+    if (auto b = dynamic_cast<const BinaryExpr *>(e))
+    {
+        if (b->op == "=")
+            return assign(*b, dst);
+        if (b->op == "&&" || b->op == "||")
+        {
+            logical(*b, dst);
+            return DType::Bool;
+        }
+        BinOp op = binOpFromLexeme(b->op);
+        if (op == BinOp::Invalid)
+        {
+            error("Unknown operator '" + b->op + "' in function '" + m_fn->name + "'");
+            return DType::Unknown;
+        }
+        // A local read on the left must be copied if the right-hand side
+        // can reassign it, to keep left-to-right evaluation.
+        int top = m_top;
+        DType lt = DType::Unknown, rt = DType::Unknown;
+        int l = exprReg(b->left.get(), hasAssignment(b->right.get()), &lt);
+        int r = exprReg(b->right.get(), false, &rt);
+        OpCode code = binaryOpcode(op);
+        // Comparisons and % have a single result kind when they succeed;
+        // arithmetic follows vector and complex operands.
+        DType type = op >= BinOp::Eq ? DType::Bool : op == BinOp::Mod ? DType::Number : arithmeticType(lt, rt);
+        if (op == BinOp::Add)
+        {
+            if (isNumeric(lt) && isNumeric(rt))
+                code = OpCode::ADD_NUM;
+            else if (lt == DType::Text || rt == DType::Text)
+            {
+                code = OpCode::CONCAT_TEXT;
+                type = DType::Text;
+            }
+            else if (lt == DType::Sequence && rt == DType::Sequence)
+                type = DType::Sequence;
+        }
+        emit(encodeABC(code, dst, l, r));
+        m_top = top;
+        return type;
+    }
+    if (auto c = dynamic_cast<const CallExpr *>(e))
+        return call(*c, dst);
+    error("Unsupported expression in function '" + m_fn->name + "'");
+    return DType::Unknown;
+}
+
+void BytecodeCompiler::literal(const LiteralExpr &lit, int dst)
+{
+    Value v;
+    if (!literalValue(lit.value, lit.litType, m_module->strings, v))
+    {
+        error(std::string("Unsupported literal '") + lit.value + "' (" + to_string(lit.litType) + ")");
+        return;
+    }
+    if (v.kind() == ValueKind::Bool)
+        emit(encodeABC(OpCode::LOADBOOL, dst, v.boolean() ? 1 : 0));
+    else
+        emit(encodeABx(OpCode::LOADK, dst, constant(v)));
+}
+
+DType BytecodeCompiler::assign(const BinaryExpr &b, int dst)
+{
+    auto id = dynamic_cast<const IdentifierExpr *>(b.left.get());
+    if (!id)
+    {
+        error("Invalid assignment target in function '" + m_fn->name + "'");
+        return DType::Unknown;
+    }
+    int r = localReg(*id);
+    if (r >= 0)
+    {
+        DType t = exprTo(b.right.get(), r);
+        if (dst >= 0 && dst != r)
+            emit(encodeABC(OpCode::MOVE, dst, r));
+        return t;
+    }
+    if (id->ref.kind != SymbolKind::Global)
+    {
+        error("Assignment to undeclared name '" + id->name + "' in function '" + m_fn->name + "'");
+        return DType::Unknown;
+    }
+    int top = m_top;
+    int t = dst >= 0 ? dst : allocReg();
+    DType type = exprTo(b.right.get(), t);
+    emit(encodeABx(OpCode::SETGLOBAL, t, static_cast<int>(id->ref.slot)));
+    m_top = top;
+    return type;
+}
+
+void BytecodeCompiler::logical(const BinaryExpr &b, int dst)
+{
+    // The left operand is written to the target before the right one is
+    // read, so a named target goes through a temporary.
+    int top = m_top;
+    int t = isLocalReg(dst) ? allocReg() : dst;
+    exprTo(b.left.get(), t);
+    emit(encodeABC(OpCode::BOOL, t, t));
+    int skip = emitJump(b.op == "&&" ? OpCode::JMPIFNOT : OpCode::JMPIF, t);
+    exprTo(b.right.get(), t);
+    emit(encodeABC(OpCode::BOOL, t, t));
+    patchJump(skip);
+    if (t != dst)
+        emit(encodeABC(OpCode::MOVE, dst, t));
+    m_top = top;
+}
+
+DType BytecodeCompiler::call(const CallExpr &c, int dst)
+{
+    auto id = dynamic_cast<const IdentifierExpr *>(c.callee.get());
+    if (!id)
+    {
+        error("Only named functions can be called (in function '" + m_fn->name + "')");
+        return DType::Unknown;
+    }
+
+    // Arguments are evaluated into consecutive registers, which become the
+    // callee's parameters; the result comes back in the first of them.
+    int top = m_top;
+    int base = m_top;
+    for (const auto &a : c.args)
+        exprTo(a.get(), allocReg());
+    if (c.args.empty())
+        allocReg();
+
+    m_resolver.bindCallee(*id);
+    if (id->ref.kind == SymbolKind::Function)
+    {
+        const FuncDecl *decl = m_resolver.functions()[id->ref.slot];
+        if (!decl->body)
+            error("Function '" + id->name + "' is declared but never defined");
+        else if (decl->params.size() != c.args.size())
+            error("Function '" + id->name + "' expects " + std::to_string(decl->params.size()) + " arguments, got " +
+                  std::to_string(c.args.size()));
+        emit(encodeABx(OpCode::CALL, base, static_cast<int>(id->ref.slot)));
+    }
+    else if (id->ref.kind == SymbolKind::Builtin)
+    {
+        Builtin builtin = static_cast<Builtin>(id->ref.slot);
+        int arity = builtinArity(builtin);
+        if (arity >= 0 && c.args.size() != static_cast<size_t>(arity))
+            error(std::string(to_string(builtin)) + " expects " + std::to_string(arity) + " argument" +
+                  (arity == 1 ? "" : "s") + ", got " + std::to_string(c.args.size()));
+        if (c.args.size() > kMaxRegisters)
+            error(std::string("Too many arguments to ") + to_string(builtin));
+        emit(encodeABC(OpCode::CALLB, base, static_cast<int>(builtin), static_cast<int>(c.args.size())));
+    }
+    else
+    {
+        error("Call to undefined function '" + id->name + "' in function '" + m_fn->name + "'");
+    }
+
+    if (dst >= 0 && dst != base)
+        emit(encodeABC(OpCode::MOVE, dst, base));
+    m_top = top;
+    if (id->ref.kind == SymbolKind::Builtin)
+        return builtinResult(static_cast<Builtin>(id->ref.slot));
+    return DType::Unknown;
+}
+
+int BytecodeCompiler::jumpIfFalse(const Expr *cond)
+{
+    if (!cond)
+        return -1; // an omitted condition never exits
+    int top = m_top;
+    int j = emitJump(OpCode::JMPIFNOT, exprReg(cond));
+    m_top = top;
+    return j;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Registers and scopes
+
+int BytecodeCompiler::allocReg()
+{
+    if (m_top >= kMaxRegisters)
+    {
+        if (m_fn->numRegs <= kMaxRegisters)
+            error("Function '" + m_fn->name + "' needs more than " + std::to_string(kMaxRegisters) + " registers");
+        m_fn->numRegs = kMaxRegisters + 1; // report once
+        return kMaxRegisters - 1;
+    }
+    int r = m_top++;
+    m_fn->numRegs = std::max(m_fn->numRegs, m_top);
+    return r;
+}
+
+void BytecodeCompiler::declare(uint32_t slot, int reg, DType type)
+{
+    if (slot >= m_slotRegs.size())
+    {
+        m_slotRegs.resize(slot + 1);
+        m_slotTypes.resize(slot + 1);
+    }
+    m_slotRegs[slot] = reg;
+    m_slotTypes[slot] = type;
+    m_locals.push_back(reg);
+}
+
+int BytecodeCompiler::localReg(const IdentifierExpr &id)
+{
+    const SymbolRef &ref = m_resolver.bind(id);
+    return ref.kind == SymbolKind::Local ? m_slotRegs[ref.slot] : -1;
+}
+
+DType BytecodeCompiler::nameType(const IdentifierExpr &id) const
+{
+    if (id.ref.kind == SymbolKind::Local)
+        return m_slotTypes[id.ref.slot];
+    if (id.ref.kind == SymbolKind::Global)
+        return dtypeFromName(m_resolver.globals()[id.ref.slot]->typeName);
+    return DType::Unknown;
+}
+
+bool BytecodeCompiler::isLocalReg(int reg) const
+{
+    for (int l : m_locals)
+        if (l == reg)
+            return true;
+    return false;
+}
+
+void BytecodeCompiler::beginScope()
+{
+    m_scopes.push_back(Scope{m_locals.size(), m_top, m_resolver.mark()});
+}
+
+void BytecodeCompiler::endScope()
+{
+    m_locals.resize(m_scopes.back().locals);
+    m_top = m_scopes.back().top;
+    m_resolver.popTo(m_scopes.back().names);
+    m_scopes.pop_back();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Emission
+
+int BytecodeCompiler::emit(Instr i)
+{
+    m_fn->code.push_back(i);
+    return static_cast<int>(m_fn->code.size()) - 1;
+}
+
+int BytecodeCompiler::constant(const Value &v)
+{
+    auto &k = m_fn->constants;
+    for (size_t i = 0; i < k.size(); i++)
+        if (sameConstant(k[i], v))
+            return static_cast<int>(i);
+    if (k.size() > static_cast<size_t>(kMaxBx))
+    {
+        error("Too many constants in function '" + m_fn->name + "'");
+        return 0;
+    }
+    k.push_back(v);
+    return static_cast<int>(k.size()) - 1;
+}
+
+int BytecodeCompiler::emitJump(OpCode op, int a)
+{
+    return emit(encodeAsBx(op, a, 0));
+}
+
+void BytecodeCompiler::patchJump(int at)
+{
+    if (at < 0)
+        return;
+    int offset = static_cast<int>(m_fn->code.size()) - (at + 1);
+    if (offset > kSBxBias)
+        error("Jump too long in function '" + m_fn->name + "'");
+    Instr i = m_fn->code[at];
+    m_fn->code[at] = encodeAsBx(decodeOp(i), decodeA(i), offset);
+}
+
+void BytecodeCompiler::jumpBack(int target)
+{
+    int offset = target - (static_cast<int>(m_fn->code.size()) + 1);
+    if (-offset > kSBxBias)
+        error("Jump too long in function '" + m_fn->name + "'");
+    emit(encodeAsBx(OpCode::LOOP, 0, offset));
+}
+
+void BytecodeCompiler::error(const std::string &msg)
+{
+    m_errors.push_back(msg);
+}
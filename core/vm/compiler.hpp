@@ -0,0 +1,106 @@
+#pragma once
+#include "../parser/ast.hpp"
+#include "../semantic/dtype.hpp"
+#include "../semantic/resolver.hpp"
+#include "bytecode.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Program -> register bytecode.
+//
+// Locals live in fixed registers of their function's frame; each block
+// scope reuses the registers of the scope it closes. Temporaries are taken
+// above the live locals and released at the end of every statement, so a
+// frame never needs more than (locals + deepest expression) registers.
+//
+// Names resolve innermost local first, then module globals, through the
+// Resolver's symbol table as the walk goes; locals are register-mapped by
+// slot and the bindings are left on the AST. Functions are
+// not values: a call names a @func (or a block method, compiled as a plain
+// function of the same name) or one of the builtins (see Builtin in
+// bytecode.hpp and builtins.hpp), which a @func of the same name shadows.
+// Assigning
+// to a name that was never declared is an error, as is calling with the
+// wrong number of arguments.
+//
+// Each expression also yields its static type, from literals, operators
+// and the declared dtypes of variables and parameters. It only chooses the
+// specialised `+` opcodes (ADD_NUM, CONCAT_TEXT; see bytecode.hpp), which
+// guard the kinds at runtime, so a wrong declaration costs speed, never
+// correctness.
+//
+// Complex and vector literals become constants (see literalValue). Block
+// fields and datetime literals have no runtime representation yet and are
+// rejected.
+
+class BytecodeCompiler
+{
+public:
+    // Returns nullptr when the program has errors; see errors().
+    std::unique_ptr<Module> compile(const Program &prog);
+
+    const std::vector<std::string> &errors() const { return m_errors; }
+
+private:
+    struct Scope
+    {
+        size_t locals;
+        int top;
+        size_t names; // Resolver mark
+    };
+
+    void compileFunction(const FuncDecl &f, FunctionProto &proto);
+    void compileInit(const Program &prog, FunctionProto &proto);
+    void beginFunction(FunctionProto &proto);
+    void endFunction();
+
+    // statements
+    void statement(const Stmt *s);
+    void block(const Block &b);
+    void varDecl(const VarDecl &v);
+    void ifStmt(const IfStmt &s);
+    void whileStmt(const WhileStmt &s);
+    void loopStmt(const LoopStmt &s);
+    void iterStmt(const IterStmt &s);
+    void returnStmt(const ReturnStmt &s);
+
+    // expressions; dst < 0 means the value is not needed. Each returns the
+    // static type of the value (DType::Unknown when it cannot tell).
+    void effect(const Expr *e);
+    DType exprTo(const Expr *e, int dst);
+    int exprReg(const Expr *e, bool forceTemp = false, DType *type = nullptr);
+    void literal(const LiteralExpr &lit, int dst);
+    DType assign(const BinaryExpr &b, int dst);
+    void logical(const BinaryExpr &b, int dst);
+    DType call(const CallExpr &c, int dst);
+    DType nameType(const IdentifierExpr &id) const; // bound `id`
+    int jumpIfFalse(const Expr *cond);
+
+    // registers and scopes
+    int allocReg();
+    void declare(uint32_t slot, int reg, DType type);
+    int localReg(const IdentifierExpr &id); // binds `id`; -1 unless a local
+    bool isLocalReg(int reg) const;
+    void beginScope();
+    void endScope();
+
+    // emission
+    int emit(Instr i);
+    int constant(const Value &v);
+    int emitJump(OpCode op, int a);
+    void patchJump(int at);
+    void jumpBack(int target);
+    void error(const std::string &msg);
+
+    Module *m_module = nullptr;
+    FunctionProto *m_fn = nullptr;
+    Resolver m_resolver;
+    std::vector<int> m_slotRegs;    // by local slot of the current function
+    std::vector<DType> m_slotTypes; // declared dtype, by local slot
+    std::vector<int> m_locals;      // registers of the locals in scope
+    std::vector<Scope> m_scopes;
+    int m_top = 0;
+    std::vector<std::string> m_errors;
+};
@@ -0,0 +1,544 @@
+#include "lane_vm.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    constexpr size_t N = LaneVM::kLanes;
+
+#ifdef __AVX2__
+    template <class F> void rowLoop(double *d, const double *a, const double *b, F f)
+    {
+        for (size_t i = 0; i < N; i += 4)
+            _mm256_storeu_pd(d + i, f(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+
+    template <int Cmp> void rowCompare(double *d, const double *a, const double *b)
+    {
+        const __m256d one = _mm256_set1_pd(1.0);
+        rowLoop(d, a, b, [one](__m256d x, __m256d y) { return _mm256_and_pd(_mm256_cmp_pd(x, y, Cmp), one); });
+    }
+#endif
+
+    // d = a op b over a whole register row. Comparisons store 1.0 / 0.0.
+    // The switch sits outside the loops so each one is a straight kernel.
+    void rowBinary(OpCode op, double *d, const double *a, const double *b)
+    {
+        switch (op)
+        {
+#ifdef __AVX2__
+        case OpCode::ADD: rowLoop(d, a, b, [](__m256d x, __m256d y) { return _mm256_add_pd(x, y); }); break;
+        case OpCode::SUB: rowLoop(d, a, b, [](__m256d x, __m256d y) { return _mm256_sub_pd(x, y); }); break;
+        case OpCode::MUL: rowLoop(d, a, b, [](__m256d x, __m256d y) { return _mm256_mul_pd(x, y); }); break;
+        case OpCode::DIV: rowLoop(d, a, b, [](__m256d x, __m256d y) { return _mm256_div_pd(x, y); }); break;
+        case OpCode::EQ: rowCompare<_CMP_EQ_OQ>(d, a, b); break;
+        case OpCode::NE: rowCompare<_CMP_NEQ_UQ>(d, a, b); break;
+        case OpCode::LT: rowCompare<_CMP_LT_OQ>(d, a, b); break;
+        case OpCode::LE: rowCompare<_CMP_LE_OQ>(d, a, b); break;
+        case OpCode::GT: rowCompare<_CMP_GT_OQ>(d, a, b); break;
+        case OpCode::GE: rowCompare<_CMP_GE_OQ>(d, a, b); break;
+#else
+        case OpCode::ADD: for (size_t i = 0; i < N; i++) d[i] = a[i] + b[i]; break;
+        case OpCode::SUB: for (size_t i = 0; i < N; i++) d[i] = a[i] - b[i]; break;
+        case OpCode::MUL: for (size_t i = 0; i < N; i++) d[i] = a[i] * b[i]; break;
+        case OpCode::DIV: for (size_t i = 0; i < N; i++) d[i] = a[i] / b[i]; break;
+        case OpCode::EQ: for (size_t i = 0; i < N; i++) d[i] = a[i] == b[i]; break;
+        case OpCode::NE: for (size_t i = 0; i < N; i++) d[i] = a[i] != b[i]; break;
+        case OpCode::LT: for (size_t i = 0; i < N; i++) d[i] = a[i] < b[i]; break;
+        case OpCode::LE: for (size_t i = 0; i < N; i++) d[i] = a[i] <= b[i]; break;
+        case OpCode::GT: for (size_t i = 0; i < N; i++) d[i] = a[i] > b[i]; break;
+        case OpCode::GE: for (size_t i = 0; i < N; i++) d[i] = a[i] >= b[i]; break;
+#endif
+        default: for (size_t i = 0; i < N; i++) d[i] = numberMod(a[i], b[i]); break;
+        }
+    }
+
+    void rowNegate(double *d, const double *a)
+    {
+#ifdef __AVX2__
+        const __m256d sign = _mm256_set1_pd(-0.0);
+        for (size_t i = 0; i < N; i += 4)
+            _mm256_storeu_pd(d + i, _mm256_xor_pd(_mm256_loadu_pd(a + i), sign));
+#else
+        for (size_t i = 0; i < N; i++)
+            d[i] = -a[i];
+#endif
+    }
+
+    bool isComparison(OpCode op) { return op >= OpCode::EQ && op <= OpCode::GE; }
+}
+
+bool LaneVM::supports(const Module &module, int entry)
+{
+    auto check = [](const FunctionProto &fn) {
+        for (const Value &k : fn.constants)
+            if (!k.isNumber())
+                return false;
+        for (Instr i : fn.code)
+        {
+            switch (decodeOp(i))
+            {
+            case OpCode::CALL:
+            case OpCode::CALLB:
+            case OpCode::ITERPREP:
+            case OpCode::ITERNEXT:
+                return false;
+            default:
+                break;
+            }
+        }
+        return true;
+    };
+    if (entry < 0 || static_cast<size_t>(entry) >= module.functions.size() || !check(module.functions[entry]))
+        return false;
+    return module.initFunction < 0 || check(module.functions[module.initFunction]);
+}
+
+bool LaneVM::run(const Module &module, int entry, const Value *inputs, size_t arity, size_t count, VmResult *results)
+{
+    if (!supports(module, entry) || arity != static_cast<size_t>(module.functions[entry].numParams))
+        return false;
+    for (size_t i = 0; i < arity * count; i++)
+        if (inputs[i].isText() || inputs[i].object())
+            return false;
+
+    const FunctionProto &fn = module.functions[entry];
+    for (size_t first = 0; first < count; first += N)
+        runBatch(module, fn, inputs + first * arity, arity, std::min(N, count - first), results + first);
+    return true;
+}
+
+Value LaneVM::laneValue(int slot, uint32_t lane) const
+{
+    size_t at = static_cast<size_t>(slot) * N + lane;
+    switch (static_cast<ValueKind>(m_kind[at]))
+    {
+    case ValueKind::Number: return Value::number(m_num[at]);
+    case ValueKind::Bool: return Value::fromBool(m_num[at] != 0.0);
+    default: return Value();
+    }
+}
+
+void LaneVM::setLane(int slot, uint32_t lane, const Value &v)
+{
+    size_t at = static_cast<size_t>(slot) * N + lane;
+    ValueKind kind = v.kind();
+    m_num[at] = kind == ValueKind::Bool ? (v.boolean() ? 1.0 : 0.0) : kind == ValueKind::Number ? v.num() : 0.0;
+    m_kind[at] = static_cast<uint8_t>(kind);
+    if (m_summary[slot] != m_kind[at])
+        m_summary[slot] = kMixed;
+}
+
+void LaneVM::setRow(int slot, ValueKind k)
+{
+    std::memset(kind(slot), static_cast<int>(k), N);
+    m_summary[slot] = static_cast<uint8_t>(k);
+}
+
+bool LaneVM::allNumbers(int slot, const uint32_t *lanes, size_t n)
+{
+    auto number = static_cast<uint8_t>(ValueKind::Number);
+    if (m_summary[slot] != kMixed)
+        return m_summary[slot] == number;
+    // A slot reused for a bool on one path and a number on another is mixed
+    // over the batch but usually uniform over the lanes running now.
+    const uint8_t *kinds = kind(slot);
+    for (size_t j = 0; j < n; j++)
+        if (kinds[lanes[j]] != number)
+            return false;
+    return true;
+}
+
+void LaneVM::copyLanes(int dst, int src, const uint32_t *lanes, size_t n)
+{
+    double *d = num(dst);
+    const double *v = num(src);
+    uint8_t *dk = kind(dst);
+    const uint8_t *sk = kind(src);
+    for (size_t j = 0; j < n; j++)
+    {
+        d[lanes[j]] = v[lanes[j]];
+        dk[lanes[j]] = sk[lanes[j]];
+    }
+    if (m_summary[dst] != m_summary[src])
+        m_summary[dst] = kMixed;
+}
+
+void LaneVM::scatter(int slot, const uint32_t *lanes, size_t n, ValueKind k)
+{
+    double *d = num(slot);
+    uint8_t *kinds = kind(slot);
+    for (size_t j = 0; j < n; j++)
+    {
+        d[lanes[j]] = m_scratch[lanes[j]];
+        kinds[lanes[j]] = static_cast<uint8_t>(k);
+    }
+    if (m_summary[slot] != static_cast<uint8_t>(k))
+        m_summary[slot] = kMixed;
+}
+
+void LaneVM::finish(uint32_t lane, VmStatus status, const Value &value, const std::string &err)
+{
+    VmResult &r = m_results[lane];
+    r.status = status;
+    r.value = value;
+    if (!err.empty())
+        r.error = err; // cleared when the batch started
+    r.steps = m_limits.maxSteps - static_cast<uint64_t>(std::max<int64_t>(m_fuel[lane], 0));
+    m_done[lane] = 1;
+    m_finishedAny = true;
+}
+
+void LaneVM::runBatch(const Module &module, const FunctionProto &fn, const Value *inputs, size_t arity, size_t count,
+                      VmResult *results)
+{
+    const FunctionProto *init = module.initFunction >= 0 ? &module.functions[module.initFunction] : nullptr;
+    m_globals = static_cast<int>(module.globalNames.size());
+    int slots = m_globals + std::max(fn.numRegs, init ? init->numRegs : 0);
+    m_num.assign(static_cast<size_t>(slots) * N, 0.0);
+    m_kind.assign(static_cast<size_t>(slots) * N, static_cast<uint8_t>(ValueKind::Nil));
+    m_summary.assign(slots, static_cast<uint8_t>(ValueKind::Nil));
+    m_pc.assign(N, 0);
+    m_fuel.assign(N, static_cast<int64_t>(std::min<uint64_t>(m_limits.maxSteps, INT64_MAX)));
+    m_done.assign(N, 0);
+    m_results.resize(N);
+    for (VmResult &r : m_results)
+    {
+        r.status = VmStatus::Error;
+        r.error.clear();
+    }
+
+    // Lanes past `count` repeat the first row, so a short batch still runs
+    // whole rows; their results are dropped.
+    auto resetLive = [&] {
+        m_live.clear();
+        for (uint32_t l = 0; l < N; l++)
+            if (!m_done[l])
+                m_live.push_back(l);
+    };
+    resetLive();
+    if (init)
+    {
+        execute(*init);
+        for (uint32_t l = 0; l < N; l++)
+            m_done[l] = m_results[l].status != VmStatus::Ok;
+    }
+
+    resetLive();
+    for (size_t p = 0; p < arity; p++)
+    {
+        int slot = m_globals + static_cast<int>(p);
+        for (uint32_t l : m_live)
+            setLane(slot, l, inputs[(l < count ? l : 0) * arity + p]);
+        // All-number parameter rows are the common case; let them take the
+        // row kernels from the first instruction.
+        const uint8_t *kinds = kind(slot);
+        m_summary[slot] = std::all_of(kinds, kinds + N, [&](uint8_t x) { return x == kinds[0]; }) ? kinds[0] : static_cast<uint8_t>(kMixed);
+    }
+    execute(fn);
+
+    for (size_t l = 0; l < count; l++)
+    {
+        // Field by field: successful lanes leave the (usually empty) error
+        // string alone instead of copying it.
+        const VmResult &src = m_results[l];
+        VmResult &dst = results[l];
+        dst.status = src.status;
+        dst.value = src.value;
+        dst.steps = src.steps;
+        if (!src.error.empty() || !dst.error.empty())
+            dst.error = src.error;
+    }
+}
+
+void LaneVM::execute(const FunctionProto &fn)
+{
+    const Instr *code = fn.code.data();
+    const Value *k = fn.constants.data();
+    const int base = m_globals;
+    bool uniform = true;
+    bool rescan = false;
+    int gpc = 0;            // pc of the lanes being stepped
+    int waitPc = INT_MAX;   // lowest pc among the other live lanes (divergent mode)
+    std::string err;
+
+    auto fail = [&](uint32_t lane, int pc, VmStatus status, const std::string &msg) {
+        finish(lane, status, Value(), "runtime error in '" + fn.name + "' at " + std::to_string(pc) + ": " + msg);
+    };
+
+    m_finishedAny = false;
+
+    while (!m_live.empty())
+    {
+        // Divergent lanes step as a group: the lanes at the lowest pc run
+        // until they reach the pc some other lane is waiting at (or jump
+        // past it), and only then are the lanes regrouped.
+        if (!uniform && rescan)
+        {
+            gpc = INT_MAX;
+            for (uint32_t l : m_live)
+                gpc = std::min(gpc, m_pc[l]);
+            m_active.clear();
+            waitPc = INT_MAX;
+            for (uint32_t l : m_live)
+            {
+                if (m_pc[l] == gpc)
+                    m_active.push_back(l);
+                else
+                    waitPc = std::min(waitPc, m_pc[l]);
+            }
+            uniform = m_active.size() == m_live.size();
+            rescan = false;
+        }
+        const uint32_t *act = uniform ? m_live.data() : m_active.data();
+        size_t nact = uniform ? m_live.size() : m_active.size();
+        int pc = gpc;
+
+        Instr i = code[pc];
+        OpCode op = baseOp(decodeOp(i)); // quickened forms behave as their base
+        int a = base + decodeA(i);
+        int next = pc + 1;
+
+        switch (op)
+        {
+        case OpCode::MOVE:
+        {
+            int b = base + decodeB(i);
+            if (uniform)
+            {
+                std::memcpy(num(a), num(b), N * sizeof(double));
+                std::memcpy(kind(a), kind(b), N);
+                m_summary[a] = m_summary[b];
+            }
+            else
+            {
+                copyLanes(a, b, act, nact);
+            }
+            break;
+        }
+        case OpCode::LOADK:
+        case OpCode::LOADBOOL:
+        case OpCode::LOADNIL:
+        {
+            Value v = op == OpCode::LOADK      ? k[decodeBx(i)]
+                      : op == OpCode::LOADBOOL ? Value::fromBool(decodeB(i) != 0)
+                                               : Value();
+            double x = v.kind() == ValueKind::Bool ? (v.boolean() ? 1.0 : 0.0) : v.isNumber() ? v.num() : 0.0;
+            if (uniform)
+            {
+                std::fill_n(num(a), N, x);
+                setRow(a, v.kind());
+            }
+            else
+            {
+                for (size_t j = 0; j < nact; j++)
+                    m_scratch[act[j]] = x;
+                scatter(a, act, nact, v.kind());
+            }
+            break;
+        }
+        case OpCode::GETGLOBAL:
+        case OpCode::SETGLOBAL:
+        {
+            int g = decodeBx(i);
+            int dst = op == OpCode::GETGLOBAL ? a : g, src = op == OpCode::GETGLOBAL ? g : a;
+            if (uniform)
+            {
+                std::memcpy(num(dst), num(src), N * sizeof(double));
+                std::memcpy(kind(dst), kind(src), N);
+                m_summary[dst] = m_summary[src];
+            }
+            else
+            {
+                copyLanes(dst, src, act, nact);
+            }
+            break;
+        }
+
+        case OpCode::ADD:
+        case OpCode::SUB:
+        case OpCode::MUL:
+        case OpCode::DIV:
+        case OpCode::MOD:
+        case OpCode::EQ:
+        case OpCode::NE:
+        case OpCode::LT:
+        case OpCode::LE:
+        case OpCode::GT:
+        case OpCode::GE:
+        {
+            int b = base + decodeB(i), c = base + decodeC(i);
+            if (allNumbers(b, act, nact) && allNumbers(c, act, nact))
+            {
+                // Whole rows; a divergent batch computes into scratch and
+                // keeps only the active lanes.
+                ValueKind rk = isComparison(op) ? ValueKind::Bool : ValueKind::Number;
+                if (uniform)
+                {
+                    rowBinary(op, num(a), num(b), num(c));
+                    setRow(a, rk);
+                }
+                else
+                {
+                    rowBinary(op, m_scratch, num(b), num(c));
+                    scatter(a, act, nact, rk);
+                }
+                break;
+            }
+            // Mixed kinds: the generic operator, lane by lane.
+            BinOp bop = static_cast<BinOp>(static_cast<int>(op) - static_cast<int>(OpCode::ADD));
+            for (size_t j = 0; j < nact; j++)
+            {
+                Value out;
+                if (applyBinOp(bop, laneValue(b, act[j]), laneValue(c, act[j]), m_heap, out, err))
+                    setLane(a, act[j], out);
+                else
+                    fail(act[j], pc, VmStatus::Error, err);
+            }
+            break;
+        }
+
+        case OpCode::NOT:
+        case OpCode::BOOL:
+        {
+            const double *v = num(base + decodeB(i));
+            double yes = op == OpCode::NOT ? 0.0 : 1.0;
+            if (uniform)
+            {
+                double *d = num(a);
+                for (size_t l = 0; l < N; l++)
+                    d[l] = v[l] != 0.0 ? yes : 1.0 - yes;
+                setRow(a, ValueKind::Bool);
+            }
+            else
+            {
+                for (size_t j = 0; j < nact; j++)
+                    m_scratch[act[j]] = v[act[j]] != 0.0 ? yes : 1.0 - yes;
+                scatter(a, act, nact, ValueKind::Bool);
+            }
+            break;
+        }
+        case OpCode::NEG:
+        case OpCode::POS:
+        {
+            int b = base + decodeB(i);
+            if (uniform && m_summary[b] == static_cast<uint8_t>(ValueKind::Number))
+            {
+                if (op == OpCode::NEG)
+                    rowNegate(num(a), num(b));
+                else
+                    std::memcpy(num(a), num(b), N * sizeof(double));
+                setRow(a, ValueKind::Number);
+                break;
+            }
+            for (size_t j = 0; j < nact; j++)
+            {
+                Value v = laneValue(b, act[j]);
+                if (!v.isNumber())
+                    fail(act[j], pc, VmStatus::Error,
+                         (op == OpCode::NEG ? "cannot negate " : "unary '+' on ") + std::string(to_string(v.kind())));
+                else
+                    setLane(a, act[j], op == OpCode::NEG ? Value::number(-v.num()) : v);
+            }
+            break;
+        }
+
+        case OpCode::JMP:
+            next = pc + 1 + decodeSBx(i);
+            break;
+        case OpCode::LOOP:
+        {
+            int offset = decodeSBx(i);
+            if (nact == N)
+            {
+                // Every lane is here (act[j] == j): charge them all and only
+                // look for exhausted lanes when one ran dry.
+                int64_t lowest = INT64_MAX;
+                for (size_t l = 0; l < N; l++)
+                {
+                    m_fuel[l] += offset;
+                    lowest = std::min(lowest, m_fuel[l]);
+                }
+                if (lowest >= 0)
+                {
+                    next = pc + 1 + offset;
+                    break;
+                }
+            }
+            for (size_t j = 0; j < nact; j++)
+            {
+                uint32_t l = act[j];
+                if (nact != N)
+                    m_fuel[l] += offset;
+                if (m_fuel[l] < 0)
+                    fail(l, pc, VmStatus::StepLimit, "step budget of " + std::to_string(m_limits.maxSteps) + " exhausted");
+            }
+            next = pc + 1 + offset;
+            break;
+        }
+        case OpCode::JMPIF:
+        case OpCode::JMPIFNOT:
+        {
+            int target = pc + 1 + decodeSBx(i);
+            bool onTrue = op == OpCode::JMPIF;
+            const double *v = num(a);
+            size_t taken = 0;
+            if (nact == N)
+                for (size_t l = 0; l < N; l++)
+                    taken += v[l] != 0.0;
+            else
+                for (size_t j = 0; j < nact; j++)
+                    taken += v[act[j]] != 0.0;
+            if (!onTrue)
+                taken = nact - taken;
+            if (taken == nact || taken == 0)
+            {
+                next = taken ? target : pc + 1;
+                break;
+            }
+            for (size_t j = 0; j < nact; j++)
+                m_pc[act[j]] = (v[act[j]] != 0.0) == onTrue ? target : pc + 1;
+            uniform = false;
+            rescan = true;
+            continue;
+        }
+
+        case OpCode::RET:
+        {
+            bool hasValue = decodeB(i) != 0;
+            for (size_t j = 0; j < nact; j++)
+                finish(act[j], VmStatus::Ok, hasValue ? laneValue(a, act[j]) : Value(), std::string());
+            break;
+        }
+
+        default:
+            for (size_t j = 0; j < nact; j++)
+                fail(act[j], pc, VmStatus::Error, std::string("unsupported opcode ") + to_string(op));
+            break;
+        }
+
+        gpc = next;
+        if (m_finishedAny)
+        {
+            auto done = [&](uint32_t l) { return m_done[l] != 0; };
+            m_live.erase(std::remove_if(m_live.begin(), m_live.end(), done), m_live.end());
+            if (!uniform)
+            {
+                m_active.erase(std::remove_if(m_active.begin(), m_active.end(), done), m_active.end());
+                rescan = m_active.empty();
+            }
+            m_finishedAny = false;
+        }
+        if (!uniform && !rescan && gpc >= waitPc)
+        {
+            for (uint32_t l : m_active)
+                m_pc[l] = gpc;
+            rescan = true;
+        }
+    }
+}
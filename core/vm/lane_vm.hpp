@@ -0,0 +1,76 @@
+#pragma once
+#include "bytecode.hpp"
+#include "vm.hpp"
+#include <cstdint>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Batched interpreter: one function over many argument rows at once.
+//
+// Registers are stored structure-of-arrays, kLanes values per register,
+// one lane per input row. While every running lane is at the same pc the
+// batch is "uniform" and number arithmetic runs over whole register rows
+// (AVX2 when compiled with -mavx2, plain loops otherwise). When a branch
+// splits the lanes each lane keeps its own pc and the lanes at the lowest
+// pc step together; since the compiler only emits forward branches and
+// LOOP back-edges, the lanes meet again at the join and the batch returns
+// to uniform.
+//
+// Per-lane results (status, value, steps, step budget) are the ones the
+// scalar VM produces for that row. Only number/bool code is supported: no
+// calls, builtins, iteration or text. A nil lane always holds 0.0, so
+// truthiness is simply "not 0.0" whatever the kind. supports() checks this up front
+// and run() refuses anything else, so callers fall back to the VM.
+
+class LaneVM
+{
+public:
+    static constexpr size_t kLanes = 64;
+
+    void setLimits(const VmLimits &limits) { m_limits = limits; }
+
+    static bool supports(const Module &module, int entry);
+
+    // Runs `entry` once per row of `inputs` (row-major, `arity` values per
+    // row) and writes results[0 .. count). Returns false, writing nothing,
+    // when the module or an input cannot be run in lanes.
+    bool run(const Module &module, int entry, const Value *inputs, size_t arity, size_t count, VmResult *results);
+
+private:
+    enum : uint8_t
+    {
+        kMixed = 0xFF // register summary: lanes hold different kinds
+    };
+
+    void runBatch(const Module &module, const FunctionProto &fn, const Value *inputs, size_t arity, size_t count,
+                  VmResult *results);
+    void execute(const FunctionProto &fn);
+
+    double *num(int slot) { return &m_num[static_cast<size_t>(slot) * kLanes]; }
+    uint8_t *kind(int slot) { return &m_kind[static_cast<size_t>(slot) * kLanes]; }
+    Value laneValue(int slot, uint32_t lane) const;
+    void setLane(int slot, uint32_t lane, const Value &v);
+    void setRow(int slot, ValueKind k);
+    bool allNumbers(int slot, const uint32_t *lanes, size_t n);
+    void copyLanes(int dst, int src, const uint32_t *lanes, size_t n);
+    void scatter(int slot, const uint32_t *lanes, size_t n, ValueKind k); // m_scratch -> slot
+    void finish(uint32_t lane, VmStatus status, const Value &value, const std::string &err);
+
+    VmLimits m_limits;
+    int m_globals = 0; // frame registers start at this slot
+
+    // slot * kLanes + lane
+    std::vector<double> m_num;
+    std::vector<uint8_t> m_kind;
+    std::vector<uint8_t> m_summary; // per slot: the kind all lanes hold, or kMixed
+    alignas(32) double m_scratch[kLanes];
+
+    std::vector<uint32_t> m_live;   // lanes still running
+    std::vector<uint32_t> m_active; // lanes at the current pc (divergent mode)
+    std::vector<int32_t> m_pc;
+    std::vector<int64_t> m_fuel;
+    std::vector<uint8_t> m_done;
+    std::vector<VmResult> m_results;
+    bool m_finishedAny = false;
+    ValueHeap m_heap; // required by applyBinOp; stays empty without text
+};
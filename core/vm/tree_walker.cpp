@@ -0,0 +1,356 @@
+#include "tree_walker.hpp"
+#include "../runtime/hash_map.hpp"
+#include "builtins.hpp"
+#include <algorithm>
+
+VmResult TreeWalker::run(const Program &prog, const std::string &entry, const std::vector<Value> &args)
+{
+    VmResult result;
+    m_frame.clear();
+    m_heap.clear();
+    m_output.clear();
+    m_error.clear();
+    m_status = VmStatus::Error;
+    m_returning = false;
+    m_depth = 0;
+
+    m_resolver.resolve(prog);
+    // Every global exists (as nil) before any initialiser runs.
+    m_globals.assign(m_resolver.globals().size(), Value());
+    for (const auto &g : prog.globalVars)
+    {
+        Value v;
+        if (g->initValue && !eval(g->initValue->get(), v))
+            goto done;
+        m_globals[g->slot] = v;
+    }
+    for (const auto &e : prog.globalExprs)
+    {
+        Value v;
+        if (!eval(e.get(), v))
+            goto done;
+    }
+
+    {
+        const auto &functions = m_resolver.functions();
+        auto f = std::find_if(functions.begin(), functions.end(), [&](const FuncDecl *d) { return d->name == entry; });
+        if (f == functions.end())
+        {
+            fail("no function named '" + entry + "'");
+            goto done;
+        }
+        std::vector<Value> params(args);
+        for (Value &p : params)
+            p = m_heap.adopt(p);
+        if (callFunction(**f, params, result.value))
+            result.status = VmStatus::Ok;
+    }
+
+done:
+    if (!result.ok())
+        result.status = m_status;
+    result.error = m_error;
+    return result;
+}
+
+bool TreeWalker::fail(const std::string &msg)
+{
+    if (m_error.empty())
+        m_error = msg;
+    return false;
+}
+
+Value *TreeWalker::slot(const IdentifierExpr &id)
+{
+    switch (id.ref.kind)
+    {
+    case SymbolKind::Local: return &m_frame[id.ref.slot];
+    case SymbolKind::Global: return &m_globals[id.ref.slot];
+    default: return nullptr;
+    }
+}
+
+bool TreeWalker::callFunction(const FuncDecl &f, std::vector<Value> &args, Value &out)
+{
+    if (!f.body)
+        return fail("function '" + f.name + "' is declared but never defined");
+    if (args.size() != f.params.size())
+        return fail("'" + f.name + "' expects " + std::to_string(f.params.size()) + " arguments, got " +
+                    std::to_string(args.size()));
+    if (m_depth >= m_maxDepth)
+    {
+        m_status = VmStatus::DepthLimit;
+        return fail("call depth limit reached");
+    }
+
+    std::vector<Value> saved(f.frameSize);
+    saved.swap(m_frame);
+    std::copy(args.begin(), args.end(), m_frame.begin());
+
+    m_depth++;
+    bool ok = execBlock(*f.body);
+    m_depth--;
+
+    out = m_returning ? m_returnValue : Value();
+    m_returning = false;
+    m_frame.swap(saved);
+    return ok;
+}
+
+bool TreeWalker::execBlock(const Block &b)
+{
+    bool ok = true;
+    for (const auto &s : b)
+    {
+        if (!(ok = exec(s.get())) || m_returning)
+            break;
+    }
+    return ok;
+}
+
+bool TreeWalker::exec(const Stmt *s)
+{
+    if (auto v = dynamic_cast<const VarDecl *>(s))
+    {
+        Value init;
+        if (v->initValue && !eval(v->initValue->get(), init))
+            return false;
+        m_frame[v->slot] = init;
+        return true;
+    }
+    if (auto e = dynamic_cast<const ExprStmt *>(s))
+    {
+        Value ignored;
+        return !e->expr || eval(e->expr.get(), ignored);
+    }
+    if (auto r = dynamic_cast<const ReturnStmt *>(s))
+    {
+        Value v;
+        if (r->value && *r->value && !eval(r->value->get(), v))
+            return false;
+        m_returnValue = v;
+        m_returning = true;
+        return true;
+    }
+    if (auto ifs = dynamic_cast<const IfStmt *>(s))
+    {
+        Value c;
+        if (!eval(ifs->ifBlock.first.get(), c))
+            return false;
+        if (!ifs->ifBlock.first || c.truthy())
+            return execBlock(ifs->ifBlock.second);
+        if (ifs->elseIfs)
+        {
+            for (const auto &branch : *ifs->elseIfs)
+            {
+                if (!eval(branch.first.get(), c))
+                    return false;
+                if (!branch.first || c.truthy())
+                    return execBlock(branch.second);
+            }
+        }
+        return ifs->elseBlock ? execBlock(*ifs->elseBlock) : true;
+    }
+    if (auto w = dynamic_cast<const WhileStmt *>(s))
+    {
+        for (;;)
+        {
+            Value c;
+            if (!eval(w->condition.get(), c))
+                return false;
+            if (w->condition && !c.truthy())
+                return true;
+            if (!execBlock(w->body))
+                return false;
+            if (m_returning)
+                return true;
+        }
+    }
+    if (auto l = dynamic_cast<const LoopStmt *>(s))
+    {
+        bool ok = true;
+        auto init = dynamic_cast<const ExprStmt *>(l->init.get());
+        auto assignInit = init ? dynamic_cast<const BinaryExpr *>(init->expr.get()) : nullptr;
+        auto declared = assignInit && assignInit->op == "=" && l->dtype
+                            ? dynamic_cast<const IdentifierExpr *>(assignInit->left.get())
+                            : nullptr;
+        if (declared)
+        {
+            Value v;
+            ok = eval(assignInit->right.get(), v);
+            m_frame[declared->ref.slot] = v;
+        }
+        else if (l->init)
+        {
+            ok = exec(l->init.get());
+        }
+        while (ok)
+        {
+            Value c;
+            if (!(ok = eval(l->condition.get(), c)) || (l->condition && !c.truthy()))
+                break;
+            if (!(ok = execBlock(l->body)) || m_returning)
+                break;
+            if (l->step && !(ok = exec(l->step.get())))
+                break;
+        }
+        return ok;
+    }
+    if (auto it = dynamic_cast<const IterStmt *>(s))
+    {
+        Value seq;
+        if (!eval(it->iterable.get(), seq))
+            return false;
+        if (!seq.isText() && !seq.isNumber() && !seq.isVector() && !seq.isSequence() && !seq.isMap())
+            return fail(std::string("cannot iterate over ") + to_string(seq.kind()));
+        bool ok = true;
+        for (double pos = 0.0;; pos += 1.0)
+        {
+            if (seq.isVector())
+            {
+                if (pos >= static_cast<double>(seq.vector().size))
+                    break;
+                m_frame[it->slot] = Value::number(seq.vector().data[static_cast<size_t>(pos)]);
+            }
+            else if (seq.isText())
+            {
+                if (pos >= static_cast<double>(seq.text().size()))
+                    break;
+                m_frame[it->slot] = m_heap.text(seq.text().substr(static_cast<size_t>(pos), 1));
+            }
+            else if (seq.isSequence())
+            {
+                if (pos >= static_cast<double>(seq.sequence().size))
+                    break;
+                m_frame[it->slot] = seq.sequence().items[static_cast<size_t>(pos)];
+            }
+            else if (seq.isMap())
+            {
+                const HashMap &m = seq.map();
+                size_t at = mapNext(m, static_cast<size_t>(pos));
+                if (at >= m.capacity)
+                    break;
+                m_frame[it->slot] = m.slots[at].key;
+                pos = static_cast<double>(at);
+            }
+            else
+            {
+                if (pos >= seq.num())
+                    break;
+                m_frame[it->slot] = Value::number(pos);
+            }
+            if (!(ok = execBlock(it->body)) || m_returning)
+                break;
+        }
+        return ok;
+    }
+    return !s || fail("unsupported statement");
+}
+
+bool TreeWalker::eval(const Expr *e, Value &out)
+{
+    if (!e)
+    {
+        out = Value();
+        return true;
+    }
+    if (auto lit = dynamic_cast<const LiteralExpr *>(e))
+    {
+        if (!literalValue(lit->value, lit->litType, m_heap, out))
+            return fail("unsupported literal '" + lit->value + "'");
+        return true;
+    }
+    if (auto id = dynamic_cast<const IdentifierExpr *>(e))
+    {
+        Value *v = slot(*id);
+        if (!v)
+            return fail("undefined name '" + id->name + "'");
+        out = *v;
+        return true;
+    }
+    if (auto u = dynamic_cast<const UnaryExpr *>(e))
+    {
+        Value v;
+        if (!eval(u->right.get(), v))
+            return false;
+        if (u->op == "!")
+        {
+            out = Value::fromBool(!v.truthy());
+            return true;
+        }
+        if (!v.isNumber())
+            return fail("unary '" + u->op + "' on " + to_string(v.kind()));
+        out = u->op == "-" ? Value::number(-v.num()) : v;
+        return true;
+    }
+    if (auto b = dynamic_cast<const BinaryExpr *>(e))
+    {
+        if (b->op == "=")
+        {
+            auto id = dynamic_cast<const IdentifierExpr *>(b->left.get());
+            if (!id)
+                return fail("invalid assignment target");
+            if (!eval(b->right.get(), out))
+                return false;
+            Value *v = slot(*id);
+            if (!v)
+                return fail("assignment to undeclared name '" + id->name + "'");
+            *v = out;
+            return true;
+        }
+        Value l, r;
+        if (!eval(b->left.get(), l))
+            return false;
+        if (b->op == "&&" || b->op == "||")
+        {
+            if (l.truthy() == (b->op == "||"))
+            {
+                out = Value::fromBool(l.truthy());
+                return true;
+            }
+            if (!eval(b->right.get(), r))
+                return false;
+            out = Value::fromBool(r.truthy());
+            return true;
+        }
+        if (!eval(b->right.get(), r))
+            return false;
+        BinOp op = binOpFromLexeme(b->op);
+        std::string err;
+        if (op == BinOp::Invalid)
+            return fail("unknown operator '" + b->op + "'");
+        if (!applyBinOp(op, l, r, m_heap, out, err))
+            return fail(err);
+        return true;
+    }
+    if (auto c = dynamic_cast<const CallExpr *>(e))
+        return evalCall(*c, out);
+    return fail("unsupported expression");
+}
+
+bool TreeWalker::evalCall(const CallExpr &c, Value &out)
+{
+    auto id = dynamic_cast<const IdentifierExpr *>(c.callee.get());
+    if (!id)
+        return fail("only named functions can be called");
+    std::vector<Value> args(c.args.size());
+    for (size_t i = 0; i < c.args.size(); i++)
+        if (!eval(c.args[i].get(), args[i]))
+            return false;
+
+    if (id->ref.kind == SymbolKind::Function)
+        return callFunction(*m_resolver.functions()[id->ref.slot], args, out);
+
+    if (id->ref.kind == SymbolKind::Builtin)
+    {
+        std::string err;
+        if (args.empty())
+            args.emplace_back();
+        if (!callBuiltin(static_cast<Builtin>(id->ref.slot), args.data(), static_cast<int>(c.args.size()), m_heap,
+                         m_output, err))
+            return fail(err);
+        out = args[0];
+        return true;
+    }
+    return fail("call to undefined function '" + id->name + "'");
+}
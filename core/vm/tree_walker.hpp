@@ -0,0 +1,50 @@
+#pragma once
+#include "../parser/ast.hpp"
+#include "../semantic/resolver.hpp"
+#include "vm.hpp"
+#include <string>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Direct AST interpreter with the VM's semantics.
+//
+// Every node is dispatched through dynamic_cast, i.e. the straightforward
+// way to run the AST; names are bound up front by a Resolver pass, so
+// variables are plain slots of a per-call frame and the globals array. It
+// is kept as the reference the bytecode VM is checked and benchmarked
+// against, not for use in the fitness loop.
+//
+// Unlike BytecodeCompiler it reports undefined names and arity mismatches
+// only when they are reached. Only call depth is limited; there is no step
+// or memory budget, so it must not be given untrusted mutants.
+
+class TreeWalker
+{
+public:
+    explicit TreeWalker(size_t maxDepth = 4096) : m_maxDepth(maxDepth) {}
+
+    VmResult run(const Program &prog, const std::string &entry, const std::vector<Value> &args = {});
+
+    const std::string &output() const { return m_output; }
+
+private:
+    bool callFunction(const FuncDecl &f, std::vector<Value> &args, Value &out);
+    bool exec(const Stmt *s);
+    bool execBlock(const Block &b);
+    bool eval(const Expr *e, Value &out);
+    bool evalCall(const CallExpr &c, Value &out);
+    Value *slot(const IdentifierExpr &id);
+    bool fail(const std::string &msg);
+
+    Resolver m_resolver;
+    std::vector<Value> m_globals; // by global slot
+    std::vector<Value> m_frame;   // by local slot; current call only
+    ValueHeap m_heap;
+    std::string m_output;
+    std::string m_error;
+    VmStatus m_status = VmStatus::Error;
+    Value m_returnValue;
+    bool m_returning = false;
+    size_t m_depth = 0;
+    size_t m_maxDepth;
+};
@@ -0,0 +1,446 @@
+#include "vm.hpp"
+#include "../runtime/hash_map.hpp"
+#include "builtins.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(MUTAGEN_NO_COMPUTED_GOTO)
+#define MUTAGEN_COMPUTED_GOTO 1
+#endif
+
+VM::VM(size_t stackSize) : m_stack(stackSize)
+{
+    m_frames.reserve(256);
+}
+
+VmResult VM::run(const Module &module, const std::string &entry, const std::vector<Value> &args)
+{
+    int index = module.find(entry);
+    if (index < 0)
+    {
+        VmResult result;
+        result.error = "no function named '" + entry + "'";
+        return result;
+    }
+    return run(module, index, args);
+}
+
+VmResult VM::run(const Module &module, int entry, const std::vector<Value> &args)
+{
+    VmResult result;
+    m_globals.assign(module.globalNames.size(), Value());
+    m_heap.clear();
+    m_output.clear();
+    m_frames.clear();
+    m_fuel = static_cast<int64_t>(std::min<uint64_t>(m_limits.maxSteps, INT64_MAX));
+
+    const FunctionProto &fn = module.functions[entry];
+    if (args.size() != static_cast<size_t>(fn.numParams))
+    {
+        result.error = "'" + fn.name + "' expects " + std::to_string(fn.numParams) + " arguments, got " +
+                       std::to_string(args.size());
+        return result;
+    }
+    if (module.initFunction < 0 || execute(module, module.initFunction, m_stack.data(), result))
+    {
+        // A stack too small for the arguments fails the frame size check.
+        for (size_t i = 0; i < args.size() && i < m_stack.size(); i++)
+            m_stack[i] = m_heap.adopt(args[i]);
+        execute(module, entry, m_stack.data(), result);
+    }
+    result.steps = m_limits.maxSteps - static_cast<uint64_t>(std::max<int64_t>(m_fuel, 0));
+    return result;
+}
+
+const char *to_string(VmStatus s)
+{
+    switch (s)
+    {
+    case VmStatus::Ok: return "ok";
+    case VmStatus::Error: return "error";
+    case VmStatus::StepLimit: return "step limit";
+    case VmStatus::DepthLimit: return "depth limit";
+    case VmStatus::MemoryLimit: return "memory limit";
+    default: return "?";
+    }
+}
+
+bool VM::execute(const Module &module, int entry, Value *base, VmResult &result)
+{
+    const FunctionProto *const functions = module.functions.data();
+    const Value *const stackEnd = m_stack.data() + m_stack.size();
+    const FunctionProto *fn = &functions[entry];
+    Instr *pc = fn->code.data();
+    const Value *k = fn->constants.data();
+    Value *globals = m_globals.data();
+    int64_t fuel = m_fuel;
+    VmStatus status = VmStatus::Error;
+    std::string err;
+    Instr i;
+
+    if (base + fn->numRegs > stackEnd)
+    {
+        pc = fn->code.data() + 1;
+        goto too_deep;
+    }
+
+#define RA base[decodeA(i)]
+#define RB base[decodeB(i)]
+#define RC base[decodeC(i)]
+
+#ifdef MUTAGEN_COMPUTED_GOTO
+    static void *const dispatch[] = {
+#define MUTAGEN_OPCODE_LABEL(name) &&op_##name,
+        MUTAGEN_OPCODES(MUTAGEN_OPCODE_LABEL)
+#undef MUTAGEN_OPCODE_LABEL
+    };
+#define VM_CASE(name) op_##name:
+#define VM_NEXT()                                       \
+    do                                                  \
+    {                                                   \
+        i = *pc++;                                      \
+        goto *dispatch[static_cast<int>(decodeOp(i))];  \
+    } while (0)
+
+    VM_NEXT();
+#else
+#define VM_CASE(name) case OpCode::name:
+#define VM_NEXT() continue
+    for (;;)
+    {
+        i = *pc++;
+        switch (decodeOp(i))
+        {
+#endif
+
+#define VM_ARITH(name, binop, expr)                                     \
+    VM_CASE(name)                                                       \
+    {                                                                   \
+        const Value &b = RB, &c = RC;                                   \
+        if (b.isNumber() && c.isNumber())                               \
+            RA = expr;                                                  \
+        else if (!applyBinOp(binop, b, c, m_heap, RA, err))             \
+            goto fail;                                                  \
+        else if (memoryUsed() > m_limits.maxHeapBytes)                  \
+            goto out_of_memory;                                         \
+        VM_NEXT();                                                      \
+    }
+
+    VM_CASE(MOVE)
+    {
+        RA = RB;
+        VM_NEXT();
+    }
+    VM_CASE(LOADK)
+    {
+        RA = k[decodeBx(i)];
+        VM_NEXT();
+    }
+    VM_CASE(LOADBOOL)
+    {
+        RA = Value::fromBool(decodeB(i) != 0);
+        VM_NEXT();
+    }
+    VM_CASE(LOADNIL)
+    {
+        RA = Value();
+        VM_NEXT();
+    }
+    VM_CASE(GETGLOBAL)
+    {
+        RA = globals[decodeBx(i)];
+        VM_NEXT();
+    }
+    VM_CASE(SETGLOBAL)
+    {
+        globals[decodeBx(i)] = RA;
+        VM_NEXT();
+    }
+
+    VM_CASE(ADD)
+    {
+        // First execution of the site: specialise it for these operands.
+        const Value &b = RB, &c = RC;
+        if (b.isNumber() && c.isNumber())
+            pc[-1] = replaceOp(i, OpCode::ADD_NUM);
+        else if (b.isText() || c.isText())
+            pc[-1] = replaceOp(i, OpCode::CONCAT_TEXT);
+        else
+            pc[-1] = replaceOp(i, OpCode::ADD_ANY);
+        goto add_any;
+    }
+    VM_CASE(ADD_NUM)
+    {
+        const Value &b = RB, &c = RC;
+        if (b.isNumber() && c.isNumber())
+        {
+            RA = Value::number(b.num() + c.num());
+            VM_NEXT();
+        }
+        pc[-1] = replaceOp(i, OpCode::ADD_ANY); // deoptimise
+        goto add_any;
+    }
+    VM_CASE(CONCAT_TEXT)
+    {
+        const Value &b = RB, &c = RC;
+        bool bText = b.isText(), cText = c.isText();
+        if (!bText && !cText)
+        {
+            pc[-1] = replaceOp(i, OpCode::ADD_ANY);
+            goto add_any;
+        }
+        if (bText && cText)
+        {
+            // RA may be b or c, whose inline bytes the views point at: the
+            // result is assembled before RA is written.
+            std::string_view x = b.text(), y = c.text();
+            size_t n = x.size() + y.size();
+            if (n <= Value::kInlineText)
+            {
+                char buf[Value::kInlineText];
+                std::memcpy(buf, x.data(), x.size());
+                std::memcpy(buf + x.size(), y.data(), y.size());
+                if (Value::inlineText(buf, n, RA))
+                    VM_NEXT();
+            }
+            RA = m_heap.appendText(b, y);
+        }
+        else if (bText)
+            RA = m_heap.appendText(b, formatValue(c));
+        else
+            RA = m_heap.text(formatValue(b) + formatValue(c));
+        if (memoryUsed() > m_limits.maxHeapBytes)
+            goto out_of_memory;
+        VM_NEXT();
+    }
+    VM_CASE(ADD_ANY)
+    add_any:
+    {
+        const Value &b = RB, &c = RC;
+        if (b.isNumber() && c.isNumber())
+            RA = Value::number(b.num() + c.num());
+        else if (!applyBinOp(BinOp::Add, b, c, m_heap, RA, err))
+            goto fail;
+        else if (memoryUsed() > m_limits.maxHeapBytes)
+            goto out_of_memory;
+        VM_NEXT();
+    }
+    VM_ARITH(SUB, BinOp::Sub, Value::number(b.num() - c.num()))
+    VM_ARITH(MUL, BinOp::Mul, Value::number(b.num() * c.num()))
+    VM_ARITH(DIV, BinOp::Div, Value::number(b.num() / c.num()))
+    VM_ARITH(MOD, BinOp::Mod, Value::number(numberMod(b.num(), c.num())))
+    VM_ARITH(EQ, BinOp::Eq, Value::fromBool(b.num() == c.num()))
+    VM_ARITH(NE, BinOp::Ne, Value::fromBool(b.num() != c.num()))
+    VM_ARITH(LT, BinOp::Lt, Value::fromBool(b.num() < c.num()))
+    VM_ARITH(LE, BinOp::Le, Value::fromBool(b.num() <= c.num()))
+    VM_ARITH(GT, BinOp::Gt, Value::fromBool(b.num() > c.num()))
+    VM_ARITH(GE, BinOp::Ge, Value::fromBool(b.num() >= c.num()))
+
+    VM_CASE(NOT)
+    {
+        RA = Value::fromBool(!RB.truthy());
+        VM_NEXT();
+    }
+    VM_CASE(NEG)
+    {
+        if (!RB.isNumber())
+        {
+            err = std::string("cannot negate ") + to_string(RB.kind());
+            goto fail;
+        }
+        RA = Value::number(-RB.num());
+        VM_NEXT();
+    }
+    VM_CASE(POS)
+    {
+        if (!RB.isNumber())
+        {
+            err = std::string("unary '+' on ") + to_string(RB.kind());
+            goto fail;
+        }
+        RA = RB;
+        VM_NEXT();
+    }
+    VM_CASE(BOOL)
+    {
+        RA = Value::fromBool(RB.truthy());
+        VM_NEXT();
+    }
+
+    VM_CASE(JMP)
+    {
+        pc += decodeSBx(i);
+        VM_NEXT();
+    }
+    VM_CASE(LOOP)
+    {
+        // The backward distance is the length of the loop body, so it is
+        // what one iteration costs.
+        int offset = decodeSBx(i);
+        fuel += offset;
+        if (fuel < 0)
+            goto out_of_steps;
+        if (memoryUsed() > m_limits.maxHeapBytes)
+            goto out_of_memory;
+        pc += offset;
+        VM_NEXT();
+    }
+    VM_CASE(JMPIF)
+    {
+        if (RA.truthy())
+            pc += decodeSBx(i);
+        VM_NEXT();
+    }
+    VM_CASE(JMPIFNOT)
+    {
+        if (!RA.truthy())
+            pc += decodeSBx(i);
+        VM_NEXT();
+    }
+
+    VM_CASE(CALL)
+    {
+        const FunctionProto *callee = &functions[decodeBx(i)];
+        Value *calleeBase = &RA;
+        if (m_frames.size() >= m_limits.maxDepth || calleeBase + callee->numRegs > stackEnd)
+            goto too_deep;
+        m_frames.push_back(Frame{fn, pc, base});
+        fn = callee;
+        k = fn->constants.data();
+        base = calleeBase;
+        pc = fn->code.data();
+        VM_NEXT();
+    }
+    VM_CASE(CALLB)
+    {
+        if (!callBuiltin(static_cast<Builtin>(decodeB(i)), &RA, decodeC(i), m_heap, m_output, err))
+            goto fail;
+        if (memoryUsed() > m_limits.maxHeapBytes)
+            goto out_of_memory;
+        VM_NEXT();
+    }
+    VM_CASE(RET)
+    {
+        // The frame pays for the code it ran up to here: its loop bodies
+        // were charged by LOOP on every trip round, the rest at most once.
+        fuel -= pc - fn->code.data();
+        if (fuel < 0)
+            goto out_of_steps;
+        // The callee's register 0 is the caller's result register.
+        base[0] = decodeB(i) ? RA : Value();
+        if (m_frames.empty())
+        {
+            m_fuel = fuel;
+            result.value = base[0];
+            result.status = VmStatus::Ok;
+            return true;
+        }
+        const Frame &f = m_frames.back();
+        fn = f.fn;
+        pc = f.pc;
+        base = f.base;
+        k = fn->constants.data();
+        m_frames.pop_back();
+        VM_NEXT();
+    }
+
+    VM_CASE(ITERPREP)
+    {
+        if (!RA.isText() && !RA.isNumber() && !RA.isVector() && !RA.isSequence() && !RA.isMap())
+        {
+            err = std::string("cannot iterate over ") + to_string(RA.kind());
+            goto fail;
+        }
+        base[decodeA(i) + 1] = Value::number(0.0);
+        VM_NEXT();
+    }
+    VM_CASE(ITERNEXT)
+    {
+        // Text yields its characters, a vector or sequence its elements, a
+        // map its keys in slot order, a number n yields 0 .. n-1.
+        Value *r = &RA;
+        double pos = r[1].num();
+        if (r[0].isVector())
+        {
+            const NumVector &v = r[0].vector();
+            if (pos < static_cast<double>(v.size))
+                r[2] = Value::number(v.data[static_cast<size_t>(pos)]);
+            else
+                pc += decodeSBx(i);
+        }
+        else if (r[0].isText())
+        {
+            std::string_view t = r[0].text();
+            if (pos < static_cast<double>(t.size()))
+            {
+                char ch = t[static_cast<size_t>(pos)];
+                if (!Value::inlineText(&ch, 1, r[2]))
+                    r[2] = m_heap.text(std::string_view(&ch, 1));
+            }
+            else
+                pc += decodeSBx(i);
+        }
+        else if (r[0].isSequence())
+        {
+            const Sequence &s = r[0].sequence();
+            if (pos < static_cast<double>(s.size))
+                r[2] = s.items[static_cast<size_t>(pos)];
+            else
+                pc += decodeSBx(i);
+        }
+        else if (r[0].isMap())
+        {
+            // The position is the next slot to look at.
+            const HashMap &m = r[0].map();
+            size_t at = mapNext(m, static_cast<size_t>(pos));
+            if (at < m.capacity)
+            {
+                r[2] = m.slots[at].key;
+                pos = static_cast<double>(at);
+            }
+            else
+                pc += decodeSBx(i);
+        }
+        else if (pos < r[0].num())
+            r[2] = Value::number(pos);
+        else
+            pc += decodeSBx(i);
+        r[1] = Value::number(pos + 1.0);
+        VM_NEXT();
+    }
+
+#ifndef MUTAGEN_COMPUTED_GOTO
+        default:
+            err = "bad opcode";
+            goto fail;
+        }
+    }
+#endif
+
+#undef VM_ARITH
+#undef VM_NEXT
+#undef VM_CASE
+#undef RC
+#undef RB
+#undef RA
+
+out_of_steps:
+    status = VmStatus::StepLimit;
+    err = "step budget of " + std::to_string(m_limits.maxSteps) + " exhausted";
+    goto fail;
+too_deep:
+    status = VmStatus::DepthLimit;
+    err = "call depth limit reached (" + std::to_string(m_frames.size()) + " frames)";
+    goto fail;
+out_of_memory:
+    status = VmStatus::MemoryLimit;
+    err = "memory limit of " + std::to_string(m_limits.maxHeapBytes) + " bytes exceeded";
+fail:
+    m_fuel = fuel;
+    result.status = status;
+    result.error = "runtime error in '" + fn->name + "' at " + std::to_string(pc - 1 - fn->code.data()) + ": " + err;
+    m_frames.clear();
+    return false;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "bytecode.hpp"
+#include <string>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Bytecode interpreter.
+//
+// All frames share one preallocated register stack; a call pushes a small
+// record on an explicit frame stack instead of recursing on the C++ stack,
+// so deep or runaway Genex recursion ends in a clean error. Dispatch uses
+// computed goto on GCC/Clang and a switch elsewhere.
+//
+// A VM is single-threaded and meant to be reused: each run() resets the
+// globals, the value heap and the output buffer but keeps their capacity;
+// the heap is an arena, so that reset is O(1) however much a test case
+// allocated. Text, complex and vector values in a result point into this
+// VM (or the module) and stay valid until the next run, unless copied out
+// with heap().escape().
+//
+// Mutants loop forever, recurse without end and grow text without bound,
+// so every run is sandboxed by VmLimits. The checks sit only where control
+// can come back around: LOOP (every backward jump) charges the length of
+// the loop body against the step budget and checks the heap, CALL checks
+// the depth, and RET charges how far into its function the frame got.
+// Code a frame skipped over is charged too, and frames still open when a
+// run stops are not, so the budget is a close estimate of instructions
+// executed, with the gap bounded by the depth limit times the function's
+// length, at no cost to the arithmetic opcodes. Text-creating
+// slow paths check the heap as well, since one statement can double it.
+//
+// `+` sites are quickened in place as they run (see bytecode.hpp), so the
+// Module passed to run() is modified and must not be shared with a VM on
+// another thread.
+
+struct VmLimits
+{
+    uint64_t maxSteps = 10000000;
+    size_t maxDepth = 1000;          // nested calls
+    size_t maxHeapBytes = 16u << 20; // text created by the run, print output included
+};
+
+enum class VmStatus : uint8_t
+{
+    Ok,
+    Error, // runtime type error, bad argument, ...
+    StepLimit,
+    DepthLimit, // call depth or register stack exhausted
+    MemoryLimit
+};
+
+const char *to_string(VmStatus s);
+
+struct VmResult
+{
+    VmStatus status = VmStatus::Error;
+    Value value;
+    std::string error;
+    uint64_t steps = 0; // budget consumed
+
+    bool ok() const { return status == VmStatus::Ok; }
+};
+
+class VM
+{
+public:
+    explicit VM(size_t stackSize = 1 << 16);
+
+    void setLimits(const VmLimits &limits) { m_limits = limits; }
+    const VmLimits &limits() const { return m_limits; }
+
+    // Runs the module's global initialiser, then `entry` with `args`.
+    VmResult run(const Module &module, const std::string &entry, const std::vector<Value> &args = {});
+    VmResult run(const Module &module, int entry, const std::vector<Value> &args = {});
+
+    // Everything print() wrote during the last run.
+    const std::string &output() const { return m_output; }
+    ValueHeap &heap() { return m_heap; }
+
+private:
+    struct Frame
+    {
+        const FunctionProto *fn;
+        Instr *pc;
+        Value *base;
+    };
+
+    bool execute(const Module &module, int entry, Value *base, VmResult &result);
+    size_t memoryUsed() const { return m_heap.bytes() + m_output.size(); }
+
+    std::vector<Value> m_stack;
+    std::vector<Frame> m_frames;
+    std::vector<Value> m_globals;
+    ValueHeap m_heap;
+    std::string m_output;
+    VmLimits m_limits;
+    int64_t m_fuel = 0; // steps left in the current run
+};
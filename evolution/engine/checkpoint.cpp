@@ -0,0 +1,581 @@
+#include "checkpoint.hpp"
+#include "../../core/parser/ast_hash.hpp"
+#include "../../core/serialize/ast_binary.hpp"
+#include "../../core/utils/hash.hpp"
+#include "../../core/utils/timer.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+static_assert(std::is_trivially_copyable<GAConfig>::value, "GAConfig is stored as raw bytes");
+static_assert(std::is_trivially_copyable<GenerationStats>::value, "GenerationStats is stored as raw bytes");
+static_assert(std::is_trivially_copyable<CheckpointEntry>::value, "CheckpointEntry is stored as raw bytes");
+
+namespace
+{
+    const char kManifest[] = "checkpoint.bin";
+
+    // Images start 8-byte aligned in the pack, as AstBinaryView expects of
+    // a buffer it reads in place.
+    uint64_t alignImage(uint64_t offset) { return (offset + 7) & ~uint64_t(7); }
+
+    bool writeAll(int fd, const void *data, size_t size, uint64_t offset)
+    {
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        while (size)
+        {
+            ssize_t n = pwrite(fd, p, size, static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            p += n;
+            size -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+
+    bool readAll(int fd, void *data, size_t size, uint64_t offset)
+    {
+        uint8_t *p = static_cast<uint8_t *>(data);
+        while (size)
+        {
+            ssize_t n = pread(fd, p, size, static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            p += n;
+            size -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+
+    bool readFile(const std::string &path, std::vector<uint8_t> &out)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0;
+        if (ok)
+        {
+            out.resize(static_cast<size_t>(st.st_size));
+            ok = readAll(fd, out.data(), out.size(), 0);
+        }
+        ::close(fd);
+        return ok;
+    }
+
+    // The manifest's parts, pointing into `bytes`.
+    struct Manifest
+    {
+        std::vector<uint8_t> bytes;
+        CheckpointHeader header;
+        const uint8_t *config = nullptr;
+        const uint8_t *history = nullptr;
+        const uint8_t *entries = nullptr;
+        const uint8_t *priority = nullptr;
+        const uint8_t *cache = nullptr;
+    };
+
+    bool readManifest(const std::string &dir, Manifest &m, std::string &error)
+    {
+        std::string path = dir + "/" + kManifest;
+        if (!readFile(path, m.bytes))
+        {
+            error = "Cannot read checkpoint: " + path;
+            return false;
+        }
+        if (m.bytes.size() < sizeof(CheckpointHeader))
+        {
+            error = "Truncated checkpoint: " + path;
+            return false;
+        }
+        std::memcpy(&m.header, m.bytes.data(), sizeof(CheckpointHeader));
+        const CheckpointHeader &h = m.header;
+        if (std::memcmp(h.magic, "GXCK", 4) != 0 || h.version != kCheckpointVersion || h.byteOrder != 0x0102)
+        {
+            error = "Not a checkpoint of this version: " + path;
+            return false;
+        }
+        if (h.configBytes != sizeof(GAConfig) || h.statsBytes != sizeof(GenerationStats) ||
+            h.entryBytes != sizeof(CheckpointEntry))
+        {
+            error = "Checkpoint written by a build with another layout: " + path;
+            return false;
+        }
+        uint64_t payload = m.bytes.size() - sizeof(CheckpointHeader);
+        uint64_t need = h.configBytes;
+        if (h.historyCount > payload / h.statsBytes || h.populationCount > payload / h.entryBytes ||
+            h.priorityBytes > payload || h.cacheBytes > payload)
+            need = payload + 1;
+        else
+            need += h.historyCount * h.statsBytes + h.populationCount * h.entryBytes + h.priorityBytes + h.cacheBytes;
+        if (need != payload || hashBytes(m.bytes.data() + sizeof(CheckpointHeader), payload) != h.checksum)
+        {
+            error = "Corrupt checkpoint: " + path;
+            return false;
+        }
+        m.config = m.bytes.data() + sizeof(CheckpointHeader);
+        m.history = m.config + h.configBytes;
+        m.entries = m.history + h.historyCount * h.statsBytes;
+        m.priority = m.entries + h.populationCount * h.entryBytes;
+        m.cache = m.priority + h.priorityBytes;
+        return true;
+    }
+
+    CheckpointEntry entryAt(const Manifest &m, size_t i)
+    {
+        CheckpointEntry e;
+        std::memcpy(&e, m.entries + i * sizeof(CheckpointEntry), sizeof(e));
+        return e;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Checkpointer
+
+Checkpointer::~Checkpointer()
+{
+    if (m_thread.joinable())
+    {
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        m_thread.join();
+    }
+    if (m_packFd >= 0)
+        ::close(m_packFd);
+}
+
+std::string Checkpointer::packPath(uint64_t pack) const
+{
+    return m_dir + "/pack-" + std::to_string(pack) + ".bin";
+}
+
+bool Checkpointer::open(const std::string &dir, std::string *error)
+{
+    if (m_thread.joinable())
+    {
+        if (error)
+            *error = "Checkpointer already open: " + m_dir;
+        return false;
+    }
+    if (::mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        if (error)
+            *error = "Cannot create checkpoint directory: " + dir;
+        return false;
+    }
+    m_dir = dir;
+
+    // Continue an existing checkpoint: its live images stay where they are.
+    Manifest m;
+    std::string ignored;
+    if (readManifest(dir, m, ignored))
+    {
+        m_pack = m.header.pack;
+        m_packBytes = m.header.packBytes;
+        for (size_t i = 0; i < m.header.populationCount; i++)
+        {
+            CheckpointEntry e = entryAt(m, i);
+            m_index[e.key] = Located{e.offset, e.length};
+            m_known.insert(e.key);
+        }
+    }
+
+    m_packFd = ::open(packPath(m_pack).c_str(), O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (m_packFd < 0 || fstat(m_packFd, &st) != 0)
+    {
+        if (error)
+            *error = "Cannot open checkpoint pack: " + packPath(m_pack);
+        return false;
+    }
+    // Bytes past packBytes belong to a snapshot whose manifest never made
+    // it. Missing bytes are images the manifest needs: extending the file
+    // would only hide that.
+    if (static_cast<uint64_t>(st.st_size) < m_packBytes)
+    {
+        if (error)
+            *error = "Truncated checkpoint pack: " + packPath(m_pack);
+        return false;
+    }
+    if (ftruncate(m_packFd, static_cast<off_t>(m_packBytes)) != 0)
+    {
+        if (error)
+            *error = "Cannot open checkpoint pack: " + packPath(m_pack);
+        return false;
+    }
+    m_thread = std::thread([this] { writerLoop(); });
+    return true;
+}
+
+void Checkpointer::capture(const GAController &ga)
+{
+    double t0 = wallSeconds();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_failed || !m_thread.joinable())
+            return;
+    }
+
+    Snapshot snap;
+    snap.config = ga.config();
+    snap.generation = ga.generation();
+    snap.history = ga.history();
+    if (ga.testPriority())
+        snap.priority = ga.testPriority()->snapshot();
+    if (ga.fitnessCache())
+        snap.cache = ga.fitnessCache()->snapshot();
+    const Population &pop = ga.population();
+    snap.entries.resize(pop.size());
+    std::unordered_set<uint64_t> live;
+    live.reserve(pop.size());
+    for (size_t i = 0; i < pop.size(); i++)
+    {
+        const Individual &ind = pop[i];
+        CheckpointEntry &e = snap.entries[i];
+        e.key = AstHasher::hash(*ind.program);
+        e.hash = ind.hash;
+        e.fitness = ind.fitness;
+        live.insert(e.key);
+        if (m_known.insert(e.key).second)
+            snap.images.push_back(Image{e.key, AstBinary::encode(*ind.program)});
+    }
+    // Most of the pack is dead: have the writer move the live images to a
+    // fresh one, and forget the rest so a returning program is re-sent.
+    if (m_known.size() > 4 * live.size() + 256)
+    {
+        snap.compact = true;
+        m_known = std::move(live);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_hasPending)
+        {
+            // Not started yet: the newer state supersedes it, but the
+            // images it was to write may be referenced from now on.
+            for (Image &img : snap.images)
+                m_pending.images.push_back(std::move(img));
+            snap.images = std::move(m_pending.images);
+            snap.compact = snap.compact || m_pending.compact;
+            m_stats.coalesced++;
+        }
+        m_pending = std::move(snap);
+        m_hasPending = true;
+        m_stats.captured++;
+        m_stats.captureSeconds += wallSeconds() - t0;
+    }
+    m_wake.notify_one();
+}
+
+bool Checkpointer::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return !m_hasPending && !m_busy; });
+    return !m_failed;
+}
+
+std::string Checkpointer::error() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_error;
+}
+
+CheckpointStats Checkpointer::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void Checkpointer::fail(const std::string &message)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_failed = true;
+    m_error = message;
+}
+
+void Checkpointer::writerLoop()
+{
+    for (;;)
+    {
+        Snapshot snap;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stop || m_hasPending; });
+            if (!m_hasPending)
+                return;
+            snap = std::move(m_pending);
+            m_hasPending = false;
+            m_busy = !m_failed;
+            if (!m_busy)
+            {
+                m_idle.notify_all();
+                continue;
+            }
+        }
+        double t0 = wallSeconds();
+        bool ok = write(snap);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_busy = false;
+            if (ok)
+                m_stats.written++;
+            m_stats.writeSeconds += wallSeconds() - t0;
+        }
+        m_idle.notify_all();
+    }
+}
+
+bool Checkpointer::write(Snapshot &snap)
+{
+    uint64_t oldPack = m_pack;
+    if (snap.compact)
+    {
+        if (!compactPack(snap))
+            return false;
+    }
+    else if (!snap.images.empty())
+    {
+        uint64_t appended = 0;
+        for (const Image &img : snap.images)
+        {
+            if (!writeAll(m_packFd, img.bytes.data(), img.bytes.size(), m_packBytes))
+            {
+                fail("Cannot write checkpoint pack: " + packPath(m_pack));
+                return false;
+            }
+            m_index[img.key] = Located{m_packBytes, static_cast<uint32_t>(img.bytes.size())};
+            m_packBytes = alignImage(m_packBytes + img.bytes.size());
+            appended += img.bytes.size();
+        }
+        if (fdatasync(m_packFd) != 0)
+        {
+            fail("Cannot sync checkpoint pack: " + packPath(m_pack));
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.images += snap.images.size();
+        m_stats.imageBytes += appended;
+    }
+
+    for (CheckpointEntry &e : snap.entries)
+    {
+        auto it = m_index.find(e.key);
+        if (it == m_index.end())
+        {
+            fail("Checkpoint lost track of a program image");
+            return false;
+        }
+        e.offset = it->second.offset;
+        e.length = it->second.length;
+    }
+    if (!writeManifest(snap))
+        return false;
+    if (m_pack != oldPack)
+        std::remove(packPath(oldPack).c_str());
+    return true;
+}
+
+bool Checkpointer::compactPack(const Snapshot &snap)
+{
+    std::unordered_map<uint64_t, const Image *> fresh;
+    for (const Image &img : snap.images)
+        fresh[img.key] = &img;
+
+    uint64_t pack = m_pack + 1;
+    int fd = ::open(packPath(pack).c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        fail("Cannot create checkpoint pack: " + packPath(pack));
+        return false;
+    }
+    std::unordered_map<uint64_t, Located> index;
+    uint64_t size = 0;
+    std::vector<uint8_t> buffer;
+    bool ok = true;
+    for (const CheckpointEntry &e : snap.entries)
+    {
+        if (index.count(e.key))
+            continue;
+        const std::vector<uint8_t> *bytes = nullptr;
+        auto f = fresh.find(e.key);
+        if (f != fresh.end())
+        {
+            bytes = &f->second->bytes;
+        }
+        else
+        {
+            auto old = m_index.find(e.key);
+            ok = old != m_index.end();
+            if (ok)
+            {
+                buffer.resize(old->second.length);
+                ok = readAll(m_packFd, buffer.data(), buffer.size(), old->second.offset);
+                bytes = &buffer;
+            }
+        }
+        ok = ok && writeAll(fd, bytes->data(), bytes->size(), size);
+        if (!ok)
+            break;
+        index[e.key] = Located{size, static_cast<uint32_t>(bytes->size())};
+        size = alignImage(size + bytes->size());
+    }
+    if (!ok || fdatasync(fd) != 0)
+    {
+        ::close(fd);
+        std::remove(packPath(pack).c_str());
+        fail("Cannot compact checkpoint pack into " + packPath(pack));
+        return false;
+    }
+    ::close(m_packFd);
+    m_packFd = fd;
+    m_pack = pack;
+    m_packBytes = size;
+    m_index = std::move(index);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.compactions++;
+    m_stats.images += fresh.size();
+    for (const Image &img : snap.images)
+        m_stats.imageBytes += img.bytes.size();
+    return true;
+}
+
+bool Checkpointer::writeManifest(const Snapshot &snap)
+{
+    CheckpointHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, "GXCK", 4);
+    h.version = kCheckpointVersion;
+    h.byteOrder = 0x0102;
+    h.configBytes = sizeof(GAConfig);
+    h.statsBytes = sizeof(GenerationStats);
+    h.entryBytes = sizeof(CheckpointEntry);
+    h.generation = snap.generation;
+    h.historyCount = snap.history.size();
+    h.populationCount = snap.entries.size();
+    h.pack = m_pack;
+    h.packBytes = m_packBytes;
+    h.priorityBytes = snap.priority.size();
+    h.cacheBytes = snap.cache.size();
+
+    std::vector<uint8_t> out(sizeof(h) + sizeof(GAConfig) + snap.history.size() * sizeof(GenerationStats) +
+                             snap.entries.size() * sizeof(CheckpointEntry) + snap.priority.size() +
+                             snap.cache.size());
+    uint8_t *p = out.data() + sizeof(h);
+    std::memcpy(p, &snap.config, sizeof(GAConfig));
+    p += sizeof(GAConfig);
+    if (!snap.history.empty())
+        std::memcpy(p, snap.history.data(), snap.history.size() * sizeof(GenerationStats));
+    p += snap.history.size() * sizeof(GenerationStats);
+    if (!snap.entries.empty())
+        std::memcpy(p, snap.entries.data(), snap.entries.size() * sizeof(CheckpointEntry));
+    p += snap.entries.size() * sizeof(CheckpointEntry);
+    if (!snap.priority.empty())
+        std::memcpy(p, snap.priority.data(), snap.priority.size());
+    p += snap.priority.size();
+    if (!snap.cache.empty())
+        std::memcpy(p, snap.cache.data(), snap.cache.size());
+    h.checksum = hashBytes(out.data() + sizeof(h), out.size() - sizeof(h));
+    std::memcpy(out.data(), &h, sizeof(h));
+
+    std::string path = m_dir + "/" + kManifest;
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd >= 0 && writeAll(fd, out.data(), out.size(), 0) && fsync(fd) == 0;
+    if (fd >= 0)
+        ok = (::close(fd) == 0) && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmp.c_str());
+        fail("Cannot write checkpoint: " + path);
+        return false;
+    }
+    return true;
+}
+
+bool Checkpointer::load(const std::string &dir, CheckpointState &out, std::string *error)
+{
+    Manifest m;
+    std::string why;
+    if (!readManifest(dir, m, why))
+    {
+        if (error)
+            *error = why;
+        return false;
+    }
+    std::string packFile = dir + "/pack-" + std::to_string(m.header.pack) + ".bin";
+    std::vector<uint8_t> pack;
+    if (!readFile(packFile, pack) || pack.size() < m.header.packBytes)
+    {
+        if (error)
+            *error = "Cannot read checkpoint pack: " + packFile;
+        return false;
+    }
+
+    std::memcpy(&out.config, m.config, sizeof(GAConfig));
+    out.generation = m.header.generation;
+    out.history.resize(m.header.historyCount);
+    if (!out.history.empty())
+        std::memcpy(out.history.data(), m.history, out.history.size() * sizeof(GenerationStats));
+    out.population.clear();
+    out.population.resize(m.header.populationCount);
+    for (size_t i = 0; i < out.population.size(); i++)
+    {
+        CheckpointEntry e = entryAt(m, i);
+        Individual &ind = out.population[i];
+        if (e.offset <= m.header.packBytes && e.length <= m.header.packBytes - e.offset)
+            ind.program = AstBinary::decode(pack.data() + e.offset, e.length);
+        if (!ind.program)
+        {
+            if (error)
+                *error = "Corrupt program image in " + packFile;
+            out.population.clear();
+            return false;
+        }
+        ind.fitness = e.fitness;
+        ind.hash = e.hash;
+    }
+    out.priority.assign(m.priority, m.priority + m.header.priorityBytes);
+    out.cache.assign(m.cache, m.cache + m.header.cacheBytes);
+    return true;
+}
+
+bool Checkpointer::restore(GAController &ga, CheckpointState &&state, std::string *error)
+{
+    TestPrioritizer *priority = ga.testPriority();
+    FitnessCache *cache = ga.fitnessCache();
+    std::vector<uint8_t> before;
+    if (priority && !state.priority.empty())
+    {
+        before = priority->snapshot();
+        if (!priority->restore(state.priority.data(), state.priority.size()))
+        {
+            if (error)
+                *error = "Checkpoint test priorities do not fit the attached prioritizer";
+            return false;
+        }
+    }
+    if (cache && !state.cache.empty() && !cache->restore(state.cache.data(), state.cache.size()))
+    {
+        if (!before.empty())
+            priority->restore(before.data(), before.size());
+        if (error)
+            *error = "Checkpoint fitness cache does not fit the attached cache";
+        return false;
+    }
+    ga.restore(std::move(state.population), state.generation, std::move(state.history));
+    return true;
+}
@@ -0,0 +1,190 @@
+#pragma once
+#include "ga_controller.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Incremental GAController checkpoints, written off the generation loop.
+//
+// A checkpoint directory holds two files:
+//
+//   pack-<n>.bin    AstBinary images, appended back to back
+//   checkpoint.bin  CheckpointHeader, GAConfig, GenerationStats[history],
+//                   CheckpointEntry[population], TestPrioritizer and
+//                   FitnessCache snapshots (either may be empty)
+//
+// Programs are keyed by their AstHasher structural hash, and an image is
+// appended to the pack only the first time its key is seen. Elites,
+// duplicates and programs that come back cost a manifest entry, not a new
+// image. The small manifest is rewritten each time through a temp file
+// and a rename, after the pack is synced, so checkpoint.bin always
+// describes a complete state. A crash can only leave unreferenced bytes at
+// the end of the pack, and open() cuts those off; a pack shorter than the
+// manifest says was damaged some other way, and open() refuses it. Once the pack holds
+// mostly dead images it is rewritten with the live ones under the next n.
+//
+// capture() only hashes the population and encodes the new programs. The
+// files are written by a background thread. If that thread falls behind,
+// a queued snapshot that has not started yet is replaced by the newer one
+// and its images are carried over, so the loop never waits on the disk.
+//
+// A captured state is what GAController holds between two steps:
+// population (with evaluated flags and hashes), generation and history,
+// plus the snapshots of the TestPrioritizer and FitnessCache attached to
+// it. Operator streams are keyed by generation, so that is the whole RNG
+// state. Both attachments steer a racing run: the prioritizer picks the
+// case order, and cache hits count towards the racing threshold before
+// any candidate runs (see GAController::raceLeaders). Restoring all of it
+// into a controller set up the same way resumes a run bit-exact. The cache
+// is written whole with every manifest, so a large one makes checkpoints
+// proportionally larger (25 bytes an entry).
+//
+// Files use host byte order and struct layout, checked on load, like the
+// AstBinary image.
+
+constexpr uint16_t kCheckpointVersion = 2;
+
+struct CheckpointHeader
+{
+    char magic[4]; // "GXCK"
+    uint16_t version;
+    uint16_t byteOrder; // 0x0102 as written by the host
+    uint32_t configBytes;
+    uint32_t statsBytes;
+    uint32_t entryBytes;
+    uint32_t reserved;
+    uint64_t generation;
+    uint64_t historyCount;
+    uint64_t populationCount;
+    uint64_t pack;          // n of the pack-<n>.bin the entries point into
+    uint64_t packBytes;     // bytes of that pack in use; anything after is garbage
+    uint64_t priorityBytes; // TestPrioritizer::snapshot(), 0 = none
+    uint64_t cacheBytes;    // FitnessCache::snapshot(), 0 = none
+    uint64_t checksum;      // hashBytes of everything after the header
+};
+static_assert(sizeof(CheckpointHeader) == 88, "CheckpointHeader layout is part of the file format");
+
+struct CheckpointEntry
+{
+    uint64_t key;    // AstHasher hash of the program
+    uint64_t hash;   // Individual::hash as it was (0 before evaluation)
+    uint64_t offset; // image in the pack
+    uint32_t length;
+    uint32_t reserved;
+    FitnessRecord fitness;
+};
+
+struct CheckpointState
+{
+    GAConfig config;
+    size_t generation = 0;
+    std::vector<GenerationStats> history;
+    Population population;
+    std::vector<uint8_t> priority; // TestPrioritizer::snapshot(), or empty
+    std::vector<uint8_t> cache;    // FitnessCache::snapshot(), or empty
+};
+
+struct CheckpointStats
+{
+    uint64_t captured = 0;   // capture() calls
+    uint64_t written = 0;    // manifests written
+    uint64_t coalesced = 0;  // snapshots replaced by a newer one before they were written
+    uint64_t images = 0;     // images appended to the pack
+    uint64_t imageBytes = 0;
+    uint64_t compactions = 0;
+    double captureSeconds = 0.0; // on the calling thread
+    double writeSeconds = 0.0;   // on the writer thread
+};
+
+class Checkpointer
+{
+public:
+    Checkpointer() = default;
+    ~Checkpointer(); // flushes
+    Checkpointer(const Checkpointer &) = delete;
+    Checkpointer &operator=(const Checkpointer &) = delete;
+
+    // Use `dir` (created if missing) and start the writer. An existing
+    // checkpoint there is continued: its images are not written again.
+    // False if its pack is shorter than its manifest says.
+    bool open(const std::string &dir, std::string *error = nullptr);
+
+    // Queue the controller's current state; call between steps, e.g. from
+    // run()'s onGeneration. Never waits for the disk.
+    void capture(const GAController &ga);
+
+    // Wait until every queued snapshot is on disk. False after any write
+    // error, which error() then describes; later captures are ignored.
+    bool flush();
+    std::string error() const;
+    CheckpointStats stats() const;
+
+    // Read the checkpoint in `dir`; false (and `error`) when there is none
+    // or it does not match this build's layout.
+    static bool load(const std::string &dir, CheckpointState &out, std::string *error = nullptr);
+
+    // Hand a loaded state to a controller built with state.config, and to
+    // the prioritizer and cache attached to it. Snapshots for attachments
+    // the controller does not have are dropped. False (and `error`, the
+    // controller untouched) if a snapshot does not fit its attachment.
+    static bool restore(GAController &ga, CheckpointState &&state, std::string *error = nullptr);
+
+private:
+    struct Image
+    {
+        uint64_t key;
+        std::vector<uint8_t> bytes;
+    };
+    struct Snapshot
+    {
+        GAConfig config;
+        size_t generation = 0;
+        std::vector<GenerationStats> history;
+        std::vector<CheckpointEntry> entries; // offsets filled in by the writer
+        std::vector<Image> images;            // keys the writer has not seen
+        std::vector<uint8_t> priority;
+        std::vector<uint8_t> cache;
+        bool compact = false;
+    };
+    struct Located
+    {
+        uint64_t offset;
+        uint32_t length;
+    };
+
+    void writerLoop();
+    bool write(Snapshot &snap);
+    bool compactPack(const Snapshot &snap);
+    bool writeManifest(const Snapshot &snap);
+    void fail(const std::string &message);
+    std::string packPath(uint64_t pack) const;
+
+    std::string m_dir;
+
+    // Capture side (the thread calling capture()).
+    std::unordered_set<uint64_t> m_known; // keys sent to the writer
+
+    // Writer side.
+    int m_packFd = -1;
+    uint64_t m_pack = 0;
+    uint64_t m_packBytes = 0;
+    std::unordered_map<uint64_t, Located> m_index; // key -> image in the current pack
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    bool m_hasPending = false;
+    Snapshot m_pending;
+    bool m_busy = false;
+    bool m_stop = false;
+    bool m_failed = false;
+    std::string m_error;
+    CheckpointStats m_stats;
+    std::thread m_thread;
+};
@@ -0,0 +1,292 @@
+#include "ga_controller.hpp"
+#include "../../core/parser/ast_clone.hpp"
+#include "../../core/parser/ast_hash.hpp"
+#include "../../core/utils/timer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+
+GAController::GAController(GAConfig config, FitnessFn fitness)
+    : m_config(config), m_fitness(std::move(fitness)), m_pool(config.threads)
+{
+    m_workspaces.resize(m_pool.size());
+    for (unsigned i = 0; i < m_pool.size(); i++)
+        m_workspaces[i].worker = i;
+    if (m_config.simplify)
+        m_simplifiers.resize(m_pool.size());
+}
+
+void GAController::setHeaders(HeaderCache *cache, const std::vector<std::string> &searchPaths)
+{
+    for (EvalWorkspace &ws : m_workspaces)
+        ws.headers = cache ? std::make_unique<HeaderResolver>(*cache, searchPaths) : nullptr;
+}
+
+void GAController::seed(std::vector<std::unique_ptr<Program>> programs)
+{
+    m_population.clear();
+    m_history.clear();
+    m_generation = 0;
+    if (programs.empty())
+        return;
+    size_t n = std::max(m_config.populationSize, programs.size());
+    m_population.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i < programs.size())
+            m_population[i].program = std::move(programs[i]);
+        else
+            m_population[i].program = AstCloner::clone(*m_population[i % programs.size()].program);
+    }
+}
+
+void GAController::restore(Population population, size_t generation, std::vector<GenerationStats> history)
+{
+    m_population = std::move(population);
+    m_generation = generation;
+    m_history = std::move(history);
+}
+
+const Individual &GAController::best() const
+{
+    return *std::max_element(m_population.begin(), m_population.end(),
+                             [](const Individual &a, const Individual &b) { return a.fitness.score < b.fitness.score; });
+}
+
+void GAController::evaluate(GenerationStats &stats)
+{
+    // Only offspring need scoring; elites carry their record over.
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < m_population.size(); i++)
+        if (!m_population[i].fitness.evaluated)
+            pending.push_back(i);
+
+    if (m_config.dedupe || m_cache)
+        m_pool.parallelFor(pending.size(), [&](size_t k, unsigned) {
+            Individual &ind = m_population[pending[k]];
+            ind.hash = AstHasher::hash(*ind.program);
+        });
+
+    // Population-level dedupe: the first offspring of each structure is
+    // scored, later copies (and copies of elites) take over its record.
+    std::vector<size_t> leaders;
+    std::vector<std::pair<size_t, size_t>> copies; // (copy, source)
+    if (m_config.dedupe)
+    {
+        std::unordered_map<uint64_t, size_t> first;
+        first.reserve(m_population.size());
+        for (size_t i = 0; i < m_population.size(); i++)
+            if (m_population[i].fitness.evaluated)
+                first.emplace(m_population[i].hash, i);
+        for (size_t i : pending)
+        {
+            auto ins = first.emplace(m_population[i].hash, i);
+            if (ins.second)
+                leaders.push_back(i);
+            else
+                copies.emplace_back(i, ins.first->second);
+        }
+    }
+    else
+    {
+        leaders = std::move(pending);
+    }
+
+    if (m_raceSuite)
+    {
+        raceLeaders(leaders, stats);
+    }
+    else
+    {
+        std::atomic<size_t> hits{0}, limited{0};
+        m_pool.parallelFor(leaders.size(), [&](size_t k, unsigned worker) {
+            Individual &ind = m_population[leaders[k]];
+            if (m_cache && m_cache->lookup(ind.hash, ind.fitness))
+            {
+                hits.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            ind.fitness = m_fitness(*ind.program, m_workspaces[worker]);
+            ind.fitness.evaluated = true;
+            if (isLimitOutcome(ind.fitness.outcome))
+                limited.fetch_add(1, std::memory_order_relaxed);
+            if (m_cache)
+                m_cache->insert(ind.hash, ind.fitness);
+        });
+        stats.cacheHits = hits.load();
+        stats.limited = limited.load();
+    }
+
+    // Sources are leaders or already-evaluated individuals, never copies.
+    for (const auto &c : copies)
+        m_population[c.first].fitness = m_population[c.second].fitness;
+
+    stats.duplicates = copies.size();
+    stats.evaluated = leaders.size() - stats.cacheHits;
+}
+
+void GAController::raceLeaders(const std::vector<size_t> &leaders, GenerationStats &stats)
+{
+    // Cache hits are settled first so that their scores, like the elites',
+    // tighten the threshold from the first rung on.
+    std::vector<uint8_t> hit(leaders.size(), 0);
+    if (m_cache)
+        m_pool.parallelFor(leaders.size(), [&](size_t k, unsigned) {
+            Individual &ind = m_population[leaders[k]];
+            hit[k] = m_cache->lookup(ind.hash, ind.fitness);
+        });
+
+    std::vector<size_t> racing;
+    std::vector<const Program *> programs;
+    for (size_t k = 0; k < leaders.size(); k++)
+    {
+        if (hit[k])
+            continue;
+        racing.push_back(leaders[k]);
+        programs.push_back(m_population[leaders[k]].program.get());
+    }
+    std::vector<double> known;
+    for (const auto &ind : m_population)
+        if (ind.fitness.evaluated)
+            known.push_back(ind.fitness.score);
+
+    std::vector<FitnessRecord> records;
+    std::vector<CaseOutcome> outcomes;
+    const TestSuite &suite = m_priority ? m_priority->suite() : *m_raceSuite;
+    RaceStats race = raceSuite(suite, m_race, programs, known, records, m_pool, m_workspaces,
+                               m_priority ? &outcomes : nullptr);
+    if (m_priority)
+    {
+        stats.casesImplied = m_priority->skipped();
+        m_priority->observe(outcomes);
+        m_priority->nextGeneration();
+    }
+    for (size_t k = 0; k < racing.size(); k++)
+    {
+        Individual &ind = m_population[racing[k]];
+        ind.fitness = records[k];
+        if (isLimitOutcome(ind.fitness.outcome))
+            stats.limited++;
+        // A partial score depends on the rest of the generation; only
+        // complete ones are worth remembering.
+        if (m_cache && !ind.fitness.partial)
+            m_cache->insert(ind.hash, ind.fitness);
+    }
+
+    stats.cacheHits = leaders.size() - racing.size();
+    stats.raceDropped = race.dropped;
+    stats.casesRun = race.executions;
+    stats.casesSaved = race.saved;
+}
+
+size_t GAController::tournament(RandomStream &rng) const
+{
+    size_t best = rng.below(m_population.size());
+    for (size_t k = 1; k < m_config.tournamentSize; k++)
+    {
+        size_t c = rng.below(m_population.size());
+        if (m_population[c].fitness.score > m_population[best].fitness.score)
+            best = c;
+    }
+    return best;
+}
+
+void GAController::breedChild(size_t index, Individual &child) const
+{
+    RandomStream select(m_config.seed, m_generation, index, RngStream::Selection);
+    RandomStream cross(m_config.seed, m_generation, index, RngStream::Crossover);
+    RandomStream mutate(m_config.seed, m_generation, index, RngStream::Mutation);
+
+    const Program &a = *m_population[tournament(select)].program;
+    if (m_crossover && select.chance(m_config.crossoverRate))
+        child.program = m_crossover(a, *m_population[tournament(select)].program, cross);
+    if (!child.program)
+        child.program = AstCloner::clone(a);
+    if (m_mutate && mutate.chance(m_config.mutationRate))
+        m_mutate(*child.program, mutate);
+}
+
+void GAController::breed(GenerationStats &stats)
+{
+    std::stable_sort(m_population.begin(), m_population.end(), [](const Individual &a, const Individual &b) {
+        return a.fitness.score > b.fitness.score;
+    });
+    if (m_prepare)
+        m_prepare(m_population, m_pool);
+
+    size_t elites = std::min(m_config.eliteCount, m_population.size());
+    Population next(m_population.size());
+    size_t children = m_population.size() - elites;
+    struct Simplified
+    {
+        size_t programs = 0;
+        uint64_t before = 0;
+        uint64_t after = 0;
+    };
+    std::vector<Simplified> simplified(m_simplifiers.size());
+    m_pool.parallelFor(children, [&](size_t i, unsigned worker) {
+        breedChild(i, next[i]);
+        if (m_simplifiers.empty() || !m_simplifiers[worker].simplify(*next[i].program))
+            return;
+        const SimplifyStats &s = m_simplifiers[worker].stats();
+        simplified[worker].programs++;
+        simplified[worker].before += s.nodesBefore;
+        simplified[worker].after += s.nodesAfter;
+    });
+    for (const Simplified &s : simplified)
+    {
+        stats.simplified += s.programs;
+        stats.nodesBefore += s.before;
+        stats.nodesAfter += s.after;
+    }
+
+    // Elites move over last so that parents stay valid while breeding.
+    for (size_t i = 0; i < elites; i++)
+        next[children + i] = std::move(m_population[i]);
+    m_population = std::move(next);
+}
+
+const GenerationStats &GAController::step()
+{
+    GenerationStats stats;
+    stats.generation = m_generation;
+    double wall0 = wallSeconds();
+    double cpu0 = processCpuSeconds();
+
+    evaluate(stats);
+    stats.evalWallSeconds = wallSeconds() - wall0;
+    if (m_migrate)
+        m_migrate(m_population, m_generation);
+
+    double sum = 0.0;
+    stats.bestFitness = m_population.empty() ? 0.0 : m_population.front().fitness.score;
+    for (const auto &ind : m_population)
+    {
+        sum += ind.fitness.score;
+        stats.bestFitness = std::max(stats.bestFitness, ind.fitness.score);
+    }
+    stats.meanFitness = m_population.empty() ? 0.0 : sum / m_population.size();
+
+    if (stats.bestFitness < m_config.targetFitness && m_generation + 1 < m_config.generations)
+        breed(stats);
+
+    stats.wallSeconds = wallSeconds() - wall0;
+    stats.cpuSeconds = processCpuSeconds() - cpu0;
+    size_t scored = stats.evaluated + stats.duplicates + stats.cacheHits;
+    stats.candidatesPerSecond = stats.wallSeconds > 0.0 ? scored / stats.wallSeconds : 0.0;
+    m_generation++;
+    m_history.push_back(stats);
+    return m_history.back();
+}
+
+void GAController::run(const std::function<void(const GenerationStats &)> &onGeneration)
+{
+    while (m_generation < m_config.generations && !m_population.empty())
+    {
+        const GenerationStats &s = step();
+        if (onGeneration)
+            onGeneration(s);
+        if (s.bestFitness >= m_config.targetFitness)
+            break;
+    }
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include "../../core/parser/ast.hpp"
+#include "../../core/semantic/simplifier.hpp"
+#include "../../core/utils/rng.hpp"
+#include "../../core/utils/thread_pool.hpp"
+#include "../fitness/fitness.hpp"
+#include "../fitness/fitness_cache.hpp"
+#include "../fitness/racing.hpp"
+#include "../fitness/test_priority.hpp"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Generational GA driver (see flow.md): Selection -> Crossover -> Mutation
+// produce offspring, the Fitness Evaluator scores them in parallel.
+//
+// Both breeding and evaluation run on the pool. Operators draw from
+// counter-based RandomStreams keyed by (seed, generation, child index), so
+// a run is bit-identical for any thread count.
+
+struct Individual
+{
+    std::unique_ptr<Program> program;
+    FitnessRecord fitness;
+    uint64_t hash = 0; // AstHasher structural hash, set when evaluated
+};
+
+using Population = std::vector<Individual>;
+
+using MutationFn = std::function<void(Program &prog, RandomStream &rng)>;
+using CrossoverFn = std::function<std::unique_ptr<Program>(const Program &a, const Program &b, RandomStream &rng)>;
+
+// Runs once per generation before breeding, so operators can precompute
+// per-parent tables that the parallel breeding phase then only reads.
+using PrepareFn = std::function<void(const Population &pop, ThreadPool &pool)>;
+
+// Runs once per generation right after evaluation, with every individual
+// scored. Island migration (island_model.hpp) reads emigrants here and
+// swaps immigrants in; whatever it leaves must carry a fitness record and
+// its AstHasher hash.
+using MigrateFn = std::function<void(Population &pop, size_t generation)>;
+
+struct GAConfig
+{
+    unsigned threads = 0; // 0 = all hardware threads
+    size_t populationSize = 100;
+    size_t generations = 50;
+    size_t eliteCount = 2;
+    size_t tournamentSize = 3;
+    double crossoverRate = 0.7;
+    double mutationRate = 0.9;
+    double targetFitness = 1.0; // stop once the best individual reaches this
+    uint64_t seed = 1;
+    // Score structurally identical offspring once per generation. Needs a
+    // fitness function that depends on the program only.
+    bool dedupe = true;
+    // Run the Simplifier over every offspring once bred, so bloat is not
+    // carried into evaluation, hashing and later clones.
+    bool simplify = false;
+};
+
+struct GenerationStats
+{
+    size_t generation = 0;
+    size_t evaluated = 0;       // fitness calls made this generation
+    size_t duplicates = 0;      // offspring that copied an identical program's record
+    size_t cacheHits = 0;       // offspring answered by the FitnessCache
+    size_t limited = 0;         // evaluations stopped by a VM step/depth/memory limit
+    size_t raceDropped = 0;     // offspring abandoned by racing (see setRace)
+    uint64_t casesRun = 0;      // test cases executed while racing
+    uint64_t casesSaved = 0;    // test cases racing skipped
+    size_t casesImplied = 0;    // suite cases left out as implied by others (see setTestPriority)
+    size_t simplified = 0;      // offspring bred this generation that the Simplifier accepted
+    uint64_t nodesBefore = 0;   // their AST nodes before and after simplification
+    uint64_t nodesAfter = 0;
+    double wallSeconds = 0.0;   // evaluation + breeding
+    double cpuSeconds = 0.0;    // process CPU time over the same span
+    double evalWallSeconds = 0.0;
+    double candidatesPerSecond = 0.0;
+    double bestFitness = 0.0;
+    double meanFitness = 0.0;
+};
+
+class GAController
+{
+public:
+    GAController(GAConfig config, FitnessFn fitness);
+
+    void setMutation(MutationFn fn) { m_mutate = std::move(fn); }
+    void setCrossover(CrossoverFn fn) { m_crossover = std::move(fn); }
+    void setPrepare(PrepareFn fn) { m_prepare = std::move(fn); }
+    void setMigration(MigrateFn fn) { m_migrate = std::move(fn); }
+    // Optional memo shared across generations (and controllers); not owned.
+    void setFitnessCache(FitnessCache *cache) { m_cache = cache; }
+    // Resolve the header() declarations of candidates through `cache`
+    // (shared, not owned) and `searchPaths`, one resolver per worker (see
+    // EvalWorkspace::link). nullptr goes back to ignoring them.
+    void setHeaders(HeaderCache *cache, const std::vector<std::string> &searchPaths = {});
+    // Score offspring by racing them on `suite` (see racing.hpp) instead of
+    // calling the fitness function; elites count towards the threshold.
+    // Pass nullptr to go back to the fitness function. Not owned.
+    void setRace(const TestSuite *suite, RaceConfig config = {})
+    {
+        m_raceSuite = suite;
+        m_race = config;
+    }
+    // Race on the prioritizer's order instead of the suite's own; it must
+    // be built over the suite given to setRace. Not owned.
+    void setTestPriority(TestPrioritizer *priority) { m_priority = priority; }
+
+    // Initial population. Seeds are cycled (and cloned) up to populationSize.
+    void seed(std::vector<std::unique_ptr<Program>> programs);
+
+    // Continue a run from a state captured between two steps (see
+    // checkpoint.hpp). Operator streams are keyed by generation, so this is
+    // all the state the controller itself carries; an attached FitnessCache
+    // or TestPrioritizer is restored on its own (Checkpointer does both).
+    void restore(Population population, size_t generation, std::vector<GenerationStats> history);
+
+    // Evaluate the current population, record stats, then breed the next
+    // generation. Returns the stats of the generation just evaluated.
+    const GenerationStats &step();
+
+    // Run until config.generations or targetFitness is reached. The final
+    // population is left evaluated.
+    void run(const std::function<void(const GenerationStats &)> &onGeneration = {});
+
+    const Population &population() const { return m_population; }
+    const Individual &best() const;
+    const std::vector<GenerationStats> &history() const { return m_history; }
+    const GAConfig &config() const { return m_config; }
+    size_t generation() const { return m_generation; }
+    FitnessCache *fitnessCache() const { return m_cache; }
+    TestPrioritizer *testPriority() const { return m_priority; }
+
+private:
+    void evaluate(GenerationStats &stats);
+    void raceLeaders(const std::vector<size_t> &leaders, GenerationStats &stats);
+    void breed(GenerationStats &stats);
+    void breedChild(size_t index, Individual &child) const;
+    size_t tournament(RandomStream &rng) const;
+
+    GAConfig m_config;
+    FitnessFn m_fitness;
+    MutationFn m_mutate;
+    CrossoverFn m_crossover;
+    PrepareFn m_prepare;
+    MigrateFn m_migrate;
+    FitnessCache *m_cache = nullptr;
+    const TestSuite *m_raceSuite = nullptr;
+    RaceConfig m_race;
+    TestPrioritizer *m_priority = nullptr;
+    ThreadPool m_pool;
+    std::vector<EvalWorkspace> m_workspaces; // one per pool worker
+    std::vector<Simplifier> m_simplifiers;   // one per pool worker, if config.simplify
+    Population m_population;
+    std::vector<GenerationStats> m_history;
+    size_t m_generation = 0;
+};
@@ -0,0 +1,509 @@
+#include "island_model.hpp"
+#include "../../core/parser/ast_hash.hpp"
+#include "../../core/serialize/ast_binary.hpp"
+#include "../../core/utils/cpu_affinity.hpp"
+#include "../../core/utils/hash.hpp"
+#include "../../core/utils/timer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <new>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+    size_t roundUp(size_t n, size_t to) { return (n + to - 1) / to * to; }
+
+    // Spin briefly, then yield, then sleep: waits are usually short (a
+    // neighbour finishing its generation) but can last a whole generation.
+    void backoff(unsigned &spins)
+    {
+        spins++;
+        if (spins < 64)
+            return;
+        if (spins < 256)
+            std::this_thread::yield();
+        else
+            usleep(100);
+    }
+
+    struct Pending
+    {
+        MigrantHeader header;
+        std::vector<uint8_t> image;
+    };
+}
+
+struct alignas(64) IslandModel::Slot
+{
+    std::atomic<uint32_t> finished{0}; // no more migrants will come from it
+    IslandReport report;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// One island's side of migration: the GAController calls exchange() after
+// every evaluation.
+class IslandModel::Island
+{
+public:
+    Island(IslandModel &model, size_t index, IslandReport &report)
+        : m_model(model), m_config(model.m_config), m_index(index), m_report(report) {}
+
+    void exchange(Population &pop, size_t generation);
+
+private:
+    std::vector<size_t> destinations(size_t generation) const;
+    std::vector<size_t> sources(size_t generation) const;
+    size_t randomOffset(size_t generation) const;
+    void deliver(size_t to, const MigrantHeader &header, const std::vector<uint8_t> &image);
+    void drain();
+    void collect(size_t generation, std::vector<Pending> &out);
+    void settle(Population &pop, std::vector<Pending> &arrived);
+
+    IslandModel &m_model;
+    const IslandConfig &m_config;
+    size_t m_index;
+    IslandReport &m_report;
+    std::vector<Pending> m_pending; // received, not yet taken in
+    Pending m_scratch;
+};
+
+size_t IslandModel::Island::randomOffset(size_t generation) const
+{
+    // Drawn from the shared seed, so every island agrees on it.
+    RandomStream rng(m_config.ga.seed, generation, 0, RngStream::Migration);
+    return 1 + rng.below(m_config.islands - 1);
+}
+
+std::vector<size_t> IslandModel::Island::destinations(size_t generation) const
+{
+    size_t k = m_config.islands;
+    std::vector<size_t> out;
+    switch (m_config.topology)
+    {
+    case MigrationTopology::Ring:
+        out.push_back((m_index + 1) % k);
+        break;
+    case MigrationTopology::FullyConnected:
+        for (size_t i = 1; i < k; i++)
+            out.push_back((m_index + i) % k);
+        break;
+    case MigrationTopology::RandomRing:
+        out.push_back((m_index + randomOffset(generation)) % k);
+        break;
+    }
+    return out;
+}
+
+std::vector<size_t> IslandModel::Island::sources(size_t generation) const
+{
+    size_t k = m_config.islands;
+    std::vector<size_t> out;
+    switch (m_config.topology)
+    {
+    case MigrationTopology::Ring:
+        out.push_back((m_index + k - 1) % k);
+        break;
+    case MigrationTopology::FullyConnected:
+        for (size_t i = 1; i < k; i++)
+            out.push_back((m_index + i) % k);
+        break;
+    case MigrationTopology::RandomRing:
+        out.push_back((m_index + k - randomOffset(generation)) % k);
+        break;
+    }
+    return out;
+}
+
+void IslandModel::Island::drain()
+{
+    // A finished source has returned from every push it made, and one that
+    // crashed is only marked finished by the parent once waitpid has seen
+    // it exit; either way a cell it claimed and never published is dead.
+    auto abandoned = [this](uint32_t source) {
+        return source < m_config.islands && m_model.slot(source).finished.load(std::memory_order_acquire);
+    };
+    MigrationRing &ring = m_model.inbox(m_index);
+    while (ring.pop(m_scratch.header, m_scratch.image, abandoned))
+        m_pending.push_back(std::move(m_scratch));
+}
+
+void IslandModel::Island::deliver(size_t to, const MigrantHeader &header, const std::vector<uint8_t> &image)
+{
+    MigrationRing &ring = m_model.inbox(to);
+    unsigned spins = 0;
+    double wait0 = 0.0;
+    while (!ring.push(header, image.data()))
+    {
+        // A finished island never drains its inbox again, and an
+        // asynchronous run never waits.
+        if (!m_config.synchronous || m_model.slot(to).finished.load(std::memory_order_acquire))
+        {
+            if (header.bytes)
+                m_report.dropped++;
+            return;
+        }
+        if (spins == 0)
+            wait0 = wallSeconds();
+        // Keep our own inbox moving while we wait, so two islands filling
+        // each other's inboxes cannot deadlock.
+        drain();
+        backoff(spins);
+    }
+    if (spins)
+        m_report.waitSeconds += wallSeconds() - wait0;
+    if (header.bytes)
+        m_report.emigrated++;
+}
+
+void IslandModel::Island::collect(size_t generation, std::vector<Pending> &out)
+{
+    if (!m_config.synchronous)
+    {
+        drain();
+        out = std::move(m_pending);
+        m_pending.clear();
+        return;
+    }
+
+    // Every source sends exactly `migrants` cells per destination and
+    // migration, so a batch is complete once that many have arrived. A
+    // source that has finished will send nothing more; its flag is read
+    // before draining so that anything it pushed first is seen.
+    std::vector<size_t> from = sources(generation);
+    unsigned spins = 0;
+    double wait0 = wallSeconds();
+    for (;;)
+    {
+        std::vector<uint8_t> finished(from.size());
+        for (size_t s = 0; s < from.size(); s++)
+            finished[s] = m_model.slot(from[s]).finished.load(std::memory_order_acquire);
+        drain();
+        bool complete = true;
+        for (size_t s = 0; s < from.size() && complete; s++)
+        {
+            size_t have = 0;
+            for (const Pending &p : m_pending)
+                if (p.header.epoch == generation && p.header.source == from[s])
+                    have++;
+            complete = have >= m_config.migrants || finished[s];
+        }
+        if (complete)
+            break;
+        backoff(spins);
+    }
+    if (spins)
+        m_report.waitSeconds += wallSeconds() - wait0;
+
+    // Faster sources may already have sent later batches; keep those.
+    auto later = std::partition(m_pending.begin(), m_pending.end(),
+                                [&](const Pending &p) { return p.header.epoch == generation; });
+    out.assign(std::make_move_iterator(m_pending.begin()), std::make_move_iterator(later));
+    m_pending.erase(m_pending.begin(), later);
+}
+
+void IslandModel::Island::settle(Population &pop, std::vector<Pending> &arrived)
+{
+    // Best of every source first, then second best, ...: a fixed order
+    // that also decides who gets in when there are more migrants than
+    // places.
+    std::sort(arrived.begin(), arrived.end(), [](const Pending &a, const Pending &b) {
+        if (a.header.rank != b.header.rank)
+            return a.header.rank < b.header.rank;
+        return a.header.source < b.header.source;
+    });
+
+    std::vector<size_t> worst(pop.size());
+    for (size_t i = 0; i < pop.size(); i++)
+        worst[i] = i;
+    std::stable_sort(worst.begin(), worst.end(),
+                     [&](size_t a, size_t b) { return pop[a].fitness.score < pop[b].fitness.score; });
+
+    // Never more than half the population, so an island keeps its own line.
+    size_t places = pop.size() / 2;
+    size_t placed = 0;
+    for (Pending &p : arrived)
+    {
+        if (p.header.bytes == 0)
+            continue;
+        if (placed == places)
+            break;
+        std::unique_ptr<Program> program = AstBinary::decode(p.image.data(), p.image.size());
+        if (!program)
+        {
+            m_report.rejected++;
+            continue;
+        }
+        Individual &ind = pop[worst[placed++]];
+        ind.hash = AstHasher::hash(*program);
+        ind.program = std::move(program);
+        ind.fitness = p.header.fitness;
+        ind.fitness.evaluated = true;
+    }
+    m_report.immigrated += placed;
+}
+
+void IslandModel::Island::exchange(Population &pop, size_t generation)
+{
+    if (m_config.interval == 0 || m_config.islands < 2 || generation == 0 || generation % m_config.interval)
+        return;
+
+    std::vector<size_t> order(pop.size());
+    for (size_t i = 0; i < pop.size(); i++)
+        order[i] = i;
+    size_t picked = std::min(m_config.migrants, pop.size());
+    std::partial_sort(order.begin(), order.begin() + picked, order.end(), [&](size_t a, size_t b) {
+        if (pop[a].fitness.score != pop[b].fitness.score)
+            return pop[a].fitness.score > pop[b].fitness.score;
+        return a < b;
+    });
+
+    std::vector<size_t> to = destinations(generation);
+    std::vector<uint8_t> image;
+    for (size_t r = 0; r < m_config.migrants; r++)
+    {
+        // Ranks with nothing to send still go out as empty cells, which is
+        // how a synchronous receiver knows the batch is complete.
+        MigrantHeader header;
+        header.epoch = generation;
+        header.source = static_cast<uint32_t>(m_index);
+        header.rank = static_cast<uint32_t>(r);
+        image.clear();
+        if (r < picked)
+        {
+            const Individual &ind = pop[order[r]];
+            image = AstBinary::encode(*ind.program);
+            header.fitness = ind.fitness;
+            if (image.size() > m_config.slotBytes)
+            {
+                m_report.oversized++;
+                image.clear();
+            }
+        }
+        header.bytes = static_cast<uint32_t>(image.size());
+        for (size_t dest : to)
+            deliver(dest, header, image);
+    }
+
+    std::vector<Pending> arrived;
+    collect(generation, arrived);
+    settle(pop, arrived);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// IslandModel
+
+IslandModel::IslandModel(IslandConfig config, FitnessFn fitness)
+    : m_config(config), m_fitness(std::move(fitness))
+{
+}
+
+IslandModel::Slot &IslandModel::slot(size_t island)
+{
+    return reinterpret_cast<Slot *>(m_memory.data() + m_slotsOffset)[island];
+}
+
+MigrationRing &IslandModel::inbox(size_t island)
+{
+    return *reinterpret_cast<MigrationRing *>(m_memory.data() + m_ringsOffset + island * m_ringBytes);
+}
+
+MigrationRing &IslandModel::results()
+{
+    return *reinterpret_cast<MigrationRing *>(m_memory.data() + m_resultsOffset);
+}
+
+const Individual *IslandModel::best() const
+{
+    if (m_champions.empty())
+        return nullptr;
+    return &*std::max_element(m_champions.begin(), m_champions.end(),
+                              [](const Individual &a, const Individual &b) { return a.fitness.score < b.fitness.score; });
+}
+
+// [stop flag][Slot x islands][inbox ring x islands][results ring]
+bool IslandModel::mapShared(std::string *error)
+{
+    size_t k = m_config.islands;
+    m_slotsOffset = 64;
+    m_ringsOffset = roundUp(m_slotsOffset + k * sizeof(Slot), 64);
+    m_ringBytes = MigrationRing::bytesFor(m_config.inboxSlots, m_config.slotBytes);
+    m_resultsOffset = m_ringsOffset + k * m_ringBytes;
+    size_t total = m_resultsOffset + MigrationRing::bytesFor(k, m_config.slotBytes);
+    // Pages are only backed once touched, so generous rings cost little.
+    if (!m_memory.create(total, error))
+        return false;
+
+    m_stop = new (m_memory.data()) std::atomic<uint32_t>(0);
+    for (size_t i = 0; i < k; i++)
+    {
+        Slot *s = new (&slot(i)) Slot();
+        s->report.island = i;
+    }
+    for (size_t i = 0; i < k; i++)
+        MigrationRing::create(&inbox(i), m_config.inboxSlots, m_config.slotBytes);
+    MigrationRing::create(&results(), k, m_config.slotBytes);
+    return true;
+}
+
+void IslandModel::runIsland(size_t index, const std::vector<int> &cpus)
+{
+    Slot &mine = slot(index);
+    IslandReport &report = mine.report;
+    double wall0 = wallSeconds();
+
+    // Pin first: the pool threads created below inherit it.
+    if (pinCurrentThread(cpus))
+        report.cpus = static_cast<unsigned>(cpus.size());
+
+    GAConfig ga = m_config.ga;
+    ga.seed = hashCombine(m_config.ga.seed, index);
+    if (ga.threads == 0)
+    {
+        unsigned share = std::thread::hardware_concurrency() / static_cast<unsigned>(m_config.islands);
+        ga.threads = report.cpus ? report.cpus : std::max(1u, share);
+    }
+
+    GAController controller(ga, m_fitness);
+    if (m_setup)
+        m_setup(controller, index);
+    Island island(*this, index, report);
+    controller.setMigration([&](Population &pop, size_t generation) { island.exchange(pop, generation); });
+    controller.seed(m_seeds(index));
+
+    while (controller.generation() < ga.generations && !controller.population().empty())
+    {
+        const GenerationStats &s = controller.step();
+        report.bestFitness = std::max(report.bestFitness, s.bestFitness);
+        if (s.bestFitness >= ga.targetFitness)
+        {
+            m_stop->store(1, std::memory_order_relaxed);
+            break;
+        }
+        if (!m_config.synchronous && m_stop->load(std::memory_order_relaxed))
+            break;
+    }
+    report.generations = controller.generation();
+
+    // The champion travels like a migrant, through the results ring.
+    if (!controller.population().empty())
+    {
+        const Individual &best = controller.best();
+        std::vector<uint8_t> image = AstBinary::encode(*best.program);
+        MigrantHeader header;
+        header.epoch = controller.generation();
+        header.source = static_cast<uint32_t>(index);
+        header.fitness = best.fitness;
+        if (image.size() <= m_config.slotBytes)
+        {
+            header.bytes = static_cast<uint32_t>(image.size());
+            results().push(header, image.data());
+        }
+        else
+        {
+            report.oversized++;
+        }
+    }
+    report.wallSeconds = wallSeconds() - wall0;
+    report.completed = true;
+    mine.finished.store(1, std::memory_order_release);
+}
+
+bool IslandModel::run(std::string *error)
+{
+    m_reports.clear();
+    m_champions.clear();
+    size_t k = m_config.islands;
+    if (k == 0 || !m_seeds)
+    {
+        if (error)
+            *error = k == 0 ? "no islands configured" : "no seeds for the islands";
+        return false;
+    }
+    if (!mapShared(error))
+        return false;
+
+    std::vector<std::vector<int>> cpus(k);
+    if (m_config.pinning != IslandPinning::None)
+        cpus = splitCpus(k, m_config.pinning == IslandPinning::NumaNodes);
+
+    bool ok = true;
+    if (m_config.mode == IslandMode::Threads)
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(k);
+        for (size_t i = 0; i < k; i++)
+            threads.emplace_back([this, i, &cpus] { runIsland(i, cpus[i]); });
+        for (auto &t : threads)
+            t.join();
+    }
+    else
+    {
+        // Children run their island and _exit, never returning into the
+        // caller's code; buffered output is flushed so it is not repeated.
+        std::fflush(nullptr);
+        std::vector<pid_t> children(k, -1);
+        for (size_t i = 0; i < k; i++)
+        {
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                runIsland(i, cpus[i]);
+                std::fflush(nullptr);
+                _exit(0);
+            }
+            if (pid < 0)
+            {
+                if (error)
+                    *error = "cannot fork island " + std::to_string(i);
+                ok = false;
+                // Islands that never start count as finished, so nobody
+                // waits for their migrants.
+                for (size_t j = i; j < k; j++)
+                    slot(j).finished.store(1, std::memory_order_release);
+                m_stop->store(1, std::memory_order_relaxed);
+                break;
+            }
+            children[i] = pid;
+        }
+        for (size_t left = std::count_if(children.begin(), children.end(), [](pid_t p) { return p > 0; }); left;)
+        {
+            int status = 0;
+            pid_t pid = waitpid(-1, &status, 0);
+            if (pid < 0)
+                break;
+            auto it = std::find(children.begin(), children.end(), pid);
+            if (it == children.end())
+                continue;
+            left--;
+            // A crashed island stops sending; release whoever waits on it.
+            slot(static_cast<size_t>(it - children.begin())).finished.store(1, std::memory_order_release);
+        }
+    }
+
+    for (size_t i = 0; i < k; i++)
+        m_reports.push_back(slot(i).report);
+    MigrantHeader header;
+    std::vector<uint8_t> image;
+    std::vector<Individual> found(k);
+    // Every island has exited, so nothing still in the ring is being written.
+    auto abandoned = [](uint32_t) { return true; };
+    while (results().pop(header, image, abandoned))
+    {
+        if (header.source >= k)
+            continue;
+        Individual &ind = found[header.source];
+        ind.program = AstBinary::decode(image.data(), image.size());
+        if (!ind.program)
+            continue;
+        ind.fitness = header.fitness;
+        ind.hash = AstHasher::hash(*ind.program);
+    }
+    for (Individual &ind : found)
+        if (ind.program)
+            m_champions.push_back(std::move(ind));
+    m_memory.release();
+    m_stop = nullptr;
+    return ok;
+}
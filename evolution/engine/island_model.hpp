@@ -0,0 +1,135 @@
+#pragma once
+#include "ga_controller.hpp"
+#include "migration_ring.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Island-model GA: K GAControllers evolve apart and trade their best
+// individuals every few generations, on one Linux machine.
+//
+// Islands run as threads of this process or as forked child processes.
+// Either way they talk only through one anonymous shared mapping that
+// holds a MigrationRing inbox per island (see migration_ring.hpp):
+// emigrants travel as AstBinary images with their fitness records, are
+// decoded by the receiver and replace its worst individuals without being
+// scored again. Each island can be pinned to its own slice of cores or to
+// a NUMA node, and its controller's pool is sized to that slice.
+//
+// With `synchronous` set, an island that reaches a migration generation
+// waits until all its sources have delivered that generation's migrants
+// and takes them in a fixed order, so a run is bit-identical from one
+// execution to the next and in either mode. Otherwise islands never wait:
+// they take whatever has arrived, a full inbox drops the migrant, and the
+// first island to reach targetFitness stops the others at their next
+// generation.
+
+enum class IslandMode : uint8_t
+{
+    Threads,
+    Processes
+};
+
+enum class MigrationTopology : uint8_t
+{
+    Ring,           // island i sends to i + 1
+    FullyConnected, // every island sends to every other one
+    RandomRing      // i sends to i + k, k drawn afresh for every migration
+};
+
+enum class IslandPinning : uint8_t
+{
+    None,
+    Cores,    // contiguous, disjoint slices of the allowed CPUs
+    NumaNodes // island i on node i % nodes, sharing it with its neighbours there
+};
+
+struct IslandConfig
+{
+    size_t islands = 4;
+    IslandMode mode = IslandMode::Threads;
+    MigrationTopology topology = MigrationTopology::Ring;
+    size_t interval = 5; // generations between migrations; 0 = never
+    size_t migrants = 2; // individuals each island sends to each destination
+    bool synchronous = true;
+    IslandPinning pinning = IslandPinning::Cores;
+    size_t inboxSlots = 64;       // migrants an inbox holds before senders wait or drop
+    size_t slotBytes = 64 << 10;  // largest image a migrant may have; larger ones stay home
+    // Per-island settings. Island i runs with seed hashCombine(ga.seed, i);
+    // ga.threads == 0 gives it one worker per CPU of its slice (or an even
+    // share of the machine when unpinned).
+    GAConfig ga;
+};
+
+struct IslandReport
+{
+    size_t island = 0;
+    size_t generations = 0;
+    double bestFitness = 0.0;
+    size_t emigrated = 0;   // migrants delivered to other inboxes
+    size_t immigrated = 0;  // migrants taken into the population
+    size_t oversized = 0;   // emigrants whose image exceeded slotBytes
+    size_t dropped = 0;     // migrants lost to a full inbox or a finished island
+    size_t rejected = 0;    // received images that failed to decode
+    double waitSeconds = 0.0; // spent blocked on migration
+    double wallSeconds = 0.0;
+    unsigned cpus = 0;      // CPUs the island was pinned to, 0 = unpinned
+    bool completed = false; // false when its process died
+};
+static_assert(std::is_trivially_copyable<IslandReport>::value, "reports live in shared memory");
+
+// Configures island `island`'s controller (operators, cache, racing, ...).
+// Runs on the island's own thread or process, concurrently with the other
+// islands in thread mode.
+using IslandSetup = std::function<void(GAController &ga, size_t island)>;
+// Initial programs for island `island`; same threading as IslandSetup.
+using IslandSeeds = std::function<std::vector<std::unique_ptr<Program>>(size_t island)>;
+
+class IslandModel
+{
+public:
+    IslandModel(IslandConfig config, FitnessFn fitness);
+
+    void setSetup(IslandSetup fn) { m_setup = std::move(fn); }
+    void setSeeds(IslandSeeds fn) { m_seeds = std::move(fn); }
+
+    // Run every island to completion. Returns false (and `error`) when the
+    // shared mapping or a child process cannot be created; islands that
+    // had started are still waited for and reported.
+    bool run(std::string *error = nullptr);
+
+    const std::vector<IslandReport> &reports() const { return m_reports; }
+    // Best individual of every island that finished with one whose image
+    // fit in a slot, in island order.
+    const Population &champions() const { return m_champions; }
+    const Individual *best() const;
+    const IslandConfig &config() const { return m_config; }
+
+private:
+    class Island;
+    struct Slot; // per-island state in the shared mapping
+
+    bool mapShared(std::string *error);
+    void runIsland(size_t index, const std::vector<int> &cpus);
+    Slot &slot(size_t island);
+    MigrationRing &inbox(size_t island);
+    MigrationRing &results();
+
+    IslandConfig m_config;
+    FitnessFn m_fitness;
+    IslandSetup m_setup;
+    IslandSeeds m_seeds;
+    SharedMemory m_memory;
+    std::atomic<uint32_t> *m_stop = nullptr; // set once an island reaches targetFitness
+    size_t m_slotsOffset = 0;
+    size_t m_ringsOffset = 0;
+    size_t m_ringBytes = 0;
+    size_t m_resultsOffset = 0;
+    std::vector<IslandReport> m_reports;
+    Population m_champions;
+};
@@ -0,0 +1,203 @@
+#include "migration_ring.hpp"
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
+
+namespace
+{
+    size_t roundUp(size_t n, size_t to) { return (n + to - 1) / to * to; }
+
+    size_t ringHeaderBytes(size_t ringSize) { return roundUp(ringSize, 64); }
+
+    constexpr unsigned kOwnerBits = 24;
+    constexpr uint64_t kOwnerMask = (uint64_t(1) << kOwnerBits) - 1;
+
+    uint64_t claimFor(uint64_t pos, uint32_t producer) { return pos << kOwnerBits | (producer + 1); }
+    bool claimedAt(uint64_t claim, uint64_t pos)
+    {
+        return (claim >> kOwnerBits) == (pos & (~uint64_t(0) >> kOwnerBits)) && (claim & kOwnerMask) != 0;
+    }
+    uint32_t claimOwner(uint64_t claim) { return static_cast<uint32_t>((claim & kOwnerMask) - 1); }
+
+    // A power of two, and at least two: with a single cell a filled cell's
+    // sequence (pos + 1) would read as free to the next producer.
+    size_t ringSlots(size_t slots)
+    {
+        size_t n = 2;
+        while (n < slots)
+            n <<= 1;
+        return n;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// SharedMemory
+
+SharedMemory::~SharedMemory()
+{
+    release();
+}
+
+bool SharedMemory::create(size_t bytes, std::string *error)
+{
+    release();
+    void *addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED)
+    {
+        if (error)
+            *error = std::string("cannot map shared memory: ") + std::strerror(errno);
+        return false;
+    }
+    m_addr = addr;
+    m_size = bytes;
+    return true;
+}
+
+void SharedMemory::release()
+{
+    if (m_addr)
+        munmap(m_addr, m_size);
+    m_addr = nullptr;
+    m_size = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// MigrationRing
+
+size_t MigrationRing::cellBytes(size_t payloadBytes)
+{
+    return roundUp(sizeof(Cell) + payloadBytes, 64);
+}
+
+size_t MigrationRing::bytesFor(size_t slots, size_t payloadBytes)
+{
+    size_t n = ringSlots(slots);
+    return ringHeaderBytes(sizeof(MigrationRing)) + n * cellBytes(payloadBytes);
+}
+
+MigrationRing *MigrationRing::create(void *at, size_t slots, size_t payloadBytes)
+{
+    size_t n = ringSlots(slots);
+    MigrationRing *ring = new (at) MigrationRing();
+    ring->m_mask = n - 1;
+    ring->m_payloadBytes = payloadBytes;
+    ring->m_cellBytes = cellBytes(payloadBytes);
+    for (uint64_t i = 0; i < n; i++)
+    {
+        Cell *c = new (ring->cell(i)) Cell();
+        c->sequence.store(i, std::memory_order_relaxed);
+        c->claim.store(0, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    return ring;
+}
+
+MigrationRing::Cell *MigrationRing::cell(uint64_t pos)
+{
+    uint8_t *base = reinterpret_cast<uint8_t *>(this) + ringHeaderBytes(sizeof(MigrationRing));
+    return reinterpret_cast<Cell *>(base + (pos & m_mask) * m_cellBytes);
+}
+
+// Moves the tail from `from` to the next position unless someone already
+// did; a claimed cell's tail may be moved by anyone.
+void MigrationRing::advanceTail(uint64_t from)
+{
+    m_tail.compare_exchange_strong(from, from + 1, std::memory_order_relaxed);
+}
+
+// A cell whose sequence equals the position is free for the producer that
+// claims that position; sequence == pos + 1 marks it filled for the
+// consumer, which hands it back for the next lap with pos + slots.
+//
+// The claim is a CAS on the cell's claim word from whatever it held before
+// to (pos, producer), so the owner of a position is recorded in the same
+// atomic step that takes it, and a consumer can later tell whose
+// unpublished cell it is looking at. Positions only grow, so a stale claim
+// word never matches a current one.
+bool MigrationRing::push(const MigrantHeader &header, const void *payload)
+{
+    if (header.bytes > m_payloadBytes || header.source >= kMaxProducers)
+        return false;
+    uint64_t pos = m_tail.load(std::memory_order_relaxed);
+    Cell *c;
+    for (;;)
+    {
+        c = cell(pos);
+        uint64_t seq = c->sequence.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(seq - pos);
+        if (diff == 0)
+        {
+            uint64_t claim = c->claim.load(std::memory_order_acquire);
+            if (!claimedAt(claim, pos) &&
+                c->claim.compare_exchange_strong(claim, claimFor(pos, header.source), std::memory_order_acq_rel))
+            {
+                advanceTail(pos);
+                break;
+            }
+            // Someone else owns this position: move the tail past it for
+            // them, in case they have not (or never will).
+            advanceTail(pos);
+            pos = m_tail.load(std::memory_order_relaxed);
+        }
+        else if (diff < 0)
+        {
+            return false; // full: the cell still holds last lap's migrant
+        }
+        else
+        {
+            pos = m_tail.load(std::memory_order_relaxed);
+        }
+    }
+    c->header = header;
+    if (header.bytes)
+        std::memcpy(payloadOf(c), payload, header.bytes);
+    c->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool MigrationRing::pop(MigrantHeader &header, std::vector<uint8_t> &payload,
+                        const std::function<bool(uint32_t)> &abandoned)
+{
+    uint64_t pos = m_head.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Cell *c = cell(pos);
+        uint64_t seq = c->sequence.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(seq - (pos + 1));
+        if (diff == 0)
+        {
+            if (!m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                continue;
+            header = c->header;
+            // The mapping is writable by every island process, so the size
+            // is checked again rather than trusted.
+            bool fits = header.bytes <= m_payloadBytes;
+            if (fits)
+                payload.assign(payloadOf(c), payloadOf(c) + header.bytes);
+            c->sequence.store(pos + m_mask + 1, std::memory_order_release);
+            if (fits)
+                return true;
+            pos++;
+        }
+        else if (diff < 0)
+        {
+            // Free, or claimed and still being written.
+            if (!abandoned)
+                return false; // empty
+            uint64_t claim = c->claim.load(std::memory_order_acquire);
+            if (!claimedAt(claim, pos) || !abandoned(claimOwner(claim)))
+                return false;
+            // Its producer died holding it: hand it to the next lap unread.
+            advanceTail(pos);
+            if (!m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                continue;
+            c->sequence.store(pos + m_mask + 1, std::memory_order_release);
+            pos++;
+        }
+        else
+        {
+            pos = m_head.load(std::memory_order_relaxed);
+        }
+    }
+}
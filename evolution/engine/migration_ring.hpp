@@ -0,0 +1,120 @@
+#pragma once
+#include "../fitness/fitness.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Shared-memory transport for island migration (see island_model.hpp).
+//
+// SharedMemory is an anonymous MAP_SHARED mapping: threads see it as
+// ordinary memory and processes forked after it was created share the
+// same pages, so one layout serves both island modes without a name in
+// /dev/shm to clean up.
+//
+// MigrationRing is a bounded multi-producer multi-consumer queue
+// (Vyukov's sequenced cells) built in place inside such a mapping. Each
+// cell holds one migrant: a header with its fitness record and an
+// AstBinary image of its program. Consumers claim positions with a CAS on
+// a shared counter and every cell is published through its sequence
+// number, so no lock is ever held. The ring addresses its cells relative
+// to `this` and keeps no pointers, which is what lets every process map
+// it at a different address.
+//
+// A producer claims its cell, rather than the tail counter, with a CAS
+// that stamps the cell with the position and the producer's id
+// (header.source); whoever sees a claimed cell moves the tail past it.
+// A producer that dies between that claim and publishing still blocks
+// the cell, and everything behind it, for consumers that pop() without a
+// predicate. A consumer that can tell a dead producer from a slow one
+// (IslandModel uses the finished flag its parent sets after waitpid)
+// passes pop() an `abandoned` predicate, and cells claimed by a producer
+// it names are skipped unread. A consumer that dies mid-pop is not
+// recovered: it is the only reader of its inbox, so producers see it as
+// finished and stop sending.
+
+class SharedMemory
+{
+public:
+    SharedMemory() = default;
+    ~SharedMemory();
+    SharedMemory(const SharedMemory &) = delete;
+    SharedMemory &operator=(const SharedMemory &) = delete;
+
+    // Map `bytes` of zeroed memory; false (and `error`) on failure.
+    bool create(size_t bytes, std::string *error = nullptr);
+    void release();
+
+    uint8_t *data() const { return static_cast<uint8_t *>(m_addr); }
+    size_t size() const { return m_size; }
+
+private:
+    void *m_addr = nullptr;
+    size_t m_size = 0;
+};
+
+struct MigrantHeader
+{
+    uint64_t epoch = 0;  // generation the migrant left its island
+    uint32_t source = 0; // island it came from
+    uint32_t rank = 0;   // 0 = best of its batch
+    uint32_t bytes = 0;  // image size; 0 = placeholder (image did not fit)
+    FitnessRecord fitness;
+};
+static_assert(std::is_trivially_copyable<MigrantHeader>::value, "migrants are copied between processes");
+
+class MigrationRing
+{
+public:
+    // Bytes to reserve for a ring of `slots` cells (rounded up to a power
+    // of two, at least 2) with room for `payloadBytes` of image each.
+    static size_t bytesFor(size_t slots, size_t payloadBytes);
+
+    // Construct an empty ring at `at`, which must be 64-byte aligned and
+    // bytesFor(slots, payloadBytes) long.
+    static MigrationRing *create(void *at, size_t slots, size_t payloadBytes);
+
+    // Enqueue a migrant whose image is header.bytes long at `payload`, as
+    // producer header.source (below kMaxProducers). Returns false when the
+    // ring is full or the image is too large.
+    bool push(const MigrantHeader &header, const void *payload);
+
+    // Dequeue the oldest migrant; false when the ring is empty. Cells that
+    // claim an image larger than payloadBytes() were written by something
+    // other than push() and are dropped. With `abandoned`, a cell claimed
+    // but never published by a producer for which abandoned(source) holds
+    // is skipped instead of reading as the end of the ring.
+    bool pop(MigrantHeader &header, std::vector<uint8_t> &payload,
+             const std::function<bool(uint32_t source)> &abandoned = {});
+
+    static constexpr uint32_t kMaxProducers = (1u << 24) - 1;
+
+    size_t slots() const { return static_cast<size_t>(m_mask + 1); }
+    size_t payloadBytes() const { return static_cast<size_t>(m_payloadBytes); }
+
+private:
+    struct Cell
+    {
+        std::atomic<uint64_t> sequence;
+        std::atomic<uint64_t> claim; // position << 24 | (producer + 1); see push()
+        MigrantHeader header;
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                  "the ring needs address-free atomics to work across processes");
+
+    MigrationRing() = default;
+    static size_t cellBytes(size_t payloadBytes);
+    Cell *cell(uint64_t pos);
+    uint8_t *payloadOf(Cell *c) { return reinterpret_cast<uint8_t *>(c) + sizeof(Cell); }
+    void advanceTail(uint64_t from);
+
+    alignas(64) std::atomic<uint64_t> m_head{0}; // next position to pop
+    alignas(64) std::atomic<uint64_t> m_tail{0}; // next position to push
+    alignas(64) uint64_t m_mask = 0;
+    uint64_t m_payloadBytes = 0;
+    uint64_t m_cellBytes = 0;
+};
@@ -0,0 +1,239 @@
+#include "steady_state.hpp"
+#include "../../core/parser/ast_clone.hpp"
+#include "../../core/parser/ast_hash.hpp"
+#include "../../core/utils/timer.hpp"
+#include <algorithm>
+
+SteadyStateGA::SteadyStateGA(GAConfig config, FitnessFn fitness)
+    : m_config(config), m_fitness(std::move(fitness)), m_pool(config.threads)
+{
+    m_workspaces.resize(m_pool.size());
+    for (unsigned i = 0; i < m_pool.size(); i++)
+        m_workspaces[i].worker = i;
+    if (m_config.simplify)
+        m_simplifiers.resize(m_pool.size());
+}
+
+void SteadyStateGA::setHeaders(HeaderCache *cache, const std::vector<std::string> &searchPaths)
+{
+    for (EvalWorkspace &ws : m_workspaces)
+        ws.headers = cache ? std::make_unique<HeaderResolver>(*cache, searchPaths) : nullptr;
+}
+
+void SteadyStateGA::seed(std::vector<std::unique_ptr<Program>> programs)
+{
+    m_slots.reset();
+    m_size = 0;
+    m_history.clear();
+    m_stats = SteadyStateStats();
+    if (programs.empty())
+        return;
+    m_size = std::max(m_config.populationSize, programs.size());
+    m_slots.reset(new Slot[m_size]);
+    for (size_t i = 0; i < m_size; i++)
+    {
+        if (i < programs.size())
+            m_slots[i].program = std::move(programs[i]);
+        else
+            m_slots[i].program = AstCloner::clone(*m_slots[i % programs.size()].program);
+    }
+}
+
+FitnessRecord SteadyStateGA::score(const Program &prog, uint64_t hash, unsigned worker)
+{
+    FitnessRecord record;
+    if (m_cache && m_cache->lookup(hash, record))
+    {
+        m_cacheHits.fetch_add(1, std::memory_order_relaxed);
+        return record;
+    }
+    record = m_fitness(prog, m_workspaces[worker]);
+    record.evaluated = true;
+    m_evaluated.fetch_add(1, std::memory_order_relaxed);
+    if (isLimitOutcome(record.outcome))
+        m_limited.fetch_add(1, std::memory_order_relaxed);
+    if (m_cache)
+        m_cache->insert(hash, record);
+    return record;
+}
+
+// Best (or, for replacement, worst) of tournamentSize random slots, by the
+// lock-free score mirror. A score may change under us; the winner is only
+// a good candidate, which is all a tournament promises anyway.
+size_t SteadyStateGA::tournament(RandomStream &rng, bool worst) const
+{
+    size_t pick = rng.below(m_size);
+    double at = m_slots[pick].score.load(std::memory_order_relaxed);
+    for (size_t k = 1; k < m_config.tournamentSize; k++)
+    {
+        size_t c = rng.below(m_size);
+        double s = m_slots[c].score.load(std::memory_order_relaxed);
+        if (worst ? s < at : s > at)
+        {
+            pick = c;
+            at = s;
+        }
+    }
+    return pick;
+}
+
+std::shared_ptr<const Program> SteadyStateGA::parent(size_t slot) const
+{
+    std::lock_guard<std::mutex> lock(m_slots[slot].mutex);
+    return m_slots[slot].program;
+}
+
+bool SteadyStateGA::offer(RandomStream &rng, std::shared_ptr<const Program> child, const FitnessRecord &fitness,
+                          uint64_t hash)
+{
+    Slot &slot = m_slots[tournament(rng, true)];
+    std::shared_ptr<const Program> old;
+    {
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        // Checked again under the lock: another worker may have put a
+        // better individual here since the tournament looked.
+        if (fitness.score < slot.fitness.score)
+            return false;
+        old = std::move(slot.program);
+        slot.program = std::move(child);
+        slot.fitness = fitness;
+        slot.hash = hash;
+        slot.score.store(fitness.score, std::memory_order_relaxed);
+    }
+    // `old` is freed here, outside the lock, unless a breeder still holds it.
+    return true;
+}
+
+void SteadyStateGA::work(unsigned worker)
+{
+    for (;;)
+    {
+        uint64_t birth = m_nextBirth.fetch_add(1, std::memory_order_relaxed);
+        if (birth >= m_budget || m_stop.load(std::memory_order_relaxed))
+            return;
+        double t0 = wallSeconds();
+
+        RandomStream select(m_config.seed, birth >> 32, birth, RngStream::Selection);
+        RandomStream cross(m_config.seed, birth >> 32, birth, RngStream::Crossover);
+        RandomStream mutate(m_config.seed, birth >> 32, birth, RngStream::Mutation);
+
+        std::shared_ptr<const Program> a = parent(tournament(select, false));
+        std::unique_ptr<Program> child;
+        if (m_crossover && select.chance(m_config.crossoverRate))
+        {
+            std::shared_ptr<const Program> b = parent(tournament(select, false));
+            child = m_crossover(*a, *b, cross);
+        }
+        if (!child)
+            child = AstCloner::clone(*a);
+        a.reset();
+        if (m_mutate && mutate.chance(m_config.mutationRate))
+            m_mutate(*child, mutate);
+        if (!m_simplifiers.empty() && m_simplifiers[worker].simplify(*child))
+            m_simplified.fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t hash = m_cache ? AstHasher::hash(*child) : 0;
+        FitnessRecord record = score(*child, hash, worker);
+        if (offer(select, std::move(child), record, hash))
+            m_replaced.fetch_add(1, std::memory_order_relaxed);
+        if (record.score >= m_config.targetFitness)
+            m_stop.store(true, std::memory_order_relaxed);
+
+        m_busyNanos.fetch_add(static_cast<uint64_t>((wallSeconds() - t0) * 1e9), std::memory_order_relaxed);
+        uint64_t done = m_births.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (done % m_size == 0)
+        {
+            std::lock_guard<std::mutex> lock(m_progressMutex);
+            m_history.push_back(snapshot());
+            if (m_onProgress && *m_onProgress)
+                (*m_onProgress)(m_history.back());
+        }
+    }
+}
+
+SteadyStateStats SteadyStateGA::snapshot() const
+{
+    SteadyStateStats s;
+    s.births = m_births.load(std::memory_order_relaxed);
+    s.evaluated = m_evaluated.load(std::memory_order_relaxed);
+    s.cacheHits = m_cacheHits.load(std::memory_order_relaxed);
+    s.limited = m_limited.load(std::memory_order_relaxed);
+    s.replaced = m_replaced.load(std::memory_order_relaxed);
+    s.simplified = m_simplified.load(std::memory_order_relaxed);
+    s.wallSeconds = wallSeconds() - m_wall0;
+    s.cpuSeconds = processCpuSeconds() - m_cpu0;
+    s.busySeconds = m_busyNanos.load(std::memory_order_relaxed) * 1e-9;
+    s.candidatesPerSecond = s.wallSeconds > 0.0 ? (s.evaluated + s.cacheHits) / s.wallSeconds : 0.0;
+    double sum = 0.0;
+    s.bestFitness = m_size ? m_slots[0].score.load(std::memory_order_relaxed) : 0.0;
+    for (size_t i = 0; i < m_size; i++)
+    {
+        double v = m_slots[i].score.load(std::memory_order_relaxed);
+        sum += v;
+        s.bestFitness = std::max(s.bestFitness, v);
+    }
+    s.meanFitness = m_size ? sum / m_size : 0.0;
+    return s;
+}
+
+void SteadyStateGA::run(const std::function<void(const SteadyStateStats &)> &onProgress)
+{
+    if (!m_size)
+        return;
+    m_wall0 = wallSeconds();
+    m_cpu0 = processCpuSeconds();
+    m_onProgress = &onProgress;
+    for (auto *c : {&m_nextBirth, &m_births, &m_evaluated, &m_cacheHits, &m_limited, &m_replaced, &m_simplified,
+                    &m_busyNanos})
+        c->store(0);
+    m_stop = false;
+
+    // The seeds are the one batch: nothing can be bred before they have
+    // scores to select on.
+    m_pool.parallelFor(m_size, [&](size_t i, unsigned worker) {
+        Slot &slot = m_slots[i];
+        double t0 = wallSeconds();
+        slot.hash = m_cache ? AstHasher::hash(*slot.program) : 0;
+        slot.fitness = score(*slot.program, slot.hash, worker);
+        slot.score.store(slot.fitness.score, std::memory_order_relaxed);
+        if (slot.fitness.score >= m_config.targetFitness)
+            m_stop.store(true, std::memory_order_relaxed);
+        m_busyNanos.fetch_add(static_cast<uint64_t>((wallSeconds() - t0) * 1e9), std::memory_order_relaxed);
+    });
+
+    size_t generations = std::max<size_t>(m_config.generations, 1);
+    m_budget = (generations - 1) * m_size;
+    m_pool.parallelFor(m_pool.size(), [&](size_t, unsigned worker) { work(worker); });
+
+    m_stats = snapshot();
+    m_onProgress = nullptr;
+}
+
+Population SteadyStateGA::population() const
+{
+    Population pop(m_size);
+    for (size_t i = 0; i < m_size; i++)
+    {
+        std::lock_guard<std::mutex> lock(m_slots[i].mutex);
+        pop[i].program = AstCloner::clone(*m_slots[i].program);
+        pop[i].fitness = m_slots[i].fitness;
+        pop[i].hash = m_slots[i].hash;
+    }
+    return pop;
+}
+
+Individual SteadyStateGA::best() const
+{
+    Individual out;
+    size_t at = 0;
+    for (size_t i = 1; i < m_size; i++)
+        if (m_slots[i].score.load(std::memory_order_relaxed) > m_slots[at].score.load(std::memory_order_relaxed))
+            at = i;
+    if (!m_size)
+        return out;
+    std::lock_guard<std::mutex> lock(m_slots[at].mutex);
+    out.program = AstCloner::clone(*m_slots[at].program);
+    out.fitness = m_slots[at].fitness;
+    out.hash = m_slots[at].hash;
+    return out;
+}
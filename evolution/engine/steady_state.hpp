@@ -0,0 +1,137 @@
+#pragma once
+#include "../../core/semantic/simplifier.hpp"
+#include "../../core/utils/thread_pool.hpp"
+#include "../fitness/fitness.hpp"
+#include "../fitness/fitness_cache.hpp"
+#include "ga_controller.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Asynchronous steady-state GA: no generations, no barrier.
+//
+// Every pool worker loops on its own: take the next birth number, pick
+// parents by tournament, breed and score one offspring, then offer it to
+// the population, where it replaces the worst of a random tournament
+// unless that one scores higher. A worker whose candidate runs long
+// holds up nobody, so cores stay busy however unevenly evaluations cost.
+//
+// The population is a table of slots, each behind its own mutex. Scores
+// are mirrored in atomics, so tournaments compare without locking and
+// only the winner's slot is locked, to take a reference to its program;
+// parents are shared and immutable, so a replacement never disturbs an
+// offspring being bred from the old occupant.
+//
+// Operators draw from RandomStreams keyed by birth number, so with one
+// thread a run is bit-identical; with more, which parents a birth sees
+// depends on timing. GAConfig is read as for GAController, except that:
+//   generations  sets the budget, generations * populationSize candidates
+//                including the seeds (what a generational run scores);
+//   eliteCount   is implied: the best individual only gives way to a
+//                better one;
+//   dedupe       is left to the FitnessCache.
+// There is no population-wide PrepareFn step, so operators must work from
+// the parents alone, as SubtreeCrossover does when it was never prepared.
+
+struct SteadyStateStats
+{
+    uint64_t births = 0;      // offspring bred so far
+    uint64_t evaluated = 0;   // fitness calls made
+    uint64_t cacheHits = 0;   // offspring answered by the FitnessCache
+    uint64_t limited = 0;     // evaluations stopped by a VM limit
+    uint64_t replaced = 0;    // offspring that took a place in the population
+    uint64_t simplified = 0;  // offspring the Simplifier accepted
+    double wallSeconds = 0.0; // since run() started
+    double cpuSeconds = 0.0;  // process CPU time over the same span
+    double busySeconds = 0.0; // summed over workers: breeding + scoring + inserting
+    double candidatesPerSecond = 0.0;
+    double bestFitness = 0.0;
+    double meanFitness = 0.0;
+
+    // Share of the workers' wall time spent on offspring.
+    double utilization(unsigned workers) const
+    {
+        return wallSeconds > 0.0 && workers ? busySeconds / (wallSeconds * workers) : 0.0;
+    }
+};
+
+class SteadyStateGA
+{
+public:
+    SteadyStateGA(GAConfig config, FitnessFn fitness);
+
+    void setMutation(MutationFn fn) { m_mutate = std::move(fn); }
+    void setCrossover(CrossoverFn fn) { m_crossover = std::move(fn); }
+    // Optional memo shared across runs (and controllers); not owned.
+    void setFitnessCache(FitnessCache *cache) { m_cache = cache; }
+    // Resolve the header() declarations of candidates through `cache`
+    // (shared, not owned) and `searchPaths`, one resolver per worker (see
+    // EvalWorkspace::link). nullptr goes back to ignoring them.
+    void setHeaders(HeaderCache *cache, const std::vector<std::string> &searchPaths = {});
+
+    // Initial population, cycled (and cloned) up to populationSize.
+    void seed(std::vector<std::unique_ptr<Program>> programs);
+
+    // Score the seeds, then breed until the birth budget is spent or an
+    // offspring reaches targetFitness. onProgress runs on a worker every
+    // populationSize births (one generation's worth), serialised.
+    void run(const std::function<void(const SteadyStateStats &)> &onProgress = {});
+
+    // Copies of the current individuals and of the best one.
+    Population population() const;
+    Individual best() const;
+    const SteadyStateStats &stats() const { return m_stats; }
+    const std::vector<SteadyStateStats> &history() const { return m_history; }
+    const GAConfig &config() const { return m_config; }
+    unsigned workers() const { return m_pool.size(); }
+
+private:
+    struct alignas(64) Slot
+    {
+        mutable std::mutex mutex;
+        std::shared_ptr<const Program> program;
+        FitnessRecord fitness;
+        uint64_t hash = 0;
+        std::atomic<double> score{0.0}; // fitness.score, readable without the lock
+    };
+
+    void work(unsigned worker);
+    FitnessRecord score(const Program &prog, uint64_t hash, unsigned worker);
+    size_t tournament(RandomStream &rng, bool worst) const;
+    std::shared_ptr<const Program> parent(size_t slot) const;
+    bool offer(RandomStream &rng, std::shared_ptr<const Program> child, const FitnessRecord &fitness, uint64_t hash);
+    SteadyStateStats snapshot() const;
+
+    GAConfig m_config;
+    FitnessFn m_fitness;
+    MutationFn m_mutate;
+    CrossoverFn m_crossover;
+    FitnessCache *m_cache = nullptr;
+    ThreadPool m_pool;
+    std::vector<EvalWorkspace> m_workspaces; // one per pool worker
+    std::vector<Simplifier> m_simplifiers;   // one per pool worker, if config.simplify
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_size = 0;
+
+    uint64_t m_budget = 0;
+    std::atomic<uint64_t> m_nextBirth{0};
+    std::atomic<uint64_t> m_births{0};
+    std::atomic<uint64_t> m_evaluated{0};
+    std::atomic<uint64_t> m_cacheHits{0};
+    std::atomic<uint64_t> m_limited{0};
+    std::atomic<uint64_t> m_replaced{0};
+    std::atomic<uint64_t> m_simplified{0};
+    std::atomic<uint64_t> m_busyNanos{0};
+    std::atomic<bool> m_stop{false};
+
+    std::mutex m_progressMutex;
+    const std::function<void(const SteadyStateStats &)> *m_onProgress = nullptr;
+    double m_wall0 = 0.0;
+    double m_cpu0 = 0.0;
+    SteadyStateStats m_stats;
+    std::vector<SteadyStateStats> m_history;
+};
@@ -0,0 +1,119 @@
+#include "fitness.hpp"
+#include "../../core/lexer/lexer.hpp"
+#include "../../core/parser/parser.hpp"
+#include "../../core/parser/ast_clone.hpp"
+#include "../../core/parser/ast_printer.hpp"
+#include <unordered_set>
+
+bool EvalWorkspace::reparse(const Program &prog)
+{
+    source = AstPrinter::print(prog);
+    Lexer lexer(source);
+    tokens = lexer.tokenize();
+    Parser parser(tokens);
+    parser.setEcho(false);
+    parser.parse();
+    errors = parser.errors();
+    return errors.empty();
+}
+
+const Program *EvalWorkspace::link(const Program &prog)
+{
+    bool declares = false;
+    for (const auto &d : prog.decls)
+        declares = declares || dynamic_cast<const HeaderDecl *>(d.get());
+    if (!headers || !declares)
+        return &prog;
+    std::vector<ResolvedHeader> resolved;
+    if (!headers->resolve(prog, resolved))
+    {
+        errors = headers->errors();
+        return nullptr;
+    }
+
+    // Header ASTs are shared between workers and the checker leaves its
+    // bindings on the tree, so what is used is copied. The program's own
+    // definitions win, then the first header (dependencies come first).
+    linked = AstCloner::clone(prog);
+    std::unordered_set<std::string> defined;
+    for (const auto &d : prog.decls)
+        if (auto f = dynamic_cast<const FuncDecl *>(d.get()))
+            defined.insert(f->name);
+    for (const auto &v : prog.globalVars)
+        defined.insert(v->varName);
+    std::vector<DeclPtr> decls;
+    std::vector<std::unique_ptr<VarDecl>> globals;
+    for (const ResolvedHeader &h : resolved)
+    {
+        for (const auto &d : h.parsed->program->decls)
+            if (auto f = dynamic_cast<const FuncDecl *>(d.get()); f && defined.insert(f->name).second)
+                decls.push_back(AstCloner::clone(f));
+        for (const auto &v : h.parsed->program->globalVars)
+            if (defined.insert(v->varName).second)
+                globals.push_back(AstCloner::clone(v.get()));
+    }
+    for (auto &d : linked->decls)
+        decls.push_back(std::move(d));
+    for (auto &v : linked->globalVars)
+        globals.push_back(std::move(v));
+    linked->decls = std::move(decls);
+    linked->globalVars = std::move(globals);
+    return linked.get();
+}
+
+bool EvalWorkspace::check(const Program &prog)
+{
+    const Program *p = link(prog);
+    bool ok = checker.check(p ? *p : prog, true);
+    errors = checker.errors();
+    return ok;
+}
+
+bool EvalWorkspace::compile(const Program &prog)
+{
+    const Program *p = link(prog);
+    if (!p)
+    {
+        module.reset();
+        return false;
+    }
+    module = compiler.compile(*p);
+    errors = compiler.errors();
+    return module != nullptr;
+}
+
+FitnessOutcome EvalWorkspace::run(const std::string &entry, const std::vector<Value> &args)
+{
+    if (!module)
+        return FitnessOutcome::CompileError;
+    result = vm.run(*module, entry, args);
+    return outcomeOf(result.status);
+}
+
+FitnessOutcome outcomeOf(VmStatus status)
+{
+    switch (status)
+    {
+    case VmStatus::Ok: return FitnessOutcome::Ok;
+    case VmStatus::StepLimit: return FitnessOutcome::StepLimit;
+    case VmStatus::DepthLimit: return FitnessOutcome::DepthLimit;
+    case VmStatus::MemoryLimit: return FitnessOutcome::MemoryLimit;
+    default: return FitnessOutcome::RuntimeError;
+    }
+}
+
+const char *to_string(FitnessOutcome o)
+{
+    switch (o)
+    {
+    case FitnessOutcome::Ok: return "ok";
+    case FitnessOutcome::ParseError: return "parse error";
+    case FitnessOutcome::SemanticError: return "semantic error";
+    case FitnessOutcome::CompileError: return "compile error";
+    case FitnessOutcome::RuntimeError: return "runtime error";
+    case FitnessOutcome::StepLimit: return "step limit";
+    case FitnessOutcome::DepthLimit: return "depth limit";
+    case FitnessOutcome::MemoryLimit: return "memory limit";
+    default: return "?";
+    }
+}
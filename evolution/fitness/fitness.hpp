@@ -0,0 +1,101 @@
+#pragma once
+#include "../../core/lexer/token.hpp"
+#include "../../core/loader/header_cache.hpp"
+#include "../../core/parser/ast.hpp"
+#include "../../core/semantic/checker.hpp"
+#include "../../core/vm/compiler.hpp"
+#include "../../core/vm/lane_vm.hpp"
+#include "../../core/vm/vm.hpp"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// How a candidate's evaluation ended. The VM limit outcomes are kept apart
+// from ordinary errors so that non-terminating or exploding mutants can be
+// counted and penalised on their own.
+enum class FitnessOutcome : uint8_t
+{
+    Ok,
+    ParseError,
+    SemanticError,
+    CompileError,
+    RuntimeError,
+    StepLimit,
+    DepthLimit,
+    MemoryLimit
+};
+
+const char *to_string(FitnessOutcome o);
+FitnessOutcome outcomeOf(VmStatus status);
+
+inline bool isLimitOutcome(FitnessOutcome o)
+{
+    return o == FitnessOutcome::StepLimit || o == FitnessOutcome::DepthLimit || o == FitnessOutcome::MemoryLimit;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Fitness record attached to every individual. Higher score is better.
+struct FitnessRecord
+{
+    double score = 0.0;
+    bool evaluated = false;
+    bool partial = false; // stopped early by racing; score is a lower bound
+    FitnessOutcome outcome = FitnessOutcome::Ok;
+    CheckError checkError = CheckError::None; // why a SemanticError was rejected
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Per-worker scratch state for fitness evaluation. Each pool worker owns
+// exactly one, so buffers are reused across candidates without locking;
+// cache-line alignment keeps neighbouring workspaces from false sharing.
+struct alignas(64) EvalWorkspace
+{
+    unsigned worker = 0;
+    std::string source;
+    std::vector<Token> tokens;
+    std::vector<std::string> errors;
+
+    SemanticChecker checker;
+    BytecodeCompiler compiler;
+    std::unique_ptr<Module> module;
+    VM vm; // limits: vm.setLimits(); runSuite applies them to `lanes` too
+    LaneVM lanes;
+    VmResult result;
+    std::vector<VmResult> caseResults; // per test case, see runSuite
+    ValueHeap caseValues;              // what their values point at
+    std::vector<uint8_t> casePassed;
+    // Resolves header() declarations (see link()); null ignores them, as the
+    // checker and compiler do. Set by the controllers' setHeaders().
+    std::unique_ptr<HeaderResolver> headers;
+    std::unique_ptr<Program> linked;
+
+    // Print -> lex -> parse round trip ("Compiles?" in flow.md). Returns true
+    // when the re-emitted source parses without errors.
+    bool reparse(const Program &prog);
+
+    // The program check() and compile() work on: `prog` itself, or, when
+    // `headers` is set and `prog` declares header()s, a copy in `linked`
+    // with the functions and globals of its headers that it does not define
+    // itself. nullptr when a header is missing or does not parse, with the
+    // reasons in `errors`.
+    const Program *link(const Program &prog);
+
+    // Semantic check ahead of compile(), stopping at the first problem,
+    // which is then in `errors` and checker.firstError(). A program whose
+    // headers fail to link is checked without them.
+    bool check(const Program &prog);
+
+    // Bytecode for `prog` into `module`; on failure, headers that fail to
+    // link included, `errors` says why.
+    bool compile(const Program &prog);
+
+    // Runs `entry` of the compiled module under the VM limits ("Runs?"),
+    // leaving the details in `result`. A candidate that hits a limit is
+    // stopped in place; the worker simply moves on to the next one.
+    FitnessOutcome run(const std::string &entry, const std::vector<Value> &args = {});
+};
+
+using FitnessFn = std::function<FitnessRecord(const Program &prog, EvalWorkspace &ws)>;
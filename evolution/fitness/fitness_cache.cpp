@@ -0,0 +1,207 @@
+#include "fitness_cache.hpp"
+#include "../../core/utils/hash.hpp"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace
+{
+    void put(std::vector<uint8_t> &out, const void *data, size_t size)
+    {
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        out.insert(out.end(), p, p + size);
+    }
+
+    bool take(const uint8_t *&p, const uint8_t *end, void *data, size_t size)
+    {
+        if (static_cast<size_t>(end - p) < size)
+            return false;
+        std::memcpy(data, p, size);
+        p += size;
+        return true;
+    }
+}
+
+FitnessCache::FitnessCache(size_t capacity, unsigned shards)
+{
+    if (shards == 0)
+        shards = 64;
+    size_t n = 1;
+    while (n < shards)
+        n <<= 1;
+    // Never more shards than entries, so every shard holds at least one.
+    while (n > 1 && n > capacity)
+        n >>= 1;
+
+    m_shards.reset(new Shard[n]);
+    m_shardMask = n - 1;
+    m_capacity = std::max<size_t>(capacity, 1);
+    for (size_t i = 0; i < n; i++)
+    {
+        Shard &s = m_shards[i];
+        s.capacity = m_capacity / n + (i < m_capacity % n ? 1 : 0);
+        s.slots.reserve(s.capacity);
+        s.index.reserve(s.capacity);
+    }
+}
+
+bool FitnessCache::lookup(uint64_t key, FitnessRecord &out)
+{
+    // Structural hashes are already well mixed, but the shard index uses
+    // the low bits, so fold the high ones in for keys from other sources.
+    Shard &s = shardOf(mix64(key));
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.lookups++;
+    auto it = s.index.find(key);
+    if (it == s.index.end())
+        return false;
+    Slot &slot = s.slots[it->second];
+    slot.referenced = true;
+    out = slot.record;
+    s.hits++;
+    return true;
+}
+
+void FitnessCache::insert(uint64_t key, const FitnessRecord &record)
+{
+    Shard &s = shardOf(mix64(key));
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.index.find(key);
+    if (it != s.index.end())
+    {
+        s.slots[it->second].record = record;
+        return;
+    }
+    s.inserts++;
+    if (s.slots.size() < s.capacity)
+    {
+        s.index.emplace(key, static_cast<uint32_t>(s.slots.size()));
+        s.slots.push_back(Slot{key, record, false});
+        return;
+    }
+
+    // CLOCK: give referenced entries a second chance, evict the first that
+    // has none. Terminates within two sweeps.
+    for (;;)
+    {
+        Slot &victim = s.slots[s.hand];
+        if (victim.referenced)
+        {
+            victim.referenced = false;
+            s.hand = (s.hand + 1) % s.slots.size();
+            continue;
+        }
+        s.index.erase(victim.key);
+        victim = Slot{key, record, false};
+        s.index.emplace(key, static_cast<uint32_t>(s.hand));
+        s.hand = (s.hand + 1) % s.slots.size();
+        s.evictions++;
+        return;
+    }
+}
+
+void FitnessCache::clear()
+{
+    for (size_t i = 0; i <= m_shardMask; i++)
+    {
+        Shard &s = m_shards[i];
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.slots.clear();
+        s.index.clear();
+        s.hand = 0;
+    }
+}
+
+FitnessCacheStats FitnessCache::stats() const
+{
+    FitnessCacheStats st;
+    st.capacity = m_capacity;
+    for (size_t i = 0; i <= m_shardMask; i++)
+    {
+        const Shard &s = m_shards[i];
+        std::lock_guard<std::mutex> lock(s.mutex);
+        st.lookups += s.lookups;
+        st.hits += s.hits;
+        st.inserts += s.inserts;
+        st.evictions += s.evictions;
+        st.size += s.slots.size();
+    }
+    return st;
+}
+
+// Layout: shard count, capacity, then per shard its hand, slot count and
+// counters followed by the slots in CLOCK order.
+std::vector<uint8_t> FitnessCache::snapshot() const
+{
+    static_assert(std::is_trivially_copyable<FitnessRecord>::value, "FitnessRecord is stored as raw bytes");
+    std::vector<uint8_t> out;
+    uint64_t shards = m_shardMask + 1, capacity = m_capacity;
+    put(out, &shards, sizeof(shards));
+    put(out, &capacity, sizeof(capacity));
+    for (size_t i = 0; i <= m_shardMask; i++)
+    {
+        const Shard &s = m_shards[i];
+        std::lock_guard<std::mutex> lock(s.mutex);
+        uint64_t head[6] = {s.hand, s.slots.size(), s.lookups, s.hits, s.inserts, s.evictions};
+        put(out, head, sizeof(head));
+        for (const Slot &slot : s.slots)
+        {
+            uint8_t referenced = slot.referenced;
+            put(out, &slot.key, sizeof(slot.key));
+            put(out, &slot.record, sizeof(slot.record));
+            put(out, &referenced, sizeof(referenced));
+        }
+    }
+    return out;
+}
+
+bool FitnessCache::restore(const uint8_t *data, size_t size)
+{
+    const uint8_t *p = data, *end = data + size;
+    uint64_t shards = 0, capacity = 0;
+    if (!take(p, end, &shards, sizeof(shards)) || !take(p, end, &capacity, sizeof(capacity)) ||
+        shards != m_shardMask + 1 || capacity != m_capacity)
+        return false;
+    std::unique_ptr<Shard[]> loaded(new Shard[shards]);
+    for (size_t i = 0; i < shards; i++)
+    {
+        Shard &s = loaded[i];
+        uint64_t head[6];
+        if (!take(p, end, head, sizeof(head)) || head[1] > m_shards[i].capacity ||
+            (head[1] ? head[0] >= head[1] : head[0] != 0))
+            return false;
+        s.hand = head[0];
+        s.lookups = head[2];
+        s.hits = head[3];
+        s.inserts = head[4];
+        s.evictions = head[5];
+        s.slots.resize(head[1]);
+        for (size_t k = 0; k < s.slots.size(); k++)
+        {
+            Slot &slot = s.slots[k];
+            uint8_t referenced = 0;
+            if (!take(p, end, &slot.key, sizeof(slot.key)) || !take(p, end, &slot.record, sizeof(slot.record)) ||
+                !take(p, end, &referenced, sizeof(referenced)) || (mix64(slot.key) & m_shardMask) != i ||
+                !s.index.emplace(slot.key, static_cast<uint32_t>(k)).second)
+                return false;
+            slot.referenced = referenced != 0;
+        }
+    }
+    if (p != end)
+        return false;
+
+    for (size_t i = 0; i < shards; i++)
+    {
+        Shard &s = m_shards[i];
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.slots = std::move(loaded[i].slots);
+        s.slots.reserve(s.capacity);
+        s.index = std::move(loaded[i].index);
+        s.hand = loaded[i].hand;
+        s.lookups = loaded[i].lookups;
+        s.hits = loaded[i].hits;
+        s.inserts = loaded[i].inserts;
+        s.evictions = loaded[i].evictions;
+    }
+    return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "fitness.hpp"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Concurrent memo of fitness records keyed by AstHasher structural hash.
+//
+// The key space is split over power-of-two shards, each with its own lock,
+// so evaluation threads probing different programs almost never meet. Each
+// shard is bounded and evicts with CLOCK (second chance): a hit sets the
+// entry's reference bit, the hand clears bits until it finds an entry that
+// was not touched since its last pass.
+//
+// Keys are the 64-bit hash only; at the population sizes involved a false
+// hit is far less likely than a hardware fault.
+//
+// snapshot() and restore() copy the contents with their CLOCK state
+// (reference bits, hands, counters) for checkpoints. A restored cache
+// answers, and later evicts, exactly as the saved one would have.
+
+struct FitnessCacheStats
+{
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+    uint64_t inserts = 0;
+    uint64_t evictions = 0;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    double hitRate() const { return lookups ? static_cast<double>(hits) / lookups : 0.0; }
+};
+
+class FitnessCache
+{
+public:
+    // capacity: total entries over all shards. shards is rounded up to a
+    // power of two; 0 picks a default that is plenty for any pool size.
+    explicit FitnessCache(size_t capacity = 1 << 16, unsigned shards = 0);
+
+    bool lookup(uint64_t key, FitnessRecord &out);
+    void insert(uint64_t key, const FitnessRecord &record);
+    void clear();
+
+    // Call while no other thread uses the cache. restore() needs a cache of
+    // the same capacity and shard count; false (cache unchanged) otherwise.
+    std::vector<uint8_t> snapshot() const;
+    bool restore(const uint8_t *data, size_t size);
+
+    FitnessCacheStats stats() const;
+    size_t capacity() const { return m_capacity; }
+
+private:
+    struct Slot
+    {
+        uint64_t key = 0;
+        FitnessRecord record;
+        bool referenced = false;
+    };
+
+    struct alignas(64) Shard
+    {
+        mutable std::mutex mutex;
+        std::vector<Slot> slots; // CLOCK ring, filled up to capacity
+        std::unordered_map<uint64_t, uint32_t> index;
+        size_t capacity = 0;
+        size_t hand = 0;
+        uint64_t lookups = 0;
+        uint64_t hits = 0;
+        uint64_t inserts = 0;
+        uint64_t evictions = 0;
+    };
+
+    Shard &shardOf(uint64_t key) { return m_shards[key & m_shardMask]; }
+
+    std::unique_ptr<Shard[]> m_shards;
+    size_t m_shardMask = 0;
+    size_t m_capacity = 0;
+};
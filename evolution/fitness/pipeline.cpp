@@ -0,0 +1,91 @@
+#include "pipeline.hpp"
+
+const char *to_string(PipelineStage s)
+{
+    switch (s)
+    {
+    case PipelineStage::Syntax: return "syntax";
+    case PipelineStage::Semantic: return "semantic";
+    case PipelineStage::Compile: return "compile";
+    case PipelineStage::Execute: return "execute";
+    default: return "?";
+    }
+}
+
+FitnessPipeline::FitnessPipeline(const TestSuite &suite, PipelineConfig config) : m_suite(suite), m_config(config)
+{
+}
+
+FitnessRecord FitnessPipeline::evaluate(const Program &prog, EvalWorkspace &ws)
+{
+    auto at = [](PipelineStage s) { return static_cast<size_t>(s); };
+    FitnessRecord rec;
+    rec.evaluated = true;
+
+    if (m_config.syntax)
+    {
+        count(m_entered[at(PipelineStage::Syntax)]);
+        if (!ws.reparse(prog))
+        {
+            count(m_rejected[at(PipelineStage::Syntax)]);
+            rec.outcome = FitnessOutcome::ParseError;
+            return rec;
+        }
+    }
+
+    count(m_entered[at(PipelineStage::Semantic)]);
+    ws.checker.setTypeChecks(m_config.typeChecks);
+    if (!ws.check(prog))
+    {
+        count(m_rejected[at(PipelineStage::Semantic)]);
+        count(m_semantic[static_cast<size_t>(ws.checker.firstError())]);
+        rec.outcome = FitnessOutcome::SemanticError;
+        rec.checkError = ws.checker.firstError();
+        return rec;
+    }
+
+    count(m_entered[at(PipelineStage::Compile)]);
+    if (!ws.compile(prog))
+    {
+        count(m_rejected[at(PipelineStage::Compile)]);
+        rec.outcome = FitnessOutcome::CompileError;
+        return rec;
+    }
+
+    count(m_entered[at(PipelineStage::Execute)]);
+    SuiteResult r = runSuite(ws, m_suite, m_config.mode);
+    uint64_t total = m_suite.totalWeight();
+    rec.score = total ? static_cast<double>(r.passedWeight) / total : 0.0;
+    rec.outcome = r.outcome;
+    if (r.outcome != FitnessOutcome::Ok)
+        count(m_rejected[at(PipelineStage::Execute)]);
+    return rec;
+}
+
+FitnessFn FitnessPipeline::fitness()
+{
+    return [this](const Program &prog, EvalWorkspace &ws) { return evaluate(prog, ws); };
+}
+
+PipelineStats FitnessPipeline::stats() const
+{
+    PipelineStats s;
+    for (size_t i = 0; i < PipelineStats::kStages; i++)
+    {
+        s.entered[i] = m_entered[i].load(std::memory_order_relaxed);
+        s.rejected[i] = m_rejected[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < PipelineStats::kCheckErrors; i++)
+        s.semantic[i] = m_semantic[i].load(std::memory_order_relaxed);
+    return s;
+}
+
+void FitnessPipeline::resetStats()
+{
+    for (auto &c : m_entered)
+        c.store(0, std::memory_order_relaxed);
+    for (auto &c : m_rejected)
+        c.store(0, std::memory_order_relaxed);
+    for (auto &c : m_semantic)
+        c.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "fitness.hpp"
+#include "test_suite.hpp"
+#include <atomic>
+#include <cstdint>
+
+//////////////////////////////////////////////////////////////////////////
+// Staged test-suite fitness: each stage is cheaper than the next and
+// rejects a candidate before it costs any more.
+//
+//   Syntax    print -> lex -> parse round trip (EvalWorkspace::reparse)
+//   Semantic  SemanticChecker: names, arity, literals, declared dtypes
+//   Compile   bytecode; only unresolvable header()s (see
+//             EvalWorkspace::link) and the compiler's own limits are left
+//             to fail
+//   Execute   the suite under the VM limits
+//
+// A rejected candidate scores 0 with the stage's outcome (ParseError,
+// SemanticError, CompileError) and, for the semantic stage, the kind of
+// the first error in FitnessRecord::checkError; the message is left in
+// the workspace's `errors`. Counters per stage and per semantic error
+// kind are shared by all workers.
+
+enum class PipelineStage : uint8_t
+{
+    Syntax,
+    Semantic,
+    Compile,
+    Execute,
+    Count
+};
+
+const char *to_string(PipelineStage s);
+
+struct PipelineConfig
+{
+    bool syntax = true;     // the round trip costs a print and a parse
+    bool typeChecks = true; // false: only reject what the compiler would
+    SuiteMode mode = SuiteMode::Batched;
+};
+
+struct PipelineStats
+{
+    static constexpr size_t kStages = static_cast<size_t>(PipelineStage::Count);
+    static constexpr size_t kCheckErrors = static_cast<size_t>(CheckError::Unsupported) + 1;
+
+    uint64_t entered[kStages] = {};
+    uint64_t rejected[kStages] = {}; // Execute: did not run every case cleanly
+    uint64_t semantic[kCheckErrors] = {};
+};
+
+class FitnessPipeline
+{
+public:
+    // `suite` must outlive the pipeline and any FitnessFn taken from it.
+    explicit FitnessPipeline(const TestSuite &suite, PipelineConfig config = {});
+
+    FitnessRecord evaluate(const Program &prog, EvalWorkspace &ws);
+    FitnessFn fitness();
+
+    PipelineStats stats() const;
+    void resetStats();
+
+private:
+    void count(std::atomic<uint64_t> &c) { c.fetch_add(1, std::memory_order_relaxed); }
+
+    const TestSuite &m_suite;
+    PipelineConfig m_config;
+    std::atomic<uint64_t> m_entered[PipelineStats::kStages] = {};
+    std::atomic<uint64_t> m_rejected[PipelineStats::kStages] = {};
+    std::atomic<uint64_t> m_semantic[PipelineStats::kCheckErrors] = {};
+};
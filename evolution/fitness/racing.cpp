@@ -0,0 +1,164 @@
+#include "racing.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+
+namespace
+{
+    struct Entrant
+    {
+        std::unique_ptr<Module> module;
+        size_t run = 0;          // cases
+        uint64_t runWeight = 0;
+        uint64_t passed = 0;     // weight
+        bool open = true;
+        FitnessOutcome outcome = FitnessOutcome::Ok;
+    };
+
+    double fraction(uint64_t passed, uint64_t total) { return total ? static_cast<double>(passed) / total : 0.0; }
+
+    // Score `e` finishes with if the weight not yet run passes at `rate`.
+    double finalScore(const Entrant &e, uint64_t total, double rate)
+    {
+        return total ? (e.passed + rate * static_cast<double>(total - e.runWeight)) / total : 0.0;
+    }
+
+    double margin(const Entrant &e, double delta)
+    {
+        if (delta <= 0.0 || e.run == 0)
+            return 1.0;
+        return std::sqrt(std::log(1.0 / delta) / (2.0 * e.run));
+    }
+
+    double lowerBound(const Entrant &e, uint64_t total, double delta)
+    {
+        return finalScore(e, total, std::max(0.0, fraction(e.passed, e.runWeight) - margin(e, delta)));
+    }
+
+    double upperBound(const Entrant &e, uint64_t total, double delta)
+    {
+        return finalScore(e, total, std::min(1.0, fraction(e.passed, e.runWeight) + margin(e, delta)));
+    }
+
+    // Runs cases [e.run, end) of `suite` with the entrant's own module. The
+    // module is swapped into the worker's workspace for the duration, so a
+    // candidate can move between workers from one rung to the next.
+    void runRung(EvalWorkspace &ws, const TestSuite &suite, SuiteMode mode, Entrant &e, size_t end,
+                 CaseOutcome *row)
+    {
+        ws.module.swap(e.module);
+        SuiteResult r = runSuite(ws, suite, e.run, end - e.run, mode);
+        ws.module.swap(e.module);
+        for (size_t i = e.run; i < end; i++)
+        {
+            e.runWeight += suite.weight(i);
+            if (row)
+                row[i] = ws.casePassed[i - e.run] ? CaseOutcome::Passed : CaseOutcome::Failed;
+        }
+        e.run = end;
+        e.passed += r.passedWeight;
+        if (e.outcome == FitnessOutcome::Ok)
+            e.outcome = r.outcome;
+    }
+}
+
+RaceStats raceSuite(const TestSuite &suite, const RaceConfig &config, const std::vector<const Program *> &programs,
+                    const std::vector<double> &known, std::vector<FitnessRecord> &records, ThreadPool &pool,
+                    std::vector<EvalWorkspace> &ws, std::vector<CaseOutcome> *outcomes)
+{
+    RaceStats stats;
+    stats.candidates = programs.size();
+    records.assign(programs.size(), FitnessRecord());
+    const size_t n = suite.size();
+    const uint64_t total = suite.totalWeight();
+    if (outcomes)
+        outcomes->assign(programs.size() * n, CaseOutcome::NotRun);
+    std::vector<Entrant> entrants(programs.size());
+    std::vector<size_t> open(programs.size());
+    for (size_t i = 0; i < open.size(); i++)
+        open[i] = i;
+
+    std::vector<double> floor;
+    for (size_t end = std::min(n, std::max<size_t>(config.firstRung, 1));; end = std::min(n, end * 2))
+    {
+        stats.rungs++;
+        pool.parallelFor(open.size(), [&](size_t k, unsigned worker) {
+            Entrant &e = entrants[open[k]];
+            if (!e.module)
+            {
+                if (!ws[worker].compile(*programs[open[k]]))
+                {
+                    e.outcome = FitnessOutcome::CompileError;
+                    e.open = false;
+                    return;
+                }
+                e.module = std::move(ws[worker].module);
+            }
+            runRung(ws[worker], suite, config.mode, e, end, outcomes ? outcomes->data() + open[k] * n : nullptr);
+        });
+        if (end >= n)
+            break;
+
+        // Threshold: the keep-th best score already assured, counting the
+        // lower bounds of candidates still running.
+        double threshold = -std::numeric_limits<double>::infinity();
+        if (config.keep)
+        {
+            floor.assign(known.begin(), known.end());
+            for (const Entrant &e : entrants)
+                floor.push_back(lowerBound(e, total, config.delta));
+            if (floor.size() >= config.keep)
+            {
+                std::nth_element(floor.begin(), floor.begin() + (config.keep - 1), floor.end(), std::greater<double>());
+                threshold = floor[config.keep - 1];
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t i : open)
+        {
+            Entrant &e = entrants[i];
+            if (!e.open)
+                continue;
+            if (upperBound(e, total, config.delta) < threshold)
+            {
+                e.open = false;
+                records[i].partial = true;
+                stats.dropped++;
+                stats.saved += n - e.run;
+                continue;
+            }
+            open[kept++] = i;
+        }
+        open.resize(kept);
+        if (open.empty())
+            break;
+    }
+
+    for (size_t i = 0; i < entrants.size(); i++)
+    {
+        records[i].score = fraction(entrants[i].passed, total);
+        records[i].outcome = entrants[i].outcome;
+        records[i].evaluated = true;
+        stats.executions += entrants[i].run;
+    }
+    return stats;
+}
+
+FitnessFn suiteFitness(const TestSuite &suite, SuiteMode mode)
+{
+    return [&suite, mode](const Program &prog, EvalWorkspace &ws) {
+        FitnessRecord rec;
+        if (!ws.compile(prog))
+        {
+            rec.outcome = FitnessOutcome::CompileError;
+            return rec;
+        }
+        SuiteResult r = runSuite(ws, suite, mode);
+        rec.score = fraction(r.passedWeight, suite.totalWeight());
+        rec.outcome = r.outcome;
+        return rec;
+    };
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "../../core/parser/ast.hpp"
+#include "../../core/utils/thread_pool.hpp"
+#include "fitness.hpp"
+#include "test_suite.hpp"
+#include <cstdint>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Test-suite fitness with racing.
+//
+// A candidate's score is the (weighted) fraction of suite cases it passes. Scoring a
+// whole batch at once lets hopeless candidates be abandoned early: all of
+// them run a short prefix of the suite (a "rung"), and each further rung
+// doubles the prefix. After a rung a candidate that has passed p of the k
+// cases run so far scores at least p/n and at most (p + n - k)/n. Once
+// `keep` candidates are known to reach some score T, any candidate whose
+// upper bound is below T cannot finish in the top `keep` and is dropped.
+// Every rung is a fresh parallelFor over the survivors only, so workers
+// freed by dropped candidates go straight to the remaining ones.
+//
+// A dropped candidate keeps its lower bound as score and is marked
+// `partial`. With delta == 0 the bound is exact and the top `keep` always
+// come out as a full run would rank them. That bound is loose, though: it
+// assumes every case not yet run passes. With delta > 0 both bounds
+// instead assume the remaining cases pass at the observed rate give or
+// take the Hoeffding margin sqrt(ln(1/delta) / 2k). That drops weak
+// candidates after a few rungs, but, when the cases are in random order,
+// may with probability about delta drop one that would have made the cut.
+
+struct RaceConfig
+{
+    size_t keep = 0;       // 0 runs every case of every candidate
+    size_t firstRung = 8;  // cases in the first prefix
+    double delta = 0.0;    // 0: exact bound; else Hoeffding, see above
+    SuiteMode mode = SuiteMode::Batched;
+};
+
+struct RaceStats
+{
+    size_t candidates = 0;
+    size_t dropped = 0;
+    size_t rungs = 0;
+    uint64_t executions = 0; // test cases run
+    uint64_t saved = 0;      // cases dropped candidates never ran
+};
+
+// Scores `programs` into `records` (same length). `known` holds the scores
+// of individuals that already count towards the top `keep`, e.g. elites
+// carried over from the previous generation. `ws` needs one workspace per
+// pool worker; its VM limits apply. If `outcomes` is given it receives
+// every candidate's case outcomes, one row of suite.size() per program.
+RaceStats raceSuite(const TestSuite &suite, const RaceConfig &config, const std::vector<const Program *> &programs,
+                    const std::vector<double> &known, std::vector<FitnessRecord> &records, ThreadPool &pool,
+                    std::vector<EvalWorkspace> &ws, std::vector<CaseOutcome> *outcomes = nullptr);
+
+// The same score as a plain FitnessFn: every case, one candidate at a time.
+FitnessFn suiteFitness(const TestSuite &suite, SuiteMode mode = SuiteMode::Batched);
@@ -0,0 +1,220 @@
+#include "test_priority.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace
+{
+    void put(std::vector<uint8_t> &out, const void *data, size_t size)
+    {
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        out.insert(out.end(), p, p + size);
+    }
+
+    bool take(const uint8_t *&p, const uint8_t *end, void *data, size_t size)
+    {
+        if (static_cast<size_t>(end - p) < size)
+            return false;
+        std::memcpy(data, p, size);
+        p += size;
+        return true;
+    }
+}
+
+TestPrioritizer::TestPrioritizer(const TestSuite &base, PriorityConfig config)
+    : m_base(base), m_config(config), m_stats(base.size())
+{
+    m_joint.assign(base.size() * base.size(), 0);
+    m_disagree.assign(base.size() * base.size(), 0);
+    rebuild(true);
+}
+
+void TestPrioritizer::observe(const std::vector<CaseOutcome> &outcomes)
+{
+    const size_t n = m_suite.size();
+    const size_t stride = m_base.size();
+    std::vector<uint32_t> ran;
+    std::vector<uint8_t> passed;
+    const size_t rows = n ? outcomes.size() / n : 0;
+    for (size_t row = 0; row < rows; row++)
+    {
+        const CaseOutcome *o = outcomes.data() + row * n;
+        ran.clear();
+        passed.clear();
+        uint64_t runWeight = 0, passWeight = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (o[i] == CaseOutcome::NotRun)
+                continue;
+            ran.push_back(m_order[i]);
+            passed.push_back(o[i] == CaseOutcome::Passed);
+            runWeight += m_suite.weight(i);
+            passWeight += passed.back() ? m_suite.weight(i) : 0;
+        }
+        if (ran.empty())
+            continue; // did not compile
+        double s = static_cast<double>(passWeight) / runWeight;
+
+        for (size_t a = 0; a < ran.size(); a++)
+        {
+            CaseStats &c = m_stats[ran[a]];
+            c.samples += 1.0;
+            c.fails += passed[a] ? 0.0 : 1.0;
+            c.score += s;
+            c.score2 += s * s;
+            c.passScore += passed[a] ? s : 0.0;
+            for (size_t b = a + 1; b < ran.size(); b++)
+            {
+                size_t at = std::min(ran[a], ran[b]) * stride + std::max(ran[a], ran[b]);
+                m_joint[at]++;
+                m_disagree[at] += passed[a] != passed[b];
+            }
+        }
+    }
+}
+
+void TestPrioritizer::nextGeneration()
+{
+    m_generation++;
+    for (CaseStats &c : m_stats)
+    {
+        c.samples *= m_config.decay;
+        c.fails *= m_config.decay;
+        c.score *= m_config.decay;
+        c.score2 *= m_config.decay;
+        c.passScore *= m_config.decay;
+    }
+    bool refresh = m_config.refreshEvery && m_generation % m_config.refreshEvery == 0;
+    if (refresh)
+    {
+        std::fill(m_joint.begin(), m_joint.end(), 0);
+        std::fill(m_disagree.begin(), m_disagree.end(), 0);
+    }
+    rebuild(refresh);
+}
+
+double TestPrioritizer::failureRate(size_t baseCase) const
+{
+    const CaseStats &c = m_stats[baseCase];
+    return c.samples > 0.0 ? c.fails / c.samples : 0.0;
+}
+
+double TestPrioritizer::discrimination(size_t baseCase) const
+{
+    const CaseStats &c = m_stats[baseCase];
+    if (c.samples <= 0.0)
+        return 0.0;
+    double pass = 1.0 - c.fails / c.samples;
+    double mean = c.score / c.samples;
+    double cov = c.passScore / c.samples - pass * mean;
+    double var = (pass * (1.0 - pass)) * (c.score2 / c.samples - mean * mean);
+    return var > 1e-12 ? std::max(-1.0, std::min(1.0, cov / std::sqrt(var))) : 0.0;
+}
+
+void TestPrioritizer::rebuild(bool everyCase)
+{
+    const size_t n = m_base.size();
+    std::vector<double> priority(n);
+    for (size_t i = 0; i < n; i++)
+        priority[i] = m_stats[i].samples < 1.0 ? std::numeric_limits<double>::infinity()
+                                               : failureRate(i) * (1.0 - failureRate(i)) * (1.0 + discrimination(i));
+    std::vector<uint32_t> ranked(n);
+    for (size_t i = 0; i < n; i++)
+        ranked[i] = static_cast<uint32_t>(i);
+    std::stable_sort(ranked.begin(), ranked.end(), [&](uint32_t a, uint32_t b) { return priority[a] > priority[b]; });
+
+    // Fold implied cases into the first kept case they always agreed with.
+    std::vector<uint32_t> weight;
+    m_order.clear();
+    for (uint32_t c : ranked)
+    {
+        size_t into = m_order.size();
+        for (size_t k = 0; !everyCase && k < m_order.size(); k++)
+        {
+            size_t at = std::min(m_order[k], c) * n + std::max(m_order[k], c);
+            if (m_joint[at] >= m_config.minAgreement && m_disagree[at] == 0)
+            {
+                into = k;
+                break;
+            }
+        }
+        if (into < m_order.size())
+        {
+            weight[into] += m_base.weight(c);
+            continue;
+        }
+        m_order.push_back(c);
+        weight.push_back(m_base.weight(c));
+    }
+
+    m_suite.entry = m_base.entry;
+    m_suite.arity = m_base.arity;
+    m_suite.inputs.clear();
+    m_suite.expected.clear();
+    for (uint32_t c : m_order)
+    {
+        const Value *args = m_base.args(c);
+        m_suite.inputs.insert(m_suite.inputs.end(), args, args + m_base.arity);
+        m_suite.expected.push_back(m_base.expected[c]);
+    }
+    m_suite.weights = std::move(weight);
+}
+
+// Layout: generation, case count, CaseStats[n], joint[n * n],
+// disagree[n * n], then the order built from them, which restore() uses
+// to check that suite and config are the ones the state was learned on.
+std::vector<uint8_t> TestPrioritizer::snapshot() const
+{
+    static_assert(std::is_trivially_copyable<CaseStats>::value, "CaseStats is stored as raw bytes");
+    std::vector<uint8_t> out;
+    uint64_t generation = m_generation, n = m_stats.size(), kept = m_order.size();
+    put(out, &generation, sizeof(generation));
+    put(out, &n, sizeof(n));
+    put(out, m_stats.data(), m_stats.size() * sizeof(CaseStats));
+    put(out, m_joint.data(), m_joint.size() * sizeof(uint32_t));
+    put(out, m_disagree.data(), m_disagree.size() * sizeof(uint32_t));
+    put(out, &kept, sizeof(kept));
+    put(out, m_order.data(), m_order.size() * sizeof(uint32_t));
+    return out;
+}
+
+bool TestPrioritizer::restore(const uint8_t *data, size_t size)
+{
+    const uint8_t *p = data, *end = data + size;
+    const size_t n = m_base.size();
+    uint64_t generation = 0, cases = 0, kept = 0;
+    if (!take(p, end, &generation, sizeof(generation)) || !take(p, end, &cases, sizeof(cases)) || cases != n)
+        return false;
+    std::vector<CaseStats> stats(n);
+    std::vector<uint32_t> joint(n * n), disagree(n * n);
+    if (!take(p, end, stats.data(), n * sizeof(CaseStats)) ||
+        !take(p, end, joint.data(), joint.size() * sizeof(uint32_t)) ||
+        !take(p, end, disagree.data(), disagree.size() * sizeof(uint32_t)) || !take(p, end, &kept, sizeof(kept)) ||
+        kept > n)
+        return false;
+    std::vector<uint32_t> order(kept);
+    if (!take(p, end, order.data(), order.size() * sizeof(uint32_t)) || p != end)
+        return false;
+
+    // Rebuild as the constructor or the last nextGeneration() did; the
+    // refresh generations run every case.
+    const size_t every = m_config.refreshEvery;
+    const size_t previous = m_generation;
+    m_generation = static_cast<size_t>(generation);
+    std::swap(m_stats, stats);
+    std::swap(m_joint, joint);
+    std::swap(m_disagree, disagree);
+    rebuild(m_generation == 0 || (every && m_generation % every == 0));
+    if (m_order != order)
+    {
+        m_generation = previous;
+        std::swap(m_stats, stats);
+        std::swap(m_joint, joint);
+        std::swap(m_disagree, disagree);
+        rebuild(m_generation == 0 || (every && m_generation % every == 0));
+        return false;
+    }
+    return true;
+}
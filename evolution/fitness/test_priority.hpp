@@ -0,0 +1,84 @@
+#pragma once
+#include "test_suite.hpp"
+#include <cstdint>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Adaptive test-case order for racing.
+//
+// Racing (racing.hpp) can only drop a candidate early if the cases it
+// fails come early. TestPrioritizer keeps per-case statistics over recent
+// generations, decayed by `decay` each generation: how often the case
+// fails, and how well passing it correlates with the candidate's overall
+// score. Cases are ordered by f(1 - f)(1 + correlation) for failure rate
+// f: cases that split the population, with weak candidates on the failing
+// side, fill the first rungs. Cases every candidate fails or passes say
+// nothing about the ranking and go last; cases never observed go first.
+//
+// A case whose outcome has matched an earlier kept case on every one of at
+// least `minAgreement` candidates is taken to be implied by it. It is left
+// out of suite() and its weight is added to that case, so scores stay on
+// the same scale. This is a heuristic: a new mutant can still tell the two
+// apart, and its score is then off by the folded weight. Every
+// `refreshEvery`-th generation runs every case again and the agreement
+// counts start over, so such cases are split again.
+//
+// snapshot() and restore() carry the learned state across a checkpoint
+// (see checkpoint.hpp): the generation counter, the decayed statistics and
+// the agreement counts. Host byte order, like the rest of the checkpoint.
+
+struct PriorityConfig
+{
+    double decay = 0.8;
+    size_t minAgreement = 128;
+    size_t refreshEvery = 5;
+};
+
+class TestPrioritizer
+{
+public:
+    // `base` must outlive the prioritizer; suite() shares its text values.
+    explicit TestPrioritizer(const TestSuite &base, PriorityConfig config = {});
+
+    // The cases to run this generation, most useful first, with weights.
+    const TestSuite &suite() const { return m_suite; }
+    // Base index of each case of suite().
+    const std::vector<uint32_t> &order() const { return m_order; }
+    size_t skipped() const { return m_base.size() - m_suite.size(); }
+
+    // Records a generation's outcomes on suite(), one row of suite().size()
+    // per candidate (see raceSuite).
+    void observe(const std::vector<CaseOutcome> &outcomes);
+    // Folds the observations in and rebuilds suite() for the next generation.
+    void nextGeneration();
+
+    double failureRate(size_t baseCase) const;
+    double discrimination(size_t baseCase) const; // pass/score correlation, -1..1
+
+    size_t generation() const { return m_generation; }
+    std::vector<uint8_t> snapshot() const;
+    // Take over a snapshot() of a prioritizer built over the same suite with
+    // the same config; false (state unchanged) if it does not fit.
+    bool restore(const uint8_t *data, size_t size);
+
+private:
+    struct CaseStats
+    {
+        double samples = 0.0;
+        double fails = 0.0;
+        double score = 0.0;  // sum of candidate scores
+        double score2 = 0.0; // sum of squared candidate scores
+        double passScore = 0.0;
+    };
+
+    void rebuild(bool everyCase);
+
+    const TestSuite &m_base;
+    PriorityConfig m_config;
+    size_t m_generation = 0;
+    std::vector<CaseStats> m_stats;   // per base case
+    std::vector<uint32_t> m_joint;    // [min * n + max] over base cases: candidates that ran both
+    std::vector<uint32_t> m_disagree; // ... and got different outcomes
+    std::vector<uint32_t> m_order;
+    TestSuite m_suite;
+};
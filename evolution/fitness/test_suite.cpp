@@ -0,0 +1,84 @@
+#include "test_suite.hpp"
+#include <algorithm>
+
+bool TestSuite::add(const std::vector<Value> &args, const Value &result)
+{
+    if (expected.empty() && inputs.empty())
+        arity = args.size();
+    else if (args.size() != arity)
+        return false;
+    inputs.insert(inputs.end(), args.begin(), args.end());
+    expected.push_back(result);
+    if (!weights.empty())
+        weights.push_back(1);
+    return true;
+}
+
+uint64_t TestSuite::totalWeight() const
+{
+    if (weights.empty())
+        return size();
+    uint64_t total = 0;
+    for (uint32_t w : weights)
+        total += w;
+    return total;
+}
+
+SuiteResult runSuite(EvalWorkspace &ws, const TestSuite &suite, size_t first, size_t count, SuiteMode mode)
+{
+    SuiteResult res;
+    count = first < suite.size() ? std::min(count, suite.size() - first) : 0;
+    ws.caseResults.resize(count);
+    ws.casePassed.assign(count, 0);
+    ws.caseValues.clear();
+    if (!ws.module)
+    {
+        res.outcome = FitnessOutcome::CompileError;
+        return res;
+    }
+    int entry = ws.module->find(suite.entry);
+    if (entry < 0)
+    {
+        res.outcome = FitnessOutcome::CompileError;
+        return res;
+    }
+
+    if (mode == SuiteMode::Batched)
+    {
+        ws.lanes.setLimits(ws.vm.limits());
+        res.batched = ws.lanes.run(*ws.module, entry, suite.args(first), suite.arity, count, ws.caseResults.data());
+    }
+    if (!res.batched)
+    {
+        std::vector<Value> args(suite.arity);
+        for (size_t i = 0; i < count; i++)
+        {
+            const Value *row = suite.args(first + i);
+            args.assign(row, row + suite.arity);
+            ws.caseResults[i] = ws.vm.run(*ws.module, entry, args);
+            // The next run clears the VM's heap; a result pointing into it
+            // moves out first.
+            ws.caseResults[i].value = ws.vm.heap().escape(ws.caseResults[i].value, ws.caseValues);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const VmResult &r = ws.caseResults[i];
+        if (r.ok() && valuesEqual(r.value, suite.expected[first + i]))
+        {
+            ws.casePassed[i] = 1;
+            res.passed++;
+            res.passedWeight += suite.weight(first + i);
+        }
+        if (!r.ok() && res.outcome == FitnessOutcome::Ok)
+            res.outcome = outcomeOf(r.status);
+    }
+    res.executed = count;
+    return res;
+}
+
+SuiteResult runSuite(EvalWorkspace &ws, const TestSuite &suite, SuiteMode mode)
+{
+    return runSuite(ws, suite, 0, suite.size(), mode);
+}
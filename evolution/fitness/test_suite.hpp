@@ -0,0 +1,64 @@
+#pragma once
+#include "../../core/runtime/value.hpp"
+#include "fitness.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Input/expected-output pairs for the "Passes tests?" stage.
+//
+// Arguments are stored row-major, one row of `arity` values per case, so
+// any run of cases is one contiguous block that the lane VM can take as
+// is. Text arguments and expected values live in `strings`.
+//
+// A case may stand for several: TestPrioritizer drops cases whose outcome
+// always matches another's and adds their weight to that one. Scores are
+// passed weight over total weight; without weights every case counts once.
+struct TestSuite
+{
+    std::string entry = "main";
+    size_t arity = 0;
+    std::vector<Value> inputs;
+    std::vector<Value> expected;
+    std::vector<uint32_t> weights; // empty, or one per case
+    ValueHeap strings;
+
+    size_t size() const { return expected.size(); }
+    const Value *args(size_t i) const { return inputs.data() + i * arity; }
+    uint32_t weight(size_t i) const { return weights.empty() ? 1 : weights[i]; }
+    uint64_t totalWeight() const;
+
+    // Appends a case; the first one fixes the arity, later ones must match.
+    bool add(const std::vector<Value> &args, const Value &result);
+};
+
+enum class SuiteMode
+{
+    Scalar,  // one VM run per case
+    Batched  // LaneVM where the program allows it, scalar VM otherwise
+};
+
+// How a case went for one candidate, as recorded by raceSuite.
+enum class CaseOutcome : uint8_t
+{
+    NotRun,
+    Failed,
+    Passed
+};
+
+struct SuiteResult
+{
+    size_t passed = 0;
+    uint64_t passedWeight = 0;
+    size_t executed = 0;
+    bool batched = false;
+    FitnessOutcome outcome = FitnessOutcome::Ok; // first case that did not run cleanly
+};
+
+// Runs the cases [first, first + count) of `suite` on the module compiled
+// in `ws` (see EvalWorkspace::compile). Per-case results are left in
+// ws.caseResults / ws.casePassed, indexed from `first`.
+SuiteResult runSuite(EvalWorkspace &ws, const TestSuite &suite, size_t first, size_t count,
+                     SuiteMode mode = SuiteMode::Batched);
+SuiteResult runSuite(EvalWorkspace &ws, const TestSuite &suite, SuiteMode mode = SuiteMode::Batched);
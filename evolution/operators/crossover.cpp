@@ -0,0 +1,283 @@
+#include "crossover.hpp"
+#include "../../core/parser/ast_clone.hpp"
+#include <algorithm>
+
+namespace
+{
+    uint64_t signatureOf(const FuncDecl &f)
+    {
+        // FNV-1a over the parameter type names. The names don't matter:
+        // cloneReplacing renames the donor's parameters to the recipient's.
+        uint64_t h = 1469598103934665603ULL;
+        for (const auto &p : f.params)
+        {
+            for (char c : p.first)
+                h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+            h = (h ^ ',') * 1099511628211ULL;
+        }
+        return h;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Catalog construction: one post-order walk per function, with a flat
+// name -> dtype table standing in for scopes (good enough to keep swaps
+// type-compatible; the semantic checker has the final word).
+class CatalogBuilder
+{
+public:
+    explicit CatalogBuilder(SubtreeCatalog &c) : cat(c) {}
+
+    void program(const Program &prog)
+    {
+        for (const auto &d : prog.decls)
+        {
+            if (auto f = dynamic_cast<const FuncDecl *>(d.get()))
+            {
+                func(*f);
+            }
+            else if (auto b = dynamic_cast<const BlockDecl *>(d.get()))
+            {
+                for (const auto &m : b->methods)
+                    if (m)
+                        func(*m);
+            }
+        }
+    }
+
+private:
+    SubtreeCatalog &cat;
+    std::vector<std::pair<std::string, DType>> names;
+
+    DType lookup(const std::string &name) const
+    {
+        for (auto it = names.rbegin(); it != names.rend(); ++it)
+            if (it->first == name)
+                return it->second;
+        return DType::Unknown;
+    }
+
+    void func(const FuncDecl &f)
+    {
+        if (!f.body)
+            return;
+        names.clear();
+        for (const auto &p : f.params)
+            names.emplace_back(p.second, dtypeFromName(p.first));
+        block(*f.body);
+        cat.add(SubtreeKind::FuncBody, DType::Unknown, 0, &f, signatureOf(f));
+    }
+
+    uint32_t block(const Block &b)
+    {
+        uint32_t h = 0;
+        for (const auto &s : b)
+            h = std::max(h, stmt(s.get()));
+        cat.add(SubtreeKind::Block, DType::Unknown, h + 1, &b);
+        return h + 1;
+    }
+
+    uint32_t stmt(const Stmt *s)
+    {
+        uint32_t h = 0;
+        DType t;
+        if (auto es = dynamic_cast<const ExprStmt *>(s))
+        {
+            h = expr(es->expr.get(), t);
+        }
+        else if (auto rs = dynamic_cast<const ReturnStmt *>(s))
+        {
+            if (rs->value)
+                h = expr(rs->value->get(), t);
+        }
+        else if (auto is = dynamic_cast<const IfStmt *>(s))
+        {
+            h = std::max(expr(is->ifBlock.first.get(), t), block(is->ifBlock.second));
+            if (is->elseIfs)
+                for (const auto &ei : *is->elseIfs)
+                    h = std::max({h, expr(ei.first.get(), t), block(ei.second)});
+            if (is->elseBlock)
+                h = std::max(h, block(*is->elseBlock));
+        }
+        else if (auto ws = dynamic_cast<const WhileStmt *>(s))
+        {
+            h = std::max(expr(ws->condition.get(), t), block(ws->body));
+        }
+        else if (auto ls = dynamic_cast<const LoopStmt *>(s))
+        {
+            if (auto init = dynamic_cast<const ExprStmt *>(ls->init.get()))
+                h = expr(init->expr.get(), t);
+            h = std::max(h, expr(ls->condition.get(), t));
+            if (auto step = dynamic_cast<const ExprStmt *>(ls->step.get()))
+                h = std::max(h, expr(step->expr.get(), t));
+            h = std::max(h, block(ls->body));
+        }
+        else if (auto it = dynamic_cast<const IterStmt *>(s))
+        {
+            h = expr(it->iterable.get(), t);
+            names.emplace_back(it->varName, DType::Unknown);
+            h = std::max(h, block(it->body));
+        }
+        else if (auto vd = dynamic_cast<const VarDecl *>(s))
+        {
+            if (vd->initValue)
+                h = expr(vd->initValue->get(), t);
+            names.emplace_back(vd->varName, dtypeFromName(vd->typeName));
+        }
+        return h + 1;
+    }
+
+    // Returns the subtree height and reports the inferred type in `type`.
+    uint32_t expr(const Expr *e, DType &type, bool valuePosition = true)
+    {
+        type = DType::Unknown;
+        if (!e)
+            return 0;
+        uint32_t h = 1;
+        if (auto lit = dynamic_cast<const LiteralExpr *>(e))
+        {
+            type = dtypeOfLiteral(lit->litType);
+        }
+        else if (auto id = dynamic_cast<const IdentifierExpr *>(e))
+        {
+            type = lookup(id->name);
+        }
+        else if (auto u = dynamic_cast<const UnaryExpr *>(e))
+        {
+            DType rt;
+            h = expr(u->right.get(), rt) + 1;
+            type = u->op == "!" ? DType::Bool : rt;
+        }
+        else if (auto b = dynamic_cast<const BinaryExpr *>(e))
+        {
+            DType lt, rt;
+            // The target of an assignment is a place, not a value.
+            uint32_t lh = expr(b->left.get(), lt, b->op != "=");
+            uint32_t rh = expr(b->right.get(), rt);
+            h = std::max(lh, rh) + 1;
+            if (b->op == "=")
+                type = rt;
+            else if (isComparisonOp(b->op) || isLogicalOp(b->op))
+                type = DType::Bool;
+            else if (lt == rt)
+                type = lt;
+        }
+        else if (auto c = dynamic_cast<const CallExpr *>(e))
+        {
+            DType at;
+            for (const auto &a : c->args)
+                h = std::max(h, expr(a.get(), at) + 1);
+        }
+        // Untyped subtrees are left out: there is nothing to match them on.
+        if (valuePosition && type != DType::Unknown)
+            cat.add(SubtreeKind::Expr, type, h, e);
+        return h;
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////
+// SubtreeCatalog
+
+uint64_t SubtreeCatalog::makeKey(SubtreeKind kind, DType type, uint32_t height, uint64_t signature)
+{
+    uint64_t h = std::min<uint32_t>(height, 255);
+    return (uint64_t(kind) << 62) | (uint64_t(type) << 56) | (h << 48) | (signature & 0xFFFFFFFFFFFFULL);
+}
+
+void SubtreeCatalog::add(SubtreeKind kind, DType type, uint32_t height, const void *node, uint64_t signature)
+{
+    uint64_t key = makeKey(kind, type, height, signature);
+    m_buckets[key].push_back(static_cast<uint32_t>(m_entries.size()));
+    m_entries.push_back(CatalogEntry{key, kind, node});
+}
+
+void SubtreeCatalog::build(const Program &prog)
+{
+    m_entries.clear();
+    m_buckets.clear();
+    CatalogBuilder b(*this);
+    b.program(prog);
+}
+
+const CatalogEntry *SubtreeCatalog::random(RandomStream &rng) const
+{
+    if (m_entries.empty())
+        return nullptr;
+    return &m_entries[rng.below(m_entries.size())];
+}
+
+const std::vector<uint32_t> *SubtreeCatalog::bucket(uint64_t key) const
+{
+    auto it = m_buckets.find(key);
+    return it == m_buckets.end() ? nullptr : &it->second;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// SubtreeCrossover
+
+void SubtreeCrossover::prepare(const Population &pop, ThreadPool &pool)
+{
+    m_catalogs.assign(pop.size(), SubtreeCatalog());
+    m_byProgram.clear();
+    pool.parallelFor(pop.size(), [&](size_t i, unsigned) {
+        if (pop[i].program)
+            m_catalogs[i].build(*pop[i].program);
+    });
+    for (size_t i = 0; i < pop.size(); i++)
+        m_byProgram[pop[i].program.get()] = static_cast<uint32_t>(i);
+}
+
+const SubtreeCatalog *SubtreeCrossover::catalogFor(const Program &p) const
+{
+    auto it = m_byProgram.find(&p);
+    return it == m_byProgram.end() ? nullptr : &m_catalogs[it->second];
+}
+
+std::unique_ptr<Program> SubtreeCrossover::cross(const Program &a, const Program &b, RandomStream &rng) const
+{
+    SubtreeCatalog localA, localB;
+    const SubtreeCatalog *ca = catalogFor(a);
+    const SubtreeCatalog *cb = catalogFor(b);
+    if (!ca)
+    {
+        localA.build(a);
+        ca = &localA;
+    }
+    if (!cb)
+    {
+        localB.build(b);
+        cb = &localB;
+    }
+
+    for (unsigned k = 0; k < m_attempts; k++)
+    {
+        const CatalogEntry *site = ca->random(rng);
+        if (!site)
+            return nullptr;
+        const std::vector<uint32_t> *matches = cb->bucket(site->key);
+        if (!matches)
+            continue;
+        const CatalogEntry &donor = cb->entry((*matches)[rng.below(matches->size())]);
+        if (donor.node == site->node)
+            continue;
+        if (site->kind == SubtreeKind::Expr)
+            return AstCloner::cloneReplacing(a, static_cast<const Expr *>(site->node),
+                                             static_cast<const Expr *>(donor.node));
+        if (site->kind == SubtreeKind::FuncBody)
+            return AstCloner::cloneReplacing(a, static_cast<const FuncDecl *>(site->node),
+                                             static_cast<const FuncDecl *>(donor.node));
+        return AstCloner::cloneReplacing(a, static_cast<const Block *>(site->node),
+                                         static_cast<const Block *>(donor.node));
+    }
+    return nullptr;
+}
+
+CrossoverFn SubtreeCrossover::crossoverFn()
+{
+    return [this](const Program &a, const Program &b, RandomStream &rng) { return cross(a, b, rng); };
+}
+
+PrepareFn SubtreeCrossover::prepareFn()
+{
+    return [this](const Population &pop, ThreadPool &pool) { prepare(pop, pool); };
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "../../core/parser/ast.hpp"
+#include "../../core/semantic/dtype.hpp"
+#include "../../core/utils/rng.hpp"
+#include "../engine/ga_controller.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Type-compatible subtree crossover.
+//
+// A SubtreeCatalog lists every swappable subtree of one program under a
+// compatibility key: (kind, inferred DType, height) for expressions,
+// (kind, height) for blocks, and the parameter-type signature for function
+// bodies. Two subtrees are swapped only when their keys are equal, so a
+// crossover is: one draw for a site in parent A, one hash lookup in B's
+// catalog, one draw inside the matching bucket.
+//
+// A function body arrives with its parameters renamed to the recipient's,
+// but still reads the donor's globals. Expr and Block sites are matched on
+// type and height only, not on the locals the subtree reads. A donor
+// subtree that reads a name the recipient site cannot see gives an
+// offspring the semantic checker rejects.
+
+enum class SubtreeKind : uint8_t
+{
+    Expr,
+    Block,
+    FuncBody
+};
+
+struct CatalogEntry
+{
+    uint64_t key;
+    SubtreeKind kind;
+    const void *node; // const Expr*, const Block* or, for FuncBody, const FuncDecl*
+};
+
+class SubtreeCatalog
+{
+public:
+    void build(const Program &prog);
+
+    size_t size() const { return m_entries.size(); }
+    const CatalogEntry *random(RandomStream &rng) const;
+    // Entries of `key`, or nullptr when the program has none.
+    const std::vector<uint32_t> *bucket(uint64_t key) const;
+    const CatalogEntry &entry(uint32_t i) const { return m_entries[i]; }
+
+    static uint64_t makeKey(SubtreeKind kind, DType type, uint32_t height, uint64_t signature = 0);
+
+private:
+    friend class CatalogBuilder;
+    void add(SubtreeKind kind, DType type, uint32_t height, const void *node, uint64_t signature = 0);
+
+    std::vector<CatalogEntry> m_entries;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> m_buckets;
+};
+
+class SubtreeCrossover
+{
+public:
+    // attempts: sites tried in parent A before giving up on a compatible pair.
+    explicit SubtreeCrossover(unsigned attempts = 8) : m_attempts(attempts) {}
+
+    // Build the catalogs of a whole population (in parallel). Parents without
+    // a prepared catalog get a temporary one at crossover time.
+    void prepare(const Population &pop, ThreadPool &pool);
+
+    // Offspring = A with one compatible subtree replaced by one from B, or
+    // nullptr when no compatible pair was found.
+    std::unique_ptr<Program> cross(const Program &a, const Program &b, RandomStream &rng) const;
+
+    // GA hooks bound to this object (which must outlive the controller run).
+    CrossoverFn crossoverFn();
+    PrepareFn prepareFn();
+
+private:
+    const SubtreeCatalog *catalogFor(const Program &p) const;
+
+    unsigned m_attempts;
+    std::vector<SubtreeCatalog> m_catalogs;
+    std::unordered_map<const Program *, uint32_t> m_byProgram;
+};
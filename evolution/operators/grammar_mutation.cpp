@@ -0,0 +1,605 @@
+#include "grammar_mutation.hpp"
+#include "../../core/lexer/lexer.hpp"
+#include "../../core/parser/ast_clone.hpp"
+#include "../../core/parser/ast_printer.hpp"
+#include "../../core/parser/parser.hpp"
+#include <cstdio>
+
+namespace
+{
+    const char *const kArithOps[] = {"+", "-", "*", "/", "%"};
+    const char *const kCompareOps[] = {"==", "!=", "<", ">", "<=", ">="};
+    const char *const kLogicOps[] = {"&&", "||"};
+
+    // Every dtype keyword a VarDecl may carry (Block names a type, not a value).
+    const DType kDeclTypes[] = {DType::Number, DType::Text, DType::Bin, DType::Hex, DType::Bool,
+                                DType::Complex, DType::Vector, DType::Sequence, DType::HashMap,
+                                DType::DateTime};
+
+    bool hasLiteralSyntax(DType t)
+    {
+        return t == DType::Number || t == DType::Text || t == DType::Bool || t == DType::Bin || t == DType::Hex;
+    }
+
+    bool hasLiteralKind(DType t)
+    {
+        return hasLiteralSyntax(t) || t == DType::Complex || t == DType::Vector || t == DType::DateTime;
+    }
+
+    ExprPtr binary(ExprPtr l, const char *op, ExprPtr r)
+    {
+        return std::make_unique<BinaryExpr>(std::move(l), op, std::move(r));
+    }
+
+    // Typed names already declared by a program: parameters, variables and
+    // loop variables. Scopes are flattened; this only steers generation.
+    class NameCollector
+    {
+    public:
+        explicit NameCollector(GenexGrammar &g) : grammar(g) {}
+
+        void program(const Program &prog)
+        {
+            for (const auto &v : prog.globalVars)
+                if (v)
+                    stmt(v.get());
+            for (const auto &d : prog.decls)
+            {
+                if (auto f = dynamic_cast<const FuncDecl *>(d.get()))
+                {
+                    func(*f);
+                }
+                else if (auto b = dynamic_cast<const BlockDecl *>(d.get()))
+                {
+                    for (const auto &fld : b->fields)
+                        if (fld)
+                            stmt(fld.get());
+                    for (const auto &m : b->methods)
+                        if (m)
+                            func(*m);
+                }
+            }
+        }
+
+    private:
+        GenexGrammar &grammar;
+
+        void func(const FuncDecl &f)
+        {
+            for (const auto &p : f.params)
+                grammar.addName(p.second, dtypeFromName(p.first));
+            if (f.body)
+                block(*f.body);
+        }
+
+        void block(const Block &b)
+        {
+            for (const auto &s : b)
+                stmt(s.get());
+        }
+
+        void stmt(const Stmt *s)
+        {
+            if (auto vd = dynamic_cast<const VarDecl *>(s))
+            {
+                grammar.addName(vd->varName, dtypeFromName(vd->typeName));
+            }
+            else if (auto is = dynamic_cast<const IfStmt *>(s))
+            {
+                block(is->ifBlock.second);
+                if (is->elseIfs)
+                    for (const auto &ei : *is->elseIfs)
+                        block(ei.second);
+                if (is->elseBlock)
+                    block(*is->elseBlock);
+            }
+            else if (auto ws = dynamic_cast<const WhileStmt *>(s))
+            {
+                block(ws->body);
+            }
+            else if (auto ls = dynamic_cast<const LoopStmt *>(s))
+            {
+                auto init = dynamic_cast<const ExprStmt *>(ls->init.get());
+                auto bin = init ? dynamic_cast<const BinaryExpr *>(init->expr.get()) : nullptr;
+                auto id = bin && bin->op == "=" ? dynamic_cast<const IdentifierExpr *>(bin->left.get()) : nullptr;
+                if (id)
+                    grammar.addName(id->name, ls->dtype ? dtypeFromName(*ls->dtype) : DType::Number);
+                block(ls->body);
+            }
+            else if (auto it = dynamic_cast<const IterStmt *>(s))
+            {
+                grammar.addName(it->varName, DType::Unknown);
+                block(it->body);
+            }
+        }
+    };
+}
+
+//////////////////////////////////////////////////////////////////////////
+// GenexGrammar
+
+DType GenexGrammar::valueType(RandomStream &rng)
+{
+    static const DType types[] = {DType::Number, DType::Number, DType::Number, DType::Bool, DType::Bool,
+                                  DType::Text, DType::Bin, DType::Hex};
+    return types[rng.below(8)];
+}
+
+const std::string *GenexGrammar::nameOf(RandomStream &rng, DType type) const
+{
+    // Count, draw once, walk to the pick: no allocation, a single RNG draw.
+    uint64_t matches = 0;
+    for (const auto &n : m_names)
+        matches += n.second == type;
+    if (matches == 0)
+        return nullptr;
+    uint64_t k = rng.below(matches);
+    for (const auto &n : m_names)
+        if (n.second == type && k-- == 0)
+            return &n.first;
+    return nullptr;
+}
+
+std::string GenexGrammar::freshName()
+{
+    for (;;)
+    {
+        std::string name = "v" + std::to_string(m_fresh++);
+        bool taken = false;
+        for (const auto &n : m_names)
+            taken = taken || n.first == name;
+        if (!taken)
+            return name;
+    }
+}
+
+ExprPtr GenexGrammar::literal(RandomStream &rng, DType type) const
+{
+    std::string v;
+    switch (type)
+    {
+    case DType::Text:
+    {
+        v = "\"";
+        for (uint64_t n = 1 + rng.below(6); n > 0; n--)
+            v += static_cast<char>('a' + rng.below(26));
+        v += "\"";
+        return std::make_unique<LiteralExpr>(v, TokenType::STRING_LITERAL);
+    }
+    case DType::Bool:
+        return std::make_unique<LiteralExpr>(rng.chance(0.5) ? "true" : "false", TokenType::BOOL_LITERAL);
+    case DType::Bin:
+        v = "0b";
+        for (uint64_t n = 1 + rng.below(8); n > 0; n--)
+            v += rng.chance(0.5) ? '1' : '0';
+        return std::make_unique<LiteralExpr>(v, TokenType::BIN_LITERAL);
+    case DType::Hex:
+        v = "0x";
+        for (uint64_t n = 1 + rng.below(4); n > 0; n--)
+            v += "0123456789abcdef"[rng.below(16)];
+        return std::make_unique<LiteralExpr>(v, TokenType::HEX_LITERAL);
+    default:
+        break;
+    }
+
+    if (m_cfg.allLiteralKinds)
+    {
+        char buf[48];
+        switch (type)
+        {
+        case DType::Complex:
+            std::snprintf(buf, sizeof(buf), "%u+%ui", unsigned(rng.below(10)), unsigned(rng.below(10)));
+            return std::make_unique<LiteralExpr>(buf, TokenType::COMPLEX_LITERAL);
+        case DType::Vector:
+            v = "[";
+            for (uint64_t n = 1 + rng.below(4); n > 0; n--)
+                v += std::to_string(rng.below(100)) + (n > 1 ? ", " : "]");
+            return std::make_unique<LiteralExpr>(v, TokenType::VECTOR_LITERAL);
+        case DType::DateTime:
+            std::snprintf(buf, sizeof(buf), "%04u-%02u-%02uT%02u:%02u:00", unsigned(1970 + rng.below(100)),
+                          unsigned(1 + rng.below(12)), unsigned(1 + rng.below(28)), unsigned(rng.below(24)),
+                          unsigned(rng.below(60)));
+            return std::make_unique<LiteralExpr>(buf, TokenType::DATETIME_LITERAL);
+        default:
+            break;
+        }
+    }
+
+    // number, and the fallback for dtypes without literal syntax
+    v = std::to_string(rng.below(100));
+    if (rng.chance(0.2))
+        v += "." + std::to_string(rng.below(10));
+    else if (m_cfg.allLiteralKinds)
+        return std::make_unique<LiteralExpr>(v, TokenType::INT_LITERAL);
+    return std::make_unique<LiteralExpr>(v, TokenType::FLOAT_LITERAL);
+}
+
+ExprPtr GenexGrammar::expr(RandomStream &rng, DType type, int depth) const
+{
+    bool composite = type == DType::Number || type == DType::Bool || type == DType::Text;
+    if (depth <= 0 || !composite || rng.chance(0.35))
+    {
+        const std::string *name = nameOf(rng, type);
+        bool literalOk = m_cfg.allLiteralKinds ? hasLiteralKind(type) : hasLiteralSyntax(type);
+        if (name && (rng.chance(0.6) || !literalOk))
+            return std::make_unique<IdentifierExpr>(*name);
+        return literal(rng, type);
+    }
+
+    switch (type)
+    {
+    case DType::Number:
+        if (rng.chance(0.15))
+            return std::make_unique<UnaryExpr>("-", expr(rng, DType::Number, depth - 1));
+        return binary(expr(rng, DType::Number, depth - 1), kArithOps[rng.below(5)],
+                      expr(rng, DType::Number, depth - 1));
+    case DType::Bool:
+    {
+        double r = rng.uniform();
+        if (r < 0.2)
+            return std::make_unique<UnaryExpr>("!", expr(rng, DType::Bool, depth - 1));
+        if (r < 0.65)
+            return binary(expr(rng, DType::Number, depth - 1), kCompareOps[rng.below(6)],
+                          expr(rng, DType::Number, depth - 1));
+        return binary(expr(rng, DType::Bool, depth - 1), kLogicOps[rng.below(2)],
+                      expr(rng, DType::Bool, depth - 1));
+    }
+    default: // Text
+        return binary(expr(rng, DType::Text, depth - 1), "+", expr(rng, DType::Text, depth - 1));
+    }
+}
+
+std::unique_ptr<VarDecl> GenexGrammar::varDecl(RandomStream &rng)
+{
+    DType type = rng.chance(0.75) ? valueType(rng) : kDeclTypes[rng.below(10)];
+    auto v = std::make_unique<VarDecl>();
+    v->typeName = to_string(type);
+    v->varName = freshName();
+    bool literalOk = m_cfg.allLiteralKinds ? hasLiteralKind(type) : hasLiteralSyntax(type);
+    if (literalOk && rng.chance(0.8))
+        v->initValue = expr(rng, type, m_cfg.maxExprDepth);
+    // Visible to whatever is generated after it.
+    addName(v->varName, type);
+    return v;
+}
+
+StmtPtr GenexGrammar::assignment(RandomStream &rng)
+{
+    // Assign to an existing name of a value type, or declare one.
+    DType type = valueType(rng);
+    const std::string *name = nameOf(rng, type);
+    if (!name)
+        return varDecl(rng);
+    ExprPtr target = std::make_unique<IdentifierExpr>(*name);
+    return std::make_unique<ExprStmt>(binary(std::move(target), "=", expr(rng, type, m_cfg.maxExprDepth)));
+}
+
+StmtPtr GenexGrammar::returnStmt(RandomStream &rng)
+{
+    std::optional<ExprPtr> value;
+    if (rng.chance(0.9))
+        value = expr(rng, valueType(rng), m_cfg.maxExprDepth);
+    return std::make_unique<ReturnStmt>(std::move(value));
+}
+
+StmtPtr GenexGrammar::ifStmt(RandomStream &rng, int depth)
+{
+    auto s = std::make_unique<IfStmt>();
+    s->ifBlock.first = expr(rng, DType::Bool, m_cfg.maxExprDepth);
+    s->ifBlock.second = block(rng, depth - 1);
+    for (uint64_t n = rng.chance(0.3) ? 1 + rng.below(2) : 0; n > 0; n--)
+    {
+        if (!s->elseIfs)
+            s->elseIfs.emplace();
+        s->elseIfs->emplace_back(expr(rng, DType::Bool, m_cfg.maxExprDepth), block(rng, depth - 1));
+    }
+    if (rng.chance(0.4))
+        s->elseBlock = block(rng, depth - 1);
+    return s;
+}
+
+StmtPtr GenexGrammar::whileStmt(RandomStream &rng, int depth)
+{
+    auto s = std::make_unique<WhileStmt>();
+    s->condition = expr(rng, DType::Bool, m_cfg.maxExprDepth);
+    s->body = block(rng, depth - 1);
+    return s;
+}
+
+StmtPtr GenexGrammar::loopStmt(RandomStream &rng, int depth)
+{
+    // loop(number i = a, (i < b), (i = (i + 1))) { ... }
+    auto s = std::make_unique<LoopStmt>();
+    std::string var = freshName();
+    s->dtype = "number";
+    s->init = std::make_unique<ExprStmt>(
+        binary(std::make_unique<IdentifierExpr>(var), "=", literal(rng, DType::Number)));
+    s->condition = binary(std::make_unique<IdentifierExpr>(var), rng.chance(0.5) ? "<" : "<=",
+                          expr(rng, DType::Number, 1));
+    s->step = std::make_unique<ExprStmt>(binary(
+        std::make_unique<IdentifierExpr>(var), "=",
+        binary(std::make_unique<IdentifierExpr>(var), "+", std::make_unique<LiteralExpr>("1", TokenType::FLOAT_LITERAL))));
+    size_t mark = m_names.size();
+    addName(var, DType::Number);
+    s->body = block(rng, depth - 1);
+    m_names.resize(mark);
+    return s;
+}
+
+StmtPtr GenexGrammar::iterStmt(RandomStream &rng, int depth)
+{
+    auto s = std::make_unique<IterStmt>();
+    const std::string *seq = nameOf(rng, rng.chance(0.5) ? DType::Vector : DType::Sequence);
+    if (seq)
+        s->iterable = std::make_unique<IdentifierExpr>(*seq);
+    else
+        s->iterable = literal(rng, DType::Text);
+    s->varName = freshName();
+    size_t mark = m_names.size();
+    addName(s->varName, DType::Unknown);
+    s->body = block(rng, depth - 1);
+    m_names.resize(mark);
+    return s;
+}
+
+StmtPtr GenexGrammar::statement(RandomStream &rng, int depth)
+{
+    // Compound statements only while nesting budget remains.
+    const double weights[] = {m_cfg.assignWeight, m_cfg.varDeclWeight, m_cfg.returnWeight, m_cfg.ifWeight,
+                              m_cfg.whileWeight, m_cfg.loopWeight, m_cfg.iterWeight};
+    size_t n = depth > 0 ? 7 : 3;
+    double total = 0.0;
+    for (size_t i = 0; i < n; i++)
+        total += weights[i];
+    double r = rng.uniform() * total;
+    size_t pick = 0;
+    while (pick + 1 < n && r >= weights[pick])
+        r -= weights[pick++];
+    if (total <= 0.0)
+        pick = 0;
+
+    switch (pick)
+    {
+    case 0: return assignment(rng);
+    case 1: return varDecl(rng);
+    case 2: return returnStmt(rng);
+    case 3: return ifStmt(rng, depth);
+    case 4: return whileStmt(rng, depth);
+    case 5: return loopStmt(rng, depth);
+    default: return iterStmt(rng, depth);
+    }
+}
+
+Block GenexGrammar::block(RandomStream &rng, int depth)
+{
+    Block b;
+    size_t mark = m_names.size();
+    for (uint64_t n = 1 + rng.below(m_cfg.maxBlockStmts); n > 0; n--)
+        b.addStatement(statement(rng, depth));
+    // Declarations inside the block go out of scope with it.
+    m_names.resize(mark);
+    return b;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// GrammarMutator
+
+GrammarMutator::GrammarMutator(Program &prog, const GrammarConfig &cfg)
+    : m_prog(prog), m_cfg(cfg), m_grammar(cfg), m_index(prog)
+{
+    NameCollector(m_grammar).program(prog);
+}
+
+bool GrammarMutator::regenerateExpr(RandomStream &rng)
+{
+    const ExprSite *site = m_index.randomExpr(rng);
+    if (!site)
+        return false;
+    ExprPtr *slot = site->slot;
+    uint32_t depth = site->depth;
+
+    // Keep the kind of value the position held when it is evident.
+    DType type = DType::Unknown;
+    if (auto lit = dynamic_cast<const LiteralExpr *>(slot->get()))
+        type = dtypeOfLiteral(lit->litType);
+    else if (auto b = dynamic_cast<const BinaryExpr *>(slot->get()))
+        type = isComparisonOp(b->op) || isLogicalOp(b->op) ? DType::Bool : DType::Unknown;
+    else if (auto u = dynamic_cast<const UnaryExpr *>(slot->get()))
+        type = u->op == "!" ? DType::Bool : DType::Number;
+    if (type == DType::Unknown)
+        type = GenexGrammar::valueType(rng);
+
+    ExprPtr fresh = m_grammar.expr(rng, type, m_cfg.maxExprDepth);
+    m_index.removeExpr(slot->get());
+    *slot = std::move(fresh);
+    m_index.addExpr(*slot, depth);
+    return true;
+}
+
+bool GrammarMutator::regenerateStmt(RandomStream &rng)
+{
+    const StmtSite *site = m_index.randomStmt(rng);
+    if (!site)
+        return false;
+    Block *block = site->block;
+    Stmt *old = site->stmt;
+    uint32_t depth = site->depth;
+
+    StmtPtr fresh = m_grammar.statement(rng, m_cfg.maxStmtDepth);
+    Stmt *raw = fresh.get();
+    m_index.removeStmt(old);
+    block->replaceAt(block->indexOf(old), std::move(fresh));
+    m_index.addStmt(*block, raw, depth);
+    return true;
+}
+
+bool GrammarMutator::insert(RandomStream &rng, StmtPtr s)
+{
+    Block *block = nullptr;
+    size_t pos = 0;
+    uint32_t depth = 1;
+    if (const StmtSite *site = m_index.randomStmt(rng))
+    {
+        block = site->block;
+        depth = site->depth;
+        pos = block->indexOf(site->stmt);
+    }
+    else
+    {
+        // No statements anywhere: start the body of the first function.
+        for (auto &d : m_prog.decls)
+        {
+            auto f = dynamic_cast<FuncDecl *>(d.get());
+            if (f && f->body)
+            {
+                block = &*f->body;
+                break;
+            }
+        }
+        if (!block)
+            return false;
+    }
+    Stmt *raw = s.get();
+    block->insertAt(pos, std::move(s));
+    m_index.addStmt(*block, raw, depth);
+    return true;
+}
+
+bool GrammarMutator::apply(GrammarOp op, RandomStream &rng)
+{
+    bool ok = false;
+    switch (op)
+    {
+    case GrammarOp::RegenerateExpr:
+        ok = regenerateExpr(rng);
+        break;
+    case GrammarOp::RegenerateStmt:
+        ok = regenerateStmt(rng);
+        break;
+    case GrammarOp::InsertStmt:
+        ok = insert(rng, m_grammar.statement(rng, m_cfg.maxStmtDepth));
+        break;
+    case GrammarOp::InsertVarDecl:
+        ok = insert(rng, m_grammar.varDecl(rng));
+        break;
+    default:
+        break;
+    }
+    if (ok)
+        m_applied++;
+    return ok;
+}
+
+bool GrammarMutator::mutate(RandomStream &rng)
+{
+    const double weights[] = {m_cfg.regenerateExpr, m_cfg.regenerateStmt, m_cfg.insertStmt, m_cfg.insertVarDecl};
+    constexpr size_t n = static_cast<size_t>(GrammarOp::Count);
+    double total = 0.0;
+    for (double x : weights)
+        total += x;
+    if (total <= 0.0)
+        return false;
+
+    double r = rng.uniform() * total;
+    size_t first = 0;
+    while (first + 1 < n && r >= weights[first])
+        r -= weights[first++];
+    for (size_t k = 0; k < n; k++)
+    {
+        size_t op = (first + k) % n;
+        if (weights[op] > 0.0 && apply(static_cast<GrammarOp>(op), rng))
+            return true;
+    }
+    return false;
+}
+
+MutationFn GrammarMutator::makeMutationFn(GrammarConfig cfg, unsigned count)
+{
+    return [cfg, count](Program &prog, RandomStream &rng) {
+        GrammarMutator m(prog, cfg);
+        for (unsigned i = 0; i < count; i++)
+            m.mutate(rng);
+    };
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Parse-rate measurement
+
+bool parsesCleanly(const std::string &source)
+{
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.tokenize();
+    Parser parser(tokens);
+    parser.setEcho(false);
+    parser.parse();
+    return parser.errors().empty();
+}
+
+std::string naiveTokenMutation(const std::string &source, RandomStream &rng)
+{
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.tokenize();
+    if (!tokens.empty() && tokens.back().type == TokenType::END_OF_FILE)
+        tokens.pop_back();
+
+    std::vector<std::string> lexemes;
+    lexemes.reserve(tokens.size() + 1);
+    for (const auto &t : tokens)
+        lexemes.push_back(t.lexeme);
+    if (!lexemes.empty())
+    {
+        size_t i = rng.below(lexemes.size());
+        switch (rng.below(4))
+        {
+        case 0: // delete
+            lexemes.erase(lexemes.begin() + i);
+            break;
+        case 1: // duplicate
+            lexemes.insert(lexemes.begin() + i, lexemes[i]);
+            break;
+        case 2: // replace with another token of the same program
+            lexemes[i] = lexemes[rng.below(lexemes.size())];
+            break;
+        default: // swap with the next token
+            if (i + 1 < lexemes.size())
+                std::swap(lexemes[i], lexemes[i + 1]);
+            break;
+        }
+    }
+
+    std::string out;
+    for (const auto &l : lexemes)
+    {
+        out += l;
+        out += ' ';
+    }
+    return out;
+}
+
+ParseRateReport measureParseRate(const std::vector<const Program *> &seeds, unsigned trialsPerSeed,
+                                 uint64_t seed, const GrammarConfig &cfg)
+{
+    ParseRateReport report;
+    for (size_t s = 0; s < seeds.size(); s++)
+    {
+        if (!seeds[s])
+            continue;
+        std::string source = AstPrinter::print(*seeds[s]);
+        for (unsigned t = 0; t < trialsPerSeed; t++)
+        {
+            uint64_t candidate = s * trialsPerSeed + t;
+            RandomStream grammarRng(seed, 0, candidate, RngStream::Mutation);
+            RandomStream naiveRng(seed, 0, candidate, RngStream::User);
+
+            std::unique_ptr<Program> child = AstCloner::clone(*seeds[s]);
+            GrammarMutator(*child, cfg).mutate(grammarRng);
+
+            report.trials++;
+            if (parsesCleanly(AstPrinter::print(*child)))
+                report.grammarParsed++;
+            if (parsesCleanly(naiveTokenMutation(source, naiveRng)))
+                report.naiveParsed++;
+        }
+    }
+    return report;
+}
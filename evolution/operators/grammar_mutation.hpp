@@ -0,0 +1,147 @@
+#pragma once
+#include "../../core/parser/ast.hpp"
+#include "../../core/semantic/dtype.hpp"
+#include "../../core/utils/rng.hpp"
+#include "../engine/ga_controller.hpp"
+#include "node_index.hpp"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Grammar-aware mutation.
+//
+// Rather than perturbing text or tokens, a GrammarMutator picks a site and
+// regenerates it from the production the Parser uses at that position: an
+// expression, a statement (if / while / loop / iter / return / assignment)
+// or a VarDecl. Generated subtrees are built only from tokens the Lexer can
+// produce and shapes the Parser accepts, so printed offspring always parse.
+
+struct GrammarConfig
+{
+    int maxExprDepth = 3;  // depth of generated expressions
+    int maxStmtDepth = 2;  // nesting of generated if / while / loop / iter
+    int maxBlockStmts = 3; // statements per generated block
+
+    // statement mix
+    double assignWeight = 3.0;
+    double varDeclWeight = 2.0;
+    double returnWeight = 1.0;
+    double ifWeight = 2.0;
+    double whileWeight = 1.0;
+    double loopWeight = 1.0;
+    double iterWeight = 1.0;
+
+    // Also produce the literal kinds the lexer has no syntax for yet
+    // (INT, COMPLEX, VECTOR, DATETIME). Such programs are for AST
+    // consumers; their printed text does not parse.
+    bool allLiteralKinds = false;
+
+    // operator weights
+    double regenerateExpr = 4.0;
+    double regenerateStmt = 2.0;
+    double insertStmt = 1.0;
+    double insertVarDecl = 1.0;
+};
+
+enum class GrammarOp : uint8_t
+{
+    RegenerateExpr, // expression -> fresh derivation of Expr
+    RegenerateStmt, // statement -> fresh derivation of a statement
+    InsertStmt,     // new statement before an existing one
+    InsertVarDecl,  // new typed VarDecl before an existing statement
+    Count
+};
+
+// Random derivations of the Genex grammar. Identifiers come from a typed
+// name table so generated code mostly refers to names of the right dtype;
+// dtypes without literal syntax (complex, vector, ...) are only reached
+// through such names unless allLiteralKinds is set.
+class GenexGrammar
+{
+public:
+    explicit GenexGrammar(const GrammarConfig &cfg = {}) : m_cfg(cfg) {}
+
+    void addName(const std::string &name, DType type) { m_names.emplace_back(name, type); }
+    size_t nameCount() const { return m_names.size(); }
+    // Scope handling: names added after `mark` are dropped.
+    void dropNames(size_t mark) { m_names.resize(mark); }
+    std::string freshName();
+
+    ExprPtr expr(RandomStream &rng, DType type, int depth) const;
+    ExprPtr literal(RandomStream &rng, DType type) const;
+    StmtPtr statement(RandomStream &rng, int depth);
+    std::unique_ptr<VarDecl> varDecl(RandomStream &rng);
+    Block block(RandomStream &rng, int depth);
+
+    // A value type with literal syntax: number, text, bool, bin or hex.
+    static DType valueType(RandomStream &rng);
+
+private:
+    const std::string *nameOf(RandomStream &rng, DType type) const;
+
+    StmtPtr assignment(RandomStream &rng);
+    StmtPtr ifStmt(RandomStream &rng, int depth);
+    StmtPtr whileStmt(RandomStream &rng, int depth);
+    StmtPtr loopStmt(RandomStream &rng, int depth);
+    StmtPtr iterStmt(RandomStream &rng, int depth);
+    StmtPtr returnStmt(RandomStream &rng);
+
+    GrammarConfig m_cfg;
+    std::vector<std::pair<std::string, DType>> m_names;
+    uint32_t m_fresh = 0;
+};
+
+class GrammarMutator
+{
+public:
+    explicit GrammarMutator(Program &prog, const GrammarConfig &cfg = {});
+
+    // Apply one specific operator; false when it has no applicable site.
+    bool apply(GrammarOp op, RandomStream &rng);
+
+    // Apply one weighted-random operator, falling back to the others when
+    // the chosen one has no site. Returns false only if nothing applied.
+    bool mutate(RandomStream &rng);
+
+    uint64_t applied() const { return m_applied; }
+
+    // GA hook applying `count` grammar mutations per offspring.
+    static MutationFn makeMutationFn(GrammarConfig cfg = {}, unsigned count = 1);
+
+private:
+    bool regenerateExpr(RandomStream &rng);
+    bool regenerateStmt(RandomStream &rng);
+    bool insert(RandomStream &rng, StmtPtr s);
+
+    Program &m_prog;
+    GrammarConfig m_cfg;
+    GenexGrammar m_grammar;
+    NodeIndex m_index;
+    uint64_t m_applied = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Parse-rate measurement: grammar mutation vs. naive token-level mutation
+// (delete / duplicate / replace / swap one token of the printed source),
+// each applied once to a copy of every seed per trial.
+
+struct ParseRateReport
+{
+    uint64_t trials = 0;
+    uint64_t grammarParsed = 0;
+    uint64_t naiveParsed = 0;
+
+    double grammarPercent() const { return trials ? 100.0 * grammarParsed / trials : 0.0; }
+    double naivePercent() const { return trials ? 100.0 * naiveParsed / trials : 0.0; }
+};
+
+// True if `source` lexes and parses without errors.
+bool parsesCleanly(const std::string &source);
+
+// One random token-level edit of `source`, re-joined with single spaces.
+std::string naiveTokenMutation(const std::string &source, RandomStream &rng);
+
+ParseRateReport measureParseRate(const std::vector<const Program *> &seeds, unsigned trialsPerSeed,
+                                 uint64_t seed, const GrammarConfig &cfg = {});
@@ -0,0 +1,255 @@
+#include "mutation.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+    const char *const kBinaryOps[] = {"+", "-", "*", "/", "%", "==", "!=", "<", ">", "<=", ">=", "&&", "||"};
+    const char *const kUnaryOps[] = {"-", "!"};
+
+    std::string formatNumber(double v)
+    {
+        char buf[32];
+        if (std::fabs(v) < 1e15 && v == std::floor(v))
+            std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v));
+        else
+            std::snprintf(buf, sizeof(buf), "%.6g", v);
+        return buf;
+    }
+
+    ExprPtr numberLiteral(double v)
+    {
+        return std::make_unique<LiteralExpr>(formatNumber(v), TokenType::FLOAT_LITERAL);
+    }
+}
+
+Mutator::Mutator(Program &prog) : m_prog(prog), m_index(prog) {}
+
+//////////////////////////////////////////////////////////////////////////
+// Random subtrees
+
+ExprPtr Mutator::randomLeaf(RandomStream &rng)
+{
+    // Prefer names that already occur in the program so the new subtree
+    // refers to something in scope more often than not.
+    const ExprSite *id = m_index.randomExpr(rng, NodeCategory::Identifier);
+    if (id && rng.chance(0.6))
+        return std::make_unique<IdentifierExpr>(static_cast<IdentifierExpr *>(id->slot->get())->name);
+    return numberLiteral(static_cast<double>(rng.below(10)));
+}
+
+ExprPtr Mutator::randomExpr(RandomStream &rng, int depth)
+{
+    if (depth <= 0 || rng.chance(0.4))
+        return randomLeaf(rng);
+    if (rng.chance(0.15))
+        return std::make_unique<UnaryExpr>(kUnaryOps[rng.below(2)], randomExpr(rng, depth - 1));
+    ExprPtr l = randomExpr(rng, depth - 1);
+    ExprPtr r = randomExpr(rng, depth - 1);
+    return std::make_unique<BinaryExpr>(std::move(l), kBinaryOps[rng.below(13)], std::move(r));
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Operators
+
+bool Mutator::replaceExpr(RandomStream &rng, const MutationWeights &w)
+{
+    const ExprSite *site = m_index.randomExpr(rng);
+    if (!site)
+        return false;
+    ExprPtr *slot = site->slot;
+    uint32_t depth = site->depth;
+    ExprPtr fresh = randomExpr(rng, w.maxNewDepth);
+    m_index.removeExpr(slot->get());
+    *slot = std::move(fresh);
+    m_index.addExpr(*slot, depth);
+    return true;
+}
+
+bool Mutator::wrapExpr(RandomStream &rng)
+{
+    const ExprSite *site = m_index.randomExpr(rng);
+    if (!site)
+        return false;
+    ExprPtr *slot = site->slot;
+    uint32_t depth = site->depth;
+    m_index.removeExpr(slot->get());
+    ExprPtr inner = std::move(*slot);
+    if (rng.chance(0.25))
+    {
+        *slot = std::make_unique<UnaryExpr>(kUnaryOps[rng.below(2)], std::move(inner));
+    }
+    else
+    {
+        ExprPtr other = randomLeaf(rng);
+        const char *op = kBinaryOps[rng.below(13)];
+        if (rng.chance(0.5))
+            *slot = std::make_unique<BinaryExpr>(std::move(inner), op, std::move(other));
+        else
+            *slot = std::make_unique<BinaryExpr>(std::move(other), op, std::move(inner));
+    }
+    m_index.addExpr(*slot, depth);
+    return true;
+}
+
+bool Mutator::mutateLiteral(RandomStream &rng)
+{
+    const ExprSite *site = m_index.randomExpr(rng, NodeCategory::Literal);
+    if (!site)
+        return false;
+    // In-place edit: the node stays where it is, the index is unaffected.
+    auto lit = static_cast<LiteralExpr *>(site->slot->get());
+    std::string &v = lit->value;
+    switch (lit->litType)
+    {
+    case TokenType::INT_LITERAL:
+    case TokenType::FLOAT_LITERAL:
+    {
+        double x = std::strtod(v.c_str(), nullptr);
+        double step = rng.chance(0.5) ? 1.0 : std::floor(rng.uniform() * 10.0);
+        x = rng.chance(0.5) ? x + step : std::fabs(x - step);
+        v = formatNumber(x);
+        return true;
+    }
+    case TokenType::BOOL_LITERAL:
+        v = v == "true" ? "false" : "true";
+        return true;
+    case TokenType::BIN_LITERAL:
+        if (v.size() > 2)
+        {
+            size_t i = 2 + rng.below(v.size() - 2);
+            v[i] = v[i] == '0' ? '1' : '0';
+            return true;
+        }
+        return false;
+    case TokenType::HEX_LITERAL:
+        if (v.size() > 2)
+        {
+            v[2 + rng.below(v.size() - 2)] = "0123456789abcdef"[rng.below(16)];
+            return true;
+        }
+        return false;
+    case TokenType::STRING_LITERAL:
+    {
+        // Keep the quotes, rewrite one character in between.
+        size_t begin = !v.empty() && v.front() == '"' ? 1 : 0;
+        size_t end = !v.empty() && v.back() == '"' ? v.size() - 1 : v.size();
+        if (end <= begin)
+            return false;
+        v[begin + rng.below(end - begin)] = static_cast<char>('a' + rng.below(26));
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+bool Mutator::renameIdentifier(RandomStream &rng)
+{
+    const ExprSite *site = m_index.randomExpr(rng, NodeCategory::Identifier);
+    const ExprSite *donor = m_index.randomExpr(rng, NodeCategory::Identifier);
+    if (!site || !donor)
+        return false;
+    auto id = static_cast<IdentifierExpr *>(site->slot->get());
+    const std::string &name = static_cast<IdentifierExpr *>(donor->slot->get())->name;
+    if (id->name == name)
+        return false;
+    id->name = name;
+    return true;
+}
+
+bool Mutator::deleteStmt(RandomStream &rng)
+{
+    const StmtSite *site = m_index.randomStmt(rng);
+    if (!site)
+        return false;
+    Block *block = site->block;
+    Stmt *stmt = site->stmt;
+    m_index.removeStmt(stmt);
+    block->removeAt(block->indexOf(stmt));
+    return true;
+}
+
+bool Mutator::wrapStmt(RandomStream &rng)
+{
+    const StmtSite *site = m_index.randomStmt(rng);
+    if (!site)
+        return false;
+    Block *block = site->block;
+    Stmt *stmt = site->stmt;
+    uint32_t depth = site->depth;
+    size_t pos = block->indexOf(stmt);
+
+    auto wrapper = std::make_unique<IfStmt>();
+    wrapper->ifBlock.first = randomExpr(rng, 2);
+    m_index.removeStmt(stmt);
+    wrapper->ifBlock.second.addStatement(block->removeAt(pos));
+    Stmt *raw = wrapper.get();
+    block->insertAt(pos, std::move(wrapper));
+    m_index.addStmt(*block, raw, depth);
+    return true;
+}
+
+bool Mutator::apply(MutationOp op, RandomStream &rng, const MutationWeights &w)
+{
+    bool ok = false;
+    switch (op)
+    {
+    case MutationOp::ReplaceExpr:
+        ok = replaceExpr(rng, w);
+        break;
+    case MutationOp::WrapExpr:
+        ok = wrapExpr(rng);
+        break;
+    case MutationOp::MutateLiteral:
+        ok = mutateLiteral(rng);
+        break;
+    case MutationOp::RenameIdentifier:
+        ok = renameIdentifier(rng);
+        break;
+    case MutationOp::DeleteStmt:
+        ok = deleteStmt(rng);
+        break;
+    case MutationOp::WrapStmt:
+        ok = wrapStmt(rng);
+        break;
+    default:
+        break;
+    }
+    if (ok)
+        m_applied++;
+    return ok;
+}
+
+bool Mutator::mutate(RandomStream &rng, const MutationWeights &w)
+{
+    const double weights[] = {w.replaceExpr, w.wrapExpr, w.mutateLiteral, w.renameIdentifier, w.deleteStmt, w.wrapStmt};
+    constexpr size_t n = static_cast<size_t>(MutationOp::Count);
+    double total = 0.0;
+    for (double x : weights)
+        total += x;
+    if (total <= 0.0)
+        return false;
+
+    double r = rng.uniform() * total;
+    size_t first = 0;
+    while (first + 1 < n && r >= weights[first])
+        r -= weights[first++];
+    for (size_t k = 0; k < n; k++)
+    {
+        size_t op = (first + k) % n;
+        if (weights[op] > 0.0 && apply(static_cast<MutationOp>(op), rng, w))
+            return true;
+    }
+    return false;
+}
+
+MutationFn Mutator::makeMutationFn(MutationWeights w, unsigned count)
+{
+    return [w, count](Program &prog, RandomStream &rng) {
+        Mutator m(prog);
+        for (unsigned i = 0; i < count; i++)
+            m.mutate(rng, w);
+    };
+}
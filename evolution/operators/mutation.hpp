@@ -0,0 +1,69 @@
+#pragma once
+#include "../../core/parser/ast.hpp"
+#include "../../core/utils/rng.hpp"
+#include "../engine/ga_controller.hpp"
+#include "node_index.hpp"
+#include <cstdint>
+
+//////////////////////////////////////////////////////////////////////////
+// Subtree mutation operators over a NodeIndex.
+//
+// Every operator picks its target with one O(1) draw from the index and
+// updates the index for the subtree it touched, so a Mutator can apply many
+// edits to one program without re-walking it.
+
+enum class MutationOp : uint8_t
+{
+    ReplaceExpr,      // expression -> fresh random subtree
+    WrapExpr,         // e -> (e op x) | -e | !e
+    MutateLiteral,    // perturb a literal in place
+    RenameIdentifier, // point an identifier at another name in the program
+    DeleteStmt,       // drop a statement from its block
+    WrapStmt,         // s -> if(cond) { s }
+    Count
+};
+
+struct MutationWeights
+{
+    double replaceExpr = 3.0;
+    double wrapExpr = 1.0;
+    double mutateLiteral = 3.0;
+    double renameIdentifier = 2.0;
+    double deleteStmt = 1.0;
+    double wrapStmt = 1.0;
+    int maxNewDepth = 3; // depth limit of generated subtrees
+};
+
+class Mutator
+{
+public:
+    explicit Mutator(Program &prog);
+
+    // Apply one specific operator; false when it has no applicable site.
+    bool apply(MutationOp op, RandomStream &rng, const MutationWeights &w = {});
+
+    // Apply one weighted-random operator, falling back to the others when
+    // the chosen one has no site. Returns false only if nothing applied.
+    bool mutate(RandomStream &rng, const MutationWeights &w = {});
+
+    const NodeIndex &index() const { return m_index; }
+    uint64_t applied() const { return m_applied; }
+
+    // GA hook applying `count` mutations per offspring.
+    static MutationFn makeMutationFn(MutationWeights w = {}, unsigned count = 1);
+
+private:
+    bool replaceExpr(RandomStream &rng, const MutationWeights &w);
+    bool wrapExpr(RandomStream &rng);
+    bool mutateLiteral(RandomStream &rng);
+    bool renameIdentifier(RandomStream &rng);
+    bool deleteStmt(RandomStream &rng);
+    bool wrapStmt(RandomStream &rng);
+
+    ExprPtr randomExpr(RandomStream &rng, int depth);
+    ExprPtr randomLeaf(RandomStream &rng);
+
+    Program &m_prog;
+    NodeIndex m_index;
+    uint64_t m_applied = 0;
+};
@@ -0,0 +1,321 @@
+#include "node_index.hpp"
+
+size_t NodeIndex::bucket(NodeCategory c)
+{
+    switch (c)
+    {
+    case NodeCategory::Literal:
+        return 1;
+    case NodeCategory::Identifier:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+void NodeIndex::clear()
+{
+    for (size_t i = 0; i < 3; i++)
+    {
+        m_exprs[i].clear();
+        m_exprPos[i].clear();
+    }
+    m_stmts.clear();
+    m_stmtPos.clear();
+}
+
+void NodeIndex::build(Program &prog)
+{
+    clear();
+    for (auto &d : prog.decls)
+    {
+        if (auto f = dynamic_cast<FuncDecl *>(d.get()))
+        {
+            addFunc(f);
+        }
+        else if (auto b = dynamic_cast<BlockDecl *>(d.get()))
+        {
+            for (auto &fld : b->fields)
+                if (fld && fld->initValue)
+                    addExpr(*fld->initValue, 1);
+            for (auto &m : b->methods)
+                addFunc(m.get());
+        }
+    }
+    for (auto &e : prog.globalExprs)
+        addExpr(e, 0);
+    for (auto &v : prog.globalVars)
+        if (v && v->initValue)
+            addExpr(*v->initValue, 1);
+}
+
+void NodeIndex::addFunc(FuncDecl *f)
+{
+    if (f && f->body)
+        addBlock(*f->body, 1);
+}
+
+size_t NodeIndex::count(NodeCategory c) const
+{
+    if (c == NodeCategory::Stmt)
+        return m_stmts.size();
+    return m_exprs[bucket(c)].size();
+}
+
+const ExprSite *NodeIndex::randomExpr(RandomStream &rng, NodeCategory c) const
+{
+    const auto &b = m_exprs[bucket(c)];
+    if (b.empty())
+        return nullptr;
+    return &b[rng.below(b.size())];
+}
+
+const StmtSite *NodeIndex::randomStmt(RandomStream &rng) const
+{
+    if (m_stmts.empty())
+        return nullptr;
+    return &m_stmts[rng.below(m_stmts.size())];
+}
+
+const StmtSite *NodeIndex::find(const Stmt *s) const
+{
+    auto it = m_stmtPos.find(s);
+    return it == m_stmtPos.end() ? nullptr : &m_stmts[it->second];
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Expressions
+
+void NodeIndex::addExprSite(ExprPtr &slot, uint32_t depth, NodeCategory c)
+{
+    size_t b = bucket(c);
+    m_exprPos[b][slot.get()] = static_cast<uint32_t>(m_exprs[b].size());
+    m_exprs[b].push_back(ExprSite{&slot, depth});
+}
+
+void NodeIndex::removeExprSite(const Expr *e, NodeCategory c)
+{
+    size_t b = bucket(c);
+    auto it = m_exprPos[b].find(e);
+    if (it == m_exprPos[b].end())
+        return;
+    uint32_t pos = it->second;
+    m_exprPos[b].erase(it);
+    ExprSite last = m_exprs[b].back();
+    m_exprs[b].pop_back();
+    if (pos < m_exprs[b].size())
+    {
+        m_exprs[b][pos] = last;
+        m_exprPos[b][last.slot->get()] = pos;
+    }
+}
+
+void NodeIndex::addExpr(ExprPtr &slot, uint32_t depth)
+{
+    Expr *e = slot.get();
+    if (!e)
+        return;
+    addExprSite(slot, depth, NodeCategory::Expr);
+    if (dynamic_cast<LiteralExpr *>(e))
+    {
+        addExprSite(slot, depth, NodeCategory::Literal);
+    }
+    else if (dynamic_cast<IdentifierExpr *>(e))
+    {
+        addExprSite(slot, depth, NodeCategory::Identifier);
+    }
+    else if (auto u = dynamic_cast<UnaryExpr *>(e))
+    {
+        addExpr(u->right, depth + 1);
+    }
+    else if (auto bin = dynamic_cast<BinaryExpr *>(e))
+    {
+        addExpr(bin->left, depth + 1);
+        addExpr(bin->right, depth + 1);
+    }
+    else if (auto c = dynamic_cast<CallExpr *>(e))
+    {
+        // The callee is a name, not a value: leave it out of the buckets.
+        for (auto &a : c->args)
+            addExpr(a, depth + 1);
+    }
+}
+
+void NodeIndex::removeExpr(const Expr *e)
+{
+    if (!e)
+        return;
+    removeExprSite(e, NodeCategory::Expr);
+    if (dynamic_cast<const LiteralExpr *>(e))
+    {
+        removeExprSite(e, NodeCategory::Literal);
+    }
+    else if (dynamic_cast<const IdentifierExpr *>(e))
+    {
+        removeExprSite(e, NodeCategory::Identifier);
+    }
+    else if (auto u = dynamic_cast<const UnaryExpr *>(e))
+    {
+        removeExpr(u->right.get());
+    }
+    else if (auto bin = dynamic_cast<const BinaryExpr *>(e))
+    {
+        removeExpr(bin->left.get());
+        removeExpr(bin->right.get());
+    }
+    else if (auto c = dynamic_cast<const CallExpr *>(e))
+    {
+        for (const auto &a : c->args)
+            removeExpr(a.get());
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Statements
+
+void NodeIndex::addBlock(Block &b, uint32_t depth)
+{
+    for (size_t i = 0; i < b.size(); i++)
+        addStmt(b, b.at(i), depth);
+}
+
+void NodeIndex::removeBlock(const Block &b)
+{
+    for (const auto &s : b)
+        removeStmt(s.get());
+}
+
+void NodeIndex::addStmt(Block &block, Stmt *s, uint32_t depth)
+{
+    if (!s)
+        return;
+    m_stmtPos[s] = static_cast<uint32_t>(m_stmts.size());
+    m_stmts.push_back(StmtSite{&block, s, depth});
+    addStmtChildren(s, depth);
+}
+
+void NodeIndex::removeStmt(const Stmt *s)
+{
+    if (!s)
+        return;
+    auto it = m_stmtPos.find(s);
+    if (it != m_stmtPos.end())
+    {
+        uint32_t pos = it->second;
+        m_stmtPos.erase(it);
+        StmtSite last = m_stmts.back();
+        m_stmts.pop_back();
+        if (pos < m_stmts.size())
+        {
+            m_stmts[pos] = last;
+            m_stmtPos[last.stmt] = pos;
+        }
+    }
+    removeStmtChildren(s);
+}
+
+void NodeIndex::addStmtChildren(Stmt *s, uint32_t depth)
+{
+    if (auto es = dynamic_cast<ExprStmt *>(s))
+    {
+        addExpr(es->expr, depth + 1);
+    }
+    else if (auto rs = dynamic_cast<ReturnStmt *>(s))
+    {
+        if (rs->value)
+            addExpr(*rs->value, depth + 1);
+    }
+    else if (auto is = dynamic_cast<IfStmt *>(s))
+    {
+        addExpr(is->ifBlock.first, depth + 1);
+        addBlock(is->ifBlock.second, depth + 1);
+        if (is->elseIfs)
+        {
+            for (auto &ei : *is->elseIfs)
+            {
+                addExpr(ei.first, depth + 1);
+                addBlock(ei.second, depth + 1);
+            }
+        }
+        if (is->elseBlock)
+            addBlock(*is->elseBlock, depth + 1);
+    }
+    else if (auto ws = dynamic_cast<WhileStmt *>(s))
+    {
+        addExpr(ws->condition, depth + 1);
+        addBlock(ws->body, depth + 1);
+    }
+    else if (auto ls = dynamic_cast<LoopStmt *>(s))
+    {
+        // init/step are header clauses, not block statements: index their
+        // expressions only.
+        if (auto init = dynamic_cast<ExprStmt *>(ls->init.get()))
+            addExpr(init->expr, depth + 1);
+        addExpr(ls->condition, depth + 1);
+        if (auto step = dynamic_cast<ExprStmt *>(ls->step.get()))
+            addExpr(step->expr, depth + 1);
+        addBlock(ls->body, depth + 1);
+    }
+    else if (auto it = dynamic_cast<IterStmt *>(s))
+    {
+        addExpr(it->iterable, depth + 1);
+        addBlock(it->body, depth + 1);
+    }
+    else if (auto vd = dynamic_cast<VarDecl *>(s))
+    {
+        if (vd->initValue)
+            addExpr(*vd->initValue, depth + 1);
+    }
+}
+
+void NodeIndex::removeStmtChildren(const Stmt *s)
+{
+    if (auto es = dynamic_cast<const ExprStmt *>(s))
+    {
+        removeExpr(es->expr.get());
+    }
+    else if (auto rs = dynamic_cast<const ReturnStmt *>(s))
+    {
+        if (rs->value)
+            removeExpr(rs->value->get());
+    }
+    else if (auto is = dynamic_cast<const IfStmt *>(s))
+    {
+        removeExpr(is->ifBlock.first.get());
+        removeBlock(is->ifBlock.second);
+        if (is->elseIfs)
+        {
+            for (const auto &ei : *is->elseIfs)
+            {
+                removeExpr(ei.first.get());
+                removeBlock(ei.second);
+            }
+        }
+        if (is->elseBlock)
+            removeBlock(*is->elseBlock);
+    }
+    else if (auto ws = dynamic_cast<const WhileStmt *>(s))
+    {
+        removeExpr(ws->condition.get());
+        removeBlock(ws->body);
+    }
+    else if (auto ls = dynamic_cast<const LoopStmt *>(s))
+    {
+        if (auto init = dynamic_cast<const ExprStmt *>(ls->init.get()))
+            removeExpr(init->expr.get());
+        removeExpr(ls->condition.get());
+        if (auto step = dynamic_cast<const ExprStmt *>(ls->step.get()))
+            removeExpr(step->expr.get());
+        removeBlock(ls->body);
+    }
+    else if (auto it = dynamic_cast<const IterStmt *>(s))
+    {
+        removeExpr(it->iterable.get());
+        removeBlock(it->body);
+    }
+    else if (auto vd = dynamic_cast<const VarDecl *>(s))
+    {
+        if (vd->initValue)
+            removeExpr(vd->initValue->get());
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "../../core/parser/ast.hpp"
+#include "../../core/utils/rng.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Per-program index of mutable AST sites, bucketed by category.
+//
+// Each bucket is a dense array, so a uniformly random site of a category is
+// one RNG draw away. A side table maps every indexed node to its slot in
+// the bucket, which lets edits unindex a subtree by swap-and-pop: keeping
+// the index current costs O(size of the edited subtree), never O(program).
+
+enum class NodeCategory : uint8_t
+{
+    Expr,       // every expression
+    Stmt,       // statements that live directly in a Block
+    Literal,    // LiteralExpr subset of Expr
+    Identifier, // IdentifierExpr subset of Expr (callee names excluded)
+    Count
+};
+
+// Where an expression lives: the owning pointer, so it can be replaced.
+struct ExprSite
+{
+    ExprPtr *slot;
+    uint32_t depth;
+};
+
+// Where a statement lives: its Block and the node itself (positions shift
+// as siblings are edited, so they are looked up on demand).
+struct StmtSite
+{
+    Block *block;
+    Stmt *stmt;
+    uint32_t depth;
+};
+
+class NodeIndex
+{
+public:
+    NodeIndex() = default;
+    explicit NodeIndex(Program &prog) { build(prog); }
+
+    void build(Program &prog);
+    void clear();
+
+    size_t count(NodeCategory c) const;
+    size_t size() const { return count(NodeCategory::Expr) + count(NodeCategory::Stmt); }
+
+    // O(1) uniform picks; nullptr when the bucket is empty.
+    const ExprSite *randomExpr(RandomStream &rng, NodeCategory c = NodeCategory::Expr) const;
+    const StmtSite *randomStmt(RandomStream &rng) const;
+
+    const std::vector<ExprSite> &exprs(NodeCategory c) const { return m_exprs[bucket(c)]; }
+    const std::vector<StmtSite> &stmts() const { return m_stmts; }
+    const StmtSite *find(const Stmt *s) const;
+
+    // Incremental maintenance. Call remove*() before detaching or destroying
+    // a subtree and add*() once the new subtree is attached at its site.
+    void addExpr(ExprPtr &slot, uint32_t depth);
+    void removeExpr(const Expr *e);
+    void addStmt(Block &block, Stmt *s, uint32_t depth);
+    void removeStmt(const Stmt *s);
+
+private:
+    static size_t bucket(NodeCategory c);
+
+    void addExprSite(ExprPtr &slot, uint32_t depth, NodeCategory c);
+    void removeExprSite(const Expr *e, NodeCategory c);
+    void addBlock(Block &b, uint32_t depth);
+    void removeBlock(const Block &b);
+    void addStmtChildren(Stmt *s, uint32_t depth);
+    void removeStmtChildren(const Stmt *s);
+    void addFunc(FuncDecl *f);
+
+    // Expr / Literal / Identifier buckets and their reverse maps.
+    std::vector<ExprSite> m_exprs[3];
+    std::unordered_map<const Expr *, uint32_t> m_exprPos[3];
+    std::vector<StmtSite> m_stmts;
+    std::unordered_map<const Stmt *, uint32_t> m_stmtPos;
+};
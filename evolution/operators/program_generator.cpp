@@ -0,0 +1,117 @@
+#include "program_generator.hpp"
+#include "../../core/parser/ast_printer.hpp"
+#include <algorithm>
+
+namespace
+{
+    class ProgramBuilder
+    {
+    public:
+        ProgramBuilder(const GeneratorConfig &c, RandomStream &r) : cfg(c), rng(r), grammar(c.grammar) {}
+
+        std::unique_ptr<Program> build()
+        {
+            auto prog = std::make_unique<Program>();
+            for (unsigned n = between(0, cfg.maxHeaders), i = 0; i < n; i++)
+            {
+                auto h = std::make_unique<HeaderDecl>();
+                h->name = "\"lib" + std::to_string(rng.below(100)) + ".gx\"";
+                prog->decls.push_back(std::move(h));
+            }
+            // Globals stay in the name table, so every function may use them.
+            for (unsigned n = between(0, cfg.maxGlobals), i = 0; i < n; i++)
+                prog->globalVars.push_back(grammar.varDecl(rng));
+
+            for (unsigned i = 0; i < cfg.maxBlockDecls; i++)
+                if (rng.chance(cfg.blockDeclChance))
+                    prog->decls.push_back(blockDecl(i));
+
+            unsigned funcs = between(cfg.minFuncs, cfg.maxFuncs);
+            for (unsigned i = 0; i < funcs; i++)
+                prog->decls.push_back(func(i == 0 ? "main" : "f" + std::to_string(i)));
+            return prog;
+        }
+
+    private:
+        const GeneratorConfig &cfg;
+        RandomStream &rng;
+        GenexGrammar grammar;
+
+        unsigned between(unsigned lo, unsigned hi)
+        {
+            return hi <= lo ? lo : lo + static_cast<unsigned>(rng.below(hi - lo + 1));
+        }
+
+        std::unique_ptr<FuncDecl> func(const std::string &name)
+        {
+            auto f = std::make_unique<FuncDecl>();
+            f->name = name;
+            size_t mark = grammar.nameCount();
+            for (unsigned n = between(0, cfg.maxParams), i = 0; i < n; i++)
+            {
+                DType t = GenexGrammar::valueType(rng);
+                std::string pname = grammar.freshName();
+                f->params.emplace_back(to_string(t), pname);
+                grammar.addName(pname, t);
+            }
+            Block body;
+            for (unsigned n = between(cfg.minBodyStmts, cfg.maxBodyStmts), i = 0; i < n; i++)
+                body.addStatement(grammar.statement(rng, cfg.grammar.maxStmtDepth));
+            f->body = std::move(body);
+            grammar.dropNames(mark);
+            return f;
+        }
+
+        std::unique_ptr<BlockDecl> blockDecl(unsigned i)
+        {
+            auto b = std::make_unique<BlockDecl>();
+            b->name = "B" + std::to_string(i);
+            size_t mark = grammar.nameCount();
+            for (unsigned n = between(0, cfg.maxBlockFields), k = 0; k < n; k++)
+                b->fields.push_back(grammar.varDecl(rng));
+            for (unsigned n = between(0, cfg.maxBlockMethods), k = 0; k < n; k++)
+                b->methods.push_back(func(b->name + "_m" + std::to_string(k)));
+            grammar.dropNames(mark);
+            return b;
+        }
+    };
+}
+
+std::unique_ptr<Program> ProgramGenerator::generate(uint64_t index) const
+{
+    RandomStream rng(m_seed, 0, index, RngStream::Init);
+    return ProgramBuilder(m_cfg, rng).build();
+}
+
+std::string ProgramGenerator::generateText(uint64_t index) const
+{
+    return AstPrinter::print(*generate(index));
+}
+
+std::vector<std::unique_ptr<Program>> ProgramGenerator::generate(uint64_t first, size_t count, ThreadPool &pool) const
+{
+    std::vector<std::unique_ptr<Program>> out(count);
+    pool.parallelFor(count, [&](size_t i, unsigned) { out[i] = generate(first + i); }, 16);
+    return out;
+}
+
+uint64_t ProgramGenerator::writeCorpus(std::FILE *out, uint64_t first, size_t count, ThreadPool &pool) const
+{
+    // Bounded batches keep memory flat however large the corpus is.
+    const size_t batch = std::max<size_t>(256, size_t(pool.size()) * 256);
+    std::vector<std::string> texts;
+    uint64_t written = 0;
+    for (size_t done = 0; done < count; done += batch)
+    {
+        size_t n = std::min(batch, count - done);
+        texts.assign(n, std::string());
+        pool.parallelFor(n, [&](size_t i, unsigned) { texts[i] = generateText(first + done + i); }, 16);
+        for (const auto &t : texts)
+        {
+            if (std::fwrite(t.data(), 1, t.size(), out) != t.size())
+                return 0;
+            written += t.size();
+        }
+    }
+    return written;
+}
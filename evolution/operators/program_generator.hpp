@@ -0,0 +1,75 @@
+#pragma once
+#include "../../core/parser/ast.hpp"
+#include "../../core/utils/thread_pool.hpp"
+#include "grammar_mutation.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Random whole-program generator for seeding populations and for
+// lexer/parser benchmark corpora.
+//
+// Program i of a corpus is drawn from RandomStream(seed, 0, i, Init) alone,
+// so any program can be regenerated on its own and a corpus is identical
+// whatever the thread count. Statements and expressions come from
+// GenexGrammar; this adds the top level: header(...), globals, Block
+// declarations with fields and methods, and @func definitions.
+//
+// The default config is for lexer, parser and loader benchmarks: it covers
+// every construct, and about 40% of its programs are Block declarations
+// with fields, which the checker and compiler reject (Unsupported). Seed
+// populations and run programs from GeneratorConfig::runnable() instead.
+
+struct GeneratorConfig
+{
+    GrammarConfig grammar; // expression / statement shape and construct mix
+
+    unsigned minFuncs = 1;
+    unsigned maxFuncs = 4;
+    unsigned maxParams = 3;
+    unsigned minBodyStmts = 2;
+    unsigned maxBodyStmts = 8;
+    unsigned maxHeaders = 2;
+    unsigned maxGlobals = 3;
+
+    double blockDeclChance = 0.3; // chance of each Block declaration slot
+    unsigned maxBlockDecls = 2;
+    unsigned maxBlockFields = 3;
+    unsigned maxBlockMethods = 2;
+
+    // Every program passes SemanticChecker and BytecodeCompiler: no Block
+    // fields, the rest as the default.
+    static GeneratorConfig runnable()
+    {
+        GeneratorConfig c;
+        c.maxBlockFields = 0;
+        return c;
+    }
+};
+
+class ProgramGenerator
+{
+public:
+    explicit ProgramGenerator(const GeneratorConfig &cfg = {}, uint64_t seed = 1) : m_cfg(cfg), m_seed(seed) {}
+
+    // Program number `index` of this generator's corpus.
+    std::unique_ptr<Program> generate(uint64_t index) const;
+    std::string generateText(uint64_t index) const;
+
+    // Programs [first, first + count), generated in parallel, in index order.
+    std::vector<std::unique_ptr<Program>> generate(uint64_t first, size_t count, ThreadPool &pool) const;
+
+    // Print programs [first, first + count) to `out` in index order; batches
+    // are generated in parallel. Returns the number of bytes written, or 0
+    // on a write error.
+    uint64_t writeCorpus(std::FILE *out, uint64_t first, size_t count, ThreadPool &pool) const;
+
+    const GeneratorConfig &config() const { return m_cfg; }
+
+private:
+    GeneratorConfig m_cfg;
+    uint64_t m_seed;
+};
@@ -0,0 +1,363 @@
+// Checkpointer crash recovery, and bit-exact resume of a racing run.
+//
+// Build and run from the repository root:
+//   g++ -std=c++20 -O2 -I. tests/checkpoint_recovery.cpp $(find core evolution -name '*.cpp') -lpthread -o checkpoint_recovery
+//   ./checkpoint_recovery [crash-rounds] [dir]
+//
+// The run races a small regression suite with a TestPrioritizer and a
+// FitnessCache attached, so both steer which candidates are dropped. A
+// reference run goes the whole way uninterrupted. Then:
+//
+//   resume  the run is checkpointed halfway, and continued from the
+//           checkpoint in a fresh controller, prioritizer and cache; its
+//           history and final population must equal the reference's. The
+//           same resume with the two snapshots dropped is reported, to
+//           show they matter.
+//   crash   a forked child runs with a checkpoint every generation and is
+//           SIGKILLed at some point, often inside a write. The parent
+//           open()s the directory (cutting off a half-written image),
+//           resumes from whatever the manifest describes, keeps
+//           checkpointing and must again end equal to the reference.
+//   damage  a pack shorter than its manifest says must be refused by
+//           open() and load(); a truncated manifest by load().
+
+#include "../core/lexer/lexer.hpp"
+#include "../core/parser/ast_hash.hpp"
+#include "../core/parser/parser.hpp"
+#include "../core/utils/timer.hpp"
+#include "../evolution/engine/checkpoint.hpp"
+#include "../evolution/operators/mutation.hpp"
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    const size_t kGenerations = 40;
+
+    const char *const kSeeds[] = {
+        "@func main(number x) { return x; }",
+        "@func main(number x) { return x * x; }",
+        "@func main(number x) { return x + 1; }",
+        "@func main(number x) { number y = x * 2; return y - 3; }",
+    };
+
+    TestSuite makeSuite()
+    {
+        TestSuite suite;
+        for (int x = -12; x < 12; x++)
+            suite.add({Value::number(x)}, Value::number(x * x + 1));
+        return suite;
+    }
+
+    std::vector<std::unique_ptr<Program>> seeds()
+    {
+        std::vector<std::unique_ptr<Program>> out;
+        for (const char *src : kSeeds)
+        {
+            Lexer lexer(src);
+            std::vector<Token> tokens = lexer.tokenize();
+            Parser parser(tokens);
+            out.push_back(parser.parse());
+        }
+        return out;
+    }
+
+    // A controller with everything a racing run attaches, built the same
+    // way every time.
+    struct Run
+    {
+        explicit Run(const TestSuite &suite)
+            : priority(suite, PriorityConfig{0.8, 16, 5}), cache(256, 4), ga(config(), suiteFitness(suite))
+        {
+            ga.setMutation(Mutator::makeMutationFn());
+            RaceConfig race;
+            race.keep = 8;
+            race.firstRung = 4;
+            ga.setRace(&suite, race);
+            ga.setTestPriority(&priority);
+            ga.setFitnessCache(&cache);
+        }
+
+        static GAConfig config()
+        {
+            GAConfig c;
+            c.threads = 2;
+            c.populationSize = 96;
+            c.generations = kGenerations;
+            c.seed = 7;
+            return c;
+        }
+
+        TestPrioritizer priority;
+        FitnessCache cache;
+        GAController ga;
+    };
+
+    // What a run leaves behind, minus timings.
+    struct Outcome
+    {
+        std::vector<std::vector<double>> history;
+        std::vector<std::pair<uint64_t, double>> population;
+    };
+
+    Outcome outcomeOf(const GAController &ga)
+    {
+        Outcome o;
+        for (const GenerationStats &s : ga.history())
+            o.history.push_back({double(s.generation), double(s.evaluated), double(s.duplicates),
+                                 double(s.cacheHits), double(s.raceDropped), double(s.casesRun),
+                                 double(s.casesSaved), double(s.casesImplied), s.bestFitness, s.meanFitness});
+        for (const Individual &ind : ga.population())
+            o.population.push_back({AstHasher::hash(*ind.program), ind.fitness.score});
+        return o;
+    }
+
+    // Generation at which two outcomes part, or -1 if they are equal.
+    long divergence(const Outcome &a, const Outcome &b)
+    {
+        size_t n = std::min(a.history.size(), b.history.size());
+        for (size_t g = 0; g < n; g++)
+            if (a.history[g] != b.history[g])
+                return static_cast<long>(g);
+        if (a.history.size() != b.history.size() || a.population != b.population)
+            return static_cast<long>(n);
+        return -1;
+    }
+
+    void stepTo(Run &run, size_t generations, Checkpointer *ckpt)
+    {
+        while (run.ga.generation() < generations)
+        {
+            run.ga.step();
+            if (ckpt)
+                ckpt->capture(run.ga);
+        }
+    }
+
+    void removeDir(const std::string &dir)
+    {
+        std::string cmd = "rm -rf '" + dir + "'";
+        if (std::system(cmd.c_str()) != 0)
+            std::printf("warning: could not remove %s\n", dir.c_str());
+    }
+
+    uint64_t fileSize(const std::string &path)
+    {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+    }
+
+    // The manifest's header, read directly; false if there is none.
+    bool headerOf(const std::string &dir, CheckpointHeader &h)
+    {
+        int fd = ::open((dir + "/checkpoint.bin").c_str(), O_RDONLY);
+        bool ok = fd >= 0 && ::read(fd, &h, sizeof(h)) == static_cast<ssize_t>(sizeof(h));
+        if (fd >= 0)
+            ::close(fd);
+        return ok;
+    }
+
+    std::string packOf(const std::string &dir, const CheckpointHeader &h)
+    {
+        return dir + "/pack-" + std::to_string(h.pack) + ".bin";
+    }
+
+    bool fail(const char *what, const std::string &detail)
+    {
+        std::printf("FAIL %s: %s\n", what, detail.c_str());
+        return false;
+    }
+
+    // Resume whatever `dir` holds into a fresh Run, checkpointing on, and
+    // finish it. `withSnapshots` false drops the prioritizer and cache.
+    bool resume(const TestSuite &suite, const std::string &dir, bool withSnapshots, Outcome &out,
+                size_t *from = nullptr)
+    {
+        CheckpointState state;
+        std::string error;
+        if (!Checkpointer::load(dir, state, &error))
+            return fail("load", error);
+        if (from)
+            *from = state.generation;
+        if (!withSnapshots)
+        {
+            state.priority.clear();
+            state.cache.clear();
+        }
+        Run run(suite);
+        if (!Checkpointer::restore(run.ga, std::move(state), &error))
+            return fail("restore", error);
+        Checkpointer ckpt;
+        if (!ckpt.open(dir, &error))
+            return fail("open", error);
+        stepTo(run, kGenerations, &ckpt);
+        if (!ckpt.flush())
+            return fail("flush", ckpt.error());
+        out = outcomeOf(run.ga);
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 8;
+    std::string base = argc > 2 ? argv[2] : "/tmp/checkpoint_recovery." + std::to_string(getpid());
+    removeDir(base);
+    mkdir(base.c_str(), 0755);
+
+    const TestSuite suite = makeSuite();
+    int failures = 0;
+
+    Outcome reference;
+    double span = wallSeconds();
+    {
+        Run run(suite);
+        run.ga.seed(seeds());
+        stepTo(run, kGenerations, nullptr);
+        reference = outcomeOf(run.ga);
+    }
+    span = wallSeconds() - span;
+
+    // resume
+    {
+        std::string dir = base + "/resume";
+        std::string error;
+        {
+            Run run(suite);
+            run.ga.seed(seeds());
+            Checkpointer ckpt;
+            if (!ckpt.open(dir, &error))
+                return fail("open", error), 1;
+            stepTo(run, kGenerations / 2, &ckpt);
+            if (!ckpt.flush())
+                return fail("flush", ckpt.error()), 1;
+        }
+        std::string copy = dir + ".copy";
+        std::string cmd = "cp -r '" + dir + "' '" + copy + "'";
+        if (std::system(cmd.c_str()) != 0)
+            return fail("copy", copy), 1;
+
+        Outcome resumed, bare;
+        if (!resume(suite, dir, true, resumed) || divergence(resumed, reference) >= 0)
+        {
+            std::printf("FAIL resume: parts from the reference at generation %ld\n", divergence(resumed, reference));
+            failures++;
+        }
+        if (resume(suite, copy, false, bare))
+            std::printf("resume: bit-exact; without prioritizer and cache snapshots it parts at generation %ld\n",
+                        divergence(bare, reference));
+    }
+
+    // crash
+    int recovered = 0, cut = 0, early = 0;
+    size_t resumedFrom = 0;
+    for (int r = 0; r < rounds; r++)
+    {
+        std::string dir = base + "/crash" + std::to_string(r);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            Run run(suite);
+            run.ga.seed(seeds());
+            Checkpointer ckpt;
+            if (!ckpt.open(dir))
+                _exit(1);
+            stepTo(run, kGenerations, &ckpt);
+            ckpt.flush();
+            _exit(0);
+        }
+        // Kills spread over the run's length.
+        usleep(static_cast<useconds_t>(1e6 * span * (r + 1) / rounds));
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+
+        CheckpointHeader h;
+        if (!headerOf(dir, h))
+        {
+            early++; // killed before the first manifest landed
+            continue;
+        }
+        // A pack longer than the manifest says holds images of a snapshot
+        // whose manifest never landed; open() in resume() cuts them off.
+        cut += fileSize(packOf(dir, h)) > h.packBytes;
+        Outcome out;
+        size_t from = 0;
+        if (!resume(suite, dir, true, out, &from) || divergence(out, reference) >= 0)
+        {
+            std::printf("FAIL crash round %d: resumed at generation %zu, parts at %ld\n", r, from,
+                        divergence(out, reference));
+            failures++;
+            continue;
+        }
+        CheckpointState last;
+        if (!Checkpointer::load(dir, last) || last.generation != kGenerations)
+        {
+            std::printf("FAIL crash round %d: checkpoint not continued after recovery\n", r);
+            failures++;
+            continue;
+        }
+        recovered++;
+        resumedFrom += from;
+    }
+    std::printf("crash: %d rounds recovered (%d with images past the manifest, mean resume generation %.1f), "
+                "%d killed before the first checkpoint\n",
+                recovered, cut, recovered ? double(resumedFrom) / recovered : 0.0, early);
+
+    // damage
+    {
+        std::string dir = base + "/resume";
+        CheckpointState state;
+        CheckpointHeader h;
+        std::string error;
+        if (!Checkpointer::load(dir, state, &error) || !headerOf(dir, h))
+            return fail("load", error), 1;
+        std::string pack = packOf(dir, h);
+
+        // Garbage past packBytes, as a write whose manifest never landed.
+        int fd = ::open(pack.c_str(), O_WRONLY | O_APPEND);
+        const char junk[] = "half an image";
+        if (fd < 0 || ::write(fd, junk, sizeof(junk)) != static_cast<ssize_t>(sizeof(junk)))
+            return fail("append", pack), 1;
+        ::close(fd);
+        {
+            Checkpointer ckpt;
+            if (!ckpt.open(dir, &error) || fileSize(pack) != h.packBytes)
+            {
+                std::printf("FAIL damage: open() kept bytes past the manifest's end\n");
+                failures++;
+            }
+        }
+
+        // A pack missing bytes the manifest points at.
+        if (truncate(pack.c_str(), static_cast<off_t>(h.packBytes / 2)) != 0)
+            return fail("truncate", pack), 1;
+        Checkpointer ckpt;
+        if (ckpt.open(dir, &error) || Checkpointer::load(dir, state, &error))
+        {
+            std::printf("FAIL damage: a truncated pack was accepted\n");
+            failures++;
+        }
+
+        // A manifest cut short.
+        std::string manifest = dir + "/checkpoint.bin";
+        if (truncate(manifest.c_str(), static_cast<off_t>(fileSize(manifest) - 1)) != 0)
+            return fail("truncate", manifest), 1;
+        if (Checkpointer::load(dir, state, &error))
+        {
+            std::printf("FAIL damage: a truncated manifest was accepted\n");
+            failures++;
+        }
+    }
+
+    removeDir(base);
+    std::printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,209 @@
+// Differential check of the bytecode VM against the tree walker.
+//
+// Build and run from the repository root:
+//   g++ -std=c++20 -O2 -I. tests/vm_differential.cpp $(find core evolution -name '*.cpp') -lpthread -o vm_differential
+//   ./vm_differential [corpus-programs]
+//
+// Runs a list of handwritten regression programs, then every function of
+// the first programs of the runnable generator corpus (seed 1) with a few
+// argument sets, on both engines. Status, result and print output must
+// match exactly; exits non-zero on the first few mismatches.
+
+#include "../core/lexer/lexer.hpp"
+#include "../core/parser/parser.hpp"
+#include "../core/vm/compiler.hpp"
+#include "../core/vm/tree_walker.hpp"
+#include "../core/vm/vm.hpp"
+#include "../evolution/operators/program_generator.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Case
+    {
+        const char *name;
+        const char *source;
+        const char *expected; // print output of main(), or nullptr to only compare engines
+    };
+
+    // Each case pins a bug the engines once disagreed on.
+    const Case kCases[] = {
+        // x86 propagates the first operand's NaN, and the C++ compiler may
+        // commute `*` differently in each engine: NaNs must be canonical.
+        {"nan sign", R"(
+            @func main() {
+                number z = 0;
+                number n = z / z;
+                number m = -n;
+                print(n, m, n * m, m * n, n + m, m + n, -m);
+                print((n * -n) % -(97 * n));
+                return 0;
+            }
+        )",
+         "-nan -nan -nan -nan -nan -nan -nan\n-nan\n"},
+        // Vector-scalar arithmetic read its operands after writing a result
+        // register that aliased one of them.
+        {"vector aliasing", R"(
+            @func main() {
+                vector v = vec(1, 2, 3);
+                v = v * 2;
+                print(v);
+                number s = 12;
+                s = s - v;
+                print(s);
+                number t = 12;
+                t = t / v;
+                print(t);
+                return 0;
+            }
+        )",
+         "[2, 4, 6]\n[10, 8, 6]\n[6, 3, 2]\n"},
+        // Constant pooling took -0 for 0 and merged these.
+        {"signed zero constants", R"(
+            @func main() {
+                print(1 / im("lit:3-0i"), 1 / im("lit:3+0i"));
+                print(1 / min("lit:[-0, 1]"), 1 / min("lit:[0, 1]"));
+                return 0;
+            }
+        )",
+         "-inf inf\n-inf inf\n"},
+    };
+
+    std::string describe(VmStatus status, const Value &value, const std::string &output)
+    {
+        return std::string(to_string(status)) + " " + formatValue(value) + " [" + output + "]";
+    }
+
+    // Runs `entry` on both engines; returns false and reports on a mismatch.
+    bool compare(const char *label, const Program &prog, const Module &module, const std::string &entry,
+                 const std::vector<Value> &args, const char *expected = nullptr)
+    {
+        VM vm;
+        VmLimits limits;
+        limits.maxSteps = 200000;
+        vm.setLimits(limits);
+        VmResult a = vm.run(module, entry, args);
+        // The tree walker has no step budget, so only programs that finish
+        // on the VM are compared.
+        if (a.status == VmStatus::StepLimit || a.status == VmStatus::MemoryLimit)
+            return true;
+        TreeWalker walker;
+        VmResult b = walker.run(prog, entry, args);
+        std::string left = describe(a.status, a.value, vm.output());
+        std::string right = describe(b.status, b.value, walker.output());
+        if (left != right)
+        {
+            std::printf("MISMATCH %s %s\n  vm:          %s\n  tree walker: %s\n", label, entry.c_str(),
+                        left.c_str(), right.c_str());
+            return false;
+        }
+        if (expected && vm.output() != expected)
+        {
+            std::printf("WRONG %s %s\n  got:      %s\n  expected: %s\n", label, entry.c_str(), vm.output().c_str(),
+                        expected);
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t corpus = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 3000;
+    int failures = 0;
+
+    for (const Case &c : kCases)
+    {
+        Lexer lexer(c.source);
+        std::vector<Token> tokens = lexer.tokenize();
+        // Only generated programs carry complex and vector literals; the
+        // lexer has no syntax for them, so a case spells one as "lit:...".
+        for (Token &t : tokens)
+            if (t.type == TokenType::STRING_LITERAL && t.lexeme.rfind("\"lit:", 0) == 0)
+            {
+                t.lexeme = t.lexeme.substr(5, t.lexeme.size() - 6);
+                t.type = t.lexeme[0] == '[' ? TokenType::VECTOR_LITERAL : TokenType::COMPLEX_LITERAL;
+            }
+        Parser parser(tokens);
+        parser.setEcho(false);
+        auto prog = parser.parse();
+        BytecodeCompiler compiler;
+        auto module = prog && parser.errors().empty() ? compiler.compile(*prog) : nullptr;
+        if (!module)
+        {
+            std::printf("BROKEN case %s does not compile\n", c.name);
+            failures++;
+            continue;
+        }
+        failures += !compare(c.name, *prog, *module, "main", {}, c.expected);
+    }
+
+    // The step budget once charged a call one step whatever its length, so
+    // fan-out recursion through a long body ran on for ~300 instructions a
+    // step. 4095 calls of ~600 instructions must exhaust a 200000 budget
+    // and fit in the default one.
+    {
+        std::string source = "@func f(number n) {\n    number x = n;\n";
+        for (int s = 0; s < 300; s++)
+            source += "    x = x * 3 + n;\n";
+        source += "    if (n > 0) {\n        x = x + f(n - 1) + f(n - 1);\n    }\n    return x;\n}\n";
+        Lexer lexer(source);
+        std::vector<Token> tokens = lexer.tokenize();
+        Parser parser(tokens);
+        parser.setEcho(false);
+        auto prog = parser.parse();
+        BytecodeCompiler compiler;
+        auto module = prog && parser.errors().empty() ? compiler.compile(*prog) : nullptr;
+        VM vm;
+        VmResult ok = module ? vm.run(*module, "f", {Value::number(11)}) : VmResult();
+        VmLimits limits;
+        limits.maxSteps = 200000;
+        vm.setLimits(limits);
+        VmResult cut = module ? vm.run(*module, "f", {Value::number(11)}) : VmResult();
+        if (ok.status != VmStatus::Ok || cut.status != VmStatus::StepLimit)
+        {
+            std::printf("WRONG long-bodied recursion: %s with the default budget (%llu steps), %s with 200000\n",
+                        to_string(ok.status), static_cast<unsigned long long>(ok.steps), to_string(cut.status));
+            failures++;
+        }
+    }
+
+    ProgramGenerator gen(GeneratorConfig::runnable());
+    size_t functions = 0;
+    for (size_t i = 0; i < corpus && failures < 10; i++)
+    {
+        auto prog = gen.generate(i);
+        BytecodeCompiler compiler;
+        auto module = compiler.compile(*prog);
+        std::string label = "corpus " + std::to_string(i);
+        if (!module)
+        {
+            std::printf("BROKEN %s does not compile\n", label.c_str());
+            failures++;
+            continue;
+        }
+        for (const auto &d : prog->decls)
+        {
+            auto f = dynamic_cast<const FuncDecl *>(d.get());
+            if (!f)
+                continue;
+            for (double x : {0.0, 3.0, -1.5})
+            {
+                std::vector<Value> args;
+                for (const auto &param : f->params)
+                    args.push_back(param.first == "bool" ? Value::fromBool(x != 0)
+                                   : param.first == "text" ? Value()
+                                                           : Value::number(x));
+                failures += !compare(label.c_str(), *prog, *module, f->name, args);
+                functions++;
+            }
+        }
+    }
+
+    std::printf("%zu cases, %zu corpus runs, %d failures\n", std::size(kCases) + 1, functions, failures);
+    return failures ? 1 : 0;
+}